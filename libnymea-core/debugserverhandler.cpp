@@ -37,6 +37,10 @@
 #include "nymeaconfiguration.h"
 #include "stdio.h"
 #include "version.h"
+#include "diagnostics/eventloopmonitor.h"
+#include "diagnostics/tracer.h"
+#include "diagnostics/memoryaccounting.h"
+#include "diagnostics/allocationsampler.h"
 
 #include <QXmlStreamWriter>
 #include <QCoreApplication>
@@ -472,6 +476,57 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
     }
 
+    if (requestPath.startsWith("/debug/eventloop")) {
+        qCDebug(dcDebugServer()) << "Request event loop statistics";
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json");
+        reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->eventLoopMonitor()->toVariantMap()).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
+    if (requestPath.startsWith("/debug/traces")) {
+        if (requestQuery.isEmpty()) {
+            // Chrome trace event format, to be loaded into chrome://tracing or ui.perfetto.dev
+            qCDebug(dcDebugServer()) << "Request traces";
+            HttpReply *reply = HttpReply::createSuccessReply();
+            reply->setHeader(HttpReply::ContentTypeHeader, "application/json");
+            reply->setPayload(Tracer::instance()->toChromeTraceJson());
+            return reply;
+        }
+
+        if (requestQuery.hasQueryItem("enabled")) {
+            bool enabled = QVariant(requestQuery.queryItemValue("enabled")).toBool();
+            qCDebug(dcDebugServer()) << "Tracing" << (enabled ? "enabled" : "disabled");
+            Tracer::instance()->setEnabled(enabled);
+        }
+        if (QVariant(requestQuery.queryItemValue("clear")).toBool()) {
+            qCDebug(dcDebugServer()) << "Clearing traces";
+            Tracer::instance()->clear();
+        }
+        return HttpReply::createSuccessReply();
+    }
+
+    if (requestPath.startsWith("/debug/memory")) {
+        if (requestQuery.isEmpty()) {
+            qCDebug(dcDebugServer()) << "Request memory usage";
+            HttpReply *reply = HttpReply::createSuccessReply();
+            reply->setHeader(HttpReply::ContentTypeHeader, "application/json");
+            reply->setPayload(QJsonDocument::fromVariant(NymeaCore::instance()->memoryAccounting()->toVariantMap()).toJson(QJsonDocument::Indented));
+            return reply;
+        }
+
+        if (QVariant(requestQuery.queryItemValue("reset")).toBool()) {
+            qCDebug(dcDebugServer()) << "Resetting allocation samples";
+            AllocationSampler::reset();
+        }
+        if (requestQuery.hasQueryItem("sampling")) {
+            int interval = requestQuery.queryItemValue("sampling").toInt();
+            qCDebug(dcDebugServer()) << "Allocation sampling interval set to" << interval << "bytes";
+            AllocationSampler::setSamplingInterval(interval);
+        }
+        return HttpReply::createSuccessReply();
+    }
+
     if (requestPath.startsWith("/debug/report")) {
 
         // The client can poll this url in order to get information about the current report generating process.
@@ -0,0 +1,405 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "allocationsampler.h"
+#include "loggingcategories.h"
+
+#include <QMutex>
+
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#include <execinfo.h>
+#include <cxxabi.h>
+
+namespace nymeaserver {
+
+static const int maxFrames = 10;
+// operator new and the sampler itself
+static const int skippedFrames = 2;
+
+// Live samples are spread over shards by address, so frees on different threads rarely contend
+static const int shardCount = 16;
+static const int filterSize = 1 << 16;
+
+class SampledSite
+{
+public:
+    void *frames[maxFrames];
+    int depth = 0;
+    quint64 samples = 0;
+    quint64 liveSamples = 0;
+    quint64 bytes = 0;
+    quint64 liveBytes = 0;
+};
+
+class SampledAllocation
+{
+public:
+    quint64 site = 0;
+    quint64 bytes = 0;
+};
+
+class SamplerShard
+{
+public:
+    QMutex mutex;
+    std::unordered_map<void*, SampledAllocation> live;
+};
+
+// Never destroyed, frees still arrive while static objects are torn down at exit
+class SamplerState
+{
+public:
+    QMutex sitesMutex;
+    std::unordered_map<quint64, SampledSite> sites;
+    SamplerShard shards[shardCount];
+};
+
+static std::atomic<int> s_samplingInterval(0);
+// Set by the first sample. Until then there is nothing to look up for a free.
+static std::atomic<bool> s_sampled(false);
+static std::atomic<quint64> s_liveBytes(0);
+
+// Number of live samples per address hash. Zero initialized before any constructor runs, so a free
+// can check it at any time. Frees of addresses whose slot is zero, nearly all of them, take no lock.
+static std::atomic<quint32> s_liveFilter[filterSize];
+
+// Allocations made by the sampler itself are neither sampled nor looked up
+static thread_local bool t_inSampler = false;
+static thread_local qint64 t_countdown = 0;
+
+// Allocations made while a guard exists on the thread bypass the sampler
+class SamplerGuard
+{
+public:
+    SamplerGuard():
+        m_wasInSampler(t_inSampler)
+    {
+        t_inSampler = true;
+    }
+    ~SamplerGuard()
+    {
+        t_inSampler = m_wasInSampler;
+    }
+
+private:
+    bool m_wasInSampler;
+};
+
+static SamplerState *createSamplerState()
+{
+    SamplerGuard guard;
+    return new SamplerState();
+}
+
+static SamplerState *samplerState()
+{
+    static SamplerState *state = createSamplerState();
+    return state;
+}
+
+static quint64 addressHash(void *ptr)
+{
+    return (static_cast<quint64>(reinterpret_cast<quintptr>(ptr)) >> 4) * 0x9e3779b97f4a7c15ULL;
+}
+
+static std::atomic<quint32> &liveFilterSlot(quint64 hash)
+{
+    return s_liveFilter[hash >> 48];
+}
+
+static SamplerShard &shard(quint64 hash)
+{
+    return samplerState()->shards[hash & (shardCount - 1)];
+}
+
+// Locks the given mutex. Allocations made meanwhile, including the ones of a contended mutex, bypass the sampler.
+class SamplerLocker
+{
+public:
+    explicit SamplerLocker(QMutex *mutex):
+        m_mutex(mutex)
+    {
+        m_mutex->lock();
+    }
+    ~SamplerLocker()
+    {
+        m_mutex->unlock();
+    }
+
+private:
+    SamplerGuard m_guard;
+    QMutex *m_mutex;
+};
+
+// Called with the shard of the allocation locked
+static void forgetSample(SamplerShard &allocationShard, std::unordered_map<void*, SampledAllocation>::iterator it, quint64 hash)
+{
+    SampledAllocation allocation = it->second;
+    allocationShard.live.erase(it);
+    liveFilterSlot(hash).fetch_sub(1, std::memory_order_relaxed);
+    s_liveBytes.fetch_sub(allocation.bytes, std::memory_order_relaxed);
+
+    SamplerLocker locker(&samplerState()->sitesMutex);
+    SampledSite &site = samplerState()->sites[allocation.site];
+    site.liveSamples--;
+    site.liveBytes -= allocation.bytes;
+}
+
+static void sampleAllocation(void *ptr, std::size_t size, int interval)
+{
+    SamplerGuard guard;
+    // Set on the allocating thread before the sample is visible, so any thread that can free ptr sees it
+    s_sampled.store(true, std::memory_order_relaxed);
+
+    void *frames[maxFrames + skippedFrames];
+    int depth = backtrace(frames, maxFrames + skippedFrames) - skippedFrames;
+    depth = std::max(depth, 0);
+
+    quint64 key = 14695981039346656037ULL;
+    for (int i = 0; i < depth; i++) {
+        key = (key ^ reinterpret_cast<quintptr>(frames[i + skippedFrames])) * 1099511628211ULL;
+    }
+    quint64 bytes = std::max<quint64>(size, interval);
+
+    quint64 hash = addressHash(ptr);
+    SamplerShard &allocationShard = shard(hash);
+    SamplerLocker shardLocker(&allocationShard.mutex);
+
+    // Memory released with free() behind our back may come back here
+    std::unordered_map<void*, SampledAllocation>::iterator stale = allocationShard.live.find(ptr);
+    if (stale != allocationShard.live.end()) {
+        forgetSample(allocationShard, stale, hash);
+    }
+    SampledAllocation &allocation = allocationShard.live[ptr];
+    allocation.site = key;
+    allocation.bytes = bytes;
+    liveFilterSlot(hash).fetch_add(1, std::memory_order_release);
+    s_liveBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    SamplerLocker sitesLocker(&samplerState()->sitesMutex);
+    SampledSite &site = samplerState()->sites[key];
+    if (site.depth == 0) {
+        std::memcpy(site.frames, frames + skippedFrames, sizeof(void*) * depth);
+        site.depth = depth;
+    }
+    site.samples++;
+    site.liveSamples++;
+    site.bytes += bytes;
+    site.liveBytes += bytes;
+}
+
+static void *allocate(std::size_t size)
+{
+    void *ptr;
+    while (!(ptr = std::malloc(size ? size : 1))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+
+    int interval = s_samplingInterval.load(std::memory_order_relaxed);
+    if (interval > 0 && !t_inSampler) {
+        t_countdown -= static_cast<qint64>(size);
+        if (t_countdown <= 0) {
+            t_countdown = interval;
+            sampleAllocation(ptr, size, interval);
+        }
+    }
+    return ptr;
+}
+
+static void deallocate(void *ptr)
+{
+    if (ptr && s_sampled.load(std::memory_order_relaxed) && !t_inSampler) {
+        quint64 hash = addressHash(ptr);
+        if (liveFilterSlot(hash).load(std::memory_order_acquire) > 0) {
+            SamplerShard &allocationShard = shard(hash);
+            SamplerLocker locker(&allocationShard.mutex);
+            std::unordered_map<void*, SampledAllocation>::iterator it = allocationShard.live.find(ptr);
+            if (it != allocationShard.live.end()) {
+                forgetSample(allocationShard, it, hash);
+            }
+        }
+    }
+    std::free(ptr);
+}
+
+static QString symbolize(const char *symbol)
+{
+    // Format: module(mangled+offset) [address]
+    QString frame = QString::fromLocal8Bit(symbol);
+    int begin = frame.indexOf('(');
+    int end = frame.indexOf('+', begin);
+    if (begin < 0 || end < 0 || end - begin <= 1) {
+        return frame;
+    }
+    QByteArray mangled = frame.mid(begin + 1, end - begin - 1).toLocal8Bit();
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled.constData(), nullptr, nullptr, &status);
+    if (status != 0 || !demangled) {
+        return frame;
+    }
+    QString name = QString::fromLocal8Bit(demangled);
+    std::free(demangled);
+    return name;
+}
+
+QVariantMap AllocationSampler::Site::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("stack", stack);
+    map.insert("samples", samples);
+    map.insert("liveSamples", liveSamples);
+    map.insert("estimatedBytes", estimatedBytes);
+    map.insert("estimatedLiveBytes", estimatedLiveBytes);
+    return map;
+}
+
+int AllocationSampler::samplingInterval()
+{
+    return s_samplingInterval.load(std::memory_order_relaxed);
+}
+
+void AllocationSampler::setSamplingInterval(int bytes)
+{
+    s_samplingInterval.store(qMax(0, bytes), std::memory_order_relaxed);
+}
+
+QList<AllocationSampler::Site> AllocationSampler::sites(int limit)
+{
+    QList<SampledSite> sampledSites;
+    {
+        SamplerLocker locker(&samplerState()->sitesMutex);
+        for (std::unordered_map<quint64, SampledSite>::const_iterator it = samplerState()->sites.begin(); it != samplerState()->sites.end(); ++it) {
+            sampledSites.append(it->second);
+        }
+    }
+
+    std::sort(sampledSites.begin(), sampledSites.end(), [](const SampledSite &a, const SampledSite &b){
+        return a.liveBytes != b.liveBytes ? a.liveBytes > b.liveBytes : a.bytes > b.bytes;
+    });
+
+    QList<Site> ret;
+    for (int i = 0; i < qMin(limit, sampledSites.count()); i++) {
+        const SampledSite &sampledSite = sampledSites.at(i);
+        Site site;
+        char **symbols = backtrace_symbols(sampledSite.frames, sampledSite.depth);
+        for (int j = 0; symbols && j < sampledSite.depth; j++) {
+            site.stack.append(symbolize(symbols[j]));
+        }
+        std::free(symbols);
+        site.samples = sampledSite.samples;
+        site.liveSamples = sampledSite.liveSamples;
+        site.estimatedBytes = sampledSite.bytes;
+        site.estimatedLiveBytes = sampledSite.liveBytes;
+        ret.append(site);
+    }
+    return ret;
+}
+
+quint64 AllocationSampler::estimatedLiveBytes()
+{
+    return s_liveBytes.load(std::memory_order_relaxed);
+}
+
+void AllocationSampler::reset()
+{
+    SamplerState *state = samplerState();
+    for (int i = 0; i < shardCount; i++) {
+        SamplerLocker locker(&state->shards[i].mutex);
+        for (std::unordered_map<void*, SampledAllocation>::const_iterator it = state->shards[i].live.begin(); it != state->shards[i].live.end(); ++it) {
+            liveFilterSlot(addressHash(it->first)).fetch_sub(1, std::memory_order_relaxed);
+            s_liveBytes.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+        }
+        state->shards[i].live.clear();
+    }
+    SamplerLocker locker(&state->sitesMutex);
+    state->sites.clear();
+}
+
+}
+
+// Replacing the global allocation functions in this library takes precedence over the C++ runtime
+// as it is linked before it, for nymead as well as for the tests.
+void *operator new(std::size_t size)
+{
+    return nymeaserver::allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return nymeaserver::allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {
+        return nymeaserver::allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try {
+        return nymeaserver::allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *ptr) noexcept
+{
+    nymeaserver::deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    nymeaserver::deallocate(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    nymeaserver::deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    nymeaserver::deallocate(ptr);
+}
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ALLOCATIONSAMPLER_H
+#define ALLOCATIONSAMPLER_H
+
+#include <QStringList>
+#include <QVariantMap>
+#include <QList>
+
+namespace nymeaserver {
+
+// Samples heap allocations made through operator new, one per samplingInterval bytes allocated on a
+// thread. A sample stands for the bytes allocated since the previous one, so the estimates converge to
+// the real numbers for the call sites allocating most. Freed samples are tracked even after sampling
+// has been disabled again.
+//
+// Sampling can be switched on and off at runtime. Disabled, an allocation costs a single atomic load.
+// So does a free as long as sampling has never been enabled. After that, a free costs a table lookup
+// without locking, unless the freed address may be a live sample.
+//
+// Memory obtained with malloc() directly is not seen. This includes the storage of Qt's implicitly shared
+// containers, e.g. QByteArray, QString, QList and QHash, so the estimates only cover objects created with new.
+class AllocationSampler
+{
+public:
+    class Site
+    {
+    public:
+        QStringList stack;
+        quint64 samples = 0;
+        quint64 liveSamples = 0;
+        quint64 estimatedBytes = 0;
+        quint64 estimatedLiveBytes = 0;
+
+        QVariantMap toVariantMap() const;
+    };
+
+    // In bytes, 0 disables sampling
+    static int samplingInterval();
+    static void setSamplingInterval(int bytes);
+
+    // The call sites holding most of the sampled live memory first
+    static QList<Site> sites(int limit = 20);
+    static quint64 estimatedLiveBytes();
+    static void reset();
+};
+
+}
+
+#endif // ALLOCATIONSAMPLER_H
@@ -0,0 +1,430 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "eventloopmonitor.h"
+#include "metricsregistry.h"
+#include "loggingcategories.h"
+#include "integrations/integrationplugin.h"
+#include "integrations/thing.h"
+
+#include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QDateTime>
+#include <QThread>
+#include <QTimer>
+#include <QEvent>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <time.h>
+
+namespace nymeaserver {
+
+// Checks from a separate thread whether the main thread is stuck in a handler
+class EventLoopWatchdog : public QThread
+{
+public:
+    EventLoopWatchdog(EventLoopMonitor *monitor, int threshold):
+        m_monitor(monitor),
+        m_threshold(threshold)
+    {
+    }
+
+    void stop()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        m_condition.wakeAll();
+    }
+
+protected:
+    void run() override
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_stopped) {
+            m_condition.wait(&m_mutex, static_cast<unsigned long>(qMax(m_threshold / 4, 10)));
+            if (!m_stopped) {
+                m_monitor->checkStall(m_threshold);
+            }
+        }
+    }
+
+private:
+    EventLoopMonitor *m_monitor = nullptr;
+    int m_threshold = 0;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    bool m_stopped = false;
+};
+
+std::atomic<EventLoopMonitor*> EventLoopMonitor::s_instance{nullptr};
+
+QVariantMap EventLoopMonitor::SlowDispatch::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("timestamp", timestamp);
+    map.insert("duration", duration);
+    map.insert("eventType", eventType);
+    map.insert("receiverClass", receiverClass);
+    map.insert("receiverName", receiverName);
+    map.insert("signal", signal);
+    map.insert("pluginId", pluginId.toString());
+    map.insert("pluginName", pluginName);
+    return map;
+}
+
+EventLoopMonitor::EventLoopMonitor(QObject *parent):
+    QObject(parent)
+{
+    qRegisterMetaType<nymeaserver::EventLoopMonitor::SlowDispatch>();
+
+    MetricsRegistry *metrics = MetricsRegistry::instance();
+    metrics->registerHistogram("nymea_event_loop_lag_seconds", "Delay of a timer in the main event loop beyond its interval", MetricsRegistry::latencyBuckets(), 0.000001);
+    metrics->registerHistogram("nymea_event_loop_dispatch_seconds", "Time spent dispatching a single event in the main thread", MetricsRegistry::latencyBuckets(), 0.000001);
+    metrics->registerCounter("nymea_event_loop_slow_dispatches_total", "Event dispatches exceeding the slow dispatch threshold per plugin", "plugin");
+    metrics->registerCounter("nymea_event_loop_stalls_total", "Times the watchdog found the main event loop blocked");
+    metrics->registerHistogram("nymea_plugin_dispatch_cpu_seconds", "Thread CPU time of event dispatches per plugin", MetricsRegistry::latencyBuckets(), 0.000001, "plugin");
+    m_dispatchMetric = metrics->histogram("nymea_event_loop_dispatch_seconds");
+
+    m_clock.start();
+
+    // Time spent waiting for events in a nested event loop is not spent in the outer handler
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance(thread());
+    if (dispatcher) {
+        connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, [this](){
+            m_blockStart = m_clock.nsecsElapsed();
+            m_busy = false;
+        }, Qt::DirectConnection);
+        connect(dispatcher, &QAbstractEventDispatcher::awake, this, [this](){
+            if (m_blockStart == 0) {
+                return;
+            }
+            qint64 now = m_clock.nsecsElapsed();
+            if (!m_frames.isEmpty()) {
+                m_frames.last().nested += now - m_blockStart;
+            }
+            m_blockStart = 0;
+            m_lastProgress = now;
+            m_busy = !m_frames.isEmpty();
+        }, Qt::DirectConnection);
+    }
+
+    // A late timeout means the event loop has been busy with something else
+    m_lagTimer = new QTimer(this);
+    m_lagTimer->setTimerType(Qt::PreciseTimer);
+    m_lagTimer->setInterval(1000);
+    m_lagClock.start();
+    MetricHistogram *lagMetric = metrics->histogram("nymea_event_loop_lag_seconds");
+    connect(m_lagTimer, &QTimer::timeout, this, [this, lagMetric](){
+        qint64 lag = m_lagClock.restart() - m_lagTimer->interval();
+        lagMetric->observe(static_cast<quint64>(qMax(lag, static_cast<qint64>(0))) * 1000);
+    });
+    m_lagTimer->start();
+
+    restartWatchdog();
+
+    s_instance = this;
+}
+
+EventLoopMonitor::~EventLoopMonitor()
+{
+    if (s_instance == this) {
+        s_instance = nullptr;
+    }
+    if (m_watchdog) {
+        m_watchdog->stop();
+        m_watchdog->wait();
+        delete m_watchdog;
+    }
+}
+
+/*! Returns the monitor of the main event loop or nullptr if there is none. */
+EventLoopMonitor *EventLoopMonitor::instance()
+{
+    return s_instance;
+}
+
+int EventLoopMonitor::slowDispatchThreshold() const
+{
+    return m_slowDispatchThreshold;
+}
+
+void EventLoopMonitor::setSlowDispatchThreshold(int milliseconds)
+{
+    m_slowDispatchThreshold = milliseconds;
+}
+
+int EventLoopMonitor::stallThreshold() const
+{
+    return m_stallThreshold;
+}
+
+void EventLoopMonitor::setStallThreshold(int milliseconds)
+{
+    if (m_stallThreshold == milliseconds) {
+        return;
+    }
+    m_stallThreshold = milliseconds;
+    restartWatchdog();
+}
+
+bool EventLoopMonitor::pluginCpuAccounting() const
+{
+    return m_pluginCpuAccounting;
+}
+
+void EventLoopMonitor::setPluginCpuAccounting(bool enabled)
+{
+    // Only start accounting for dispatches beginning from now on
+    if (enabled && !m_pluginCpuAccounting) {
+        for (int i = 0; i < m_frames.count(); i++) {
+            m_frames[i].cpuStart = -1;
+        }
+    }
+    m_pluginCpuAccounting = enabled;
+}
+
+QList<EventLoopMonitor::SlowDispatch> EventLoopMonitor::slowDispatches() const
+{
+    return m_slowDispatches;
+}
+
+QHash<QString, qint64> EventLoopMonitor::pluginCpuTime() const
+{
+    return m_pluginCpuTime;
+}
+
+QVariantMap EventLoopMonitor::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("slowDispatchThreshold", m_slowDispatchThreshold);
+    map.insert("stallThreshold", m_stallThreshold);
+    map.insert("pluginCpuAccounting", m_pluginCpuAccounting);
+
+    QVariantList slowDispatches;
+    foreach (const SlowDispatch &dispatch, m_slowDispatches) {
+        slowDispatches.append(dispatch.toVariantMap());
+    }
+    map.insert("slowDispatches", slowDispatches);
+
+    QVariantMap pluginCpuTime;
+    foreach (const QString &plugin, m_pluginCpuTime.keys()) {
+        pluginCpuTime.insert(plugin, m_pluginCpuTime.value(plugin));
+    }
+    map.insert("pluginCpuTime", pluginCpuTime);
+    return map;
+}
+
+void EventLoopMonitor::beginDispatch(QObject *receiver, QEvent *event)
+{
+    Frame frame;
+    frame.start = m_clock.nsecsElapsed();
+    frame.receiver = receiver;
+    frame.metaObject = receiver->metaObject();
+    frame.eventType = event->type();
+    // The receiver of a deferred delete won't survive the dispatch
+    if (event->type() != QEvent::DeferredDelete) {
+        frame.guard = receiver;
+    }
+    frame.cpuStart = m_pluginCpuAccounting ? threadCpuTime() : -1;
+    m_frames.append(frame);
+
+    m_currentMetaObject = frame.metaObject;
+    m_lastProgress = frame.start;
+    m_busy = true;
+}
+
+void EventLoopMonitor::endDispatch()
+{
+    if (m_frames.isEmpty()) {
+        return;
+    }
+
+    Frame frame = m_frames.takeLast();
+    qint64 now = m_clock.nsecsElapsed();
+    qint64 duration = now - frame.start;
+    qint64 exclusive = qMax(duration - frame.nested, static_cast<qint64>(0)) / 1000;
+    qint64 cpuTime = frame.cpuStart >= 0 ? threadCpuTime() - frame.cpuStart : -1;
+
+    if (!m_frames.isEmpty()) {
+        m_frames.last().nested += duration;
+        if (cpuTime >= 0 && m_frames.last().cpuStart >= 0) {
+            // The parent's CPU time must not include ours
+            m_frames.last().cpuStart += cpuTime;
+        }
+        m_currentMetaObject = m_frames.last().metaObject;
+    } else {
+        m_currentMetaObject = nullptr;
+        m_busy = false;
+    }
+    m_lastProgress = now;
+
+    m_dispatchMetric->observe(static_cast<quint64>(exclusive));
+
+    if (cpuTime >= 0) {
+        PluginId pluginId; QString pluginName;
+        resolvePlugin(frame.guard.data(), &pluginId, &pluginName);
+        QString plugin = !pluginName.isEmpty() ? pluginName : !pluginId.isNull() ? pluginId.toString() : QString("core");
+        m_pluginCpuTime[plugin] += cpuTime;
+        MetricsRegistry::instance()->histogram("nymea_plugin_dispatch_cpu_seconds", plugin)->observe(static_cast<quint64>(cpuTime));
+    }
+
+    if (m_slowDispatchThreshold <= 0 || exclusive < static_cast<qint64>(m_slowDispatchThreshold) * 1000) {
+        return;
+    }
+
+    SlowDispatch dispatch;
+    dispatch.timestamp = QDateTime::currentMSecsSinceEpoch();
+    dispatch.duration = exclusive;
+    dispatch.eventType = eventTypeName(frame.eventType);
+    dispatch.receiverClass = QString::fromLatin1(frame.metaObject->className());
+    if (!frame.guard.isNull()) {
+        dispatch.receiverName = frame.guard->objectName();
+        if (qobject_cast<QTimer*>(frame.guard.data())) {
+            dispatch.signal = "timeout()";
+        } else if (qobject_cast<QSocketNotifier*>(frame.guard.data())) {
+            dispatch.signal = "activated(int)";
+        }
+    }
+    resolvePlugin(frame.guard.data(), &dispatch.pluginId, &dispatch.pluginName);
+
+    m_slowDispatches.append(dispatch);
+    while (m_slowDispatches.count() > 100) {
+        m_slowDispatches.removeFirst();
+    }
+
+    QString plugin = !dispatch.pluginName.isEmpty() ? dispatch.pluginName : !dispatch.pluginId.isNull() ? dispatch.pluginId.toString() : QString("core");
+    MetricsRegistry::instance()->counter("nymea_event_loop_slow_dispatches_total", plugin)->increment();
+
+    qCWarning(dcEventLoop()).nospace() << "Slow event handler: " << dispatch.eventType << " event for " << dispatch.receiverClass
+                                       << (dispatch.receiverName.isEmpty() ? QString() : " \"" + dispatch.receiverName + "\"")
+                                       << (dispatch.signal.isEmpty() ? QString() : " (" + dispatch.signal + ")")
+                                       << " took " << dispatch.duration / 1000 << " ms (plugin: " << plugin << ")";
+
+    emit slowDispatchDetected(dispatch);
+}
+
+// Called on the watchdog thread
+void EventLoopMonitor::checkStall(int threshold)
+{
+    if (!m_busy) {
+        return;
+    }
+    qint64 progress = m_lastProgress;
+    qint64 blocked = (m_clock.nsecsElapsed() - progress) / 1000000;
+    if (blocked < threshold || progress == m_reportedStall) {
+        return;
+    }
+    m_reportedStall = progress;
+
+    const QMetaObject *metaObject = m_currentMetaObject;
+    QString receiverClass = metaObject ? QString::fromLatin1(metaObject->className()) : QString();
+    MetricsRegistry::instance()->counter("nymea_event_loop_stalls_total")->increment();
+    qCWarning(dcEventLoop()) << "The event loop is blocked for" << blocked << "ms while dispatching an event to" << receiverClass;
+    emit stallDetected(blocked, receiverClass);
+}
+
+void EventLoopMonitor::restartWatchdog()
+{
+    if (m_watchdog) {
+        m_watchdog->stop();
+        m_watchdog->wait();
+        delete m_watchdog;
+        m_watchdog = nullptr;
+    }
+    if (m_stallThreshold > 0) {
+        m_watchdog = new EventLoopWatchdog(this, m_stallThreshold);
+        m_watchdog->start(QThread::LowPriority);
+    }
+}
+
+void EventLoopMonitor::resolvePlugin(QObject *object, PluginId *pluginId, QString *pluginName)
+{
+    for (QObject *current = object; current; current = current->parent()) {
+        IntegrationPlugin *plugin = qobject_cast<IntegrationPlugin*>(current);
+        if (plugin) {
+            *pluginId = plugin->pluginId();
+            *pluginName = plugin->pluginName();
+            return;
+        }
+        Thing *thing = qobject_cast<Thing*>(current);
+        if (thing) {
+            *pluginId = thing->pluginId();
+            return;
+        }
+    }
+}
+
+QString EventLoopMonitor::eventTypeName(int eventType)
+{
+    switch (eventType) {
+    case QEvent::Timer:
+        return "Timer";
+    case QEvent::MetaCall:
+        return "MetaCall";
+    case QEvent::SockAct:
+        return "SocketActivation";
+    case QEvent::DeferredDelete:
+        return "DeferredDelete";
+    case QEvent::Quit:
+        return "Quit";
+    default:
+        return QString("Event(%1)").arg(eventType);
+    }
+}
+
+qint64 EventLoopMonitor::threadCpuTime()
+{
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+    return static_cast<qint64>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+EventDispatchScope::EventDispatchScope(QObject *receiver, QEvent *event)
+{
+    EventLoopMonitor *monitor = EventLoopMonitor::s_instance;
+    if (monitor && receiver && monitor->thread() == QThread::currentThread()) {
+        m_monitor = monitor;
+        m_monitor->beginDispatch(receiver, event);
+    }
+}
+
+EventDispatchScope::~EventDispatchScope()
+{
+    // The monitor might have been destroyed by the handler
+    if (m_monitor && EventLoopMonitor::s_instance == m_monitor) {
+        m_monitor->endDispatch();
+    }
+}
+
+}
@@ -0,0 +1,168 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef EVENTLOOPMONITOR_H
+#define EVENTLOOPMONITOR_H
+
+#include "typeutils.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include <QHash>
+#include <QList>
+
+#include <atomic>
+
+class QEvent;
+class QTimer;
+
+namespace nymeaserver {
+
+class EventLoopWatchdog;
+class MetricHistogram;
+
+// Measures how long the main thread spends dispatching each event. The application's notify() wraps
+// every dispatch in an EventDispatchScope. Time spent in nested dispatches and in nested event loops
+// waiting for events is not accounted to the outer handler.
+class EventLoopMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    class SlowDispatch
+    {
+    public:
+        qint64 timestamp = 0;
+        qint64 duration = 0; // us, excluding nested dispatches
+        QString eventType;
+        QString receiverClass;
+        QString receiverName;
+        QString signal;
+        PluginId pluginId;
+        QString pluginName;
+
+        QVariantMap toVariantMap() const;
+    };
+
+    explicit EventLoopMonitor(QObject *parent = nullptr);
+    ~EventLoopMonitor() override;
+
+    static EventLoopMonitor *instance();
+
+    // Dispatches taking longer are reported, in ms
+    int slowDispatchThreshold() const;
+    void setSlowDispatchThreshold(int milliseconds);
+
+    // The watchdog warns while the event loop is blocked for longer, in ms. 0 disables the watchdog.
+    int stallThreshold() const;
+    void setStallThreshold(int milliseconds);
+
+    // Account the thread CPU time of every dispatch to the plugin owning the receiver
+    bool pluginCpuAccounting() const;
+    void setPluginCpuAccounting(bool enabled);
+
+    QList<SlowDispatch> slowDispatches() const;
+    QHash<QString, qint64> pluginCpuTime() const; // us per plugin name
+
+    QVariantMap toVariantMap() const;
+
+signals:
+    void slowDispatchDetected(const nymeaserver::EventLoopMonitor::SlowDispatch &dispatch);
+    void stallDetected(qint64 duration, const QString &receiverClass);
+
+private:
+    friend class EventDispatchScope;
+    friend class EventLoopWatchdog;
+
+    class Frame
+    {
+    public:
+        qint64 start = 0;
+        qint64 nested = 0;
+        qint64 cpuStart = 0;
+        QObject *receiver = nullptr;
+        QPointer<QObject> guard;
+        const QMetaObject *metaObject = nullptr;
+        int eventType = 0;
+    };
+
+    void beginDispatch(QObject *receiver, QEvent *event);
+    void endDispatch();
+    void checkStall(int threshold);
+    void restartWatchdog();
+
+    static void resolvePlugin(QObject *object, PluginId *pluginId, QString *pluginName);
+    static QString eventTypeName(int eventType);
+    static qint64 threadCpuTime();
+
+    static std::atomic<EventLoopMonitor*> s_instance;
+
+    QElapsedTimer m_clock;
+    QVector<Frame> m_frames;
+    qint64 m_blockStart = 0;
+
+    int m_slowDispatchThreshold = 100;
+    int m_stallThreshold = 2000;
+    bool m_pluginCpuAccounting = false;
+
+    QList<SlowDispatch> m_slowDispatches;
+    QHash<QString, qint64> m_pluginCpuTime;
+
+    MetricHistogram *m_dispatchMetric = nullptr;
+
+    // Shared with the watchdog thread
+    std::atomic<bool> m_busy{false};
+    std::atomic<qint64> m_lastProgress{0};
+    std::atomic<const QMetaObject*> m_currentMetaObject{nullptr};
+    qint64 m_reportedStall = -1;
+    EventLoopWatchdog *m_watchdog = nullptr;
+
+    QTimer *m_lagTimer = nullptr;
+    QElapsedTimer m_lagClock;
+};
+
+// Wraps the dispatch of a single event. Does nothing if there is no monitor or the event is delivered
+// outside of the main thread.
+class EventDispatchScope
+{
+public:
+    EventDispatchScope(QObject *receiver, QEvent *event);
+    ~EventDispatchScope();
+
+private:
+    EventLoopMonitor *m_monitor = nullptr;
+};
+
+}
+
+Q_DECLARE_METATYPE(nymeaserver::EventLoopMonitor::SlowDispatch)
+
+#endif // EVENTLOOPMONITOR_H
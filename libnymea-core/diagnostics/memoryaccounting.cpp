@@ -0,0 +1,243 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "memoryaccounting.h"
+#include "allocationsampler.h"
+#include "metricsregistry.h"
+#include "loggingcategories.h"
+
+#include <QTimer>
+#include <QFile>
+
+#include <unistd.h>
+
+namespace nymeaserver {
+
+MemoryAccounting *MemoryAccounting::s_instance = nullptr;
+
+QVariantMap MemoryAccounting::Snapshot::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("timestamp", timestamp.toMSecsSinceEpoch() / 1000);
+    map.insert("residentBytes", residentBytes);
+    QVariantList subsystemList;
+    foreach (const QString &subsystem, subsystems.keys()) {
+        QVariantMap subsystemMap;
+        subsystemMap.insert("name", subsystem);
+        subsystemMap.insert("objects", subsystems.value(subsystem).objects);
+        subsystemMap.insert("bytes", subsystems.value(subsystem).bytes);
+        subsystemList.append(subsystemMap);
+    }
+    map.insert("subsystems", subsystemList);
+    return map;
+}
+
+MemoryAccounting::MemoryAccounting(QObject *parent):
+    QObject(parent)
+{
+    s_instance = this;
+
+    MetricsRegistry::instance()->registerGauge("nymea_memory_resident_bytes", "Resident memory of the process");
+    MetricsRegistry::instance()->registerGauge("nymea_memory_objects", "Live objects per subsystem at the last memory snapshot", "subsystem");
+    MetricsRegistry::instance()->registerGauge("nymea_memory_bytes", "Approximate bytes per subsystem at the last memory snapshot", "subsystem");
+
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setInterval(300 * 1000);
+    connect(m_snapshotTimer, &QTimer::timeout, this, [this](){
+        takeSnapshot();
+        QStringList growing = growingSubsystems();
+        if (!growing.isEmpty()) {
+            qCDebug(dcMemory()) << "Memory usage kept growing over the last" << m_snapshots.count() << "snapshots in:" << growing.join(", ");
+        }
+    });
+    m_snapshotTimer->start();
+}
+
+MemoryAccounting::~MemoryAccounting()
+{
+    if (s_instance == this) {
+        s_instance = nullptr;
+    }
+}
+
+MemoryAccounting *MemoryAccounting::instance()
+{
+    return s_instance;
+}
+
+void MemoryAccounting::addProbe(const QString &subsystem, QObject *owner, Probe probe)
+{
+    ProbeEntry entry;
+    entry.subsystem = subsystem;
+    entry.owner = owner;
+    entry.probe = probe;
+    m_probes.append(entry);
+    connect(owner, &QObject::destroyed, this, [this, owner](){
+        removeProbes(owner);
+    });
+}
+
+void MemoryAccounting::removeProbes(QObject *owner)
+{
+    for (int i = m_probes.count() - 1; i >= 0; i--) {
+        if (m_probes.at(i).owner == owner) {
+            m_probes.removeAt(i);
+        }
+    }
+}
+
+int MemoryAccounting::snapshotInterval() const
+{
+    return m_snapshotTimer->isActive() ? m_snapshotTimer->interval() / 1000 : 0;
+}
+
+void MemoryAccounting::setSnapshotInterval(int seconds)
+{
+    if (seconds <= 0) {
+        m_snapshotTimer->stop();
+        return;
+    }
+    m_snapshotTimer->start(seconds * 1000);
+}
+
+int MemoryAccounting::snapshotHistory() const
+{
+    return m_snapshotHistory;
+}
+
+void MemoryAccounting::setSnapshotHistory(int snapshots)
+{
+    m_snapshotHistory = qMax(2, snapshots);
+    while (m_snapshots.count() > m_snapshotHistory) {
+        m_snapshots.removeFirst();
+    }
+}
+
+MemoryAccounting::Snapshot MemoryAccounting::takeSnapshot()
+{
+    Snapshot snapshot;
+    snapshot.timestamp = QDateTime::currentDateTime();
+    snapshot.residentBytes = residentMemory();
+    foreach (const ProbeEntry &entry, m_probes) {
+        Usage usage = entry.probe();
+        Usage &total = snapshot.subsystems[entry.subsystem];
+        total.objects += usage.objects;
+        total.bytes += usage.bytes;
+    }
+
+    MetricsRegistry *metrics = MetricsRegistry::instance();
+    metrics->gauge("nymea_memory_resident_bytes")->set(snapshot.residentBytes);
+    foreach (const QString &subsystem, snapshot.subsystems.keys()) {
+        metrics->gauge("nymea_memory_objects", subsystem)->set(snapshot.subsystems.value(subsystem).objects);
+        metrics->gauge("nymea_memory_bytes", subsystem)->set(snapshot.subsystems.value(subsystem).bytes);
+    }
+
+    m_snapshots.append(snapshot);
+    while (m_snapshots.count() > m_snapshotHistory) {
+        m_snapshots.removeFirst();
+    }
+    return snapshot;
+}
+
+QList<MemoryAccounting::Snapshot> MemoryAccounting::snapshots() const
+{
+    return m_snapshots;
+}
+
+// A subsystem is growing if it never shrank over the kept snapshots, but grew overall.
+// Only considered with a few snapshots, things grow naturally during startup.
+QStringList MemoryAccounting::growingSubsystems() const
+{
+    QStringList growing;
+    if (m_snapshots.count() < 4) {
+        return growing;
+    }
+
+    QStringList subsystems = m_snapshots.last().subsystems.keys();
+    subsystems.prepend("process");
+    foreach (const QString &subsystem, subsystems) {
+        bool shrank = false;
+        QList<qint64> values;
+        foreach (const Snapshot &snapshot, m_snapshots) {
+            if (subsystem == "process") {
+                values.append(snapshot.residentBytes);
+            } else {
+                Usage usage = snapshot.subsystems.value(subsystem);
+                values.append(usage.bytes > 0 ? usage.bytes : usage.objects);
+            }
+            if (values.count() > 1 && values.last() < values.at(values.count() - 2)) {
+                shrank = true;
+                break;
+            }
+        }
+        if (!shrank && values.last() > values.first()) {
+            growing.append(subsystem);
+        }
+    }
+    return growing;
+}
+
+QVariantMap MemoryAccounting::toVariantMap()
+{
+    QVariantMap map = takeSnapshot().toVariantMap();
+
+    QVariantList history;
+    foreach (const Snapshot &snapshot, m_snapshots) {
+        history.append(snapshot.toVariantMap());
+    }
+    map.insert("snapshots", history);
+    map.insert("snapshotInterval", snapshotInterval());
+    map.insert("growing", growingSubsystems());
+
+    map.insert("allocationSamplingInterval", AllocationSampler::samplingInterval());
+    map.insert("sampledLiveBytes", AllocationSampler::estimatedLiveBytes());
+    QVariantList sites;
+    foreach (const AllocationSampler::Site &site, AllocationSampler::sites()) {
+        sites.append(site.toVariantMap());
+    }
+    map.insert("allocationSites", sites);
+    return map;
+}
+
+qint64 MemoryAccounting::residentMemory()
+{
+    // Pages in /proc/self/statm: size resident shared text lib data dirty
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.count() < 2) {
+        return 0;
+    }
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+}
@@ -0,0 +1,117 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QVariantMap>
+#include <QHash>
+#include <QList>
+
+#include <functional>
+
+class QTimer;
+
+namespace nymeaserver {
+
+// Collects the size of the long lived structures per subsystem. The subsystems register a probe
+// counting their live objects and estimating the bytes they hold, which is only called when a
+// snapshot is taken. Snapshots are taken periodically and kept for a while, subsystems growing
+// over all kept snapshots are reported as potential leaks.
+class MemoryAccounting : public QObject
+{
+    Q_OBJECT
+public:
+    class Usage
+    {
+    public:
+        qint64 objects = 0;
+        // Approximate, 0 where the subsystem can't tell
+        qint64 bytes = 0;
+    };
+
+    class Snapshot
+    {
+    public:
+        QDateTime timestamp;
+        qint64 residentBytes = 0;
+        QHash<QString, Usage> subsystems;
+
+        QVariantMap toVariantMap() const;
+    };
+
+    typedef std::function<Usage()> Probe;
+
+    explicit MemoryAccounting(QObject *parent = nullptr);
+    ~MemoryAccounting() override;
+
+    static MemoryAccounting *instance();
+
+    // The probe is removed again when the owner is destroyed
+    void addProbe(const QString &subsystem, QObject *owner, Probe probe);
+    void removeProbes(QObject *owner);
+
+    // In seconds, 0 disables periodic snapshots
+    int snapshotInterval() const;
+    void setSnapshotInterval(int seconds);
+
+    int snapshotHistory() const;
+    void setSnapshotHistory(int snapshots);
+
+    Snapshot takeSnapshot();
+    QList<Snapshot> snapshots() const;
+    QStringList growingSubsystems() const;
+
+    QVariantMap toVariantMap();
+
+    static qint64 residentMemory();
+
+private:
+    class ProbeEntry
+    {
+    public:
+        QString subsystem;
+        QObject *owner = nullptr;
+        Probe probe;
+    };
+
+    static MemoryAccounting *s_instance;
+
+    QList<ProbeEntry> m_probes;
+    QTimer *m_snapshotTimer = nullptr;
+    int m_snapshotHistory = 48;
+    QList<Snapshot> m_snapshots;
+};
+
+}
+
+#endif // MEMORYACCOUNTING_H
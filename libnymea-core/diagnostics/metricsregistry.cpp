@@ -0,0 +1,334 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "metricsregistry.h"
+
+#include <algorithm>
+
+namespace nymeaserver {
+
+static QString escapeLabelValue(QString value)
+{
+    value.replace('\\', "\\\\");
+    value.replace('"', "\\\"");
+    value.replace('\n', "\\n");
+    return value;
+}
+
+static QString escapeHelp(QString help)
+{
+    help.replace('\\', "\\\\");
+    help.replace('\n', "\\n");
+    return help;
+}
+
+static QString formatDouble(double value)
+{
+    return QString::number(value, 'g', 15);
+}
+
+MetricHistogram::MetricHistogram(const QVector<quint64> &bounds):
+    m_bounds(bounds),
+    m_buckets(new std::atomic<quint64>[bounds.count() + 1])
+{
+    for (int i = 0; i <= m_bounds.count(); i++) {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(quint64 value)
+{
+    int bucket = static_cast<int>(std::lower_bound(m_bounds.constBegin(), m_bounds.constEnd(), value) - m_bounds.constBegin());
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+QVector<quint64> MetricHistogram::bounds() const
+{
+    return m_bounds;
+}
+
+QVector<quint64> MetricHistogram::bucketCounts() const
+{
+    QVector<quint64> counts(m_bounds.count() + 1);
+    for (int i = 0; i <= m_bounds.count(); i++) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+quint64 MetricHistogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+quint64 MetricHistogram::sum() const
+{
+    return m_sum.load(std::memory_order_relaxed);
+}
+
+MetricsRegistry *MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+QVector<quint64> MetricsRegistry::latencyBuckets()
+{
+    return {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000};
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    foreach (Family *family, m_families) {
+        qDeleteAll(family->counters);
+        qDeleteAll(family->gauges);
+        qDeleteAll(family->histograms);
+        delete family;
+    }
+}
+
+void MetricsRegistry::registerCounter(const QString &name, const QString &help, const QString &labelName)
+{
+    registerFamily(name, help, MetricTypeCounter, labelName);
+}
+
+void MetricsRegistry::registerGauge(const QString &name, const QString &help, const QString &labelName)
+{
+    registerFamily(name, help, MetricTypeGauge, labelName);
+}
+
+void MetricsRegistry::registerHistogram(const QString &name, const QString &help, const QVector<quint64> &bounds, double unitScale, const QString &labelName)
+{
+    registerFamily(name, help, MetricTypeHistogram, labelName, bounds, unitScale);
+}
+
+MetricCounter *MetricsRegistry::counter(const QString &name, const QString &labelValue)
+{
+    {
+        QReadLocker locker(&m_lock);
+        Family *family = m_families.value(name);
+        if (family && family->counters.contains(labelValue)) {
+            return family->counters.value(labelValue);
+        }
+    }
+    QWriteLocker locker(&m_lock);
+    Family *f = family(name, MetricTypeCounter);
+    if (!f->counters.contains(labelValue)) {
+        f->counters.insert(labelValue, new MetricCounter());
+    }
+    return f->counters.value(labelValue);
+}
+
+MetricGauge *MetricsRegistry::gauge(const QString &name, const QString &labelValue)
+{
+    {
+        QReadLocker locker(&m_lock);
+        Family *family = m_families.value(name);
+        if (family && family->gauges.contains(labelValue)) {
+            return family->gauges.value(labelValue);
+        }
+    }
+    QWriteLocker locker(&m_lock);
+    Family *f = family(name, MetricTypeGauge);
+    if (!f->gauges.contains(labelValue)) {
+        f->gauges.insert(labelValue, new MetricGauge());
+    }
+    return f->gauges.value(labelValue);
+}
+
+MetricHistogram *MetricsRegistry::histogram(const QString &name, const QString &labelValue)
+{
+    {
+        QReadLocker locker(&m_lock);
+        Family *family = m_families.value(name);
+        if (family && family->histograms.contains(labelValue)) {
+            return family->histograms.value(labelValue);
+        }
+    }
+    QWriteLocker locker(&m_lock);
+    Family *f = family(name, MetricTypeHistogram);
+    if (!f->histograms.contains(labelValue)) {
+        f->histograms.insert(labelValue, new MetricHistogram(f->bounds));
+    }
+    return f->histograms.value(labelValue);
+}
+
+QByteArray MetricsRegistry::toPrometheusText() const
+{
+    QReadLocker locker(&m_lock);
+
+    QString text;
+    foreach (Family *family, m_families) {
+        QString typeName = family->type == MetricTypeCounter ? "counter" : family->type == MetricTypeGauge ? "gauge" : "histogram";
+        if (!family->help.isEmpty()) {
+            text += QString("# HELP %1 %2\n").arg(family->name, escapeHelp(family->help));
+        }
+        text += QString("# TYPE %1 %2\n").arg(family->name, typeName);
+
+        QStringList labelValues = family->type == MetricTypeCounter ? family->counters.keys()
+                                : family->type == MetricTypeGauge ? family->gauges.keys()
+                                : family->histograms.keys();
+        foreach (const QString &labelValue, labelValues) {
+            QString label;
+            if (!family->labelName.isEmpty()) {
+                label = QString("%1=\"%2\"").arg(family->labelName, escapeLabelValue(labelValue));
+            }
+            QString labels = label.isEmpty() ? QString() : "{" + label + "}";
+
+            if (family->type == MetricTypeCounter) {
+                text += QString("%1%2 %3\n").arg(family->name, labels).arg(family->counters.value(labelValue)->value());
+            } else if (family->type == MetricTypeGauge) {
+                text += QString("%1%2 %3\n").arg(family->name, labels).arg(family->gauges.value(labelValue)->value());
+            } else {
+                MetricHistogram *histogram = family->histograms.value(labelValue);
+                QVector<quint64> counts = histogram->bucketCounts();
+                QString separator = label.isEmpty() ? QString() : label + ",";
+                quint64 cumulative = 0;
+                for (int i = 0; i < family->bounds.count(); i++) {
+                    cumulative += counts.at(i);
+                    text += QString("%1_bucket{%2le=\"%3\"} %4\n").arg(family->name, separator, formatDouble(family->bounds.at(i) * family->unitScale)).arg(cumulative);
+                }
+                text += QString("%1_bucket{%2le=\"+Inf\"} %3\n").arg(family->name, separator).arg(histogram->count());
+                text += QString("%1_sum%2 %3\n").arg(family->name, labels, formatDouble(histogram->sum() * family->unitScale));
+                text += QString("%1_count%2 %3\n").arg(family->name, labels).arg(histogram->count());
+            }
+        }
+    }
+    return text.toUtf8();
+}
+
+QVariantList MetricsRegistry::toVariantList() const
+{
+    QReadLocker locker(&m_lock);
+
+    QVariantList metrics;
+    foreach (Family *family, m_families) {
+        QVariantMap metric;
+        metric.insert("name", family->name);
+        metric.insert("help", family->help);
+        metric.insert("type", family->type == MetricTypeCounter ? "counter" : family->type == MetricTypeGauge ? "gauge" : "histogram");
+        if (!family->labelName.isEmpty()) {
+            metric.insert("labelName", family->labelName);
+        }
+
+        QVariantList samples;
+        if (family->type == MetricTypeCounter) {
+            foreach (const QString &labelValue, family->counters.keys()) {
+                QVariantMap sample;
+                if (!family->labelName.isEmpty()) {
+                    sample.insert("labelValue", labelValue);
+                }
+                sample.insert("value", static_cast<double>(family->counters.value(labelValue)->value()));
+                samples.append(sample);
+            }
+        } else if (family->type == MetricTypeGauge) {
+            foreach (const QString &labelValue, family->gauges.keys()) {
+                QVariantMap sample;
+                if (!family->labelName.isEmpty()) {
+                    sample.insert("labelValue", labelValue);
+                }
+                sample.insert("value", static_cast<double>(family->gauges.value(labelValue)->value()));
+                samples.append(sample);
+            }
+        } else {
+            foreach (const QString &labelValue, family->histograms.keys()) {
+                MetricHistogram *histogram = family->histograms.value(labelValue);
+                QVariantMap sample;
+                if (!family->labelName.isEmpty()) {
+                    sample.insert("labelValue", labelValue);
+                }
+                sample.insert("count", histogram->count());
+                sample.insert("sum", histogram->sum() * family->unitScale);
+                QVector<quint64> counts = histogram->bucketCounts();
+                QVariantList buckets;
+                quint64 cumulative = 0;
+                for (int i = 0; i < family->bounds.count(); i++) {
+                    cumulative += counts.at(i);
+                    QVariantMap bucket;
+                    bucket.insert("upperBound", family->bounds.at(i) * family->unitScale);
+                    bucket.insert("count", cumulative);
+                    buckets.append(bucket);
+                }
+                sample.insert("buckets", buckets);
+                samples.append(sample);
+            }
+        }
+        metric.insert("samples", samples);
+        metrics.append(metric);
+    }
+    return metrics;
+}
+
+void MetricsRegistry::registerFamily(const QString &name, const QString &help, MetricType type, const QString &labelName, const QVector<quint64> &bounds, double unitScale)
+{
+    QWriteLocker locker(&m_lock);
+    if (m_families.contains(name)) {
+        // Registering again only fills in what a family created on the fly is missing
+        Family *family = m_families.value(name);
+        if (family->help.isEmpty()) {
+            family->help = help;
+        }
+        if (family->labelName.isEmpty()) {
+            family->labelName = labelName;
+        }
+        return;
+    }
+    Family *family = new Family();
+    family->name = name;
+    family->help = help;
+    family->type = type;
+    family->labelName = labelName;
+    family->bounds = bounds;
+    family->unitScale = unitScale;
+    m_families.insert(name, family);
+}
+
+// Must be called with the write lock held. Families used without registering them are
+// created on the fly, histograms then use the default latency buckets.
+MetricsRegistry::Family *MetricsRegistry::family(const QString &name, MetricType type)
+{
+    Family *family = m_families.value(name);
+    if (!family) {
+        family = new Family();
+        family->name = name;
+        family->type = type;
+        if (type == MetricTypeHistogram) {
+            family->bounds = latencyBuckets();
+            family->unitScale = 0.000001;
+        }
+        m_families.insert(name, family);
+    }
+    Q_ASSERT_X(family->type == type, "MetricsRegistry", "Metric family used with a different type than registered");
+    return family;
+}
+
+}
@@ -0,0 +1,146 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef METRICSREGISTRY_H
+#define METRICSREGISTRY_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QVariant>
+#include <QReadWriteLock>
+
+#include <atomic>
+#include <memory>
+
+namespace nymeaserver {
+
+// Monotonic counter. Increments are lock free and may happen from any thread.
+class MetricCounter
+{
+public:
+    void increment(quint64 amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+// A value that can go up and down, e.g. a queue depth.
+class MetricGauge
+{
+public:
+    void set(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(qint64 amount) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+// Histogram with fixed bucket bounds. Observations are integers in the histogram's base unit
+// (e.g. microseconds) and are scaled by the family's unit scale when exported.
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(const QVector<quint64> &bounds);
+
+    void observe(quint64 value);
+
+    QVector<quint64> bounds() const;
+    // Non-cumulative counts, one per bound plus one for values above the last bound
+    QVector<quint64> bucketCounts() const;
+    quint64 count() const;
+    quint64 sum() const;
+
+private:
+    QVector<quint64> m_bounds;
+    std::unique_ptr<std::atomic<quint64>[]> m_buckets;
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sum{0};
+};
+
+// Process wide registry of metric families. A family has a name, a help text and optionally one label.
+// Looking up a metric takes a read lock, updating it is lock free. Callers on hot paths should keep the
+// returned pointer, metrics live as long as the registry.
+class MetricsRegistry
+{
+public:
+    enum MetricType {
+        MetricTypeCounter,
+        MetricTypeGauge,
+        MetricTypeHistogram
+    };
+
+    static MetricsRegistry *instance();
+
+    // Default buckets for latencies observed in microseconds, exported in seconds
+    static QVector<quint64> latencyBuckets();
+
+    void registerCounter(const QString &name, const QString &help, const QString &labelName = QString());
+    void registerGauge(const QString &name, const QString &help, const QString &labelName = QString());
+    void registerHistogram(const QString &name, const QString &help, const QVector<quint64> &bounds, double unitScale, const QString &labelName = QString());
+
+    MetricCounter *counter(const QString &name, const QString &labelValue = QString());
+    MetricGauge *gauge(const QString &name, const QString &labelValue = QString());
+    MetricHistogram *histogram(const QString &name, const QString &labelValue = QString());
+
+    // Prometheus text exposition format (version 0.0.4)
+    QByteArray toPrometheusText() const;
+    QVariantList toVariantList() const;
+
+private:
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+
+    class Family
+    {
+    public:
+        QString name;
+        QString help;
+        MetricType type = MetricTypeCounter;
+        QString labelName;
+        QVector<quint64> bounds;
+        double unitScale = 1;
+        QMap<QString, MetricCounter*> counters;
+        QMap<QString, MetricGauge*> gauges;
+        QMap<QString, MetricHistogram*> histograms;
+    };
+
+    void registerFamily(const QString &name, const QString &help, MetricType type, const QString &labelName, const QVector<quint64> &bounds = QVector<quint64>(), double unitScale = 1);
+    Family *family(const QString &name, MetricType type);
+
+    mutable QReadWriteLock m_lock;
+    QMap<QString, Family*> m_families;
+};
+
+}
+
+#endif // METRICSREGISTRY_H
@@ -0,0 +1,306 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QThread>
+
+namespace nymeaserver {
+
+thread_local TraceContext Tracer::s_currentContext;
+
+static QString formatId(quint64 id)
+{
+    return QString("0x%1").arg(id, 0, 16);
+}
+
+TraceContext::TraceContext(quint64 traceId, quint64 spanId):
+    m_traceId(traceId),
+    m_spanId(spanId)
+{
+}
+
+quint64 TraceContext::traceId() const
+{
+    return m_traceId;
+}
+
+quint64 TraceContext::spanId() const
+{
+    return m_spanId;
+}
+
+bool TraceContext::isValid() const
+{
+    return m_traceId != 0;
+}
+
+Tracer::Tracer():
+    m_enabled(false),
+    m_nextId(1)
+{
+    m_clock.start();
+}
+
+Tracer *Tracer::instance()
+{
+    static Tracer tracer;
+    return &tracer;
+}
+
+bool Tracer::enabled() const
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int Tracer::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+void Tracer::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax(1, capacity);
+    while (m_spans.count() > m_capacity) {
+        m_spans.removeFirst();
+    }
+}
+
+qint64 Tracer::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+quint64 Tracer::createId()
+{
+    return m_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+TraceContext Tracer::currentContext()
+{
+    return s_currentContext;
+}
+
+void Tracer::setCurrentContext(const TraceContext &context)
+{
+    s_currentContext = context;
+}
+
+void Tracer::record(const Span &span)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_spans.count() >= m_capacity) {
+        m_spans.removeFirst();
+    }
+    m_spans.append(span);
+}
+
+QList<Tracer::Span> Tracer::spans() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_spans;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_spans.clear();
+}
+
+QByteArray Tracer::toChromeTraceJson() const
+{
+    qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    foreach (const Span &span, spans()) {
+        QVariantMap args = span.args;
+        args.insert("traceId", formatId(span.traceId));
+        args.insert("spanId", formatId(span.spanId));
+        if (span.parentSpanId != 0) {
+            args.insert("parentSpanId", formatId(span.parentSpanId));
+        }
+
+        QJsonObject event;
+        event.insert("name", span.name);
+        event.insert("cat", span.category);
+        event.insert("ts", static_cast<double>(span.start));
+        event.insert("pid", static_cast<double>(pid));
+        event.insert("tid", static_cast<double>(span.threadId));
+        event.insert("args", QJsonObject::fromVariantMap(args));
+
+        if (!span.async) {
+            event.insert("ph", "X");
+            event.insert("dur", static_cast<double>(span.duration));
+            events.append(event);
+            continue;
+        }
+
+        // Async spans overlap with the others on the thread, they are matched by category, name and id
+        event.insert("ph", "b");
+        event.insert("id", formatId(span.spanId));
+        events.append(event);
+
+        QJsonObject endEvent;
+        endEvent.insert("name", span.name);
+        endEvent.insert("cat", span.category);
+        endEvent.insert("ph", "e");
+        endEvent.insert("id", formatId(span.spanId));
+        endEvent.insert("ts", static_cast<double>(span.start + span.duration));
+        endEvent.insert("pid", static_cast<double>(pid));
+        endEvent.insert("tid", static_cast<double>(span.threadId));
+        events.append(endEvent);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", "ms");
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+static void initSpan(Tracer::Span *span, const char *name, const char *category, const TraceContext &parent)
+{
+    Tracer *tracer = Tracer::instance();
+    span->spanId = tracer->createId();
+    span->traceId = parent.isValid() ? parent.traceId() : span->spanId;
+    span->parentSpanId = parent.spanId();
+    span->name = QString::fromLatin1(name);
+    span->category = QString::fromLatin1(category);
+    span->threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    span->start = tracer->now();
+}
+
+TraceScope::TraceScope(const char *name, const char *category)
+{
+    begin(name, category, Tracer::currentContext());
+}
+
+TraceScope::TraceScope(const char *name, const char *category, const TraceContext &parent)
+{
+    begin(name, category, parent);
+}
+
+TraceScope::~TraceScope()
+{
+    if (!m_active) {
+        return;
+    }
+    Tracer *tracer = Tracer::instance();
+    m_span.duration = tracer->now() - m_span.start;
+    Tracer::setCurrentContext(m_previousContext);
+    tracer->record(m_span);
+}
+
+bool TraceScope::isActive() const
+{
+    return m_active;
+}
+
+TraceContext TraceScope::context() const
+{
+    return m_active ? TraceContext(m_span.traceId, m_span.spanId) : Tracer::currentContext();
+}
+
+void TraceScope::setName(const QString &name)
+{
+    if (m_active) {
+        m_span.name = name;
+    }
+}
+
+void TraceScope::setArg(const QString &key, const QVariant &value)
+{
+    if (m_active) {
+        m_span.args.insert(key, value);
+    }
+}
+
+void TraceScope::begin(const char *name, const char *category, const TraceContext &parent)
+{
+    if (!Tracer::instance()->enabled()) {
+        return;
+    }
+    m_active = true;
+    initSpan(&m_span, name, category, parent);
+    m_previousContext = Tracer::currentContext();
+    Tracer::setCurrentContext(TraceContext(m_span.traceId, m_span.spanId));
+}
+
+AsyncTraceSpan AsyncTraceSpan::begin(const char *name, const char *category, const TraceContext &parent)
+{
+    AsyncTraceSpan span;
+    if (!Tracer::instance()->enabled()) {
+        return span;
+    }
+    span.m_active = true;
+    span.m_span.async = true;
+    initSpan(&span.m_span, name, category, parent);
+    return span;
+}
+
+bool AsyncTraceSpan::isActive() const
+{
+    return m_active;
+}
+
+TraceContext AsyncTraceSpan::context() const
+{
+    return m_span.spanId != 0 ? TraceContext(m_span.traceId, m_span.spanId) : TraceContext();
+}
+
+void AsyncTraceSpan::setArg(const QString &key, const QVariant &value)
+{
+    if (m_active) {
+        m_span.args.insert(key, value);
+    }
+}
+
+void AsyncTraceSpan::end()
+{
+    if (!m_active) {
+        return;
+    }
+    m_active = false;
+    Tracer *tracer = Tracer::instance();
+    m_span.duration = tracer->now() - m_span.start;
+    tracer->record(m_span);
+}
+
+}
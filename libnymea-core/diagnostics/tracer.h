@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QList>
+
+#include <atomic>
+
+namespace nymeaserver {
+
+// Identifies the span currently executing on a thread. Stages started while a context is current
+// become children of it, so the whole chain caused by a state change or event shares one trace id.
+class TraceContext
+{
+public:
+    TraceContext() = default;
+    TraceContext(quint64 traceId, quint64 spanId);
+
+    quint64 traceId() const;
+    quint64 spanId() const;
+    bool isValid() const;
+
+private:
+    quint64 m_traceId = 0;
+    quint64 m_spanId = 0;
+};
+
+// Collects timestamped spans in a ring buffer and exports them in the Chrome trace event format,
+// to be loaded into chrome://tracing or Perfetto. Disabled by default, spans are only built when enabled.
+class Tracer
+{
+public:
+    class Span
+    {
+    public:
+        quint64 traceId = 0;
+        quint64 spanId = 0;
+        quint64 parentSpanId = 0;
+        QString name;
+        QString category;
+        qint64 start = 0; // us on the tracer clock
+        qint64 duration = 0; // us
+        quint64 threadId = 0;
+        // Ends in a later event loop iteration, exported as async event as it doesn't nest
+        bool async = false;
+        QVariantMap args;
+    };
+
+    static Tracer *instance();
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    // Maximum number of spans kept, the oldest ones are dropped first
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    qint64 now() const;
+    quint64 createId();
+
+    static TraceContext currentContext();
+    static void setCurrentContext(const TraceContext &context);
+
+    void record(const Span &span);
+    QList<Span> spans() const;
+    void clear();
+
+    QByteArray toChromeTraceJson() const;
+
+private:
+    Tracer();
+
+    static thread_local TraceContext s_currentContext;
+
+    std::atomic<bool> m_enabled;
+    std::atomic<quint64> m_nextId;
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;
+    int m_capacity = 10000;
+    QList<Span> m_spans;
+};
+
+// Records a span for the lifetime of the scope. The span is the current context meanwhile.
+// Without a parent context, a new trace is started.
+class TraceScope
+{
+public:
+    TraceScope(const char *name, const char *category);
+    TraceScope(const char *name, const char *category, const TraceContext &parent);
+    ~TraceScope();
+
+    bool isActive() const;
+    TraceContext context() const;
+
+    void setName(const QString &name);
+    void setArg(const QString &key, const QVariant &value);
+
+private:
+    void begin(const char *name, const char *category, const TraceContext &parent);
+
+    bool m_active = false;
+    Tracer::Span m_span;
+    TraceContext m_previousContext;
+};
+
+// A span ending in a later event loop iteration, e.g. when a ThingActionInfo finishes.
+// It is not made current, use a TraceScope with its context as parent for work done on its behalf.
+class AsyncTraceSpan
+{
+public:
+    AsyncTraceSpan() = default;
+
+    static AsyncTraceSpan begin(const char *name, const char *category, const TraceContext &parent = Tracer::currentContext());
+
+    bool isActive() const;
+    // Remains valid after the span ended, to continue the trace in a following stage
+    TraceContext context() const;
+
+    void setArg(const QString &key, const QVariant &value);
+    void end();
+
+private:
+    bool m_active = false;
+    Tracer::Span m_span;
+};
+
+}
+
+#endif // TRACER_H
@@ -60,6 +60,21 @@
 
 namespace nymeaserver {
 
+// Header fields of an SSDP message, keys in upper case
+static QHash<QString, QString> ssdpHeaders(const QByteArray &data)
+{
+    QHash<QString, QString> headers;
+    const QStringList lines = QString(data).split("\r\n");
+    foreach (const QString& line, lines) {
+        int separatorIndex = line.indexOf(':');
+        if (separatorIndex < 0)
+            continue;
+
+        headers.insert(line.left(separatorIndex).trimmed().toUpper(), line.mid(separatorIndex + 1).trimmed());
+    }
+    return headers;
+}
+
 /*! Construct the hardware resource UpnpDiscoveryImplementation with the given \a parent. */
 UpnpDiscoveryImplementation::UpnpDiscoveryImplementation(QNetworkAccessManager *networkAccessManager, QObject *parent) :
     UpnpDiscovery(parent),
@@ -119,12 +134,13 @@ UpnpDiscoveryReply *UpnpDiscoveryImplementation::discoverDevices(const QString &
     return reply.data();
 }
 
-void UpnpDiscoveryImplementation::requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor)
+void UpnpDiscoveryImplementation::requestDeviceInformation(const QNetworkRequest &networkRequest, const DescriptorRequest &descriptorRequest)
 {
     qCDebug(dcUpnp()) << "Requesting device information for" << networkRequest.url();
     QNetworkReply *replay = m_networkAccessManager->get(networkRequest);
     connect(replay, &QNetworkReply::finished, this, &UpnpDiscoveryImplementation::replyFinished);
-    m_informationRequestList.insert(replay, upnpDeviceDescriptor);
+    m_informationRequestList.insert(replay, descriptorRequest);
+    m_runningLocations.insert(descriptorRequest.descriptor.location(), replay);
 }
 
 void UpnpDiscoveryImplementation::respondToSearchRequest(QHostAddress host, int port)
@@ -246,60 +262,94 @@ void UpnpDiscoveryImplementation::readData()
     QByteArray data;
     quint16 port;
     QHostAddress hostAddress;
-    QUrl location;
 
-    // read the answere from the multicast
-    while (m_socket->hasPendingDatagrams()) {
+    // read the answeres from the multicast
+    while (m_socket && m_socket->hasPendingDatagrams()) {
         data.resize(m_socket->pendingDatagramSize());
         m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
+        processDatagram(data, hostAddress, port);
     }
+}
 
-    if (data.contains("M-SEARCH") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
+void UpnpDiscoveryImplementation::processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port)
+{
+    if (data.contains("M-SEARCH") && !m_localAddresses.contains(hostAddress)) {
         qCDebug(dcUpnp()) << "UPnP discovery request received. Responding...";
         respondToSearchRequest(hostAddress, port);
         return;
     }
 
-    if (data.contains("NOTIFY") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
+    if (data.contains("NOTIFY") && !m_localAddresses.contains(hostAddress)) {
+        // A device leaving the network invalidates its cached description
+        if (data.contains("ssdp:byebye")) {
+            QString usn = ssdpHeaders(data).value("USN");
+            if (m_usnLocations.contains(usn)) {
+                m_descriptorCache.remove(m_usnLocations.take(usn));
+            }
+        }
         emit upnpNotify(data);
         return;
     }
 
     // if the data contains the HTTP OK header...
     if (data.contains("HTTP/1.1 200 OK")) {
-        const QStringList lines = QString(data).split("\r\n");
-        foreach (const QString& line, lines) {
-            int separatorIndex = line.indexOf(':');
-            QString key = line.left(separatorIndex).toUpper();
-            QString value = line.mid(separatorIndex+1).trimmed();
-
-            // get location
-            if (key.contains("LOCATION") || key.contains("location") || key.contains("Location")) {
-                location = QUrl(value);
+        processSearchResponse(data, hostAddress);
+    }
+}
+
+void UpnpDiscoveryImplementation::processSearchResponse(const QByteArray &data, const QHostAddress &hostAddress)
+{
+    if (m_discoverRequests.isEmpty())
+        return;
+
+    QHash<QString, QString> headers = ssdpHeaders(data);
+    QUrl location = QUrl(headers.value("LOCATION"));
+    if (!location.isValid()) {
+        qCDebug(dcUpnp()) << "Ignoring search response without valid location from" << hostAddress.toString();
+        return;
+    }
+
+    // Devices answer once per service and repeated search, only fetch each description once
+    QHash<QUrl, CachedDescriptor>::iterator cached = m_descriptorCache.find(location);
+    if (cached != m_descriptorCache.end()) {
+        if (cached->expiry > QDateTime::currentMSecsSinceEpoch()) {
+            foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
+                upnpDiscoveryRequest->addDeviceDescriptor(cached->descriptor);
             }
+            return;
         }
+        m_descriptorCache.erase(cached);
+    }
 
-        UpnpDeviceDescriptor upnpDeviceDescriptor;
-        upnpDeviceDescriptor.setLocation(location);
-        upnpDeviceDescriptor.setHostAddress(hostAddress);
-        upnpDeviceDescriptor.setPort(location.port());
+    if (m_runningLocations.contains(location))
+        return;
 
-        foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
-            QNetworkRequest networkRequest = upnpDiscoveryRequest->createNetworkRequest(upnpDeviceDescriptor);
-            requestDeviceInformation(networkRequest, upnpDeviceDescriptor);
-        }
+    DescriptorRequest descriptorRequest;
+    descriptorRequest.descriptor.setLocation(location);
+    descriptorRequest.descriptor.setHostAddress(hostAddress);
+    descriptorRequest.descriptor.setPort(location.port());
+    descriptorRequest.usn = headers.value("USN");
+
+    QRegExp maxAgeExpression("max-age\\s*=\\s*(\\d+)", Qt::CaseInsensitive);
+    if (maxAgeExpression.indexIn(headers.value("CACHE-CONTROL")) >= 0) {
+        descriptorRequest.maxAge = maxAgeExpression.cap(1).toInt();
     }
+
+    QNetworkRequest networkRequest = m_discoverRequests.first()->createNetworkRequest(descriptorRequest.descriptor);
+    requestDeviceInformation(networkRequest, descriptorRequest);
 }
 
 void UpnpDiscoveryImplementation::replyFinished()
 {
     QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
     int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    DescriptorRequest descriptorRequest = m_informationRequestList.take(reply);
+    m_runningLocations.remove(descriptorRequest.descriptor.location());
 
     switch (status) {
     case(200):{
         QByteArray data = reply->readAll();
-        UpnpDeviceDescriptor upnpDeviceDescriptor = m_informationRequestList.take(reply);
+        UpnpDeviceDescriptor upnpDeviceDescriptor = descriptorRequest.descriptor;
 
         // parse XML data
         QXmlStreamReader xml(data);
@@ -354,6 +404,14 @@ void UpnpDiscoveryImplementation::replyFinished()
             }
         }
 
+        CachedDescriptor cachedDescriptor;
+        cachedDescriptor.descriptor = upnpDeviceDescriptor;
+        cachedDescriptor.expiry = QDateTime::currentMSecsSinceEpoch() + descriptorRequest.maxAge * 1000ll;
+        m_descriptorCache.insert(upnpDeviceDescriptor.location(), cachedDescriptor);
+        if (!descriptorRequest.usn.isEmpty()) {
+            m_usnLocations.insert(descriptorRequest.usn, upnpDeviceDescriptor.location());
+        }
+
         qCDebug(dcUpnp()) << "Discovery result:" << upnpDeviceDescriptor.hostAddress().toString();
         qCDebug(dcUpnp()) << "Have" << m_discoverRequests.count() << "running discoveries";
         foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
@@ -363,7 +421,6 @@ void UpnpDiscoveryImplementation::replyFinished()
     }
     default:
         qCWarning(dcUpnp()) << name() << "HTTP request error" << reply->request().url().toString() << status;
-        m_informationRequestList.remove(reply);
     }
 
     reply->deleteLater();
@@ -488,6 +545,11 @@ void UpnpDiscoveryImplementation::discoverTimeout()
 void UpnpDiscoveryImplementation::networkConfigurationChanged(const QNetworkConfiguration &config)
 {
     Q_UNUSED(config)
+    // Addresses may have changed, devices may be gone or have moved
+    m_localAddresses = QNetworkInterface::allAddresses();
+    m_descriptorCache.clear();
+    m_usnLocations.clear();
+
     if (m_enabled) {
         disable();
         enable();
@@ -531,6 +593,8 @@ bool UpnpDiscoveryImplementation::enable()
     m_available = true;
     emit availableChanged(true);
 
+    m_localAddresses = QNetworkInterface::allAddresses();
+
     connect(m_socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(error(QAbstractSocket::SocketError)));
     connect(m_socket, &QUdpSocket::readyRead, this, &UpnpDiscoveryImplementation::readData);
 
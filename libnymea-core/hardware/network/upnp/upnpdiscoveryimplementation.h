@@ -48,11 +48,14 @@
 // Discovering UPnP devices reference: http://upnp.org/specs/arch/UPnP-arch-DeviceArchitecture-v1.1.pdf
 // nymea basic device reference: http://upnp.org/specs/basic/UPnP-basic-Basic-v1-Device.pdf
 
+class TestUpnp;
+
 namespace nymeaserver {
 
 class UpnpDiscoveryImplementation : public UpnpDiscovery
 {
     Q_OBJECT
+    friend class ::TestUpnp;
 
 public:
     explicit UpnpDiscoveryImplementation(QNetworkAccessManager *networkAccessManager, QObject *parent = nullptr);
@@ -73,13 +76,38 @@ private:
 
     QNetworkAccessManager *m_networkAccessManager = nullptr;
 
+    class DescriptorRequest
+    {
+    public:
+        UpnpDeviceDescriptor descriptor;
+        QString usn;
+        int maxAge = 1800;
+    };
+
+    class CachedDescriptor
+    {
+    public:
+        UpnpDeviceDescriptor descriptor;
+        qint64 expiry = 0;
+    };
+
     QList<UpnpDiscoveryRequest *> m_discoverRequests;
-    QHash<QNetworkReply*, UpnpDeviceDescriptor> m_informationRequestList;
+    QHash<QNetworkReply*, DescriptorRequest> m_informationRequestList;
+    QHash<QUrl, QNetworkReply*> m_runningLocations;
+
+    // Parsed device descriptions by location, valid for the announced max-age
+    QHash<QUrl, CachedDescriptor> m_descriptorCache;
+    QHash<QString, QUrl> m_usnLocations;
+
+    // Refreshed whenever the network configuration changes
+    QList<QHostAddress> m_localAddresses;
 
     bool m_available = false;
     bool m_enabled = false;
 
-    void requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor);
+    void processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port);
+    void processSearchResponse(const QByteArray &data, const QHostAddress &hostAddress);
+    void requestDeviceInformation(const QNetworkRequest &networkRequest, const DescriptorRequest &descriptorRequest);
     void respondToSearchRequest(QHostAddress host, int port);
 
 protected:
@@ -29,15 +29,44 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "plugininfocache.h"
+#include "version.h"
 
 #include <QSettings>
 #include <QStandardPaths>
 #include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 
 #include "loggingcategories.h"
 
+// Bump this whenever the layout of the library cache file changes
+static const quint32 libraryCacheMagic = 0x6e796d70;
+static const quint32 libraryCacheFormatVersion = 2;
+
+bool PluginInfoCache::LibraryInfo::matches(const QFileInfo &fileInfo) const
+{
+    return fileName == fileInfo.absoluteFilePath()
+            && lastModified == fileInfo.lastModified().toMSecsSinceEpoch()
+            && size == fileInfo.size();
+}
+
+bool PluginInfoCache::LibraryInfo::operator==(const PluginInfoCache::LibraryInfo &other) const
+{
+    return fileName == other.fileName
+            && lastModified == other.lastModified
+            && size == other.size
+            && apiVersion == other.apiVersion
+            && metaData == other.metaData;
+}
+
+bool PluginInfoCache::LibraryInfo::operator!=(const PluginInfoCache::LibraryInfo &other) const
+{
+    return !operator==(other);
+}
+
 PluginInfoCache::PluginInfoCache()
 {
 
@@ -46,26 +75,38 @@ PluginInfoCache::PluginInfoCache()
 void PluginInfoCache::cachePluginInfo(const QJsonObject &metaData)
 {
     QString fileName = metaData.value("id").toString().remove(QRegExp("[{}]")) + ".cache";
-    QDir path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo/";
+    QDir path = cacheDir();
     if (!path.exists()) {
         if (!path.mkpath(path.absolutePath())) {
             qCWarning(dcThingManager()) << "Error creating thing class cache dir at" << path.absolutePath();
         }
     }
+
+    QByteArray data = QJsonDocument::fromVariant(metaData.toVariantMap()).toJson(QJsonDocument::Compact);
+
+    // Don't wear out the flash by rewriting an unchanged cache entry on every startup
     QFile file(path.absoluteFilePath(fileName));
+    if (file.size() == data.size() && file.open(QFile::ReadOnly)) {
+        bool unchanged = file.readAll() == data;
+        file.close();
+        if (unchanged) {
+            return;
+        }
+    }
+
     if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
         qCWarning(dcThingManager()) << "Error opening thing class cache for writing at" << path.absoluteFilePath(fileName);
         return;
     }
 
-    file.write(QJsonDocument::fromVariant(metaData.toVariantMap()).toJson(QJsonDocument::Compact));
+    file.write(data);
     file.close();
 }
 
 QJsonObject PluginInfoCache::loadPluginInfo(const PluginId &pluginId)
 {
     QString fileName = pluginId.toString().remove(QRegExp("[{}]")) + ".cache";
-    QDir path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo/";
+    QDir path = cacheDir();
     QFile file(path.absoluteFilePath(fileName));
     if (!file.open(QFile::ReadOnly)) {
         return QJsonObject();
@@ -80,3 +121,71 @@ QJsonObject PluginInfoCache::loadPluginInfo(const PluginId &pluginId)
     }
     return QJsonObject::fromVariantMap(jsonDoc.toVariant().toMap());
 }
+
+PluginInfoCache::LibraryInfos PluginInfoCache::loadLibraryInfos()
+{
+    LibraryInfos libraryInfos;
+
+    QFile file(QDir(cacheDir()).absoluteFilePath("libraries.cache"));
+    if (!file.open(QFile::ReadOnly)) {
+        return libraryInfos;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic, formatVersion;
+    QString coreApiVersion, coreVersion;
+    quint32 count;
+    stream >> magic >> formatVersion;
+    if (magic != libraryCacheMagic || formatVersion != libraryCacheFormatVersion) {
+        qCDebug(dcThingManager()) << "Plugin library cache has an unknown format. Discarding it.";
+        return libraryInfos;
+    }
+    // Any nymea upgrade invalidates the cache, not only those changing the libnymea API version
+    stream >> coreApiVersion >> coreVersion >> count;
+    if (coreApiVersion != LIBNYMEA_API_VERSION || coreVersion != NYMEA_VERSION_STRING) {
+        qCDebug(dcThingManager()) << "Plugin library cache is outdated. Discarding it.";
+        return libraryInfos;
+    }
+
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        LibraryInfo libraryInfo;
+        stream >> libraryInfo.fileName >> libraryInfo.lastModified >> libraryInfo.size >> libraryInfo.apiVersion >> libraryInfo.metaData;
+        libraryInfos.insert(libraryInfo.fileName, libraryInfo);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Plugin library cache is corrupt. Discarding it.";
+        return LibraryInfos();
+    }
+    return libraryInfos;
+}
+
+void PluginInfoCache::storeLibraryInfos(const LibraryInfos &libraryInfos)
+{
+    QDir path = cacheDir();
+    if (!path.exists() && !path.mkpath(path.absolutePath())) {
+        qCWarning(dcThingManager()) << "Error creating plugin library cache dir at" << path.absolutePath();
+        return;
+    }
+
+    QSaveFile file(path.absoluteFilePath("libraries.cache"));
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcThingManager()) << "Error opening plugin library cache for writing at" << file.fileName();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << libraryCacheMagic << libraryCacheFormatVersion << QString(LIBNYMEA_API_VERSION) << QString(NYMEA_VERSION_STRING) << static_cast<quint32>(libraryInfos.count());
+    foreach (const LibraryInfo &libraryInfo, libraryInfos) {
+        stream << libraryInfo.fileName << libraryInfo.lastModified << libraryInfo.size << libraryInfo.apiVersion << libraryInfo.metaData;
+    }
+
+    if (!file.commit()) {
+        qCWarning(dcThingManager()) << "Error writing plugin library cache:" << file.errorString();
+    }
+}
+
+QString PluginInfoCache::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugininfo/";
+}
@@ -34,13 +34,39 @@
 #include "types/thingclass.h"
 #include "integrations/integrationplugin.h"
 
+#include <QHash>
+#include <QFileInfo>
+
 class PluginInfoCache
 {
 public:
+    // Validated metadata of a plugin library. An entry is only valid as long as
+    // the library file on disk still has the same modification time and size.
+    class LibraryInfo
+    {
+    public:
+        QString fileName;
+        qint64 lastModified = 0;
+        qint64 size = 0;
+        QString apiVersion;
+        QByteArray metaData;
+
+        bool matches(const QFileInfo &fileInfo) const;
+        bool operator==(const LibraryInfo &other) const;
+        bool operator!=(const LibraryInfo &other) const;
+    };
+    typedef QHash<QString, LibraryInfo> LibraryInfos;
+
     PluginInfoCache();
 
     static void cachePluginInfo(const QJsonObject &metaData);
     static QJsonObject loadPluginInfo(const PluginId &pluginId);
+
+    static LibraryInfos loadLibraryInfos();
+    static void storeLibraryInfos(const LibraryInfos &libraryInfos);
+
+private:
+    static QString cacheDir();
 };
 
 #endif // PLUGININFOCACHE_H
@@ -0,0 +1,225 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "statechangebus.h"
+#include "integrations/thing.h"
+#include "loggingcategories.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTimer>
+
+StateChange::StateChange(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value):
+    m_thing(thing),
+    m_thingId(thing->id()),
+    m_stateTypeId(stateTypeId),
+    m_value(value),
+    m_timestamp(QDateTime::currentMSecsSinceEpoch()),
+    m_event(EventTypeId(stateTypeId), thing->id(), ParamList() << Param(ParamTypeId(stateTypeId), value), true),
+    m_traceContext(nymeaserver::Tracer::currentContext())
+{
+
+}
+
+Thing *StateChange::thing() const
+{
+    return m_thing.data();
+}
+
+ThingId StateChange::thingId() const
+{
+    return m_thingId;
+}
+
+StateTypeId StateChange::stateTypeId() const
+{
+    return m_stateTypeId;
+}
+
+QVariant StateChange::value() const
+{
+    return m_value;
+}
+
+qint64 StateChange::timestamp() const
+{
+    return m_timestamp;
+}
+
+Event StateChange::event() const
+{
+    return m_event;
+}
+
+nymeaserver::TraceContext StateChange::traceContext() const
+{
+    return m_traceContext;
+}
+
+qint64 StateChangeBus::StageStatistics::nsecsPerChange() const
+{
+    return changes > 0 ? totalNsecs / static_cast<qint64>(changes) : 0;
+}
+
+StateChangeBus::StateChangeBus(QObject *parent):
+    QObject(parent)
+{
+
+}
+
+StateChangeBus::~StateChangeBus()
+{
+    // Not flushing here, the consumers are likely half way destroyed by now. Owners are expected to flush before.
+    qDeleteAll(m_stages);
+}
+
+void StateChangeBus::addConsumer(const QString &stage, QObject *owner, Consumer consumer, DeliveryMode deliveryMode, int interval, StageOrder order)
+{
+    Stage *s = new Stage();
+    s->owner = owner;
+    s->consumer = consumer;
+    s->order = order;
+    s->statistics.stage = stage;
+    s->statistics.deliveryMode = deliveryMode;
+    if (deliveryMode != DeliveryImmediate) {
+        s->timer = new QTimer(this);
+        s->timer->setSingleShot(true);
+        s->timer->setInterval(interval);
+        connect(s->timer, &QTimer::timeout, this, [this, s](){
+            flushStage(s);
+        });
+    }
+    int index = m_stages.count();
+    while (index > 0 && m_stages.at(index - 1)->order > order) {
+        index--;
+    }
+    m_stages.insert(index, s);
+    qCDebug(dcThingManager()) << "State change consumer added:" << stage;
+}
+
+void StateChangeBus::removeConsumers(QObject *owner)
+{
+    for (int i = m_stages.count() - 1; i >= 0; i--) {
+        Stage *stage = m_stages.at(i);
+        if (stage->owner == owner) {
+            m_stages.removeAt(i);
+            delete stage->timer;
+            delete stage;
+        }
+    }
+}
+
+void StateChangeBus::publish(const StateChange &change)
+{
+    m_publishedChanges++;
+
+    // Consumers may publish further changes (e.g. IO connections), but they must not add or remove stages meanwhile.
+    for (int i = 0; i < m_stages.count(); i++) {
+        Stage *stage = m_stages.at(i);
+        if (stage->statistics.deliveryMode == DeliveryImmediate) {
+            deliver(stage, QList<StateChange>() << change);
+        } else {
+            enqueue(stage, change);
+        }
+    }
+}
+
+void StateChangeBus::flush()
+{
+    foreach (Stage *stage, m_stages) {
+        if (stage->timer) {
+            flushStage(stage);
+        }
+    }
+}
+
+quint64 StateChangeBus::publishedChanges() const
+{
+    return m_publishedChanges;
+}
+
+QList<StateChangeBus::StageStatistics> StateChangeBus::statistics() const
+{
+    QList<StageStatistics> ret;
+    foreach (Stage *stage, m_stages) {
+        ret.append(stage->statistics);
+    }
+    return ret;
+}
+
+void StateChangeBus::enqueue(Stage *stage, const StateChange &change)
+{
+    if (stage->statistics.deliveryMode == DeliveryCoalesced) {
+        QPair<ThingId, StateTypeId> key(change.thingId(), change.stateTypeId());
+        QHash<QPair<ThingId, StateTypeId>, int>::const_iterator it = stage->pendingIndex.constFind(key);
+        if (it != stage->pendingIndex.constEnd()) {
+            stage->pending[it.value()] = change;
+            return;
+        }
+        stage->pendingIndex.insert(key, stage->pending.count());
+    }
+    stage->pending.append(change);
+    if (!stage->timer->isActive()) {
+        stage->timer->start();
+    }
+}
+
+void StateChangeBus::flushStage(Stage *stage)
+{
+    stage->timer->stop();
+    if (stage->pending.isEmpty()) {
+        return;
+    }
+    QList<StateChange> changes = stage->pending;
+    stage->pending.clear();
+    stage->pendingIndex.clear();
+    deliver(stage, changes);
+}
+
+void StateChangeBus::deliver(Stage *stage, const QList<StateChange> &changes)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Immediate stages run within the publishing span, a batch continues the trace of its first change
+    nymeaserver::TraceScope traceScope("StateChangeBus::deliver", "statechangebus", stage->statistics.deliveryMode == DeliveryImmediate ? nymeaserver::Tracer::currentContext() : changes.first().traceContext());
+    if (traceScope.isActive()) {
+        traceScope.setName("StateChangeBus::" + stage->statistics.stage);
+        traceScope.setArg("changes", changes.count());
+    }
+
+    stage->consumer(changes);
+
+    qint64 elapsed = timer.nsecsElapsed();
+    stage->statistics.changes += changes.count();
+    stage->statistics.batches++;
+    stage->statistics.totalNsecs += elapsed;
+    stage->statistics.maxNsecs = qMax(stage->statistics.maxNsecs, elapsed);
+}
@@ -0,0 +1,157 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATECHANGEBUS_H
+#define STATECHANGEBUS_H
+
+#include "typeutils.h"
+#include "types/event.h"
+#include "diagnostics/tracer.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QVariant>
+#include <QHash>
+#include <QList>
+
+#include <functional>
+
+class Thing;
+class QTimer;
+
+// A single state change. Built once by the ThingManager and shared by all consumers of the StateChangeBus.
+class StateChange
+{
+public:
+    StateChange() = default;
+    StateChange(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value);
+
+    // Null if the thing has been removed before a batched consumer got to see this change
+    Thing *thing() const;
+    ThingId thingId() const;
+    StateTypeId stateTypeId() const;
+    QVariant value() const;
+    qint64 timestamp() const;
+
+    // The state change event, as passed on to logging, rules and the API
+    Event event() const;
+
+    // The trace the change was published in, batched stages continue it
+    nymeaserver::TraceContext traceContext() const;
+
+private:
+    QPointer<Thing> m_thing;
+    ThingId m_thingId;
+    StateTypeId m_stateTypeId;
+    QVariant m_value;
+    qint64 m_timestamp = 0;
+    Event m_event;
+    nymeaserver::TraceContext m_traceContext;
+};
+
+// Fans out state changes to the registered consumer stages in a single pass.
+// Each stage picks its own delivery mode, and the time spent per stage is accounted for profiling.
+class StateChangeBus : public QObject
+{
+    Q_OBJECT
+public:
+    enum DeliveryMode {
+        // Called synchronously for every change, in stage order
+        DeliveryImmediate,
+        // Changes are queued and handed over in one batch after the interval
+        DeliveryBatched,
+        // Like batched, but only the latest change per thing and state is kept
+        DeliveryCoalesced
+    };
+
+    // Stages are run in ascending order, stages with the same order in the order they were added
+    enum StageOrder {
+        StageOrderDefault = 0,
+        // For stages causing further state changes (e.g. IO connections). All other stages
+        // must have seen a change before the changes caused by it are published.
+        StageOrderLast = 100
+    };
+
+    typedef std::function<void(const QList<StateChange> &changes)> Consumer;
+
+    class StageStatistics
+    {
+    public:
+        QString stage;
+        DeliveryMode deliveryMode = DeliveryImmediate;
+        // State changes delivered to this stage
+        quint64 changes = 0;
+        // Consumer invocations, equals changes for immediate stages
+        quint64 batches = 0;
+        qint64 totalNsecs = 0;
+        // The most expensive single invocation
+        qint64 maxNsecs = 0;
+
+        qint64 nsecsPerChange() const;
+    };
+
+    explicit StateChangeBus(QObject *parent = nullptr);
+    ~StateChangeBus() override;
+
+    // The owner is only used to remove the consumer again, the consumer is not bound to the owner's thread.
+    void addConsumer(const QString &stage, QObject *owner, Consumer consumer, DeliveryMode deliveryMode = DeliveryImmediate, int interval = 0, StageOrder order = StageOrderDefault);
+    void removeConsumers(QObject *owner);
+
+    void publish(const StateChange &change);
+
+    // Hands all queued changes over to the batched stages right away.
+    void flush();
+
+    quint64 publishedChanges() const;
+    QList<StageStatistics> statistics() const;
+
+private:
+    class Stage
+    {
+    public:
+        QObject *owner = nullptr;
+        Consumer consumer;
+        StageOrder order = StageOrderDefault;
+        QTimer *timer = nullptr;
+        QList<StateChange> pending;
+        // Index into pending, for coalescing stages
+        QHash<QPair<ThingId, StateTypeId>, int> pendingIndex;
+        StageStatistics statistics;
+    };
+
+    void enqueue(Stage *stage, const StateChange &change);
+    void flushStage(Stage *stage);
+    void deliver(Stage *stage, const QList<StateChange> &changes);
+
+    QList<Stage*> m_stages;
+    quint64 m_publishedChanges = 0;
+};
+
+#endif // STATECHANGEBUS_H
@@ -0,0 +1,115 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "thingchangejournal.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+
+ThingChangeJournal::ThingChangeJournal(int maxEntries):
+    m_maxEntries(maxEntries)
+{
+    // Start with a time based revision so revisions are still increasing after a restart
+    // and clients with an old revision get a full sync instead of a bogus delta.
+    m_revision = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch()) * 1000;
+    m_truncatedRevision = m_revision;
+}
+
+quint64 ThingChangeJournal::revision() const
+{
+    return m_revision;
+}
+
+void ThingChangeJournal::recordChange(ThingChangeJournal::ChangeType changeType, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    Entry entry;
+    entry.revision = ++m_revision;
+    entry.changeType = changeType;
+    entry.thingId = thingId;
+    entry.stateTypeId = stateTypeId;
+    m_entries.append(entry);
+
+    while (m_entries.count() > m_maxEntries) {
+        m_truncatedRevision = m_entries.takeFirst().revision;
+    }
+}
+
+ThingChangeJournal::Changes ThingChangeJournal::changesSince(quint64 revision) const
+{
+    Changes changes;
+    if (revision < m_truncatedRevision || revision > m_revision) {
+        return changes;
+    }
+    changes.complete = true;
+
+    // Entries are sorted by revision
+    QList<Entry>::const_iterator it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), revision, [](quint64 revision, const Entry &entry) {
+        return revision < entry.revision;
+    });
+
+    QSet<ThingId> changedThings;
+    QSet<ThingId> removedThings;
+    QSet<QPair<ThingId, StateTypeId> > changedStates;
+    for (; it != m_entries.constEnd(); ++it) {
+        const Entry &entry = *it;
+        switch (entry.changeType) {
+        case ChangeTypeAdded:
+            removedThings.remove(entry.thingId);
+            changedThings.insert(entry.thingId);
+            break;
+        case ChangeTypeChanged:
+        case ChangeTypeSettingChanged:
+            changedThings.insert(entry.thingId);
+            break;
+        case ChangeTypeRemoved:
+            changedThings.remove(entry.thingId);
+            removedThings.insert(entry.thingId);
+            break;
+        case ChangeTypeStateChanged:
+            changedStates.insert(qMakePair(entry.thingId, entry.stateTypeId));
+            break;
+        }
+    }
+
+    foreach (const ThingId &thingId, changedThings) {
+        changes.changedThings.append(thingId);
+    }
+    foreach (const ThingId &thingId, removedThings) {
+        changes.removedThings.append(thingId);
+    }
+    // Things sent in full or removed don't need their states sent separately
+    foreach (const auto &state, changedStates) {
+        if (!changedThings.contains(state.first) && !removedThings.contains(state.first)) {
+            changes.changedStates.append(state);
+        }
+    }
+    return changes;
+}
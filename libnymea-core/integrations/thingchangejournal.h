@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGCHANGEJOURNAL_H
+#define THINGCHANGEJOURNAL_H
+
+#include "typeutils.h"
+
+#include <QList>
+#include <QSet>
+#include <QPair>
+
+// Keeps track of changes to the configured things so clients can sync incrementally.
+// Only ids are recorded, values are to be fetched from the things when building the delta.
+class ThingChangeJournal
+{
+public:
+    enum ChangeType {
+        ChangeTypeAdded,
+        ChangeTypeChanged,
+        ChangeTypeRemoved,
+        ChangeTypeStateChanged,
+        ChangeTypeSettingChanged
+    };
+
+    class Changes
+    {
+    public:
+        // False if the journal does not reach back to the requested revision
+        bool complete = false;
+        // Added things, or things with changed params, settings or names
+        QList<ThingId> changedThings;
+        QList<ThingId> removedThings;
+        QList<QPair<ThingId, StateTypeId> > changedStates;
+    };
+
+    explicit ThingChangeJournal(int maxEntries = 5000);
+
+    quint64 revision() const;
+
+    void recordChange(ChangeType changeType, const ThingId &thingId, const StateTypeId &stateTypeId = StateTypeId());
+
+    Changes changesSince(quint64 revision) const;
+
+private:
+    class Entry
+    {
+    public:
+        quint64 revision;
+        ChangeType changeType;
+        ThingId thingId;
+        StateTypeId stateTypeId;
+    };
+
+    int m_maxEntries = 0;
+    quint64 m_revision = 0;
+    // Changes up to (including) this revision are not in the journal any more
+    quint64 m_truncatedRevision = 0;
+    QList<Entry> m_entries;
+};
+
+#endif // THINGCHANGEJOURNAL_H
@@ -40,6 +40,9 @@
 #include "nymeasettings.h"
 #include "version.h"
 #include "plugininfocache.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/tracer.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingpairinginfo.h"
@@ -67,6 +70,7 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QJsonDocument>
+#include <QtConcurrent/QtConcurrentMap>
 
 ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardwareManager, const QLocale &locale, QObject *parent) :
     ThingManager(parent),
@@ -74,13 +78,22 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
     m_locale(locale),
     m_translator(new Translator(this))
 {
+    m_startupTimer.start();
+
     foreach (const Interface &interface, ThingUtils::allInterfaces()) {
         m_supportedInterfaces.insert(interface.name(), interface);
     }
 
-    // Migrate config from devices.conf (<0.20) to things.conf
+    // Migrate config from devices.conf (<0.20) to things.conf. Once the settings are stored in a
+    // settings log, things.conf is renamed to things.conf.migrated. Don't bring back the old
+    // config in that case.
     QString settingsPath = NymeaSettings::settingsPath();
-    if (QFile::exists(settingsPath + "/devices.conf") && !QFile::exists(settingsPath + "/things.conf")) {
+    QStringList thingsFiles = {"/things.conf", "/things.conf.migrated", "/things.store", "/things.store.migrated"};
+    bool thingsConfigured = false;
+    foreach (const QString &thingsFile, thingsFiles) {
+        thingsConfigured |= QFile::exists(settingsPath + thingsFile);
+    }
+    if (QFile::exists(settingsPath + "/devices.conf") && !thingsConfigured) {
         qCDebug(dcThingManager()) << "Migrating config from devices.conf to things.conf";
         QFile oldFile(settingsPath + "/devices.conf");
         oldFile.copy(settingsPath + "/things.conf");
@@ -90,6 +103,60 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
 
     m_apiKeysProvidersLoader = new ApiKeysProvidersLoader(this);
 
+    nymeaserver::MetricsRegistry::instance()->registerCounter("nymea_state_changes_total", "State changes per plugin", "plugin");
+    nymeaserver::MetricsRegistry::instance()->registerHistogram("nymea_action_duration_seconds", "Time plugins take to execute actions", nymeaserver::MetricsRegistry::latencyBuckets(), 0.000001, "plugin");
+
+    // Persisting states is expensive, write them in one go and only the latest value of each state
+    m_stateChangeBus = new StateChangeBus(this);
+    m_stateChangeBus->addConsumer("persistence", this, [this](const QList<StateChange> &changes){
+        NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+        foreach (const StateChange &change, changes) {
+            // Don't bring back the states of things removed in the meantime
+            if (!m_configuredThings.contains(change.thingId())) {
+                continue;
+            }
+            settings.beginGroup(change.thingId().toString());
+            settings.setValue(change.stateTypeId().toString(), change.value());
+            settings.endGroup();
+        }
+    }, StateChangeBus::DeliveryCoalesced, 1000);
+    m_stateChangeBus->addConsumer("signals", this, [this](const QList<StateChange> &changes){
+        foreach (const StateChange &change, changes) {
+            emit thingStateChanged(change.thing(), change.stateTypeId(), change.value());
+            emit eventTriggered(change.event());
+        }
+    });
+    // Runs after the stages added by NymeaCore, so a change is logged, notified and evaluated before the changes it causes
+    m_stateChangeBus->addConsumer("io", this, [this](const QList<StateChange> &changes){
+        foreach (const StateChange &change, changes) {
+            syncIOConnection(change.thing(), change.stateTypeId());
+        }
+    }, StateChangeBus::DeliveryImmediate, 0, StateChangeBus::StageOrderLast);
+
+    if (nymeaserver::MemoryAccounting *memoryAccounting = nymeaserver::MemoryAccounting::instance()) {
+        memoryAccounting->addProbe("thingmanager.things", this, [this](){
+            nymeaserver::MemoryAccounting::Usage usage;
+            usage.objects = m_configuredThings.count();
+            return usage;
+        });
+        // Action infos are owned by the thing manager until they finished and got deleted
+        memoryAccounting->addProbe("thingmanager.pendingActions", this, [this](){
+            nymeaserver::MemoryAccounting::Usage usage;
+            usage.objects = findChildren<ThingActionInfo*>(QString(), Qt::FindDirectChildrenOnly).count();
+            return usage;
+        });
+        // Each Python plugin runs in an interpreter of its own
+        memoryAccounting->addProbe("python.interpreters", this, [this](){
+            nymeaserver::MemoryAccounting::Usage usage;
+            foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
+                if (qobject_cast<PythonIntegrationPlugin*>(plugin)) {
+                    usage.objects++;
+                }
+            }
+            return usage;
+        });
+    }
+
     // Give hardware a chance to start up before loading plugins etc.
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
     QMetaObject::invokeMethod(this, "loadConfiguredThings", Qt::QueuedConnection);
@@ -103,6 +170,7 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
 
 ThingManagerImplementation::~ThingManagerImplementation()
 {
+    m_stateChangeBus->flush();
 
     delete m_translator;
 
@@ -197,6 +265,7 @@ void ThingManagerImplementation::registerStaticPlugin(IntegrationPlugin *plugin)
         return;
     }
     loadPlugin(plugin);
+    emit pluginsChanged();
 }
 
 IntegrationPlugins ThingManagerImplementation::plugins() const
@@ -963,12 +1032,12 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorThingNotFound;
         return result;
     }
-    if (!inputThing->thingClass().stateTypes().contains(connection.inputStateTypeId())) {
+    if (!inputThing->thingClass().hasStateType(connection.inputStateTypeId())) {
         qCWarning(dcThingManager()) << "Input thing" << inputThing->name() << "does not have a state with id" << connection.inputStateTypeId();
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType inputStateType = inputThing->thingClass().stateTypes().findById(connection.inputStateTypeId());
+    StateType inputStateType = inputThing->thingClass().getStateType(connection.inputStateTypeId());
 
     // Check if this is actually an input
     if (inputStateType.ioType() != Types::IOTypeDigitalInput && inputStateType.ioType() != Types::IOTypeAnalogInput) {
@@ -983,12 +1052,12 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
         result.error = Thing::ThingErrorThingNotFound;
         return result;
     }
-    if (!outputThing->thingClass().stateTypes().contains(connection.outputStateTypeId())) {
+    if (!outputThing->thingClass().hasStateType(connection.outputStateTypeId())) {
         qCWarning(dcThingManager()) << "Output thing" << outputThing->name() << "does not have a state with id" << connection.outputStateTypeId();
         result.error = Thing::ThingErrorStateTypeNotFound;
         return result;
     }
-    StateType outputStateType = outputThing->thingClass().stateTypes().findById(connection.outputStateTypeId());
+    StateType outputStateType = outputThing->thingClass().getStateType(connection.outputStateTypeId());
 
     // Check if this is actually an output
     if (outputStateType.ioType() != Types::IOTypeDigitalOutput && outputStateType.ioType() != Types::IOTypeAnalogOutput) {
@@ -1024,6 +1093,7 @@ IOConnectionResult ThingManagerImplementation::connectIO(const IOConnection &con
 
     // Finally add the connection
     m_ioConnections.insert(connection.id(), connection);
+    addIOConnectionEndpoints(connection);
 
     storeIOConnections();
 
@@ -1045,7 +1115,7 @@ Thing::ThingError ThingManagerImplementation::disconnectIO(const IOConnectionId
         qCWarning(dcThingManager()) << "IO connection" << ioConnectionId << "not found. Cannot disconnect.";
         return Thing::ThingErrorItemNotFound;
     }
-    m_ioConnections.remove(ioConnectionId);
+    removeIOConnectionEndpoints(m_ioConnections.take(ioConnectionId));
 
     NymeaSettings settings(NymeaSettings::SettingsRoleIOConnections);
     settings.beginGroup("IOConnections");
@@ -1225,7 +1295,7 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
 
     // Make sure this thing has an action type with this id
     ThingClass thingClass = findThingClass(thing->thingClassId());
-    ActionType actionType = thingClass.actionTypes().findById(action.actionTypeId());
+    ActionType actionType = thingClass.getActionType(action.actionTypeId());
     if (actionType.id().isNull()) {
         qCWarning(dcThingManager()) << "Cannot execute action. No such action type" << action.actionTypeId();
         ThingActionInfo *info = new ThingActionInfo(thing, action, this);
@@ -1252,6 +1322,23 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
         return info;
     }
 
+    QElapsedTimer actionTimer;
+    actionTimer.start();
+    nymeaserver::MetricHistogram *actionDurationMetric = nymeaserver::MetricsRegistry::instance()->histogram("nymea_action_duration_seconds", plugin->pluginName());
+    nymeaserver::AsyncTraceSpan actionSpan = nymeaserver::AsyncTraceSpan::begin("ThingManager::executeAction", "action");
+    if (actionSpan.isActive()) {
+        actionSpan.setArg("thing", thing->name());
+        actionSpan.setArg("actionTypeId", action.actionTypeId().toString());
+        actionSpan.setArg("plugin", plugin->pluginName());
+    }
+    connect(info, &ThingActionInfo::finished, this, [info, actionTimer, actionDurationMetric, actionSpan]() mutable {
+        actionDurationMetric->observe(actionTimer.nsecsElapsed() / 1000);
+        actionSpan.setArg("status", static_cast<int>(info->status()));
+        actionSpan.end();
+    });
+
+    // Whatever the plugin does right away, e.g. setting states, is caused by this action
+    nymeaserver::TraceScope pluginScope("IntegrationPlugin::executeAction", "plugin", actionSpan.context());
     plugin->executeAction(info);
 
     return info;
@@ -1259,6 +1346,9 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
 
 void ThingManagerImplementation::loadPlugins()
 {    
+    QElapsedTimer phaseTimer;
+    phaseTimer.start();
+
     QStringList searchDirs;
     // Add first level of subdirectories to the plugin search dirs so we can point to a collection of plugins
     foreach (const QString &path, pluginSearchDirs()) {
@@ -1269,55 +1359,92 @@ void ThingManagerImplementation::loadPlugins()
         }
     }
 
+    QList<QFileInfo> pluginFiles;
+    QList<PluginLibraryJob> libraryJobs;
+    PluginInfoCache::LibraryInfos libraryCache = PluginInfoCache::loadLibraryInfos();
     foreach (const QString &path, searchDirs) {
         QDir dir(path);
         qCDebug(dcThingManager) << "Loading plugins from:" << dir.absolutePath();
         foreach (const QString &entry, dir.entryList({"*.so", "*.js", "*.py"}, QDir::Files)) {
-
-            IntegrationPlugin *plugin = nullptr;
-
             QFileInfo fi(path + '/' + entry);
+            pluginFiles.append(fi);
             if (entry.startsWith("libnymea_integrationplugin") && entry.endsWith(".so")) {
-                plugin = createCppIntegrationPlugin(fi.absoluteFilePath());
+                PluginLibraryJob job;
+                job.fileInfo = fi;
+                PluginInfoCache::LibraryInfo cachedInfo = libraryCache.value(fi.absoluteFilePath());
+                if (cachedInfo.matches(fi)) {
+                    job.libraryInfo = cachedInfo;
+                    job.cached = true;
+                }
+                libraryJobs.append(job);
+            }
+        }
+    }
+    addStartupTiming("Scanning plugin directories", phaseTimer.restart());
 
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
+    // Reading and validating the plugin metadata is the expensive part and doesn't need the
+    // actual libraries to be loaded. Do that in parallel and only instantiate the plugins here.
+    QHash<QString, PluginLibraryJob> parsedLibraries;
+    foreach (const PluginLibraryJob &job, QtConcurrent::blockingMapped<QList<PluginLibraryJob> >(libraryJobs, parsePluginLibrary)) {
+        parsedLibraries.insert(job.fileInfo.absoluteFilePath(), job);
+    }
+    addStartupTiming(QString("Parsing metadata of %1 plugin libraries").arg(parsedLibraries.count()), phaseTimer.restart());
+
+    PluginInfoCache::LibraryInfos newLibraryCache;
+    foreach (const QFileInfo &fi, pluginFiles) {
+        QString entry = fi.fileName();
+        IntegrationPlugin *plugin = nullptr;
+
+        if (entry.startsWith("libnymea_integrationplugin") && entry.endsWith(".so")) {
+            PluginLibraryJob job = parsedLibraries.value(fi.absoluteFilePath());
+            plugin = createCppIntegrationPlugin(job);
+            if (plugin) {
+                newLibraryCache.insert(job.libraryInfo.fileName, job.libraryInfo);
+            }
+
+        } else if (entry.startsWith("integrationplugin") && entry.endsWith(".js")) {
 #if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
-                ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
-                bool ok = p->loadScript(fi.absoluteFilePath());
-                if (ok) {
-                    plugin = p;
-                } else {
-                    delete p;
-                }
+            ScriptIntegrationPlugin *p = new ScriptIntegrationPlugin(this);
+            bool ok = p->loadScript(fi.absoluteFilePath());
+            if (ok) {
+                plugin = p;
+            } else {
+                delete p;
+            }
 #else
-                qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
+            qCWarning(dcThingManager()) << "Not loading JS plugin as JS plugin support is not included in this nymea instance.";
 #endif
-            } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
-                PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
-                bool ok = p->loadScript(fi.absoluteFilePath());
-                if (ok) {
-                    plugin = p;
-                } else {
-                    delete p;
-                }
+        } else if (entry.startsWith("integrationplugin") && entry.endsWith(".py")) {
+            PythonIntegrationPlugin *p = new PythonIntegrationPlugin(this);
+            bool ok = p->loadScript(fi.absoluteFilePath());
+            if (ok) {
+                plugin = p;
             } else {
-                // Not a known plugin type
-                continue;
+                delete p;
             }
+        } else {
+            // Not a known plugin type
+            continue;
+        }
 
-            if (!plugin) {
-                qCWarning(dcThingManager()) << "Error loading plugin:" << fi.absoluteFilePath();
-                continue;
-            }
+        if (!plugin) {
+            qCWarning(dcThingManager()) << "Error loading plugin:" << fi.absoluteFilePath();
+            continue;
+        }
 
-            if (m_integrationPlugins.contains(plugin->pluginId())) {
-                qCWarning(dcThingManager()) << "A plugin with this ID is already loaded. Not loading" << entry << plugin->pluginId();
-                delete plugin;
-                continue;
-            }
-            loadPlugin(plugin);
-            PluginInfoCache::cachePluginInfo(plugin->metadata().jsonObject());
+        if (m_integrationPlugins.contains(plugin->pluginId())) {
+            qCWarning(dcThingManager()) << "A plugin with this ID is already loaded. Not loading" << entry << plugin->pluginId();
+            delete plugin;
+            continue;
         }
+        loadPlugin(plugin);
+        PluginInfoCache::cachePluginInfo(plugin->metadata().jsonObject());
+    }
+    addStartupTiming(QString("Initializing %1 plugins").arg(m_integrationPlugins.count()), phaseTimer.restart());
+
+    if (newLibraryCache != libraryCache) {
+        qCDebug(dcThingManager()) << "Plugin libraries changed. Updating plugin library cache.";
+        PluginInfoCache::storeLibraryInfos(newLibraryCache);
     }
 }
 
@@ -1407,6 +1534,9 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface)
 
 void ThingManagerImplementation::loadConfiguredThings()
 {
+    QElapsedTimer timer;
+    timer.start();
+
     bool needsMigration = false;
     NymeaSettings settings(NymeaSettings::SettingsRoleThings);
     if (settings.childGroups().contains("ThingConfig")) {
@@ -1564,6 +1694,8 @@ void ThingManagerImplementation::loadConfiguredThings()
     }
 
     loadIOConnections();
+
+    addStartupTiming(QString("Loading %1 configured things").arg(m_configuredThings.count()), timer.elapsed());
 }
 
 void ThingManagerImplementation::storeConfiguredThings()
@@ -1697,6 +1829,11 @@ void ThingManagerImplementation::onAutoThingDisappeared(const ThingId &thingId)
 void ThingManagerImplementation::onLoaded()
 {
     qCDebug(dcThingManager()) << "Done loading plugins and things.";
+    addStartupTiming("Total", m_startupTimer.elapsed());
+    qCInfo(dcThingManager()) << "Startup timing report:";
+    for (int i = 0; i < m_startupTimings.count(); i++) {
+        qCInfo(dcThingManager()).nospace().noquote() << "* " << m_startupTimings.at(i).first << ": " << m_startupTimings.at(i).second << " ms";
+    }
     emit loaded();
 
     // schedule some housekeeping...
@@ -1723,11 +1860,19 @@ void ThingManagerImplementation::onEventTriggered(const Event &event)
         qCWarning(dcThingManager()) << "Invalid thing id in emitted event. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    EventType eventType = thing->thingClass().eventTypes().findById(event.eventTypeId());
+    EventType eventType = thing->thingClass().getEventType(event.eventTypeId());
     if (!eventType.isValid()) {
         qCWarning(dcThingManager()) << "The given thing does not have an event type of id " + event.eventTypeId().toString() + ". Not forwarding event.";
         return;
     }
+
+    nymeaserver::TraceScope traceScope("ThingManager::eventTriggered", "thingmanager");
+    if (traceScope.isActive()) {
+        traceScope.setArg("thing", thing->name());
+        traceScope.setArg("eventTypeId", event.eventTypeId().toString());
+        traceScope.setArg("plugin", thing->pluginId().toString());
+    }
+
     // All good, forward the event
     emit eventTriggered(event);
 }
@@ -1739,21 +1884,37 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
         qCWarning(dcThingManager()) << "Invalid thing id in state change. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    storeThingState(thing, stateTypeId);
 
-    emit thingStateChanged(thing, stateTypeId, value);
+    nymeaserver::MetricCounter *stateChangesMetric = m_stateChangeMetrics.value(thing->pluginId());
+    if (!stateChangesMetric) {
+        IntegrationPlugin *plugin = m_integrationPlugins.value(thing->pluginId());
+        stateChangesMetric = nymeaserver::MetricsRegistry::instance()->counter("nymea_state_changes_total", plugin ? plugin->pluginName() : thing->pluginId().toString());
+        m_stateChangeMetrics.insert(thing->pluginId(), stateChangesMetric);
+    }
+    stateChangesMetric->increment();
 
-    Param valueParam(ParamTypeId(stateTypeId.toString()), value);
-    Event event(EventTypeId(stateTypeId.toString()), thing->id(), ParamList() << valueParam, true);
-    emit eventTriggered(event);
+    nymeaserver::TraceScope traceScope("ThingManager::stateChanged", "thingmanager");
+    if (traceScope.isActive()) {
+        traceScope.setArg("thing", thing->name());
+        traceScope.setArg("stateTypeId", stateTypeId.toString());
+        traceScope.setArg("plugin", thing->pluginId().toString());
+    }
 
-    syncIOConnection(thing, stateTypeId);
+    m_stateChangeBus->publish(StateChange(thing, stateTypeId, value));
 }
 
 void ThingManagerImplementation::syncIOConnection(Thing *thing, const StateTypeId &stateTypeId)
 {
+    // Only look at the connections this state is an endpoint of
+    QList<IOConnectionId> ioConnectionIds = ioConnectionsAt(thing->id(), stateTypeId);
+    if (ioConnectionIds.isEmpty()) {
+        return;
+    }
 
-    foreach (const IOConnection &ioConnection, m_ioConnections) {
+    nymeaserver::TraceScope traceScope("ThingManager::syncIOConnection", "ioconnections");
+    traceScope.setArg("connections", ioConnectionIds.count());
+    foreach (const IOConnectionId &ioConnectionId, ioConnectionIds) {
+        IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
         // Check if this state is an input to an IO connection.
         if (ioConnection.inputThingId() == thing->id() && ioConnection.inputStateTypeId() == stateTypeId) {
             Thing *inputThing = thing;
@@ -1869,6 +2030,75 @@ void ThingManagerImplementation::syncIOConnection(Thing *thing, const StateTypeI
     }
 }
 
+QList<IOConnectionId> ThingManagerImplementation::ioConnectionsAt(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    TypeIdRegistry::Handle thingHandle = thingId.handle();
+    TypeIdRegistry::Handle stateTypeHandle = stateTypeId.handle();
+    if (thingHandle == 0 || stateTypeHandle == 0 || thingHandle >= static_cast<uint>(m_ioConnectionEndpoints.count())) {
+        return QList<IOConnectionId>();
+    }
+    // A thing is only connected with a few of its states, a linear scan beats hashing here
+    foreach (const IOEndpoint &endpoint, m_ioConnectionEndpoints.at(static_cast<int>(thingHandle))) {
+        if (endpoint.stateTypeHandle == stateTypeHandle) {
+            return endpoint.ioConnectionIds;
+        }
+    }
+    return QList<IOConnectionId>();
+}
+
+void ThingManagerImplementation::addIOConnectionEndpoint(const ThingId &thingId, const StateTypeId &stateTypeId, const IOConnectionId &ioConnectionId)
+{
+    int thingHandle = static_cast<int>(TypeIdRegistry::intern(thingId));
+    TypeIdRegistry::Handle stateTypeHandle = TypeIdRegistry::intern(stateTypeId);
+    if (thingHandle >= m_ioConnectionEndpoints.count()) {
+        m_ioConnectionEndpoints.resize(thingHandle + 1);
+    }
+    QList<IOEndpoint> &endpoints = m_ioConnectionEndpoints[thingHandle];
+    for (int i = 0; i < endpoints.count(); i++) {
+        if (endpoints.at(i).stateTypeHandle == stateTypeHandle) {
+            if (!endpoints.at(i).ioConnectionIds.contains(ioConnectionId)) {
+                endpoints[i].ioConnectionIds.append(ioConnectionId);
+            }
+            return;
+        }
+    }
+    IOEndpoint endpoint;
+    endpoint.stateTypeHandle = stateTypeHandle;
+    endpoint.ioConnectionIds.append(ioConnectionId);
+    endpoints.append(endpoint);
+}
+
+void ThingManagerImplementation::removeIOConnectionEndpoint(const ThingId &thingId, const StateTypeId &stateTypeId, const IOConnectionId &ioConnectionId)
+{
+    TypeIdRegistry::Handle thingHandle = thingId.handle();
+    TypeIdRegistry::Handle stateTypeHandle = stateTypeId.handle();
+    if (thingHandle >= static_cast<uint>(m_ioConnectionEndpoints.count())) {
+        return;
+    }
+    QList<IOEndpoint> &endpoints = m_ioConnectionEndpoints[static_cast<int>(thingHandle)];
+    for (int i = 0; i < endpoints.count(); i++) {
+        if (endpoints.at(i).stateTypeHandle == stateTypeHandle) {
+            endpoints[i].ioConnectionIds.removeAll(ioConnectionId);
+            if (endpoints.at(i).ioConnectionIds.isEmpty()) {
+                endpoints.removeAt(i);
+            }
+            return;
+        }
+    }
+}
+
+void ThingManagerImplementation::addIOConnectionEndpoints(const IOConnection &ioConnection)
+{
+    addIOConnectionEndpoint(ioConnection.inputThingId(), ioConnection.inputStateTypeId(), ioConnection.id());
+    addIOConnectionEndpoint(ioConnection.outputThingId(), ioConnection.outputStateTypeId(), ioConnection.id());
+}
+
+void ThingManagerImplementation::removeIOConnectionEndpoints(const IOConnection &ioConnection)
+{
+    removeIOConnectionEndpoint(ioConnection.inputThingId(), ioConnection.inputStateTypeId(), ioConnection.id());
+    removeIOConnectionEndpoint(ioConnection.outputThingId(), ioConnection.outputStateTypeId(), ioConnection.id());
+}
+
 void ThingManagerImplementation::slotThingSettingChanged(const ParamTypeId &paramTypeId, const QVariant &value)
 {
     Thing *thing = qobject_cast<Thing*>(sender());
@@ -1967,6 +2197,8 @@ ThingSetupInfo* ThingManagerImplementation::setupThing(Thing *thing)
         states.append(state);
     }
     thing->setStates(states);
+    // Make sure no state changes are pending to be written before reading them back
+    m_stateChangeBus->flush();
     loadThingStates(thing);
 
     ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
@@ -2048,6 +2280,7 @@ void ThingManagerImplementation::loadIOConnections()
         bool inverted = connectionSettings.value("inverted").toBool();
         IOConnection ioConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted);
         m_ioConnections.insert(id, ioConnection);
+        addIOConnectionEndpoints(ioConnection);
         connectionSettings.endGroup();
 
         Thing *inputThing = m_configuredThings.value(inputThingId);
@@ -2105,6 +2338,7 @@ void ThingManagerImplementation::trySetupThing(Thing *thing)
 
 void ThingManagerImplementation::registerThing(Thing *thing)
 {
+    TypeIdRegistry::intern(thing->id());
     m_configuredThings.insert(thing->id(), thing);
     connect(thing, &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
     connect(thing, &Thing::stateValueChanged, this, &ThingManagerImplementation::slotThingStateValueChanged);
@@ -2112,29 +2346,41 @@ void ThingManagerImplementation::registerThing(Thing *thing)
     connect(thing, &Thing::nameChanged, this, &ThingManagerImplementation::slotThingNameChanged);
 }
 
-IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const QString &absoluteFilePath)
+IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(PluginLibraryJob &job)
 {
-    // Check plugin API version compatibility
-    QLibrary lib(absoluteFilePath);
-    if (!lib.load()) {
-        qCWarning(dcThingManager()).nospace() << "Error loading plugin " << absoluteFilePath << ": " << lib.errorString();
+    QString absoluteFilePath = job.fileInfo.absoluteFilePath();
+    if (!job.valid) {
+        foreach (const QString &error, job.validationErrors) {
+            qCWarning(dcThingManager()) << error;
+        }
         return nullptr;
     }
 
-    QFunctionPointer versionFunc = lib.resolve("libnymea_api_version");
-    if (!versionFunc) {
-        qCWarning(dcThingManager()).nospace() << "Unable to resolve version in plugin " << absoluteFilePath << ". Not loading plugin.";
-        lib.unload();
-        return nullptr;
-    }
+    // Check plugin API version compatibility. Libraries found in the cache have been verified already.
+    // The library is kept loaded until the QPluginLoader took over so it won't be mapped twice.
+    QLibrary lib(absoluteFilePath);
+    if (!job.cached) {
+        if (!lib.load()) {
+            qCWarning(dcThingManager()).nospace() << "Error loading plugin " << absoluteFilePath << ": " << lib.errorString();
+            return nullptr;
+        }
 
-    QString version = reinterpret_cast<QString(*)()>(versionFunc)();
-    lib.unload();
-    QStringList parts = version.split('.');
-    QStringList coreParts = QString(LIBNYMEA_API_VERSION).split('.');
-    if (parts.length() != 3 || parts.at(0).toInt() != coreParts.at(0).toInt() || parts.at(1).toInt() > coreParts.at(1).toInt()) {
-        qCWarning(dcThingManager()).nospace() << "Libnymea API mismatch for " << absoluteFilePath << ". Core API: " << LIBNYMEA_API_VERSION << ", Plugin API: " << version;
-        return nullptr;
+        QFunctionPointer versionFunc = lib.resolve("libnymea_api_version");
+        if (!versionFunc) {
+            qCWarning(dcThingManager()).nospace() << "Unable to resolve version in plugin " << absoluteFilePath << ". Not loading plugin.";
+            lib.unload();
+            return nullptr;
+        }
+
+        QString version = reinterpret_cast<QString(*)()>(versionFunc)();
+        QStringList parts = version.split('.');
+        QStringList coreParts = QString(LIBNYMEA_API_VERSION).split('.');
+        if (parts.length() != 3 || parts.at(0).toInt() != coreParts.at(0).toInt() || parts.at(1).toInt() > coreParts.at(1).toInt()) {
+            qCWarning(dcThingManager()).nospace() << "Libnymea API mismatch for " << absoluteFilePath << ". Core API: " << LIBNYMEA_API_VERSION << ", Plugin API: " << version;
+            lib.unload();
+            return nullptr;
+        }
+        job.libraryInfo.apiVersion = version;
     }
 
     // Version is ok. Now load the plugin
@@ -2142,19 +2388,13 @@ IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const
     loader.setFileName(absoluteFilePath);
     loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
 
-    qCDebug(dcThingManager()) << "Loading plugin from:" << absoluteFilePath;
-    if (!loader.load()) {
-        qCWarning(dcThingManager) << "Could not load plugin data of" << absoluteFilePath << "\n" << loader.errorString();
-        return nullptr;
+    qCDebug(dcThingManager()) << "Loading plugin from:" << absoluteFilePath << (job.cached ? "(cached)" : "");
+    bool loaded = loader.load();
+    if (lib.isLoaded()) {
+        lib.unload();
     }
-
-    QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
-    PluginMetadata metaData(pluginInfo, false, false);
-    if (!metaData.isValid()) {
-        foreach (const QString &error, metaData.validationErrors()) {
-            qCWarning(dcThingManager()) << error;
-        }
-        loader.unload();
+    if (!loaded) {
+        qCWarning(dcThingManager) << "Could not load plugin data of" << absoluteFilePath << "\n" << loader.errorString();
         return nullptr;
     }
 
@@ -2169,11 +2409,56 @@ IntegrationPlugin *ThingManagerImplementation::createCppIntegrationPlugin(const
         return nullptr;
     }
 
-    pluginIface->setMetaData(PluginMetadata(pluginInfo));
+    pluginIface->setMetaData(job.metaData);
 
     return pluginIface;
 }
 
+ThingManagerImplementation::PluginLibraryJob ThingManagerImplementation::parsePluginLibrary(const PluginLibraryJob &input)
+{
+    // Note: This runs in a worker thread.
+    PluginLibraryJob job = input;
+
+    if (job.cached) {
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(job.libraryInfo.metaData, &error);
+        if (error.error == QJsonParseError::NoError) {
+            // The cache only contains entries which passed validation before
+            job.metaData = PluginMetadata(jsonDoc.object());
+            job.valid = true;
+            return job;
+        }
+        qCWarning(dcThingManager()) << "Invalid plugin library cache entry for" << job.fileInfo.absoluteFilePath();
+        job.cached = false;
+    }
+
+    QPluginLoader loader(job.fileInfo.absoluteFilePath());
+    QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
+    PluginMetadata validationMetaData(pluginInfo, false, false);
+    job.valid = validationMetaData.isValid();
+    if (!job.valid) {
+        job.validationErrors = validationMetaData.validationErrors();
+        return job;
+    }
+
+    job.metaData = PluginMetadata(pluginInfo);
+    job.libraryInfo.fileName = job.fileInfo.absoluteFilePath();
+    job.libraryInfo.lastModified = job.fileInfo.lastModified().toMSecsSinceEpoch();
+    job.libraryInfo.size = job.fileInfo.size();
+    job.libraryInfo.metaData = QJsonDocument(pluginInfo).toJson(QJsonDocument::Compact);
+    return job;
+}
+
+StateChangeBus *ThingManagerImplementation::stateChangeBus() const
+{
+    return m_stateChangeBus;
+}
+
+void ThingManagerImplementation::addStartupTiming(const QString &phase, qint64 duration)
+{
+    m_startupTimings.append(qMakePair(phase, duration));
+}
+
 void ThingManagerImplementation::storeThingStates(Thing *thing)
 {
     ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
@@ -49,8 +49,13 @@
 #include <QLocale>
 #include <QPluginLoader>
 #include <QTranslator>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QVector>
 
 #include "hardwaremanager.h"
+#include "plugininfocache.h"
+#include "statechangebus.h"
 
 #include "integrations/thingmanager.h"
 
@@ -61,6 +66,10 @@ class HardwareManager;
 class Translator;
 class ApiKeysProvidersLoader;
 
+namespace nymeaserver {
+class MetricCounter;
+}
+
 class ThingManagerImplementation: public ThingManager
 {
     Q_OBJECT
@@ -127,8 +136,12 @@ public:
     ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) override;
     Vendor translateVendor(const Vendor &vendor, const QLocale &locale) override;
 
+    // All state changes pass through this bus. Consumers within the core subscribe here instead of the signals.
+    StateChangeBus *stateChangeBus() const;
+
 signals:
     void loaded();
+    void pluginsChanged();
 
 private slots:
     void loadPlugins();
@@ -164,9 +177,26 @@ private:
     void storeIOConnections();
     void loadIOConnections();
     void syncIOConnection(Thing *inputThing, const StateTypeId &stateTypeId);
+    QList<IOConnectionId> ioConnectionsAt(const ThingId &thingId, const StateTypeId &stateTypeId) const;
+    void addIOConnectionEndpoint(const ThingId &thingId, const StateTypeId &stateTypeId, const IOConnectionId &ioConnectionId);
+    void removeIOConnectionEndpoint(const ThingId &thingId, const StateTypeId &stateTypeId, const IOConnectionId &ioConnectionId);
+    void addIOConnectionEndpoints(const IOConnection &ioConnection);
+    void removeIOConnectionEndpoints(const IOConnection &ioConnection);
     QVariant mapValue(const QVariant &value, const StateType &fromStateType, const StateType &toStateType, bool inverted) const;
 
-    IntegrationPlugin *createCppIntegrationPlugin(const QString &absoluteFilePath);
+    class PluginLibraryJob {
+    public:
+        QFileInfo fileInfo;
+        PluginInfoCache::LibraryInfo libraryInfo;
+        bool cached = false;
+        bool valid = false;
+        PluginMetadata metaData;
+        QStringList validationErrors;
+    };
+    static PluginLibraryJob parsePluginLibrary(const PluginLibraryJob &input);
+    IntegrationPlugin *createCppIntegrationPlugin(PluginLibraryJob &job);
+
+    void addStartupTiming(const QString &phase, qint64 duration);
 
 private:
     HardwareManager *m_hardwareManager;
@@ -193,8 +223,22 @@ private:
     QHash<PairingTransactionId, PairingContext> m_pendingPairings;
 
     QHash<IOConnectionId, IOConnection> m_ioConnections;
+    // IO connections by input and output endpoint. Indexed by the interned handle of the thing, listing
+    // the connected states of that thing by their state type handle.
+    class IOEndpoint {
+    public:
+        TypeIdRegistry::Handle stateTypeHandle = 0;
+        QList<IOConnectionId> ioConnectionIds;
+    };
+    QVector<QList<IOEndpoint> > m_ioConnectionEndpoints;
 
     ApiKeysProvidersLoader *m_apiKeysProvidersLoader = nullptr;
+
+    StateChangeBus *m_stateChangeBus = nullptr;
+    QHash<PluginId, nymeaserver::MetricCounter*> m_stateChangeMetrics;
+
+    QElapsedTimer m_startupTimer;
+    QList<QPair<QString, qint64> > m_startupTimings;
 };
 
 #endif // THINGMANAGERIMPLEMENTATION_H
@@ -0,0 +1,338 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::CborCodec
+    \brief Converts JSON-RPC messages from and to CBOR.
+
+    \ingroup api
+    \inmodule core
+
+    Messages are written and read with the CBOR stream reader and writer, without building
+    an intermediate QCborValue or QJsonDocument tree. The schema of the messages is the same
+    as for the JSON encoding, so uuids and byte arrays are written as text strings. When
+    decoding, a uuid tagged byte string (tag 37) is accepted as well.
+
+    CBOR support requires Qt 5.12. On older Qt versions isAvailable() returns false.
+*/
+
+#include "cborcodec.h"
+
+#include <QUuid>
+
+#include <limits>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QCborValue>
+#endif
+
+namespace nymeaserver {
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+
+static const int maxNestingDepth = 64;
+
+static void writeValue(QCborStreamWriter &writer, const QVariant &value)
+{
+    switch (static_cast<int>(value.type())) {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        writer.append(nullptr);
+        break;
+    case QMetaType::Bool:
+        writer.append(value.toBool());
+        break;
+    case QMetaType::Char:
+    case QMetaType::SChar:
+    case QMetaType::Short:
+    case QMetaType::Int:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+        writer.append(static_cast<qint64>(value.toLongLong()));
+        break;
+    case QMetaType::UChar:
+    case QMetaType::UShort:
+    case QMetaType::UInt:
+    case QMetaType::ULong:
+    case QMetaType::ULongLong:
+        writer.append(static_cast<quint64>(value.toULongLong()));
+        break;
+    case QMetaType::Float:
+    case QMetaType::Double: {
+        // The JSON writer prints integral doubles without a fraction, keep the same representation
+        double number = value.toDouble();
+        if (qAbs(number) < 9007199254740992.0 && number == static_cast<double>(static_cast<qint64>(number))) {
+            writer.append(static_cast<qint64>(number));
+        } else {
+            writer.append(number);
+        }
+        break;
+    }
+    case QMetaType::QString:
+        writer.append(value.toString());
+        break;
+    case QMetaType::QByteArray:
+        writer.append(QString::fromUtf8(value.toByteArray()));
+        break;
+    case QMetaType::QUuid:
+        writer.append(value.toUuid().toString());
+        break;
+    case QMetaType::QStringList:
+    case QMetaType::QVariantList: {
+        const QVariantList list = value.toList();
+        writer.startArray(static_cast<quint64>(list.count()));
+        foreach (const QVariant &entry, list) {
+            writeValue(writer, entry);
+        }
+        writer.endArray();
+        break;
+    }
+    case QMetaType::QVariantMap: {
+        const QVariantMap map = value.toMap();
+        writer.startMap(static_cast<quint64>(map.count()));
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            writer.append(it.key());
+            writeValue(writer, it.value());
+        }
+        writer.endMap();
+        break;
+    }
+    default:
+        // Everything else (date times, urls, colors...) is converted the same way QCborValue does it
+        QCborValue::fromVariant(value).toCbor(writer);
+        break;
+    }
+}
+
+static QVariant readValue(QCborStreamReader &reader, int depth, QString *errorString)
+{
+    if (depth > maxNestingDepth) {
+        *errorString = QStringLiteral("Maximum nesting depth exceeded");
+        return QVariant();
+    }
+
+    switch (reader.type()) {
+    case QCborStreamReader::UnsignedInteger: {
+        quint64 number = reader.toUnsignedInteger();
+        reader.next();
+        if (number > static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+            return static_cast<qulonglong>(number);
+        }
+        return static_cast<qlonglong>(number);
+    }
+    case QCborStreamReader::NegativeInteger: {
+        // CBOR stores negative integers as -1 - n
+        quint64 number = static_cast<quint64>(reader.toNegativeInteger());
+        reader.next();
+        if (number > static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+            return -static_cast<double>(number);
+        }
+        return -static_cast<qlonglong>(number - 1) - 1;
+    }
+    case QCborStreamReader::ByteArray: {
+        QByteArray result;
+        QCborStreamReader::StringResult<QByteArray> chunk = reader.readByteArray();
+        while (chunk.status == QCborStreamReader::Ok) {
+            result.append(chunk.data);
+            chunk = reader.readByteArray();
+        }
+        return result;
+    }
+    case QCborStreamReader::String: {
+        QString result;
+        QCborStreamReader::StringResult<QString> chunk = reader.readString();
+        while (chunk.status == QCborStreamReader::Ok) {
+            result.append(chunk.data);
+            chunk = reader.readString();
+        }
+        return result;
+    }
+    case QCborStreamReader::Array: {
+        QVariantList list;
+        if (reader.isLengthKnown()) {
+            list.reserve(static_cast<int>(qMin<quint64>(reader.length(), 1024)));
+        }
+        if (!reader.enterContainer()) {
+            return QVariant();
+        }
+        while (reader.lastError() == QCborError::NoError && errorString->isEmpty() && reader.hasNext()) {
+            list.append(readValue(reader, depth + 1, errorString));
+        }
+        if (reader.lastError() == QCborError::NoError && errorString->isEmpty()) {
+            reader.leaveContainer();
+        }
+        return list;
+    }
+    case QCborStreamReader::Map: {
+        QVariantMap map;
+        if (!reader.enterContainer()) {
+            return QVariant();
+        }
+        while (reader.lastError() == QCborError::NoError && errorString->isEmpty() && reader.hasNext()) {
+            QString key = readValue(reader, depth + 1, errorString).toString();
+            map.insert(key, readValue(reader, depth + 1, errorString));
+        }
+        if (reader.lastError() == QCborError::NoError && errorString->isEmpty()) {
+            reader.leaveContainer();
+        }
+        return map;
+    }
+    case QCborStreamReader::Tag: {
+        QCborTag tag = reader.toTag();
+        reader.next();
+        QVariant value = readValue(reader, depth + 1, errorString);
+        if (tag == static_cast<QCborTag>(QCborKnownTags::Uuid) && value.type() == QVariant::ByteArray && value.toByteArray().size() == 16) {
+            return QUuid::fromRfc4122(value.toByteArray());
+        }
+        return value;
+    }
+    case QCborStreamReader::SimpleType: {
+        QVariant value;
+        if (reader.isBool()) {
+            value = reader.toBool();
+        }
+        reader.next();
+        return value;
+    }
+    case QCborStreamReader::Float16: {
+        double number = static_cast<double>(reader.toFloat16());
+        reader.next();
+        return number;
+    }
+    case QCborStreamReader::Float: {
+        double number = static_cast<double>(reader.toFloat());
+        reader.next();
+        return number;
+    }
+    case QCborStreamReader::Double: {
+        double number = reader.toDouble();
+        reader.next();
+        return number;
+    }
+    case QCborStreamReader::Invalid:
+        break;
+    }
+    return QVariant();
+}
+
+#endif
+
+/*! Returns true if CBOR encoding is supported by the Qt version nymea has been built with. */
+bool CborCodec::isAvailable()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*! Returns the CBOR representation of the given \a message. */
+QByteArray CborCodec::encode(const QVariantMap &message)
+{
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QCborStreamWriter writer(&data);
+    writeValue(writer, message);
+#else
+    Q_UNUSED(message)
+#endif
+    return data;
+}
+
+/*! Returns a CBOR encoded success response for the command with the given \a commandId. The
+    \a encodedParams must contain an already CBOR encoded map and are copied as they are.
+*/
+QByteArray CborCodec::encodeResponse(int commandId, const QByteArray &encodedParams, const QString &deprecationWarning)
+{
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QVariantMap message;
+    message.insert("id", commandId);
+    message.insert("status", "success");
+    if (!deprecationWarning.isEmpty()) {
+        message.insert("deprecationWarning", deprecationWarning);
+    }
+
+    // A map with less than 24 entries is announced by a single byte (major type 5) followed by
+    // the key/value pairs. Write the header for the additional params entry and splice them in.
+    data.reserve(encodedParams.size() + 64);
+    data.append(static_cast<char>(0xa0 | (message.count() + 1)));
+    for (QVariantMap::const_iterator it = message.constBegin(); it != message.constEnd(); ++it) {
+        QCborStreamWriter writer(&data);
+        writer.append(it.key());
+        writeValue(writer, it.value());
+    }
+    {
+        QCborStreamWriter writer(&data);
+        writer.append(QStringLiteral("params"));
+    }
+    data.append(encodedParams);
+#else
+    Q_UNUSED(commandId)
+    Q_UNUSED(encodedParams)
+    Q_UNUSED(deprecationWarning)
+#endif
+    return data;
+}
+
+/*! Decodes the CBOR encoded \a data which is expected to contain exactly one map. If the data
+    can't be decoded, an empty map is returned and \a errorString is set to a description of the error.
+*/
+QVariantMap CborCodec::decode(const QByteArray &data, QString *errorString)
+{
+    QString error;
+    QVariantMap message;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    QCborStreamReader reader(data);
+    if (reader.type() != QCborStreamReader::Map) {
+        error = reader.lastError() != QCborError::NoError ? reader.lastError().toString() : QStringLiteral("Message is not a map");
+    } else {
+        message = readValue(reader, 0, &error).toMap();
+        if (error.isEmpty() && reader.lastError() != QCborError::NoError) {
+            error = reader.lastError().toString();
+        }
+        if (error.isEmpty() && reader.currentOffset() != data.size()) {
+            error = QStringLiteral("Garbage after end of message");
+        }
+    }
+#else
+    Q_UNUSED(data)
+    error = QStringLiteral("CBOR is not supported on this platform");
+#endif
+    if (errorString) {
+        *errorString = error;
+    }
+    return error.isEmpty() ? message : QVariantMap();
+}
+
+}
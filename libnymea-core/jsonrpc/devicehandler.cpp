@@ -396,41 +396,13 @@ DeviceHandler::DeviceHandler(QObject *parent) :
     });
 
     connect(NymeaCore::instance(), &NymeaCore::pluginConfigChanged, this, &DeviceHandler::pluginConfigChanged);
-    connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &DeviceHandler::deviceStateChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingRemoved, this, &DeviceHandler::deviceRemovedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingAdded, this, &DeviceHandler::deviceAddedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingChanged, this, &DeviceHandler::deviceChangedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingSettingChanged, this, &DeviceHandler::deviceSettingChangedNotification);
 
-    connect(NymeaCore::instance(), &NymeaCore::initialized, this, [=](){
-        // Generating cache hashes.
-        // NOTE: We need to sort the lists to get a stable result
-        QHash<ThingClassId, ThingClass> thingClassesMap;
-        foreach (const ThingClass &tc, NymeaCore::instance()->thingManager()->supportedThings()) {
-            thingClassesMap.insert(tc.id(), tc);
-        }
-        QList<ThingClassId> thingClassIds = thingClassesMap.keys();
-        std::sort(thingClassIds.begin(), thingClassIds.end());
-        DeviceClasses thingClasses;
-        foreach (const ThingClassId &id, thingClassIds) {
-            thingClasses.append(thingClassesMap.value(id));
-        }
-        QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(thingClasses)).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetSupportedDevices", hash);
-
-        QHash<VendorId, Vendor> vendorsMap;
-        foreach (const Vendor &v, NymeaCore::instance()->thingManager()->supportedVendors()) {
-            vendorsMap.insert(v.id(), v);
-        }
-        QList<VendorId> vendorIds = vendorsMap.keys();
-        std::sort(vendorIds.begin(), vendorIds.end());
-        Vendors vendors;
-        foreach (const VendorId &id, vendorIds) {
-            vendors.append(vendorsMap.value(id));
-        }
-        hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(vendors)).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetSupportedVendors", hash);
-    });
+    connect(NymeaCore::instance(), &NymeaCore::initialized, this, &DeviceHandler::updateCache);
+    connect(NymeaCore::instance(), &NymeaCore::pluginsChanged, this, &DeviceHandler::updateCache);
 
 }
 
@@ -448,6 +420,11 @@ QHash<QString, QString> DeviceHandler::cacheHashes() const
 JsonReply* DeviceHandler::GetSupportedVendors(const QVariantMap &params, const JsonContext &context) const
 {
     Q_UNUSED(params)
+    QString cacheKey = "GetSupportedVendors:" + context.locale().name();
+    if (m_replyCache.contains(cacheKey)) {
+        return m_replyCache.createReply(this, cacheKey);
+    }
+
     QVariantList vendors;
     foreach (const Vendor &vendor, NymeaCore::instance()->thingManager()->supportedVendors()) {
         Vendor translatedVendor = NymeaCore::instance()->thingManager()->translateVendor(vendor, context.locale());
@@ -456,12 +433,17 @@ JsonReply* DeviceHandler::GetSupportedVendors(const QVariantMap &params, const J
 
     QVariantMap returns;
     returns.insert("vendors", vendors);
-    return createReply(returns);
+    return m_replyCache.insert(this, cacheKey, returns);
 }
 
 JsonReply* DeviceHandler::GetSupportedDevices(const QVariantMap &params, const JsonContext &context) const
 {
     VendorId vendorId = VendorId(params.value("vendorId").toString());
+    QString cacheKey = "GetSupportedDevices:" + context.locale().name() + ':' + vendorId.toString();
+    if (m_replyCache.contains(cacheKey)) {
+        return m_replyCache.createReply(this, cacheKey);
+    }
+
     QVariantMap returns;
     QVariantList deviceClasses;
     foreach (const DeviceClass &deviceClass, NymeaCore::instance()->thingManager()->supportedThings(vendorId)) {
@@ -470,7 +452,12 @@ JsonReply* DeviceHandler::GetSupportedDevices(const QVariantMap &params, const J
     }
 
     returns.insert("deviceClasses", deviceClasses);
-    return createReply(returns);
+
+    // Don't let unknown vendor ids fill up the cache
+    if (!vendorId.isNull() && NymeaCore::instance()->thingManager()->supportedVendors().findById(vendorId).id().isNull()) {
+        return createReply(returns);
+    }
+    return m_replyCache.insert(this, cacheKey, returns);
 }
 
 JsonReply *DeviceHandler::GetDiscoveredDevices(const QVariantMap &params, const JsonContext &context) const
@@ -994,12 +981,12 @@ void DeviceHandler::pluginConfigChanged(const PluginId &id, const ParamList &con
     emit PluginConfigurationChanged(params);
 }
 
-void DeviceHandler::deviceStateChanged(Thing *device, const QUuid &stateTypeId, const QVariant &value)
+void DeviceHandler::deviceStateChanged(const StateChange &change)
 {
     QVariantMap params;
-    params.insert("deviceId", device->id());
-    params.insert("stateTypeId", stateTypeId);
-    params.insert("value", value);
+    params.insert("deviceId", change.thingId());
+    params.insert("stateTypeId", change.stateTypeId());
+    params.insert("value", change.value());
     emit StateChanged(params);
 }
 
@@ -1065,6 +1052,40 @@ QVariantMap DeviceHandler::statusToReply(Thing::ThingError status) const
     return returns;
 }
 
+void DeviceHandler::updateCache()
+{
+    // Plugins and their translations have changed. Drop anything that might have been cached before.
+    m_replyCache.clear();
+
+    // Generating cache hashes.
+    // NOTE: We need to sort the lists to get a stable result
+    QHash<ThingClassId, ThingClass> thingClassesMap;
+    foreach (const ThingClass &tc, NymeaCore::instance()->thingManager()->supportedThings()) {
+        thingClassesMap.insert(tc.id(), tc);
+    }
+    QList<ThingClassId> thingClassIds = thingClassesMap.keys();
+    std::sort(thingClassIds.begin(), thingClassIds.end());
+    DeviceClasses thingClasses;
+    foreach (const ThingClassId &id, thingClassIds) {
+        thingClasses.append(thingClassesMap.value(id));
+    }
+    QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(thingClasses)).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetSupportedDevices", hash);
+
+    QHash<VendorId, Vendor> vendorsMap;
+    foreach (const Vendor &v, NymeaCore::instance()->thingManager()->supportedVendors()) {
+        vendorsMap.insert(v.id(), v);
+    }
+    QList<VendorId> vendorIds = vendorsMap.keys();
+    std::sort(vendorIds.begin(), vendorIds.end());
+    Vendors vendors;
+    foreach (const VendorId &id, vendorIds) {
+        vendors.append(vendorsMap.value(id));
+    }
+    hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(vendors)).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetSupportedVendors", hash);
+}
+
 DeviceClass::DeviceClass(const ThingClass &other):
     ThingClass(other.pluginId(), other.vendorId(), other.id())
 {
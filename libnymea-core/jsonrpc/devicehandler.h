@@ -32,8 +32,10 @@
 #define DEVICEHANDLER_H
 
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/replycache.h"
 #include "integrations/thingmanager.h"
 #include "integrations/thing.h"
+#include "integrations/statechangebus.h"
 
 #include <QObject>
 
@@ -174,6 +176,9 @@ public:
 
     static QVariantMap packBrowserItem(const BrowserItem &item);
 
+    // Called from the jsonrpc stage of the state change bus
+    void deviceStateChanged(const StateChange &change);
+
 signals:
     void PluginConfigurationChanged(const QVariantMap &params);
     void StateChanged(const QVariantMap &params);
@@ -184,9 +189,9 @@ signals:
     void EventTriggered(const QVariantMap &params);
 
 private slots:
-    void pluginConfigChanged(const PluginId &id, const ParamList &config);
+    void updateCache();
 
-    void deviceStateChanged(Thing *device, const QUuid &stateTypeId, const QVariant &value);
+    void pluginConfigChanged(const PluginId &id, const ParamList &config);
 
     void deviceRemovedNotification(const QUuid &deviceId);
 
@@ -200,6 +205,9 @@ private:
     QVariantMap statusToReply(Device::ThingError status) const;
 
     QHash<QString, QString> m_cacheHashes;
+
+    // Replies of the expensive, static methods per method, locale and filter
+    mutable ReplyCache m_replyCache;
 };
 
 }
@@ -96,6 +96,12 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     browserItem.insert("o:mediaIcon", enumRef<MediaBrowserItem::MediaBrowserIcon>());
     registerObject("BrowserItem", browserItem);
 
+    QVariantMap thingStateChange;
+    thingStateChange.insert("thingId", enumValueName(Uuid));
+    thingStateChange.insert("stateTypeId", enumValueName(Uuid));
+    thingStateChange.insert("value", enumValueName(Variant));
+    registerObject("ThingStateChange", thingStateChange);
+
 
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
@@ -195,9 +201,25 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     description = "Returns a list of configured things, optionally filtered by thingId.";
     params.insert("o:thingId", enumValueName(Uuid));
     returns.insert("o:things", objectRef<Things>());
+    returns.insert("o:revision", enumValueName(Uint));
     returns.insert("thingError", enumRef<Thing::ThingError>());
     registerMethod("GetThings", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Returns the changes to the configured things since the given revision. The current revision is returned "
+                  "by GetThings and by this method. Things which have been added, edited or had their settings changed "
+                  "since the given revision are contained in things, removed things are listed in removedThingIds and "
+                  "changed states are listed in stateChanges with their current value. If the changes since the given "
+                  "revision are not available any more, fullSync is true and things contains all the configured things.";
+    params.insert("sinceRevision", enumValueName(Uint));
+    returns.insert("thingError", enumRef<Thing::ThingError>());
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("fullSync", enumValueName(Bool));
+    returns.insert("things", objectRef<Things>());
+    returns.insert("o:removedThingIds", QVariantList() << enumValueName(Uuid));
+    returns.insert("o:stateChanges", QVariantList() << objectRef("ThingStateChange"));
+    registerMethod("GetThingChanges", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Performs a thing discovery for things of the given thingClassId and returns the results. "
                     "This function may take a while to return. Note that this method will include all the found "
@@ -441,41 +463,13 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     });
 
     connect(NymeaCore::instance(), &NymeaCore::pluginConfigChanged, this, &IntegrationsHandler::pluginConfigChanged);
-    connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &IntegrationsHandler::thingStateChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingRemoved, this, &IntegrationsHandler::thingRemovedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingAdded, this, &IntegrationsHandler::thingAddedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingChanged, this, &IntegrationsHandler::thingChangedNotification);
     connect(NymeaCore::instance(), &NymeaCore::thingSettingChanged, this, &IntegrationsHandler::thingSettingChangedNotification);
 
-    connect(NymeaCore::instance(), &NymeaCore::initialized, this, [=](){
-        // Generating cache hashes.
-        // NOTE: We need to sort the lists to get a stable result
-        QHash<ThingClassId, ThingClass> thingClassesMap;
-        foreach (const ThingClass &tc, m_thingManager->supportedThings()) {
-            thingClassesMap.insert(tc.id(), tc);
-        }
-        QList<ThingClassId> thingClassIds = thingClassesMap.keys();
-        std::sort(thingClassIds.begin(), thingClassIds.end());
-        ThingClasses thingClasses;
-        foreach (const ThingClassId &id, thingClassIds) {
-            thingClasses.append(thingClassesMap.value(id));
-        }
-        QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(thingClasses)).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetThingClasses", hash);
-
-        QHash<VendorId, Vendor> vendorsMap;
-        foreach (const Vendor &v, m_thingManager->supportedVendors()) {
-            vendorsMap.insert(v.id(), v);
-        }
-        QList<VendorId> vendorIds = vendorsMap.keys();
-        std::sort(vendorIds.begin(), vendorIds.end());
-        Vendors vendors;
-        foreach (const VendorId &id, vendorIds) {
-            vendors.append(vendorsMap.value(id));
-        }
-        hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(vendors)).toJson(), QCryptographicHash::Md5).toHex();
-        m_cacheHashes.insert("GetVendors", hash);
-    });
+    connect(NymeaCore::instance(), &NymeaCore::initialized, this, &IntegrationsHandler::updateCache);
+    connect(NymeaCore::instance(), &NymeaCore::pluginsChanged, this, &IntegrationsHandler::updateCache);
 }
 
 QString IntegrationsHandler::name() const
@@ -491,6 +485,11 @@ QHash<QString, QString> IntegrationsHandler::cacheHashes() const
 JsonReply* IntegrationsHandler::GetVendors(const QVariantMap &params, const JsonContext &context) const
 {
     Q_UNUSED(params)
+    QString cacheKey = "GetVendors:" + context.locale().name();
+    if (m_replyCache.contains(cacheKey)) {
+        return m_replyCache.createReply(this, cacheKey);
+    }
+
     QVariantList vendors;
     foreach (const Vendor &vendor, NymeaCore::instance()->thingManager()->supportedVendors()) {
         Vendor translatedVendor = NymeaCore::instance()->thingManager()->translateVendor(vendor, context.locale());
@@ -499,11 +498,22 @@ JsonReply* IntegrationsHandler::GetVendors(const QVariantMap &params, const Json
 
     QVariantMap returns;
     returns.insert("vendors", vendors);
-    return createReply(returns);
+    return m_replyCache.insert(this, cacheKey, returns);
 }
 
 JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const JsonContext &context) const
 {
+    // A given but empty vendorId is an unknown vendor, not the unfiltered list
+    QString cacheKey = "GetThingClasses:" + context.locale().name() + ':';
+    if (params.contains("vendorId")) {
+        cacheKey += "vendor:" + VendorId(params.value("vendorId").toString()).toString();
+    } else {
+        cacheKey += "all";
+    }
+    if (m_replyCache.contains(cacheKey)) {
+        return m_replyCache.createReply(this, cacheKey);
+    }
+
     QVariantMap returns;
     QVariantList thingClasses;
 
@@ -526,7 +536,7 @@ JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const
 
     returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
     returns.insert("thingClasses", thingClasses);
-    return createReply(returns);
+    return m_replyCache.insert(this, cacheKey, returns);
 }
 
 JsonReply *IntegrationsHandler::DiscoverThings(const QVariantMap &params, const JsonContext &context) const
@@ -723,24 +733,65 @@ JsonReply* IntegrationsHandler::GetThings(const QVariantMap &params, const JsonC
             returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorThingNotFound));
             return createReply(returns);
         } else {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
-            }
-            things.append(packedThing);
+            things.append(packThing(thing, context.locale()));
         }
     } else {
         foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
-            QVariantMap packedThing = pack(thing).toMap();
-            QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), thing->setupDisplayMessage(), context.locale());
-            if (!translatedSetupStatus.isEmpty()) {
-                packedThing["setupDisplayMessage"] = translatedSetupStatus;
+            things.append(packThing(thing, context.locale()));
+        }
+    }
+    returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorNoError));
+    returns.insert("things", things);
+    returns.insert("revision", m_changeJournal.revision());
+    return createReply(returns);
+}
+
+JsonReply *IntegrationsHandler::GetThingChanges(const QVariantMap &params, const JsonContext &context) const
+{
+    quint64 sinceRevision = params.value("sinceRevision").toULongLong();
+    ThingChangeJournal::Changes changes = m_changeJournal.changesSince(sinceRevision);
+
+    QVariantMap returns;
+    QVariantList things;
+    if (!changes.complete) {
+        qCDebug(dcJsonRpc()) << "Change journal does not reach back to revision" << sinceRevision << ". Sending all things.";
+        foreach (Thing *thing, NymeaCore::instance()->thingManager()->configuredThings()) {
+            things.append(packThing(thing, context.locale()));
+        }
+    } else {
+        foreach (const ThingId &thingId, changes.changedThings) {
+            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+            if (thing) {
+                things.append(packThing(thing, context.locale()));
+            }
+        }
+
+        QVariantList removedThingIds;
+        foreach (const ThingId &thingId, changes.removedThings) {
+            removedThingIds.append(thingId);
+        }
+        returns.insert("removedThingIds", removedThingIds);
+
+        QVariantList stateChanges;
+        for (int i = 0; i < changes.changedStates.count(); i++) {
+            const ThingId &thingId = changes.changedStates.at(i).first;
+            const StateTypeId &stateTypeId = changes.changedStates.at(i).second;
+            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+            if (!thing) {
+                continue;
             }
-            things.append(packedThing);
+            QVariantMap stateChange;
+            stateChange.insert("thingId", thingId);
+            stateChange.insert("stateTypeId", stateTypeId);
+            stateChange.insert("value", thing->stateValue(stateTypeId));
+            stateChanges.append(stateChange);
         }
+        returns.insert("stateChanges", stateChanges);
     }
+
     returns.insert("thingError", enumValueName<Thing::ThingError>(Thing::ThingErrorNoError));
+    returns.insert("revision", m_changeJournal.revision());
+    returns.insert("fullSync", !changes.complete);
     returns.insert("things", things);
     return createReply(returns);
 }
@@ -1079,17 +1130,21 @@ void IntegrationsHandler::pluginConfigChanged(const PluginId &id, const ParamLis
     emit PluginConfigurationChanged(params);
 }
 
-void IntegrationsHandler::thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value)
+void IntegrationsHandler::thingStateChanged(const StateChange &change)
 {
+    m_changeJournal.recordChange(ThingChangeJournal::ChangeTypeStateChanged, change.thingId(), change.stateTypeId());
+
     QVariantMap params;
-    params.insert("thingId", thing->id());
-    params.insert("stateTypeId", stateTypeId);
-    params.insert("value", value);
+    params.insert("thingId", change.thingId());
+    params.insert("stateTypeId", change.stateTypeId());
+    params.insert("value", change.value());
     emit StateChanged(params);
 }
 
 void IntegrationsHandler::thingRemovedNotification(const ThingId &thingId)
 {
+    m_changeJournal.recordChange(ThingChangeJournal::ChangeTypeRemoved, thingId);
+
     QVariantMap params;
     params.insert("thingId", thingId);
     emit ThingRemoved(params);
@@ -1097,6 +1152,8 @@ void IntegrationsHandler::thingRemovedNotification(const ThingId &thingId)
 
 void IntegrationsHandler::thingAddedNotification(Thing *thing)
 {
+    m_changeJournal.recordChange(ThingChangeJournal::ChangeTypeAdded, thing->id());
+
     QVariantMap params;
     params.insert("thing", pack(thing));
     emit ThingAdded(params);
@@ -1104,6 +1161,8 @@ void IntegrationsHandler::thingAddedNotification(Thing *thing)
 
 void IntegrationsHandler::thingChangedNotification(Thing *thing)
 {
+    m_changeJournal.recordChange(ThingChangeJournal::ChangeTypeChanged, thing->id());
+
     QVariantMap params;
     params.insert("thing", pack(thing));
     emit ThingChanged(params);
@@ -1111,6 +1170,8 @@ void IntegrationsHandler::thingChangedNotification(Thing *thing)
 
 void IntegrationsHandler::thingSettingChangedNotification(const ThingId &thingId, const ParamTypeId &paramTypeId, const QVariant &value)
 {
+    m_changeJournal.recordChange(ThingChangeJournal::ChangeTypeSettingChanged, thingId);
+
     QVariantMap params;
     params.insert("thingId", thingId);
     params.insert("paramTypeId", paramTypeId.toString());
@@ -1125,4 +1186,48 @@ QVariantMap IntegrationsHandler::statusToReply(Thing::ThingError status) const
     return returns;
 }
 
+QVariantMap IntegrationsHandler::packThing(Thing *thing, const QLocale &locale) const
+{
+    QVariantMap packedThing = pack(thing).toMap();
+    QString translatedSetupStatus = NymeaCore::instance()->thingManager()->translate(thing->pluginId(), thing->setupDisplayMessage(), locale);
+    if (!translatedSetupStatus.isEmpty()) {
+        packedThing["setupDisplayMessage"] = translatedSetupStatus;
+    }
+    return packedThing;
+}
+
+void IntegrationsHandler::updateCache()
+{
+    // Plugins and their translations have changed. Drop anything that might have been cached before.
+    m_replyCache.clear();
+
+    // Generating cache hashes.
+    // NOTE: We need to sort the lists to get a stable result
+    QHash<ThingClassId, ThingClass> thingClassesMap;
+    foreach (const ThingClass &tc, m_thingManager->supportedThings()) {
+        thingClassesMap.insert(tc.id(), tc);
+    }
+    QList<ThingClassId> thingClassIds = thingClassesMap.keys();
+    std::sort(thingClassIds.begin(), thingClassIds.end());
+    ThingClasses thingClasses;
+    foreach (const ThingClassId &id, thingClassIds) {
+        thingClasses.append(thingClassesMap.value(id));
+    }
+    QByteArray hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(thingClasses)).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetThingClasses", hash);
+
+    QHash<VendorId, Vendor> vendorsMap;
+    foreach (const Vendor &v, m_thingManager->supportedVendors()) {
+        vendorsMap.insert(v.id(), v);
+    }
+    QList<VendorId> vendorIds = vendorsMap.keys();
+    std::sort(vendorIds.begin(), vendorIds.end());
+    Vendors vendors;
+    foreach (const VendorId &id, vendorIds) {
+        vendors.append(vendorsMap.value(id));
+    }
+    hash = QCryptographicHash::hash(QJsonDocument::fromVariant(pack(vendors)).toJson(), QCryptographicHash::Md5).toHex();
+    m_cacheHashes.insert("GetVendors", hash);
+}
+
 }
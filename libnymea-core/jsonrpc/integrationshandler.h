@@ -32,7 +32,10 @@
 #define INTEGRATIONSHANDLER_H
 
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/replycache.h"
 #include "integrations/thingmanager.h"
+#include "integrations/thingchangejournal.h"
+#include "integrations/statechangebus.h"
 
 namespace nymeaserver {
 
@@ -55,6 +58,7 @@ public:
     Q_INVOKABLE JsonReply *PairThing(const QVariantMap &params, const JsonContext &context);
     Q_INVOKABLE JsonReply *ConfirmPairing(const QVariantMap &params);
     Q_INVOKABLE JsonReply *GetThings(const QVariantMap &params, const JsonContext &context) const;
+    Q_INVOKABLE JsonReply *GetThingChanges(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *ReconfigureThing(const QVariantMap &params, const JsonContext &context);
     Q_INVOKABLE JsonReply *EditThing(const QVariantMap &params);
     Q_INVOKABLE JsonReply *RemoveThing(const QVariantMap &params);
@@ -79,6 +83,9 @@ public:
 
     static QVariantMap packBrowserItem(const BrowserItem &item);
 
+    // Called from the jsonrpc stage of the state change bus
+    void thingStateChanged(const StateChange &change);
+
 signals:
     void PluginConfigurationChanged(const QVariantMap &params);
     void StateChanged(const QVariantMap &params);
@@ -91,9 +98,9 @@ signals:
     void IOConnectionRemoved(const QVariantMap &params);
 
 private slots:
-    void pluginConfigChanged(const PluginId &id, const ParamList &config);
+    void updateCache();
 
-    void thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value);
+    void pluginConfigChanged(const PluginId &id, const ParamList &config);
 
     void thingRemovedNotification(const ThingId &thingId);
 
@@ -106,8 +113,14 @@ private slots:
 private:
     ThingManager *m_thingManager = nullptr;
     QVariantMap statusToReply(Thing::ThingError status) const;
+    QVariantMap packThing(Thing *thing, const QLocale &locale) const;
 
     QHash<QString, QString> m_cacheHashes;
+
+    // Replies of the expensive, static methods per method, locale and filter
+    mutable ReplyCache m_replyCache;
+
+    ThingChangeJournal m_changeJournal;
 };
 
 }
@@ -0,0 +1,287 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::JsonRpcFramer
+    \brief Splits the data stream of a JSON-RPC client into packets.
+
+    \ingroup api
+    \inmodule core
+
+    Data received from a client is appended to a per-client buffer which is scanned
+    incrementally. For JSON, the scanner tracks the nesting depth of objects and arrays
+    as well as string literals and escapes, so a packet ends exactly where its top level
+    object is closed, regardless of line breaks or braces inside strings. Each byte is
+    scanned only once, no matter in how many fragments a packet arrives.
+
+    Packets are returned as views into the buffer without copying them. Consumed data is
+    only moved out of the buffer once it outweighs the remaining data, which keeps the
+    cost of compacting linear in the amount of data received.
+
+    While scanning, the value of the top level "method" member is picked up, so the size
+    limit for that method can be enforced before the packet is complete. Members may come
+    in any order, so until the method is known the largest of all limits applies. Once
+    the packet is complete, it is checked against the limit of its method again, the same
+    way length prefixed packets are.
+*/
+
+#include "jsonrpcframer.h"
+
+#include <QtEndian>
+
+namespace nymeaserver {
+
+// Data which isn't JSON at all is only buffered up to a line break or the start of an object
+static const int maxGarbageSize = 10 * 1024;
+
+/*! Returns the maximum packet size in bytes for the given \a method. */
+int JsonRpcFramer::Limits::limit(const QString &method) const
+{
+    return methodSizes.value(method, defaultSize);
+}
+
+/*! Returns the largest packet size in bytes accepted for any method. */
+int JsonRpcFramer::Limits::largest() const
+{
+    int largest = defaultSize;
+    foreach (int size, methodSizes) {
+        largest = qMax(largest, size);
+    }
+    return largest;
+}
+
+/*! Appends the received \a data to the buffer. Packets previously taken from this framer
+    are invalidated by this.
+*/
+void JsonRpcFramer::append(const QByteArray &data)
+{
+    if (m_start > 0 && m_start >= m_buffer.size() - m_start) {
+        m_buffer.remove(0, m_start);
+        m_scanned -= m_start;
+        if (m_stringStart >= 0) {
+            m_stringStart -= m_start;
+        }
+        m_start = 0;
+    }
+    m_buffer.append(data);
+}
+
+/*! Drops all buffered data and resets the scanner. */
+void JsonRpcFramer::clear()
+{
+    m_buffer.clear();
+    m_start = 0;
+    m_scanned = 0;
+    resetScan();
+}
+
+/*! Takes the next complete JSON packet from the buffer and stores it in \a packet.
+    Returns StatusIncomplete if more data is needed and StatusTooLarge if the packet
+    exceeds the size limit for its method, as given by \a limits. The framer should be
+    cleared after the latter, as there is no way to find the start of the next packet.
+
+    Data at the top level which doesn't start a JSON object or array is returned as a
+    packet of its own up to the next line break or opening brace, so the parser can
+    report the error to the client.
+*/
+JsonRpcFramer::Status JsonRpcFramer::takeJsonPacket(const Limits &limits, QByteArray *packet)
+{
+    const char *data = m_buffer.constData();
+    const int end = m_buffer.size();
+    int pos = m_scanned;
+
+    if (m_depth == 0 && !m_garbage) {
+        while (pos < end && (data[pos] == ' ' || data[pos] == '\n' || data[pos] == '\r' || data[pos] == '\t')) {
+            pos++;
+        }
+        m_start = pos;
+        m_scanned = pos;
+        if (pos == end) {
+            return StatusIncomplete;
+        }
+        m_garbage = data[pos] != '{' && data[pos] != '[';
+    }
+
+    for (; pos < end; pos++) {
+        const char c = data[pos];
+
+        if (m_garbage) {
+            if (c == '\n' || c == '{') {
+                *packet = QByteArray::fromRawData(data + m_start, pos - m_start);
+                m_start = pos;
+                m_scanned = pos;
+                resetScan();
+                return StatusPacket;
+            }
+            continue;
+        }
+
+        if (m_inString) {
+            if (m_escaped) {
+                m_escaped = false;
+            } else if (c == '\\') {
+                m_escaped = true;
+            } else if (c == '"') {
+                m_inString = false;
+                if (m_stringStart >= 0) {
+                    stringFinished(m_stringStart + 1, pos);
+                    m_stringStart = -1;
+                }
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            // Only keys and values of the top level object are of interest
+            m_stringStart = m_depth == 1 ? pos : -1;
+            break;
+        case '{':
+        case '[':
+            m_depth++;
+            break;
+        case '}':
+        case ']':
+            m_depth--;
+            if (m_depth == 0) {
+                int size = pos + 1 - m_start;
+                if (size > limits.limit(m_method)) {
+                    m_scanned = pos + 1;
+                    m_exceededLimit = limits.limit(m_method);
+                    return StatusTooLarge;
+                }
+                *packet = QByteArray::fromRawData(data + m_start, size);
+                m_start = pos + 1;
+                m_scanned = m_start;
+                resetScan();
+                return StatusPacket;
+            }
+            break;
+        case ':':
+            if (m_depth == 1) {
+                m_afterColon = true;
+            }
+            break;
+        case ',':
+            if (m_depth == 1) {
+                m_afterColon = false;
+                m_methodKey = false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    m_scanned = pos;
+    int limit = maxGarbageSize;
+    if (!m_garbage) {
+        limit = m_method.isEmpty() ? limits.largest() : limits.limit(m_method);
+    }
+    if (pos - m_start > limit) {
+        m_exceededLimit = limit;
+        return StatusTooLarge;
+    }
+    return StatusIncomplete;
+}
+
+/*! Takes the next packet prefixed by its size as 32 bit big endian integer from the buffer
+    and stores it in \a packet. As the method is not known before decoding the packet, the
+    largest of the given \a limits applies.
+*/
+JsonRpcFramer::Status JsonRpcFramer::takeLengthPrefixedPacket(const Limits &limits, QByteArray *packet)
+{
+    if (pendingSize() < 4) {
+        return StatusIncomplete;
+    }
+    const char *data = m_buffer.constData() + m_start;
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data));
+    if (size > static_cast<quint32>(limits.largest())) {
+        m_exceededLimit = limits.largest();
+        return StatusTooLarge;
+    }
+    if (size > static_cast<quint32>(pendingSize() - 4)) {
+        return StatusIncomplete;
+    }
+    *packet = QByteArray::fromRawData(data + 4, static_cast<int>(size));
+    m_start += 4 + static_cast<int>(size);
+    m_scanned = m_start;
+    return StatusPacket;
+}
+
+/*! Returns the method of the JSON packet currently being scanned, if it has been seen yet. */
+QString JsonRpcFramer::method() const
+{
+    return m_method;
+}
+
+/*! Returns the size limit in bytes which caused the last StatusTooLarge. */
+int JsonRpcFramer::exceededLimit() const
+{
+    return m_exceededLimit;
+}
+
+/*! Returns the number of bytes buffered which have not been taken as a packet yet. */
+int JsonRpcFramer::pendingSize() const
+{
+    return m_buffer.size() - m_start;
+}
+
+/*! Returns the number of bytes allocated for the buffer. */
+int JsonRpcFramer::capacity() const
+{
+    return m_buffer.capacity();
+}
+
+void JsonRpcFramer::resetScan()
+{
+    m_depth = 0;
+    m_garbage = false;
+    m_inString = false;
+    m_escaped = false;
+    m_stringStart = -1;
+    m_afterColon = false;
+    m_methodKey = false;
+    m_method.clear();
+}
+
+void JsonRpcFramer::stringFinished(int begin, int end)
+{
+    const QByteArray string = QByteArray::fromRawData(m_buffer.constData() + begin, end - begin);
+    if (!m_afterColon) {
+        m_methodKey = string == "method";
+    } else if (m_methodKey) {
+        m_method = QString::fromUtf8(string);
+        m_methodKey = false;
+    }
+}
+
+}
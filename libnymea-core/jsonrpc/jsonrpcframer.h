@@ -0,0 +1,91 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONRPCFRAMER_H
+#define JSONRPCFRAMER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+namespace nymeaserver {
+
+class JsonRpcFramer
+{
+public:
+    enum Status {
+        StatusIncomplete,
+        StatusPacket,
+        StatusTooLarge
+    };
+
+    class Limits
+    {
+    public:
+        int defaultSize = 64 * 1024;
+        QHash<QString, int> methodSizes;
+
+        int limit(const QString &method) const;
+        int largest() const;
+    };
+
+    void append(const QByteArray &data);
+    void clear();
+
+    Status takeJsonPacket(const Limits &limits, QByteArray *packet);
+    Status takeLengthPrefixedPacket(const Limits &limits, QByteArray *packet);
+
+    QString method() const;
+    int exceededLimit() const;
+    int pendingSize() const;
+    int capacity() const;
+
+private:
+    void resetScan();
+    void stringFinished(int begin, int end);
+
+    QByteArray m_buffer;
+    int m_start = 0;
+    int m_scanned = 0;
+
+    int m_depth = 0;
+    bool m_garbage = false;
+    bool m_inString = false;
+    bool m_escaped = false;
+    int m_stringStart = -1;
+    bool m_afterColon = false;
+    bool m_methodKey = false;
+    QString m_method;
+    int m_exceededLimit = 0;
+};
+
+}
+
+#endif // JSONRPCFRAMER_H
@@ -48,6 +48,9 @@
 #include "jsonrpcserverimplementation.h"
 #include "jsonrpc/jsonhandler.h"
 #include "jsonvalidator.h"
+#include "cborcodec.h"
+#include "notificationsubscriptions.h"
+#include "notificationthrottle.h"
 #include "nymeacore.h"
 #include "integrations/thingmanager.h"
 #include "integrations/integrationplugin.h"
@@ -56,9 +59,13 @@
 #include "ruleengine/rule.h"
 #include "ruleengine/ruleengine.h"
 #include "loggingcategories.h"
+#include "nymeasettings.h"
 #include "platform/platform.h"
 #include "version.h"
 #include "cloud/cloudmanager.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/tracer.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include "devicehandler.h"
 #include "integrationshandler.h"
@@ -75,8 +82,11 @@
 #include "usershandler.h"
 
 #include <QJsonDocument>
+#include <QJsonArray>
 #include <QStringList>
 #include <QSslConfiguration>
+#include <QtEndian>
+#include <QElapsedTimer>
 
 namespace nymeaserver {
 
@@ -86,12 +96,64 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     m_notificationId(0)
 {
     Q_UNUSED(sslConfiguration)
+
+    // Script uploads are the only requests expected to be large
+    m_packetLimits.methodSizes.insert("Scripts.AddScript", 1024 * 1024);
+    m_packetLimits.methodSizes.insert("Scripts.EditScript", 1024 * 1024);
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JsonRpc");
+    m_packetLimits.defaultSize = settings.value("maxPacketSize", m_packetLimits.defaultSize).toInt();
+    settings.beginGroup("MethodPacketSizes");
+    foreach (const QString &method, settings.childKeys()) {
+        m_packetLimits.methodSizes.insert(method, settings.value(method).toInt());
+    }
+    settings.endGroup();
+    settings.endGroup();
+
+    MetricsRegistry::instance()->registerCounter("nymea_jsonrpc_requests_total", "JSON-RPC requests per method", "method");
+    MetricsRegistry::instance()->registerHistogram("nymea_jsonrpc_request_duration_seconds", "Time from invoking a JSON-RPC method until its response has been sent", MetricsRegistry::latencyBuckets(), 0.000001, "method");
+    MetricsRegistry::instance()->registerCounter("nymea_jsonrpc_notifications_total", "JSON-RPC notifications sent to clients per namespace", "namespace");
+
+    m_notificationThrottle = new NotificationThrottle(this);
+    connect(m_notificationThrottle, &NotificationThrottle::deliver, this, [this](const QUuid &clientId, const QVariantMap &notification){
+        if (m_clientTransports.contains(clientId)) {
+            sendMessage(m_clientTransports.value(clientId), clientId, notification);
+            m_notificationCounters.value(notification.value("notification").toString())->increment();
+        }
+    });
+    // Held back state changes must not be delivered after the ThingRemoved notification
+    connect(NymeaCore::instance(), &NymeaCore::thingRemoved, m_notificationThrottle, &NotificationThrottle::removeThing);
+
+    if (MemoryAccounting *memoryAccounting = MemoryAccounting::instance()) {
+        memoryAccounting->addProbe("jsonrpc.clients", this, [this](){
+            MemoryAccounting::Usage usage;
+            usage.objects = m_clientTransports.count();
+            return usage;
+        });
+        // Incomplete packets received from clients
+        memoryAccounting->addProbe("jsonrpc.clientBuffers", this, [this](){
+            MemoryAccounting::Usage usage;
+            foreach (const QSharedPointer<JsonRpcFramer> &framer, m_clientFramers) {
+                usage.objects++;
+                usage.bytes += framer->capacity();
+            }
+            return usage;
+        });
+        memoryAccounting->addProbe("jsonrpc.asyncReplies", this, [this](){
+            MemoryAccounting::Usage usage;
+            usage.objects = m_asyncReplies.count();
+            return usage;
+        });
+    }
+
     // First, define our own JSONRPC API
 
     // Enums
     registerEnum<BasicType>();
     registerEnum<UserManager::UserError>();
     registerEnum<CloudManager::CloudConnectionState>();
+    registerEnum<TransportInterface::Compression>();
+    registerEnum<JsonRPCServerImplementation::Encoding>();
 
     // Objects
     registerObject<TokenInfo>();
@@ -106,6 +168,13 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     cacheHash.insert("hash", enumValueName(String));
     registerObject("CacheHash", cacheHash);
 
+    QVariantMap notificationFilter;
+    notificationFilter.insert("o:thingIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:interfaces", enumValueName(StringList));
+    notificationFilter.insert("o:tagIds", enumValueName(StringList));
+    notificationFilter.insert("o:stateTypeIds", QVariantList() << enumValueName(Uuid));
+    registerObject("NotificationFilter", notificationFilter);
+
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
     description = "Initiates a connection. Use this method to perform an initial handshake of the "
@@ -119,8 +188,23 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                             "like initialSetupRequired might change if the setup has been performed in the meantime.\n "
                             "The field cacheHashes may contain a map of methods and MD5 hashes. As long as the hash for "
                             "a method does not change, a client may use a previously cached copy of the call instead of "
-                            "fetching the content again.";
+                            "fetching the content again.\n"
+                            "A client may request the server to compress all messages sent on this connection by "
+                            "passing the optional parameter \"compression\". The reply to this call is still sent "
+                            "using the previous compression and indicates the compression which is used for all following messages. If the "
+                            "transport does not support the requested compression, CompressionNone is returned. When "
+                            "CompressionDeflate is active, the server writes all messages into one zlib stream and "
+                            "performs a sync flush after each message. On WebSocket connections compressed messages are "
+                            "sent as binary frames.\n"
+                            "Using the optional parameter \"encoding\", a client may switch the connection to CBOR "
+                            "(RFC 8949) encoded messages. The message schema stays the same. Like the compression, the "
+                            "encoding is applied to all messages after the reply to this call, in both directions. "
+                            "With EncodingCbor, every message is preceded by its size in bytes as a 32 bit big endian "
+                            "integer instead of being delimited by a newline. On WebSocket connections those messages "
+                            "are sent as binary frames. If the server does not support CBOR, EncodingJson is returned.";
     params.insert("o:locale", enumValueName(String));
+    params.insert("o:compression", enumRef<TransportInterface::Compression>());
+    params.insert("o:encoding", enumRef<JsonRPCServerImplementation::Encoding>());
     returns.insert("server", enumValueName(String));
     returns.insert("name", enumValueName(String));
     returns.insert("version", enumValueName(String));
@@ -133,6 +217,8 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("pushButtonAuthAvailable", enumValueName(Bool));
     returns.insert("o:experiences", QVariantList() << objectRef("Experience"));
     returns.insert("o:cacheHashes", QVariantList() << objectRef("CacheHash"));
+    returns.insert("o:compression", enumRef<TransportInterface::Compression>());
+    returns.insert("o:encoding", enumRef<JsonRPCServerImplementation::Encoding>());
     registerMethod("Hello", description, params, returns);
 
     params.clear(); returns.clear();
@@ -165,6 +251,30 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("d:enabled", enumValueName(Bool));
     registerMethod("SetNotificationStatus", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Restrict the thing related notifications sent to this connection. Notifications about a thing "
+                  "(e.g. Integrations.StateChanged or Integrations.ThingChanged) are only sent if the thing is "
+                  "listed in \"thingIds\", implements one of the given \"interfaces\" or is tagged with one of the "
+                  "given \"tagIds\". If \"stateTypeIds\" is given, state change notifications are only sent for "
+                  "those state types. Criteria which are not given do not restrict the notifications. Notifications "
+                  "which are not related to a thing are not affected. The filter applies in addition to the namespaces "
+                  "enabled with SetNotificationStatus. Calling this method without a filter removes the filter.";
+    params.insert("o:filter", objectRef("NotificationFilter"));
+    returns.insert("filter", objectRef("NotificationFilter"));
+    registerMethod("SetNotificationFilter", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Limit the rate of state change notifications sent to this connection. If \"minInterval\" is "
+                  "greater than 0, at most one state change notification per thing and state is sent within "
+                  "that many milliseconds. Changes happening in between are coalesced and only the latest value "
+                  "is sent when the interval has passed. Such a notification carries the number of skipped values "
+                  "in the field \"coalesced\", next to \"id\" and \"params\". Regardless of this setting, state "
+                  "changes are held back while the connection can't keep up with the outgoing data. Values skipped "
+                  "because of that are reported in the field \"dropped\". A value of 0 disables the rate limit.";
+    params.insert("minInterval", enumValueName(Uint));
+    returns.insert("minInterval", enumValueName(Uint));
+    registerMethod("SetNotificationRateLimit", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Create a new user in the API. Currently this is only allowed to be called once when a new nymea instance is set up. Call Authenticate after this to obtain a device token for this user.";
     params.insert("username", enumValueName(String));
@@ -279,6 +389,23 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
     if (params.contains("locale")) {
         m_clientLocales.insert(clientId, QLocale(params.value("locale").toString()));
     }
+    if (params.contains("compression")) {
+        TransportInterface::Compression compression = enumNameToValue<TransportInterface::Compression>(params.value("compression").toString());
+        if (!interface->supportedCompressions().contains(compression)) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "requested" << compression << "which is not supported by this transport.";
+            compression = TransportInterface::CompressionNone;
+        }
+        // Applied once the reply to this call has been sent
+        m_pendingCompressions.insert(clientId, compression);
+    }
+    if (params.contains("encoding")) {
+        Encoding encoding = enumNameToValue<Encoding>(params.value("encoding").toString());
+        if (encoding == EncodingCbor && (!CborCodec::isAvailable() || !interface->supportedFramings().contains(TransportInterface::FramingLengthPrefixed))) {
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "requested CBOR encoding which is not supported on this transport.";
+            encoding = EncodingJson;
+        }
+        m_pendingEncodings.insert(clientId, encoding);
+    }
 
     qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << m_clientLocales.value(clientId);
 
@@ -335,6 +462,40 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
     return createReply(returns);
 }
 
+JsonReply *JsonRPCServerImplementation::SetNotificationFilter(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+    QVariantMap filterMap = params.value("filter").toMap();
+
+    NotificationSubscriptions::Filter filter;
+    foreach (const QVariant &thingId, filterMap.value("thingIds").toList()) {
+        filter.thingIds.insert(ThingId(thingId.toUuid()));
+    }
+    filter.interfaces = filterMap.value("interfaces").toStringList();
+    filter.tagIds = filterMap.value("tagIds").toStringList();
+    foreach (const QVariant &stateTypeId, filterMap.value("stateTypeIds").toList()) {
+        filter.stateTypeIds.insert(StateTypeId(stateTypeId.toUuid()));
+    }
+    qCDebug(dcJsonRpc()) << "Notification filter for client" << clientId << ":" << filterMap;
+    m_notificationSubscriptions->setFilter(clientId, filter);
+
+    QVariantMap returns;
+    returns.insert("filter", filterMap);
+    return createReply(returns);
+}
+
+JsonReply *JsonRPCServerImplementation::SetNotificationRateLimit(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+    uint minInterval = params.value("minInterval").toUInt();
+    qCDebug(dcJsonRpc()) << "Notification rate limit for client" << clientId << ":" << minInterval << "ms";
+    m_notificationThrottle->setMinInterval(clientId, minInterval);
+
+    QVariantMap returns;
+    returns.insert("minInterval", m_notificationThrottle->minInterval(clientId));
+    return createReply(returns);
+}
+
 JsonReply *JsonRPCServerImplementation::CreateUser(const QVariantMap &params)
 {
     QString username = params.value("username").toString();
@@ -495,7 +656,7 @@ bool JsonRPCServerImplementation::registerExperienceHandler(JsonHandler *handler
 }
 
 /*! Send a JSON success response to the client with the given \a clientId,
- * \a commandId and \a params to the inerted \l{TransportInterface}.
+ * \a commandId and \a params to the inserted \l{TransportInterface}.
  */
 void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params, const QString &deprecationWarning)
 {
@@ -508,13 +669,51 @@ void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, co
         response.insert("deprecationWarning", deprecationWarning);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
+    sendMessage(interface, clientId, response);
+}
+
+/*! Send a JSON success response to the client with the given \a clientId and \a commandId
+ * to the inserted \l{TransportInterface}. The already serialized params of the \a reply are written
+ * as they are, in the encoding used by the client. If the reply has not been serialized for that
+ * encoding, its data is serialized as usual.
+ */
+void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, JsonReply *reply, const QString &deprecationWarning)
+{
+    if (m_clientEncodings.value(clientId) == EncodingCbor) {
+        if (reply->serializedCborData().isEmpty()) {
+            sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+            return;
+        }
+        qCDebug(dcJsonRpcTraffic()) << "Sending cached CBOR reply for command" << commandId;
+        interface->sendData(clientId, CborCodec::encodeResponse(commandId, reply->serializedCborData(), deprecationWarning));
+        return;
+    }
+
+    const QByteArray serializedParams = reply->serializedData();
+    if (serializedParams.isEmpty()) {
+        sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+        return;
+    }
+
+    QByteArray data;
+    data.reserve(serializedParams.size() + 64);
+    data.append('{');
+    if (!deprecationWarning.isEmpty()) {
+        QJsonArray warning = {deprecationWarning};
+        QByteArray serializedWarning = QJsonDocument(warning).toJson(QJsonDocument::Compact);
+        // Strip the surrounding [] to get the properly escaped JSON string
+        data.append("\"deprecationWarning\":").append(serializedWarning.mid(1, serializedWarning.length() - 2)).append(',');
+    }
+    data.append("\"id\":").append(QByteArray::number(commandId));
+    data.append(",\"params\":").append(serializedParams);
+    data.append(",\"status\":\"success\"}");
+
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
     interface->sendData(clientId, data);
 }
 
 /*! Send a JSON error response to the client with the given \a clientId,
- * \a commandId and \a error to the inerted \l{TransportInterface}.
+ * \a commandId and \a error to the inserted \l{TransportInterface}.
  */
 void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
 {
@@ -523,9 +722,7 @@ void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interfac
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, errorResponse);
 }
 
 void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
@@ -535,8 +732,20 @@ void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *i
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+    sendMessage(interface, clientId, errorResponse);
+}
+
+/*! Serializes the \a message in the encoding negotiated by the client with the given \a clientId and sends it to the \l{TransportInterface}. */
+void JsonRPCServerImplementation::sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
+    QByteArray data;
+    if (m_clientEncodings.value(clientId) == EncodingCbor) {
+        data = CborCodec::encode(message);
+        qCDebug(dcJsonRpcTraffic()) << "Sending CBOR data:" << message;
+    } else {
+        data = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact);
+        qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+    }
     interface->sendData(clientId, data);
 }
 
@@ -577,14 +786,23 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
     if (!cacheHashes.isEmpty()) {
         handshake.insert("cacheHashes", cacheHashes);
     }
+    TransportInterface::Compression compression = m_pendingCompressions.value(clientId, m_clientCompressions.value(clientId, TransportInterface::CompressionNone));
+    handshake.insert("compression", enumValueName(compression));
+    Encoding encoding = m_pendingEncodings.value(clientId, m_clientEncodings.value(clientId, EncodingJson));
+    handshake.insert("encoding", enumValueName(encoding));
     return handshake;
 }
 
 void JsonRPCServerImplementation::setup()
 {
+    // Created before the handlers so the subscription index is updated before they emit notifications
+    m_notificationSubscriptions = new NotificationSubscriptions(NymeaCore::instance()->thingManager(), NymeaCore::instance()->tagsStorage(), this);
+
     registerHandler(this);
-    registerHandler(new IntegrationsHandler(NymeaCore::instance()->thingManager(), this));
-    registerHandler(new DeviceHandler(this));
+    m_integrationsHandler = new IntegrationsHandler(NymeaCore::instance()->thingManager(), this);
+    registerHandler(m_integrationsHandler);
+    m_deviceHandler = new DeviceHandler(this);
+    registerHandler(m_deviceHandler);
     registerHandler(new ActionHandler(this));
     registerHandler(new RulesHandler(this));
     registerHandler(new EventHandler(this));
@@ -606,24 +824,35 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
 
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
 
-    // Handle packet fragmentation
-    QByteArray buffer = m_clientBuffers[clientId];
-    buffer.append(data);
-    int splitIndex = buffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processJsonPacket(interface, clientId, buffer.left(splitIndex + 1));
-        buffer = buffer.right(buffer.length() - splitIndex - 2);
-        splitIndex = buffer.indexOf("}\n{");
-    }
-    if (buffer.trimmed().endsWith("}")) {
-        processJsonPacket(interface, clientId, buffer);
-        buffer.clear();
+    QSharedPointer<JsonRpcFramer> framer = m_clientFramers.value(clientId);
+    if (!framer) {
+        framer = QSharedPointer<JsonRpcFramer>::create();
+        m_clientFramers.insert(clientId, framer);
     }
-    m_clientBuffers[clientId] = buffer;
-
-    if (buffer.size() > 1024 * 10) {
-        qCWarning(dcJsonRpc()) << "Client buffer larger than 10KB and no valid data. Dropping client connection.";
-        interface->terminateClientConnection(clientId);
+    framer->append(data);
+
+    // The encoding may change with every packet (JSONRPC.Hello), so it is evaluated again for the
+    // remaining data after each one. Processing a packet may also drop the client.
+    while (m_clientFramers.value(clientId) == framer) {
+        bool cbor = m_clientEncodings.value(clientId) == EncodingCbor;
+        QByteArray packet;
+        JsonRpcFramer::Status status = cbor ? framer->takeLengthPrefixedPacket(m_packetLimits, &packet)
+                                            : framer->takeJsonPacket(m_packetLimits, &packet);
+        if (status == JsonRpcFramer::StatusIncomplete) {
+            return;
+        }
+        if (status == JsonRpcFramer::StatusTooLarge) {
+            qCWarning(dcJsonRpc()) << "Packet from client" << clientId << "for method" << framer->method() << "exceeds the size limit of" << framer->exceededLimit() << "bytes. Dropping client connection.";
+            sendErrorResponse(interface, clientId, -1, QString("Packet exceeds the size limit of %1 bytes").arg(framer->exceededLimit()));
+            m_clientFramers.remove(clientId);
+            interface->terminateClientConnection(clientId);
+            return;
+        }
+        if (cbor) {
+            processCborPacket(interface, clientId, packet);
+        } else {
+            processJsonPacket(interface, clientId, packet);
+        }
     }
 }
 
@@ -638,8 +867,30 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    processMessage(interface, clientId, jsonDoc.toVariant().toMap());
+}
+
+void JsonRPCServerImplementation::processCborPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
+{
+    QString errorString;
+    QVariantMap message = CborCodec::decode(data, &errorString);
+    if (!errorString.isEmpty()) {
+        qCWarning(dcJsonRpc) << "Failed to parse CBOR data" << data.toHex() << ":" << errorString;
+        sendErrorResponse(interface, clientId, -1, QString("Failed to parse CBOR data: %1").arg(errorString));
+        return;
+    }
+    // The size of length prefixed packets can only be checked against the method once decoded
+    QString method = message.value("method").toString();
+    if (data.size() > m_packetLimits.limit(method)) {
+        qCWarning(dcJsonRpc) << "Packet for method" << method << "exceeds the size limit of" << m_packetLimits.limit(method) << "bytes";
+        sendErrorResponse(interface, clientId, message.value("id").toInt(), QString("Packet exceeds the size limit of %1 bytes for %2").arg(m_packetLimits.limit(method)).arg(method));
+        return;
+    }
+    processMessage(interface, clientId, message);
+}
 
+void JsonRPCServerImplementation::processMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
@@ -694,6 +945,17 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         return;
     }
 
+    // Only known methods are counted, clients can't make the label set grow
+    MetricsRegistry::instance()->counter("nymea_jsonrpc_requests_total", targetNamespace + '.' + method)->increment();
+    QElapsedTimer requestTimer;
+    requestTimer.start();
+
+    // Things done on behalf of the request, e.g. executing an action, are traced as its children
+    TraceScope traceScope("JsonRPCServer::request", "jsonrpc");
+    if (traceScope.isActive()) {
+        traceScope.setArg("method", targetNamespace + '.' + method);
+    }
+
     QVariantMap params = message.value("params").toMap();
 
     QVariantMap definition = handler->jsonMethods().value(method).toMap().value("params").toMap();
@@ -736,6 +998,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     if (reply->type() == JsonReply::TypeAsync) {
         m_asyncReplies.insert(reply, interface);
+        m_asyncReplyTimers.insert(reply, requestTimer);
         reply->setClientId(clientId);
         reply->setCommandId(commandId);
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
@@ -753,9 +1016,50 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
             qCWarning(dcJsonRpc()) << targetNamespace + '.' + method + ':' << deprecationWarning;
         }
 
-        sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
+        sendResponse(interface, clientId, commandId, reply, deprecationWarning);
         reply->deleteLater();
+        MetricsRegistry::instance()->histogram("nymea_jsonrpc_request_duration_seconds", targetNamespace + '.' + method)->observe(requestTimer.nsecsElapsed() / 1000);
+
+        if (m_pendingCompressions.contains(clientId)) {
+            TransportInterface::Compression compression = m_pendingCompressions.take(clientId);
+            if (interface->setCompression(clientId, compression)) {
+                m_clientCompressions.insert(clientId, compression);
+            }
+        }
+        if (m_pendingEncodings.contains(clientId)) {
+            Encoding encoding = m_pendingEncodings.take(clientId);
+            if (interface->setFraming(clientId, encoding == EncodingCbor ? TransportInterface::FramingLengthPrefixed : TransportInterface::FramingNewline)) {
+                m_clientEncodings.insert(clientId, encoding);
+            }
+        }
+    }
+}
+
+/*! Returns the id of the thing the notification with the given \a params is about, or a null id if it
+ * is not related to a thing.
+ */
+ThingId JsonRPCServerImplementation::notificationThingId(const QVariantMap &params)
+{
+    static const QStringList idKeys = {"thingId", "deviceId"};
+    static const QStringList objectKeys = {"thing", "device"};
+    static const QStringList containerKeys = {"event", "logEntry"};
+
+    foreach (const QString &key, idKeys) {
+        if (params.contains(key)) {
+            return ThingId(params.value(key).toUuid());
+        }
+    }
+    foreach (const QString &key, objectKeys) {
+        if (params.contains(key)) {
+            return ThingId(params.value(key).toMap().value("id").toUuid());
+        }
+    }
+    foreach (const QString &key, containerKeys) {
+        if (params.contains(key)) {
+            return notificationThingId(params.value(key).toMap());
+        }
     }
+    return ThingId();
 }
 
 void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
@@ -763,11 +1067,23 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
 
+    QString notificationName = handler->name() + "." + method.name();
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
+    notification.insert("notification", notificationName);
 
-    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
+    // Only build the notification for clients whose filter matches
+    ThingId thingId = notificationThingId(params);
+    StateTypeId stateTypeId = StateTypeId(params.value("stateTypeId").toUuid());
+    QList<QUuid> clients = m_notificationSubscriptions->filterClients(m_clientNotifications.keys(), thingId, stateTypeId);
+
+    TraceScope traceScope("JsonRPCServer::sendNotification", "jsonrpc");
+    if (traceScope.isActive()) {
+        traceScope.setArg("notification", notification.value("notification"));
+        traceScope.setArg("clients", clients.count());
+    }
+
+    foreach (const QUuid &clientId, clients) {
 
         // Check if this client wants to be notified
         if (!m_clientNotifications.value(clientId).contains(handler->name())) {
@@ -792,12 +1108,16 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
 
         notification.insert("params", translatedParams);
 
-        QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+        // State changes may be held back and coalesced for rate limited or slow clients
+        TransportInterface *interface = m_clientTransports.value(clientId);
+        if (!thingId.isNull() && !stateTypeId.isNull() && !m_notificationThrottle->submit(interface, clientId, notificationName, thingId, stateTypeId, notification)) {
+            qCDebug(dcJsonRpc()) << "Holding back notification" << handler->name() + "." + method.name() << "for client" << clientId;
+            continue;
+        }
 
         qCDebug(dcJsonRpc()) << "Sending notification" << handler->name() + "." + method.name() << "to client" << clientId;
-        qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
-
-        m_clientTransports.value(clientId)->sendData(clientId, data);
+        sendMessage(interface, clientId, notification);
+        m_notificationCounters.value(notificationName)->increment();
     }
 }
 
@@ -811,9 +1131,10 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
         return;
     }
 
+    QString notificationName = handler->name() + "." + method.name();
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
+    notification.insert("notification", notificationName);
     notification.insert("params", params);
 
     JsonValidator validator;
@@ -828,16 +1149,16 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
         notification.insert("deprecationWarning", deprecationMessage);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
     qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
-    m_clientTransports.value(clientId)->sendData(clientId, data);
+    sendMessage(m_clientTransports.value(clientId), clientId, notification);
+    m_notificationCounters.value(notificationName)->increment();
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
 {
     JsonReply *reply = qobject_cast<JsonReply *>(sender());
     TransportInterface *interface = m_asyncReplies.take(reply);
+    QElapsedTimer requestTimer = m_asyncReplyTimers.take(reply);
     if (!interface) {
         qCWarning(dcJsonRpc()) << "Got an async reply but the requesting connection has vanished.";
         reply->deleteLater();
@@ -858,6 +1179,7 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         }
 
         sendResponse(interface, reply->clientId(), reply->commandId(), reply->data(), deprecationWarning);
+        MetricsRegistry::instance()->histogram("nymea_jsonrpc_request_duration_seconds", method)->observe(requestTimer.nsecsElapsed() / 1000);
     } else {
         qCWarning(dcJsonRpc()) << "RPC call timed out:" << reply->handler()->name() << ":" << reply->method();
         sendErrorResponse(interface, reply->clientId(), reply->commandId(), "Command timed out");
@@ -905,6 +1227,16 @@ void JsonRPCServerImplementation::onPushButtonAuthFinished(int transactionId, bo
     emit PushButtonAuthFinished(clientId, params);
 }
 
+void JsonRPCServerImplementation::notifyStateChanged(const StateChange &change)
+{
+    // The handlers are created in setup(), there is nobody to notify before
+    if (!m_integrationsHandler) {
+        return;
+    }
+    m_integrationsHandler->thingStateChanged(change);
+    m_deviceHandler->deviceStateChanged(change);
+}
+
 bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
 {
     // Sanity checks on API:
@@ -1001,9 +1333,13 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     m_api = apiIncludingThis;
 
     m_handlers.insert(handler->name(), handler);
+
+    // Counted per namespace, resolved once instead of for each notification sent
+    MetricCounter *notificationCounter = MetricsRegistry::instance()->counter("nymea_jsonrpc_notifications_total", handler->name());
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
         QMetaMethod method = handler->metaObject()->method(i);
         if (method.methodType() == QMetaMethod::Signal && QString(method.name()).contains(QRegExp("^[A-Z]"))) {
+            m_notificationCounters.insert(handler->name() + "." + method.name(), notificationCounter);
             if (method.parameterCount() == 1 && method.parameterType(0) == QVariant::Map) {
                 QObject::connect(handler, method, this, metaObject()->method(metaObject()->indexOfSlot("sendNotification(QVariantMap)")));
             } else if (method.parameterCount() == 2 && method.parameterType(0) == QVariant::Uuid && method.parameterType(1) == QVariant::Map) {
@@ -1040,8 +1376,16 @@ void JsonRPCServerImplementation::clientDisconnected(const QUuid &clientId)
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
     m_clientTransports.remove(clientId);
     m_clientNotifications.remove(clientId);
-    m_clientBuffers.remove(clientId);
+    if (m_notificationSubscriptions) {
+        m_notificationSubscriptions->removeClient(clientId);
+    }
+    m_notificationThrottle->removeClient(clientId);
+    m_clientFramers.remove(clientId);
     m_clientLocales.remove(clientId);
+    m_clientCompressions.remove(clientId);
+    m_pendingCompressions.remove(clientId);
+    m_clientEncodings.remove(clientId);
+    m_pendingEncodings.remove(clientId);
     if (m_pushButtonTransactions.values().contains(clientId)) {
         NymeaCore::instance()->userManager()->cancelPushButtonAuth(m_pushButtonTransactions.key(clientId));
     }
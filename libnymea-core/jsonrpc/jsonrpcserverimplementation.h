@@ -33,6 +33,7 @@
 
 #include "jsonrpc/jsonrpcserver.h"
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonrpcframer.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
 
@@ -44,15 +45,30 @@
 #include <QVariantMap>
 #include <QString>
 #include <QSslConfiguration>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 class Thing;
+class StateChange;
 
 namespace nymeaserver {
 
+class NotificationSubscriptions;
+class NotificationThrottle;
+class MetricCounter;
+class IntegrationsHandler;
+class DeviceHandler;
+
 class JsonRPCServerImplementation: public JsonHandler, public JsonRPCServer
 {
     Q_OBJECT
 public:
+    enum Encoding {
+        EncodingJson,
+        EncodingCbor
+    };
+    Q_ENUM(Encoding)
+
     JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
 
     // JsonHandler API implementation
@@ -61,6 +77,8 @@ public:
     Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *Version(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetNotificationStatus(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationFilter(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationRateLimit(const QVariantMap &params, const JsonContext &context);
 
     Q_INVOKABLE JsonReply *CreateUser(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params);
@@ -84,15 +102,23 @@ public:
     bool registerHandler(JsonHandler *handler) override;
     bool registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion) override;
 
+    // Sends the StateChanged notifications of all namespaces for the given change
+    void notifyStateChanged(const StateChange &change);
+
 private:
     QHash<QString, JsonHandler *> handlers() const;
 
     void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap(), const QString &deprecationWarning = QString());
+    void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, JsonReply *reply, const QString &deprecationWarning = QString());
     void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
     void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
+    void sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+    static ThingId notificationThingId(const QVariantMap &params);
     QVariantMap createWelcomeMessage(TransportInterface *interface, const QUuid &clientId) const;
 
     void processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processCborPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
 
 private slots:
     void setup();
@@ -117,11 +143,23 @@ private:
     QMap<TransportInterface*, bool> m_interfaces; // Interface, authenticationRequired
     QHash<QString, JsonHandler *> m_handlers;
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
+    QHash<JsonReply *, QElapsedTimer> m_asyncReplyTimers;
 
     QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, QByteArray> m_clientBuffers;
+    QHash<QUuid, QSharedPointer<JsonRpcFramer> > m_clientFramers;
+    JsonRpcFramer::Limits m_packetLimits;
     QHash<QUuid, QStringList> m_clientNotifications;
+    NotificationSubscriptions *m_notificationSubscriptions = nullptr;
+    NotificationThrottle *m_notificationThrottle = nullptr;
+    IntegrationsHandler *m_integrationsHandler = nullptr;
+    DeviceHandler *m_deviceHandler = nullptr;
+    // Metric counters by notification name, e.g. "Integrations.StateChanged"
+    QHash<QString, MetricCounter *> m_notificationCounters;
     QHash<QUuid, QLocale> m_clientLocales;
+    QHash<QUuid, TransportInterface::Compression> m_clientCompressions;
+    QHash<QUuid, TransportInterface::Compression> m_pendingCompressions;
+    QHash<QUuid, Encoding> m_clientEncodings;
+    QHash<QUuid, Encoding> m_pendingEncodings;
     QHash<int, QUuid> m_pushButtonTransactions;
     QHash<QUuid, QTimer*> m_newConnectionWaitTimers;
 
@@ -33,6 +33,7 @@
 #include "logging/logfilter.h"
 #include "logging/logentry.h"
 #include "logging/logvaluetool.h"
+#include "logging/statelogpolicy.h"
 #include "loggingcategories.h"
 #include "nymeacore.h"
 
@@ -46,9 +47,11 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     registerEnum<Logging::LoggingLevel>();
     registerEnum<Logging::LoggingEventType>();
     registerEnum<Logging::LoggingError>();
+    registerEnum<Logging::StateLoggingMode>();
 
     // Objects
     registerObject<LogEntry, LogEntries>();
+    registerObject<StateLogPolicy, StateLogPolicies>();
 
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
@@ -66,7 +69,13 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "1) offset 0, maxCount 1000: Entries 0 to 9999\n"
                    "2) offset 10000, maxCount 1000: Entries 10000 - 19999\n"
                    "3) offset 20000, maxCount 1000: Entries 20000 - 29999\n"
-                   "...";
+                   "...\n\n"
+                   "Entries of the source LoggingSourceRules with the event type LoggingEventTypeActionsExecuted or "
+                   "LoggingEventTypeExitActionsExecuted are written once all actions of a rule have finished. If any "
+                   "of them failed, the entry has the loggingLevel LoggingLevelAlert, \"errorCode\" holds the ThingError "
+                   "of the first failed action and \"value\" lists each ThingError with the number of actions which "
+                   "failed with it, e.g. \"ThingErrorSetupFailed x2\". Other alert entries of rules give a RuleError "
+                   "in \"errorCode\".";
     QVariantMap timeFilter;
     timeFilter.insert("o:startDate", enumValueName(Int));
     timeFilter.insert("o:endDate", enumValueName(Int));
@@ -86,9 +95,51 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     returns.insert("offset", enumValueName(Int));
     registerMethod("GetLogEntries", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the policies deciding which state changes are written to the log. States without "
+                  "a matching policy are logged on every change.";
+    returns.insert("policies", objectRef<StateLogPolicies>());
+    registerMethod("GetStateLoggingPolicies", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Add a state logging policy or replace the existing one with the same scope. The scope "
+                  "is given by thingClassId, thingId and stateTypeId, all of which are optional. If multiple "
+                  "policies match a state, the most specific one is applied, with thingId taking precedence "
+                  "over stateTypeId and stateTypeId over thingClassId.\n"
+                  "- StateLoggingModeOff: Don't log the state at all.\n"
+                  "- StateLoggingModeOnChange: Log every change.\n"
+                  "- StateLoggingModeAbsoluteDeadband: Only log changes larger than deadband.\n"
+                  "- StateLoggingModeRelativeDeadband: Only log changes larger than deadband percent of the last logged value.\n"
+                  "If minimumInterval (in milliseconds) is given, changes are logged at most once per interval. "
+                  "With sampleAndHold, the last suppressed value is written once the interval has passed (after "
+                  "15 minutes for values within the deadband if no interval is given), or when the server shuts down.";
+    params.insert("policy", objectRef<StateLogPolicy>());
+    returns.insert("loggingError", enumRef<Logging::LoggingError>());
+    registerMethod("SetStateLoggingPolicy", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Remove the state logging policy with the given scope.";
+    params.insert("o:thingClassId", enumValueName(Uuid));
+    params.insert("o:thingId", enumValueName(Uuid));
+    params.insert("o:stateTypeId", enumValueName(Uuid));
+    returns.insert("loggingError", enumRef<Logging::LoggingError>());
+    registerMethod("RemoveStateLoggingPolicy", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Get statistics about state changes passed to the log since the server started and how many "
+                  "of them have been suppressed by the state logging policies.";
+    returns.insert("evaluated", enumValueName(Uint));
+    returns.insert("written", enumValueName(Uint));
+    returns.insert("suppressedOff", enumValueName(Uint));
+    returns.insert("suppressedDeadband", enumValueName(Uint));
+    returns.insert("suppressedInterval", enumValueName(Uint));
+    returns.insert("released", enumValueName(Uint));
+    registerMethod("GetStateLoggingStatistics", description, params, returns);
+
     // Notifications
     params.clear();
-    description = "Emitted whenever an entry is appended to the logging system. ";
+    description = "Emitted whenever an entry is appended to the logging system. See GetLogEntries for the "
+                  "contents of entries about executed rule actions.";
     params.insert("logEntry", objectRef<LogEntry>());
     registerNotification("LogEntryAdded", description, params);
 
@@ -148,6 +199,48 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
     return reply;
 }
 
+JsonReply *LoggingHandler::GetStateLoggingPolicies(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    QVariantMap returns;
+    returns.insert("policies", pack(NymeaCore::instance()->logEngine()->stateLogFilter()->policies()));
+    return createReply(returns);
+}
+
+JsonReply *LoggingHandler::SetStateLoggingPolicy(const QVariantMap &params)
+{
+    StateLogPolicy policy = unpack<StateLogPolicy>(params.value("policy").toMap());
+    Logging::LoggingError error = NymeaCore::instance()->logEngine()->stateLogFilter()->setPolicy(policy);
+    QVariantMap returns;
+    returns.insert("loggingError", enumValueName<Logging::LoggingError>(error));
+    return createReply(returns);
+}
+
+JsonReply *LoggingHandler::RemoveStateLoggingPolicy(const QVariantMap &params)
+{
+    ThingClassId thingClassId = params.value("thingClassId").toUuid();
+    ThingId thingId = params.value("thingId").toUuid();
+    StateTypeId stateTypeId = params.value("stateTypeId").toUuid();
+    Logging::LoggingError error = NymeaCore::instance()->logEngine()->stateLogFilter()->removePolicy(thingClassId, thingId, stateTypeId);
+    QVariantMap returns;
+    returns.insert("loggingError", enumValueName<Logging::LoggingError>(error));
+    return createReply(returns);
+}
+
+JsonReply *LoggingHandler::GetStateLoggingStatistics(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    StateLogFilter::Statistics statistics = NymeaCore::instance()->logEngine()->stateLogFilter()->statistics();
+    QVariantMap returns;
+    returns.insert("evaluated", statistics.evaluated);
+    returns.insert("written", statistics.written);
+    returns.insert("suppressedOff", statistics.suppressedOff);
+    returns.insert("suppressedDeadband", statistics.suppressedDeadband);
+    returns.insert("suppressedInterval", statistics.suppressedInterval);
+    returns.insert("released", statistics.released);
+    return createReply(returns);
+}
+
 QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
 {
     QVariantMap logEntryMap;
@@ -165,7 +258,12 @@ QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
     if (logEntry.level() == Logging::LoggingLevelAlert) {
         switch (logEntry.source()) {
         case Logging::LoggingSourceRules:
-            logEntryMap.insert("errorCode", enumValueName<RuleEngine::RuleError>(static_cast<RuleEngine::RuleError>(logEntry.errorCode())));
+            // Executing rule actions fails with the errors of the actions
+            if (logEntry.eventType() == Logging::LoggingEventTypeActionsExecuted || logEntry.eventType() == Logging::LoggingEventTypeExitActionsExecuted) {
+                logEntryMap.insert("errorCode", enumValueName<Thing::ThingError>(static_cast<Thing::ThingError>(logEntry.errorCode())));
+            } else {
+                logEntryMap.insert("errorCode", enumValueName<RuleEngine::RuleError>(static_cast<RuleEngine::RuleError>(logEntry.errorCode())));
+            }
             break;
         case Logging::LoggingSourceActions:
         case Logging::LoggingSourceEvents:
@@ -197,6 +295,9 @@ QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
         break;
     case Logging::LoggingSourceRules:
         logEntryMap.insert("typeId", logEntry.typeId().toString());
+        if (logEntry.level() == Logging::LoggingLevelAlert) {
+            logEntryMap.insert("value", LogValueTool::convertVariantToString(logEntry.value()));
+        }
         break;
     }
 
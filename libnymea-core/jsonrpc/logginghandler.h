@@ -46,6 +46,11 @@ public:
 
     Q_INVOKABLE JsonReply *GetLogEntries(const QVariantMap &params) const;
 
+    Q_INVOKABLE JsonReply *GetStateLoggingPolicies(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *SetStateLoggingPolicy(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *RemoveStateLoggingPolicy(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetStateLoggingStatistics(const QVariantMap &params) const;
+
 signals:
     void LogEntryAdded(const QVariantMap &params);
     void LogDatabaseUpdated(const QVariantMap &params);
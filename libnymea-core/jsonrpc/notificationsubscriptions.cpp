@@ -0,0 +1,170 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::NotificationSubscriptions
+    \brief Keeps track of the notification filters set by JSON-RPC clients.
+
+    \ingroup api
+    \inmodule core
+
+    Clients may restrict the thing related notifications they receive to a set of things,
+    given either directly by their ids or by interfaces and tags. Those criteria are
+    resolved to the matching things once and kept in an index which is invalidated when
+    things or tags are added or removed. This way, the JSON-RPC server can select the
+    receivers of a notification without evaluating the filters for every notification.
+
+    Notifications which are not related to a thing are not affected by the filters.
+*/
+
+#include "notificationsubscriptions.h"
+#include "integrations/thingmanager.h"
+#include "integrations/thing.h"
+#include "tagging/tagsstorage.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+/*! Returns true if this filter does not restrict any notifications. */
+bool NotificationSubscriptions::Filter::isEmpty() const
+{
+    return !filtersThings() && stateTypeIds.isEmpty();
+}
+
+/*! Returns true if this filter restricts the notifications to a set of things. */
+bool NotificationSubscriptions::Filter::filtersThings() const
+{
+    return !thingIds.isEmpty() || !interfaces.isEmpty() || !tagIds.isEmpty();
+}
+
+NotificationSubscriptions::NotificationSubscriptions(ThingManager *thingManager, TagsStorage *tagsStorage, QObject *parent):
+    QObject(parent),
+    m_thingManager(thingManager),
+    m_tagsStorage(tagsStorage)
+{
+    // Things need to be in the index before the ThingAdded notification goes out but
+    // must still be in it when the ThingRemoved notification is sent.
+    connect(thingManager, &ThingManager::thingAdded, this, &NotificationSubscriptions::invalidate);
+    connect(thingManager, &ThingManager::thingRemoved, this, &NotificationSubscriptions::invalidate, Qt::QueuedConnection);
+    connect(tagsStorage, &TagsStorage::tagAdded, this, &NotificationSubscriptions::invalidate);
+    connect(tagsStorage, &TagsStorage::tagRemoved, this, &NotificationSubscriptions::invalidate);
+}
+
+/*! Returns the filter for the client with the given \a clientId. */
+NotificationSubscriptions::Filter NotificationSubscriptions::filter(const QUuid &clientId) const
+{
+    return m_filters.value(clientId);
+}
+
+/*! Sets the \a filter for the client with the given \a clientId. An empty filter removes all restrictions. */
+void NotificationSubscriptions::setFilter(const QUuid &clientId, const Filter &filter)
+{
+    if (filter.isEmpty()) {
+        m_filters.remove(clientId);
+    } else {
+        m_filters.insert(clientId, filter);
+    }
+    m_indexDirty = true;
+}
+
+/*! Removes the filter for the client with the given \a clientId. */
+void NotificationSubscriptions::removeClient(const QUuid &clientId)
+{
+    if (m_filters.remove(clientId) > 0) {
+        m_indexDirty = true;
+    }
+}
+
+/*! Returns the subset of \a clients which should receive a notification about the thing with the
+    given \a thingId and the state with the given \a stateTypeId. Both ids may be null for
+    notifications which are not related to a thing or state.
+*/
+QList<QUuid> NotificationSubscriptions::filterClients(const QList<QUuid> &clients, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    if (m_filters.isEmpty() || (thingId.isNull() && stateTypeId.isNull())) {
+        return clients;
+    }
+    if (m_indexDirty) {
+        rebuildIndex();
+    }
+
+    const QSet<QUuid> thingSubscribers = m_thingSubscribers.value(thingId);
+    QList<QUuid> result;
+    result.reserve(clients.count());
+    foreach (const QUuid &clientId, clients) {
+        QHash<QUuid, Filter>::const_iterator it = m_filters.constFind(clientId);
+        if (it == m_filters.constEnd()) {
+            result.append(clientId);
+            continue;
+        }
+        if (!thingId.isNull() && it->filtersThings() && !thingSubscribers.contains(clientId)) {
+            continue;
+        }
+        if (!stateTypeId.isNull() && !it->stateTypeIds.isEmpty() && !it->stateTypeIds.contains(stateTypeId)) {
+            continue;
+        }
+        result.append(clientId);
+    }
+    return result;
+}
+
+/*! Marks the index as outdated. It will be rebuilt when the next notification is sent. */
+void NotificationSubscriptions::invalidate()
+{
+    m_indexDirty = true;
+}
+
+void NotificationSubscriptions::rebuildIndex()
+{
+    m_thingSubscribers.clear();
+    for (QHash<QUuid, Filter>::const_iterator it = m_filters.constBegin(); it != m_filters.constEnd(); ++it) {
+        const QUuid &clientId = it.key();
+        const Filter &filter = it.value();
+        foreach (const ThingId &thingId, filter.thingIds) {
+            m_thingSubscribers[thingId].insert(clientId);
+        }
+        foreach (const QString &interface, filter.interfaces) {
+            foreach (Thing *thing, m_thingManager->findConfiguredThings(interface)) {
+                m_thingSubscribers[thing->id()].insert(clientId);
+            }
+        }
+        if (!filter.tagIds.isEmpty()) {
+            foreach (const Tag &tag, m_tagsStorage->tags()) {
+                if (!tag.thingId().isNull() && filter.tagIds.contains(tag.tagId())) {
+                    m_thingSubscribers[tag.thingId()].insert(clientId);
+                }
+            }
+        }
+    }
+    m_indexDirty = false;
+    qCDebug(dcJsonRpc()) << "Rebuilt notification index for" << m_filters.count() << "clients with" << m_thingSubscribers.count() << "things";
+}
+
+}
@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NOTIFICATIONSUBSCRIPTIONS_H
+#define NOTIFICATIONSUBSCRIPTIONS_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QUuid>
+#include <QStringList>
+
+#include "typeutils.h"
+
+class ThingManager;
+
+namespace nymeaserver {
+
+class TagsStorage;
+
+class NotificationSubscriptions : public QObject
+{
+    Q_OBJECT
+public:
+    class Filter
+    {
+    public:
+        QSet<ThingId> thingIds;
+        QStringList interfaces;
+        QStringList tagIds;
+        QSet<StateTypeId> stateTypeIds;
+
+        bool isEmpty() const;
+        bool filtersThings() const;
+    };
+
+    explicit NotificationSubscriptions(ThingManager *thingManager, TagsStorage *tagsStorage, QObject *parent = nullptr);
+
+    Filter filter(const QUuid &clientId) const;
+    void setFilter(const QUuid &clientId, const Filter &filter);
+    void removeClient(const QUuid &clientId);
+
+    QList<QUuid> filterClients(const QList<QUuid> &clients, const ThingId &thingId, const StateTypeId &stateTypeId);
+
+public slots:
+    void invalidate();
+
+private:
+    void rebuildIndex();
+
+    ThingManager *m_thingManager = nullptr;
+    TagsStorage *m_tagsStorage = nullptr;
+
+    QHash<QUuid, Filter> m_filters;
+
+    // Clients with a thing filter, indexed by the things matching their filter
+    QHash<ThingId, QSet<QUuid>> m_thingSubscribers;
+    bool m_indexDirty = true;
+};
+
+}
+
+#endif // NOTIFICATIONSUBSCRIPTIONS_H
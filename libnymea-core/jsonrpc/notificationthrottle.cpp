@@ -0,0 +1,214 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::NotificationThrottle
+    \brief Limits the rate of state change notifications sent to a client.
+
+    \ingroup api
+    \inmodule core
+
+    A client may set a minimum interval between two state change notifications for the
+    same thing and state. Notifications arriving faster are held back and replaced by
+    newer ones, so the client receives the latest value once the interval has passed.
+
+    Independently of that, state change notifications for a client are held back while the
+    outgoing buffer of its transport exceeds a threshold. Intermediate values are dropped
+    until the transport has caught up.
+
+    The number of values skipped for a thing and state is added to the next notification
+    delivered for it, in the fields "coalesced" (rate limit) and "dropped" (backpressure).
+*/
+
+#include "notificationthrottle.h"
+#include "transportinterface.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+// Outgoing bytes buffered for a client before its state changes are held back
+static const qint64 congestionThreshold = 256 * 1024;
+static const int flushInterval = 50;
+
+NotificationThrottle::NotificationThrottle(QObject *parent):
+    QObject(parent)
+{
+    m_clock.start();
+    m_flushTimer.setInterval(flushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &NotificationThrottle::flush);
+}
+
+/*! Returns the minimum interval in milliseconds between two state change notifications
+    for the same state sent to the client with the given \a clientId.
+*/
+uint NotificationThrottle::minInterval(const QUuid &clientId) const
+{
+    return m_clients.value(clientId).minInterval;
+}
+
+/*! Sets the \a minInterval in milliseconds between two state change notifications for the
+    same state sent to the client with the given \a clientId. 0 disables the rate limit.
+*/
+void NotificationThrottle::setMinInterval(const QUuid &clientId, uint minInterval)
+{
+    m_clients[clientId].minInterval = minInterval;
+}
+
+/*! Drops all state kept for the client with the given \a clientId, including held back notifications. */
+void NotificationThrottle::removeClient(const QUuid &clientId)
+{
+    m_clients.remove(clientId);
+}
+
+/*! Drops all state kept for the thing with the given \a thingId, so held back state changes of a removed
+    thing are not delivered after it has been removed.
+*/
+void NotificationThrottle::removeThing(const ThingId &thingId)
+{
+    for (QHash<QUuid, ClientState>::iterator clientIt = m_clients.begin(); clientIt != m_clients.end(); ++clientIt) {
+        QHash<StateKey, PendingState>::iterator it = clientIt.value().states.begin();
+        while (it != clientIt.value().states.end()) {
+            if (it.key().thingId == thingId) {
+                it = clientIt.value().states.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+/*! Returns true if the state change \a notification for the thing with the given \a thingId and the
+    state with the given \a stateTypeId can be sent to the client with the given \a clientId right away.
+    Notifications with a different \a notificationName are throttled independently. Otherwise the notification is held back and will be delivered with the \l{deliver()} signal later,
+    unless it is replaced by a newer one in the meantime.
+*/
+bool NotificationThrottle::submit(TransportInterface *interface, const QUuid &clientId, const QString &notificationName, const ThingId &thingId, const StateTypeId &stateTypeId, const QVariantMap &notification)
+{
+    ClientState &client = m_clients[clientId];
+    client.interface = interface;
+
+    bool congested = isCongested(client, clientId);
+    if (client.minInterval == 0 && client.states.isEmpty() && !congested) {
+        return true;
+    }
+
+    StateKey key;
+    key.notificationName = notificationName;
+    key.thingId = thingId;
+    key.stateTypeId = stateTypeId;
+    PendingState &state = client.states[key];
+    qint64 now = m_clock.elapsed();
+    if (!state.pending && !congested && (state.lastSent < 0 || now - state.lastSent >= client.minInterval)) {
+        if (client.minInterval == 0) {
+            client.states.remove(key);
+        } else {
+            state.lastSent = now;
+        }
+        return true;
+    }
+
+    if (state.pending) {
+        if (congested) {
+            state.dropped++;
+        } else {
+            state.coalesced++;
+        }
+    }
+    state.notification = notification;
+    state.pending = true;
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+    return false;
+}
+
+void NotificationThrottle::flush()
+{
+    qint64 now = m_clock.elapsed();
+    bool pendingLeft = false;
+    // Delivering may end up in a client disconnecting, collect everything before emitting
+    QList<QPair<QUuid, QVariantMap>> deliveries;
+    for (QHash<QUuid, ClientState>::iterator clientIt = m_clients.begin(); clientIt != m_clients.end(); ++clientIt) {
+        ClientState &client = clientIt.value();
+        if (isCongested(client, clientIt.key())) {
+            foreach (const PendingState &state, client.states) {
+                pendingLeft |= state.pending;
+            }
+            continue;
+        }
+        QHash<StateKey, PendingState>::iterator it = client.states.begin();
+        while (it != client.states.end()) {
+            PendingState &state = it.value();
+            if (!state.pending) {
+                ++it;
+                continue;
+            }
+            if (state.lastSent >= 0 && now - state.lastSent < client.minInterval) {
+                pendingLeft = true;
+                ++it;
+                continue;
+            }
+            QVariantMap notification = state.notification;
+            if (state.coalesced > 0) {
+                notification.insert("coalesced", state.coalesced);
+            }
+            if (state.dropped > 0) {
+                notification.insert("dropped", state.dropped);
+                qCDebug(dcJsonRpc()) << "Dropped" << state.dropped << "state changes for congested client" << clientIt.key();
+            }
+            deliveries.append(qMakePair(clientIt.key(), notification));
+
+            if (client.minInterval == 0) {
+                it = client.states.erase(it);
+            } else {
+                state.notification.clear();
+                state.pending = false;
+                state.coalesced = 0;
+                state.dropped = 0;
+                state.lastSent = now;
+                ++it;
+            }
+        }
+    }
+    if (!pendingLeft) {
+        m_flushTimer.stop();
+    }
+
+    for (int i = 0; i < deliveries.count(); i++) {
+        emit deliver(deliveries.at(i).first, deliveries.at(i).second);
+    }
+}
+
+bool NotificationThrottle::isCongested(const ClientState &client, const QUuid &clientId) const
+{
+    return client.interface && client.interface->bytesToWrite(clientId) > congestionThreshold;
+}
+
+}
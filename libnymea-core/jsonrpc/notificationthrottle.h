@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NOTIFICATIONTHROTTLE_H
+#define NOTIFICATIONTHROTTLE_H
+
+#include <QObject>
+#include <QHash>
+#include <QUuid>
+#include <QTimer>
+#include <QVariantMap>
+#include <QElapsedTimer>
+
+#include "typeutils.h"
+
+namespace nymeaserver {
+
+class TransportInterface;
+
+class NotificationThrottle : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NotificationThrottle(QObject *parent = nullptr);
+
+    uint minInterval(const QUuid &clientId) const;
+    void setMinInterval(const QUuid &clientId, uint minInterval);
+    void removeClient(const QUuid &clientId);
+    void removeThing(const ThingId &thingId);
+
+    bool submit(TransportInterface *interface, const QUuid &clientId, const QString &notificationName, const ThingId &thingId, const StateTypeId &stateTypeId, const QVariantMap &notification);
+
+signals:
+    void deliver(const QUuid &clientId, const QVariantMap &notification);
+
+private slots:
+    void flush();
+
+private:
+    // The same state change is sent as different notifications, e.g. in the Devices and Integrations namespaces
+    class StateKey
+    {
+    public:
+        QString notificationName;
+        ThingId thingId;
+        StateTypeId stateTypeId;
+
+        bool operator==(const StateKey &other) const {
+            return thingId == other.thingId && stateTypeId == other.stateTypeId && notificationName == other.notificationName;
+        }
+        friend uint qHash(const StateKey &key, uint seed = 0) {
+            return qHash(key.thingId, seed) ^ qHash(key.stateTypeId, seed) ^ qHash(key.notificationName, seed);
+        }
+    };
+
+    class PendingState
+    {
+    public:
+        qint64 lastSent = -1;
+        bool pending = false;
+        QVariantMap notification;
+        int coalesced = 0;
+        int dropped = 0;
+    };
+
+    class ClientState
+    {
+    public:
+        TransportInterface *interface = nullptr;
+        uint minInterval = 0;
+        QHash<StateKey, PendingState> states;
+    };
+
+    bool isCongested(const ClientState &client, const QUuid &clientId) const;
+
+    QHash<QUuid, ClientState> m_clients;
+    QElapsedTimer m_clock;
+    QTimer m_flushTimer;
+};
+
+}
+
+#endif // NOTIFICATIONTHROTTLE_H
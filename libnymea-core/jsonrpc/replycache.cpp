@@ -0,0 +1,94 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::ReplyCache
+    \brief Caches the replies of JSON-RPC methods which return large and rarely changing data.
+
+    \ingroup api
+    \inmodule core
+
+    Each entry keeps the reply data along with its compact JSON and its CBOR encoding. Replies
+    created from the cache carry all three, so the JSON-RPC server can validate the data and
+    send the encoding the client talks without serializing the data again.
+
+    The owner is responsible for clearing the cache whenever the cached data might have changed.
+*/
+
+#include "replycache.h"
+#include "cborcodec.h"
+
+#include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonreply.h"
+
+#include <QJsonDocument>
+
+namespace nymeaserver {
+
+/*! Returns true if a reply for the given \a key is cached. */
+bool ReplyCache::contains(const QString &key) const
+{
+    return m_entries.contains(key);
+}
+
+/*! Creates a reply for the given \a handler from the entry cached for \a key. */
+JsonReply *ReplyCache::createReply(const JsonHandler *handler, const QString &key) const
+{
+    return createReply(handler, m_entries.value(key));
+}
+
+/*! Caches the given \a data for \a key and returns a reply for the given \a handler containing it. */
+JsonReply *ReplyCache::insert(const JsonHandler *handler, const QString &key, const QVariantMap &data)
+{
+    Entry entry;
+    entry.data = data;
+    entry.json = QJsonDocument::fromVariant(data).toJson(QJsonDocument::Compact);
+    if (CborCodec::isAvailable()) {
+        entry.cbor = CborCodec::encode(data);
+    }
+    m_entries.insert(key, entry);
+    return createReply(handler, entry);
+}
+
+/*! Drops all cached replies. */
+void ReplyCache::clear()
+{
+    m_entries.clear();
+}
+
+JsonReply *ReplyCache::createReply(const JsonHandler *handler, const Entry &entry)
+{
+    JsonReply *reply = JsonReply::createReply(const_cast<JsonHandler*>(handler), entry.data);
+    reply->setSerializedData(entry.json);
+    reply->setSerializedCborData(entry.cbor);
+    return reply;
+}
+
+}
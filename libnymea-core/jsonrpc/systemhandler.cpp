@@ -33,6 +33,9 @@
 #include "platform/platform.h"
 #include "platform/platformupdatecontroller.h"
 #include "platform/platformsystemcontroller.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/memoryaccounting.h"
+#include "diagnostics/allocationsampler.h"
 
 namespace nymeaserver {
 
@@ -44,6 +47,47 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     registerObject<Package, Packages>();
     registerObject<Repository, Repositories>();
 
+    QVariantMap metricBucket;
+    metricBucket.insert("upperBound", enumValueName(Double));
+    metricBucket.insert("count", enumValueName(Uint));
+    registerObject("MetricBucket", metricBucket);
+
+    QVariantMap metricSample;
+    metricSample.insert("o:labelValue", enumValueName(String));
+    metricSample.insert("o:value", enumValueName(Double));
+    metricSample.insert("o:count", enumValueName(Uint));
+    metricSample.insert("o:sum", enumValueName(Double));
+    metricSample.insert("o:buckets", QVariantList() << objectRef("MetricBucket"));
+    registerObject("MetricSample", metricSample);
+
+    QVariantMap metric;
+    metric.insert("name", enumValueName(String));
+    metric.insert("help", enumValueName(String));
+    metric.insert("type", enumValueName(String));
+    metric.insert("o:labelName", enumValueName(String));
+    metric.insert("samples", QVariantList() << objectRef("MetricSample"));
+    registerObject("Metric", metric);
+
+    QVariantMap memorySubsystem;
+    memorySubsystem.insert("name", enumValueName(String));
+    memorySubsystem.insert("objects", enumValueName(Int));
+    memorySubsystem.insert("bytes", enumValueName(Int));
+    registerObject("MemorySubsystem", memorySubsystem);
+
+    QVariantMap memorySnapshot;
+    memorySnapshot.insert("timestamp", enumValueName(Uint));
+    memorySnapshot.insert("residentBytes", enumValueName(Int));
+    memorySnapshot.insert("subsystems", QVariantList() << objectRef("MemorySubsystem"));
+    registerObject("MemorySnapshot", memorySnapshot);
+
+    QVariantMap allocationSite;
+    allocationSite.insert("stack", enumValueName(StringList));
+    allocationSite.insert("samples", enumValueName(Uint));
+    allocationSite.insert("liveSamples", enumValueName(Uint));
+    allocationSite.insert("estimatedBytes", enumValueName(Uint));
+    allocationSite.insert("estimatedLiveBytes", enumValueName(Uint));
+    registerObject("AllocationSite", allocationSite);
+
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
     description = "Get the list of capabilites on this system. The property \"powerManagement\" indicates whether "
@@ -168,6 +212,43 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     returns.insert("timeZones", enumValueName(StringList));
     registerMethod("GetTimeZones", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the runtime metrics of the server. The \"type\" of a metric is either \"counter\", \"gauge\" or \"histogram\". "
+                  "Counters and gauges have a \"value\" per sample, histograms have \"count\", \"sum\" and cumulative \"buckets\". "
+                  "Durations are given in seconds. If a metric has a \"labelName\", each sample carries the \"labelValue\" it "
+                  "has been recorded for, e.g. the JSON-RPC method. The same data is available in the Prometheus text format "
+                  "on the /metrics path of the web server when the debug server is enabled.";
+    returns.insert("metrics", QVariantList() << objectRef("Metric"));
+    registerMethod("GetMetrics", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Get the memory usage of the server. \"subsystems\" lists the live objects and the approximate bytes held "
+                  "by the long lived structures of the server right now, \"bytes\" is 0 where a subsystem can't tell. "
+                  "Snapshots of the same are taken every \"snapshotInterval\" seconds, \"growing\" names the subsystems "
+                  "which never shrank but grew over all kept snapshots, \"process\" being the resident memory of the process. "
+                  "If allocation sampling is enabled, \"allocationSites\" lists the call stacks holding most of the sampled "
+                  "memory. See also SetAllocationSampling.";
+    returns.insert("timestamp", enumValueName(Uint));
+    returns.insert("residentBytes", enumValueName(Int));
+    returns.insert("subsystems", QVariantList() << objectRef("MemorySubsystem"));
+    returns.insert("snapshots", QVariantList() << objectRef("MemorySnapshot"));
+    returns.insert("snapshotInterval", enumValueName(Int));
+    returns.insert("growing", enumValueName(StringList));
+    returns.insert("allocationSamplingInterval", enumValueName(Uint));
+    returns.insert("sampledLiveBytes", enumValueName(Uint));
+    returns.insert("allocationSites", QVariantList() << objectRef("AllocationSite"));
+    registerMethod("GetMemoryUsage", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Enable or disable sampling of heap allocations at runtime. One allocation is sampled every \"interval\" "
+                  "bytes allocated, 0 disables sampling. Sampling costs CPU time and memory while enabled, intervals of a few "
+                  "hundred kilobytes are a good start. Sampled allocations still alive are tracked after disabling sampling, "
+                  "unless \"reset\" is true which drops all collected samples. Only objects created with new are sampled. "
+                  "Memory allocated with malloc, which includes the contents of strings, byte arrays, lists and hashes, is not seen.";
+    params.insert("interval", enumValueName(Uint));
+    params.insert("o:reset", enumValueName(Bool));
+    registerMethod("SetAllocationSampling", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever the system capabilities change.";
@@ -446,6 +527,29 @@ JsonReply *SystemHandler::GetTimeZones(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *SystemHandler::GetMetrics(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    QVariantMap returns;
+    returns.insert("metrics", MetricsRegistry::instance()->toVariantList());
+    return createReply(returns);
+}
+
+JsonReply *SystemHandler::GetMemoryUsage(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    return createReply(MemoryAccounting::instance()->toVariantMap());
+}
+
+JsonReply *SystemHandler::SetAllocationSampling(const QVariantMap &params) const
+{
+    if (params.value("reset", false).toBool()) {
+        AllocationSampler::reset();
+    }
+    AllocationSampler::setSamplingInterval(params.value("interval").toInt());
+    return createReply(QVariantMap());
+}
+
 void SystemHandler::onCapabilitiesChanged()
 {
     QVariantMap caps;
@@ -68,6 +68,10 @@ public:
     Q_INVOKABLE JsonReply *SetTime(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *GetTimeZones(const QVariantMap &params) const;
 
+    Q_INVOKABLE JsonReply *GetMetrics(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *GetMemoryUsage(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *SetAllocationSampling(const QVariantMap &params) const;
+
 signals:
     void CapabilitiesChanged(const QVariantMap &params);
 
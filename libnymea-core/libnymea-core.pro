@@ -3,9 +3,9 @@ TARGET = nymea-core
 
 include(../nymea.pri)
 
-QT += sql qml
+QT += sql qml concurrent
 INCLUDEPATH += $$top_srcdir/libnymea $$top_builddir
-LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto
+LIBS += -L$$top_builddir/libnymea/ -lnymea -lssl -lcrypto -lz
 
 CONFIG += link_pkgconfig
 PKGCONFIG += nymea-mqtt nymea-networkmanager
@@ -38,6 +38,8 @@ RESOURCES += $$top_srcdir/icons.qrc \
 HEADERS += nymeacore.h \
     integrations/apikeysprovidersloader.h \
     integrations/plugininfocache.h \
+    integrations/thingchangejournal.h \
+    integrations/statechangebus.h \
     integrations/python/pynymealogginghandler.h \
     integrations/python/pynymeamodule.h \
     integrations/python/pyparam.h \
@@ -58,6 +60,7 @@ HEADERS += nymeacore.h \
     ruleengine/stateevaluator.h \
     ruleengine/ruleaction.h \
     ruleengine/ruleactionparam.h \
+    ruleengine/ruleactionexecutor.h \
     scriptengine/script.h \
     scriptengine/scriptaction.h \
     scriptengine/scriptalarm.h \
@@ -70,6 +73,7 @@ HEADERS += nymeacore.h \
     nymeaconfiguration.h \
     servermanager.h \
     servers/tcpserver.h \
+    servers/deflatestream.h \
     servers/mocktcpserver.h \
     servers/webserver.h \
     servers/httprequest.h \
@@ -77,8 +81,14 @@ HEADERS += nymeacore.h \
     servers/bluetoothserver.h \
     servers/websocketserver.h \
     servers/mqttbroker.h \
+    servers/mqtttopicmatcher.h \
     jsonrpc/jsonrpcserverimplementation.h \
+    jsonrpc/jsonrpcframer.h \
     jsonrpc/jsonvalidator.h \
+    jsonrpc/cborcodec.h \
+    jsonrpc/notificationsubscriptions.h \
+    jsonrpc/notificationthrottle.h \
+    jsonrpc/replycache.h \
     jsonrpc/integrationshandler.h \
     jsonrpc/devicehandler.h \
     jsonrpc/ruleshandler.h \
@@ -97,6 +107,13 @@ HEADERS += nymeacore.h \
     logging/logfilter.h \
     logging/logentry.h \
     logging/logvaluetool.h \
+    logging/statelogpolicy.h \
+    logging/statelogfilter.h \
+    diagnostics/metricsregistry.h \
+    diagnostics/eventloopmonitor.h \
+    diagnostics/tracer.h \
+    diagnostics/memoryaccounting.h \
+    diagnostics/allocationsampler.h \
     time/timemanager.h \
     usermanager/userinfo.h \
     usermanager/usermanager.h \
@@ -132,6 +149,8 @@ HEADERS += nymeacore.h \
 SOURCES += nymeacore.cpp \
     integrations/apikeysprovidersloader.cpp \
     integrations/plugininfocache.cpp \
+    integrations/thingchangejournal.cpp \
+    integrations/statechangebus.cpp \
     integrations/thingmanagerimplementation.cpp \
     integrations/translator.cpp \
     integrations/pythonintegrationplugin.cpp \
@@ -141,6 +160,7 @@ SOURCES += nymeacore.cpp \
     ruleengine/stateevaluator.cpp \
     ruleengine/ruleaction.cpp \
     ruleengine/ruleactionparam.cpp \
+    ruleengine/ruleactionexecutor.cpp \
     scriptengine/script.cpp \
     scriptengine/scriptaction.cpp \
     scriptengine/scriptalarm.cpp \
@@ -153,6 +173,7 @@ SOURCES += nymeacore.cpp \
     nymeaconfiguration.cpp \
     servermanager.cpp \
     servers/tcpserver.cpp \
+    servers/deflatestream.cpp \
     servers/mocktcpserver.cpp \
     servers/webserver.cpp \
     servers/httprequest.cpp \
@@ -160,8 +181,14 @@ SOURCES += nymeacore.cpp \
     servers/websocketserver.cpp \
     servers/bluetoothserver.cpp \
     servers/mqttbroker.cpp \
+    servers/mqtttopicmatcher.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
+    jsonrpc/jsonrpcframer.cpp \
     jsonrpc/jsonvalidator.cpp \
+    jsonrpc/cborcodec.cpp \
+    jsonrpc/notificationsubscriptions.cpp \
+    jsonrpc/notificationthrottle.cpp \
+    jsonrpc/replycache.cpp \
     jsonrpc/integrationshandler.cpp \
     jsonrpc/devicehandler.cpp \
     jsonrpc/ruleshandler.cpp \
@@ -179,6 +206,13 @@ SOURCES += nymeacore.cpp \
     logging/logfilter.cpp \
     logging/logentry.cpp \
     logging/logvaluetool.cpp \
+    logging/statelogpolicy.cpp \
+    logging/statelogfilter.cpp \
+    diagnostics/metricsregistry.cpp \
+    diagnostics/eventloopmonitor.cpp \
+    diagnostics/tracer.cpp \
+    diagnostics/memoryaccounting.cpp \
+    diagnostics/allocationsampler.cpp \
     time/timemanager.cpp \
     usermanager/userinfo.cpp \
     usermanager/usermanager.cpp \
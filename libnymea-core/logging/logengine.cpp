@@ -33,6 +33,8 @@
 #include "loggingcategories.h"
 #include "logging.h"
 #include "logvaluetool.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include <QCoreApplication>
 #include <QSqlDatabase>
@@ -68,6 +70,33 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
     m_trimSize = qRound(0.01 * m_dbMaxSize);
     m_maxQueueLength = 1000;
 
+    MetricsRegistry *metrics = MetricsRegistry::instance();
+    metrics->registerGauge("nymea_logengine_queue_depth", "Database jobs waiting in the log engine queue");
+    metrics->registerCounter("nymea_logengine_dropped_jobs_total", "Log entries discarded because of log flooding");
+    metrics->registerHistogram("nymea_logengine_commit_duration_seconds", "Time the log database takes to execute a job", MetricsRegistry::latencyBuckets(), 0.000001);
+    m_queueDepthMetric = metrics->gauge("nymea_logengine_queue_depth");
+    m_droppedJobsMetric = metrics->counter("nymea_logengine_dropped_jobs_total");
+    m_commitDurationMetric = metrics->histogram("nymea_logengine_commit_duration_seconds");
+
+    if (MemoryAccounting *memoryAccounting = MemoryAccounting::instance()) {
+        memoryAccounting->addProbe("logengine.queue", this, [this](){
+            MemoryAccounting::Usage usage;
+            foreach (DatabaseJob *job, m_jobQueue) {
+                usage.objects++;
+                usage.bytes += job->approximateSize();
+            }
+            return usage;
+        });
+        memoryAccounting->addProbe("logengine.jobs", this, [](){
+            MemoryAccounting::Usage usage;
+            usage.objects = DatabaseJob::liveJobs();
+            return usage;
+        });
+    }
+
+    m_stateLogFilter = new StateLogFilter(this);
+    connect(m_stateLogFilter, &StateLogFilter::sampleReleased, this, &LogEngine::appendEventEntry);
+
     qCDebug(dcLogEngine) << "Opening logging database" << m_db.databaseName() << "(Max size:" << m_dbMaxSize << "trim size:" << m_trimSize << ")";
 
     if (!m_db.isValid()) {
@@ -92,6 +121,9 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
 
 LogEngine::~LogEngine()
 {
+    // Write held back state samples so the log ends with the latest values
+    m_stateLogFilter->flush();
+
     // Process the job queue before allowing to shut down
     while (m_currentJob) {
         qCDebug(dcLogEngine()) << "Waiting for job to finish... (" << m_jobQueue.count() << "jobs left in queue)";
@@ -221,6 +253,20 @@ void LogEngine::logSystemEvent(const QDateTime &dateTime, bool active, Logging::
 }
 
 void LogEngine::logEvent(const Event &event)
+{
+    appendEventEntry(event, QDateTime::currentDateTime());
+}
+
+void LogEngine::logStateChange(const ThingClassId &thingClassId, const Event &event)
+{
+    // Filter before anything else happens, suppressed changes should be as cheap as possible
+    if (!m_stateLogFilter->accept(thingClassId, event)) {
+        return;
+    }
+    appendEventEntry(event, QDateTime::currentDateTime());
+}
+
+void LogEngine::appendEventEntry(const Event &event, const QDateTime &timestamp)
 {
     QVariantList valueList;
     Logging::LoggingSource sourceType;
@@ -238,7 +284,7 @@ void LogEngine::logEvent(const Event &event)
         }
     }
 
-    LogEntry entry(sourceType);
+    LogEntry entry(timestamp, Logging::LoggingLevelInfo, sourceType);
     entry.setTypeId(event.eventTypeId());
     entry.setThingId(event.thingId());
     if (valueList.count() == 1) {
@@ -312,17 +358,42 @@ void LogEngine::logRuleEnabledChanged(const Rule &rule, const bool &enabled)
     appendLogEntry(entry);
 }
 
-void LogEngine::logRuleActionsExecuted(const Rule &rule)
+// The errors of failed rule actions are summed up in the value, the first one is used as error code.
+// Which things failed is logged with the action entries.
+static LogEntry ruleActionsEntry(const QList<RuleActionError> &errors)
 {
-    LogEntry entry(Logging::LoggingSourceRules);
+    if (errors.isEmpty()) {
+        return LogEntry(Logging::LoggingSourceRules);
+    }
+    LogEntry entry(Logging::LoggingLevelAlert, Logging::LoggingSourceRules, errors.first().status);
+    QList<int> statuses;
+    QHash<int, int> counts;
+    foreach (const RuleActionError &error, errors) {
+        if (!counts.contains(error.status)) {
+            statuses.append(error.status);
+        }
+        counts[error.status]++;
+    }
+    QMetaEnum thingErrors = QMetaEnum::fromType<Thing::ThingError>();
+    QVariantList value;
+    foreach (int status, statuses) {
+        value.append(QString("%1 x%2").arg(thingErrors.valueToKey(status)).arg(counts.value(status)));
+    }
+    entry.setValue(value);
+    return entry;
+}
+
+void LogEngine::logRuleActionsExecuted(const Rule &rule, const QList<RuleActionError> &errors)
+{
+    LogEntry entry = ruleActionsEntry(errors);
     entry.setTypeId(rule.id());
     entry.setEventType(Logging::LoggingEventTypeActionsExecuted);
     appendLogEntry(entry);
 }
 
-void LogEngine::logRuleExitActionsExecuted(const Rule &rule)
+void LogEngine::logRuleExitActionsExecuted(const Rule &rule, const QList<RuleActionError> &errors)
 {
-    LogEntry entry(Logging::LoggingSourceRules);
+    LogEntry entry = ruleActionsEntry(errors);
     entry.setTypeId(rule.id());
     entry.setEventType(Logging::LoggingEventTypeExitActionsExecuted);
     appendLogEntry(entry);
@@ -330,6 +401,8 @@ void LogEngine::logRuleExitActionsExecuted(const Rule &rule)
 
 void LogEngine::removeThingLogs(const ThingId &thingId)
 {
+    m_stateLogFilter->removeThing(thingId);
+
     qCDebug(dcLogEngine) << "Deleting log entries from device" << thingId.toString();
 
     QString queryDeleteString = QString("DELETE FROM entries WHERE thingId = '%1';").arg(thingId.toString());
@@ -370,6 +443,11 @@ void LogEngine::removeRuleLogs(const RuleId &ruleId)
     enqueJob(job);
 }
 
+StateLogFilter *LogEngine::stateLogFilter() const
+{
+    return m_stateLogFilter;
+}
+
 void LogEngine::appendLogEntry(const LogEntry &entry)
 {
     qCDebug(dcLogEngine()) << "Adding log entry:" << entry;
@@ -399,6 +477,7 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
                 DatabaseJob *job = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
                 int jobIdx = m_jobQueue.indexOf(job);
                 m_jobQueue.takeAt(jobIdx)->deleteLater();
+                m_droppedJobsMetric->increment();
             }
         }
         m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(job);
@@ -472,6 +551,8 @@ void LogEngine::enqueJob(DatabaseJob *job, bool priority)
     } else {
         m_jobQueue.append(job);
     }
+    m_queueDepthMetric->set(m_jobQueue.count());
+    job->m_queueSpan = AsyncTraceSpan::begin("LogEngine::queued", "logengine");
     qCDebug(dcLogEngine()) << "Scheduled job at position" << (priority ? 0 : m_jobQueue.count() - 1) << "(" << m_jobQueue.count() << "jobs in the queue)";
     processQueue();
 }
@@ -503,8 +584,11 @@ void LogEngine::processQueue()
 
 
     DatabaseJob *job = m_jobQueue.takeFirst();
+    m_queueDepthMetric->set(m_jobQueue.count());
     qCDebug(dcLogEngine()) << "Processing DB queue. (" << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
     m_currentJob = job;
+    job->m_queueSpan.end();
+    job->m_commitSpan = AsyncTraceSpan::begin("LogEngine::commit", "logengine", job->m_queueSpan.context());
 
     QFuture<DatabaseJob*> future = QtConcurrent::run([job](){
         QSqlQuery query(job->m_db);
@@ -528,12 +612,15 @@ void LogEngine::processQueue()
        return job;
     });
 
+    m_jobTimer.start();
     m_jobWatcher.setFuture(future);
 }
 
 void LogEngine::handleJobFinished()
 {
     DatabaseJob *job = m_jobWatcher.result();
+    m_commitDurationMetric->observe(m_jobTimer.nsecsElapsed() / 1000);
+    job->m_commitSpan.end();
     job->finished();
     job->deleteLater();
     m_currentJob = nullptr;
@@ -797,4 +884,20 @@ bool LogEngine::initDB(const QString &username, const QString &password)
     return true;
 }
 
+qint64 DatabaseJob::approximateSize() const
+{
+    qint64 size = sizeof(DatabaseJob) + m_queryString.capacity() * sizeof(QChar);
+    foreach (const QVariant &value, m_bindValues) {
+        size += sizeof(QVariant);
+        if (value.type() == QVariant::String) {
+            size += value.toString().size() * sizeof(QChar);
+        } else if (value.type() == QVariant::ByteArray) {
+            size += value.toByteArray().size();
+        }
+    }
+    return size;
+}
+
+QAtomicInt DatabaseJob::s_liveJobs;
+
 }
@@ -33,11 +33,14 @@
 
 #include "logentry.h"
 #include "logfilter.h"
+#include "statelogfilter.h"
 #include "types/event.h"
 #include "types/action.h"
 #include "types/browseritemaction.h"
 #include "types/browseraction.h"
 #include "ruleengine/rule.h"
+#include "ruleengine/ruleactionexecutor.h"
+#include "diagnostics/tracer.h"
 
 #include <QObject>
 #include <QSqlDatabase>
@@ -46,12 +49,17 @@
 #include <QSqlRecord>
 #include <QTimer>
 #include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QAtomicInt>
 
 namespace nymeaserver {
 
 class DatabaseJob;
 class LogEntriesFetchJob;
 class ThingsFetchJob;
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
 
 class LogEngine: public QObject
 {
@@ -70,17 +78,21 @@ public:
 
     void logSystemEvent(const QDateTime &dateTime, bool active, Logging::LoggingLevel level = Logging::LoggingLevelInfo);
     void logEvent(const Event &event);
+    // Like logEvent, but subject to the state logging policies
+    void logStateChange(const ThingClassId &thingClassId, const Event &event);
     void logAction(const Action &action, Logging::LoggingLevel level = Logging::LoggingLevelInfo, int errorCode = 0);
     void logBrowserAction(const BrowserAction &browserAction, Logging::LoggingLevel level = Logging::LoggingLevelInfo, int errorCode = 0);
     void logBrowserItemAction(const BrowserItemAction &browserItemAction, Logging::LoggingLevel level = Logging::LoggingLevelInfo, int errorCode = 0);
     void logRuleTriggered(const Rule &rule);
     void logRuleActiveChanged(const Rule &rule);
     void logRuleEnabledChanged(const Rule &rule, const bool &enabled);
-    void logRuleActionsExecuted(const Rule &rule);
-    void logRuleExitActionsExecuted(const Rule &rule);
+    void logRuleActionsExecuted(const Rule &rule, const QList<RuleActionError> &errors);
+    void logRuleExitActionsExecuted(const Rule &rule, const QList<RuleActionError> &errors);
     void removeThingLogs(const ThingId &thingId);
     void removeRuleLogs(const RuleId &ruleId);
 
+    StateLogFilter *stateLogFilter() const;
+
 signals:
     void logEntryAdded(const LogEntry &logEntry);
     void logDatabaseUpdated();
@@ -90,6 +102,7 @@ signals:
 private:
     bool initDB(const QString &username, const QString &password);
     void appendLogEntry(const LogEntry &entry);
+    void appendEventEntry(const Event &event, const QDateTime &timestamp);
     void rotate(const QString &dbName);
 
     bool migrateDatabaseVersion3to4();
@@ -118,9 +131,16 @@ private:
     int m_maxQueueLength;
     QHash<QString, QList<DatabaseJob*>> m_flaggedJobs;
 
+    StateLogFilter *m_stateLogFilter = nullptr;
+
     QList<DatabaseJob*> m_jobQueue;
     DatabaseJob *m_currentJob = nullptr;
     QFutureWatcher<DatabaseJob*> m_jobWatcher;
+    QElapsedTimer m_jobTimer;
+
+    MetricGauge *m_queueDepthMetric = nullptr;
+    MetricCounter *m_droppedJobsMetric = nullptr;
+    MetricHistogram *m_commitDurationMetric = nullptr;
 };
 
 class DatabaseJob: public QObject
@@ -132,8 +152,16 @@ public:
         m_queryString(queryString),
         m_bindValues(bindValues)
     {
+        s_liveJobs.ref();
+    }
+    ~DatabaseJob() override
+    {
+        s_liveJobs.deref();
     }
 
+    // Including finished jobs waiting to be deleted
+    static int liveJobs() { return s_liveJobs.load(); }
+
     QString executedQuery() const { return m_executedQuery; }
     QSqlError error() const { return m_error; }
     QList<QSqlRecord> results() const { return m_results; }
@@ -150,6 +178,13 @@ private:
     QSqlError m_error;
     QList<QSqlRecord> m_results;
 
+    AsyncTraceSpan m_queueSpan;
+    AsyncTraceSpan m_commitSpan;
+
+    qint64 approximateSize() const;
+
+    static QAtomicInt s_liveJobs;
+
     friend class LogEngine;
 };
 
@@ -76,7 +76,7 @@ public:
     ThingId thingId() const;
     void setThingId(const ThingId &thingId);
 
-    // Valid for LoggingSourceStates, LoggingSourceBrowserActions
+    // Valid for LoggingSourceStates, LoggingSourceBrowserActions and failed rule actions
     QVariant value() const;
     void setValue(const QVariant &value);
 
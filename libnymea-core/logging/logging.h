@@ -43,7 +43,9 @@ public:
     enum LoggingError {
         LoggingErrorNoError,
         LoggingErrorLogEntryNotFound,
-        LoggingErrorInvalidFilterParameter
+        LoggingErrorInvalidFilterParameter,
+        LoggingErrorInvalidPolicy,
+        LoggingErrorPolicyNotFound
     };
     Q_ENUM(LoggingError)
 
@@ -74,6 +76,14 @@ public:
     };
     Q_ENUM(LoggingEventType)
 
+    enum StateLoggingMode {
+        StateLoggingModeOff,
+        StateLoggingModeOnChange,
+        StateLoggingModeAbsoluteDeadband,
+        StateLoggingModeRelativeDeadband
+    };
+    Q_ENUM(StateLoggingMode)
+
     Logging(QObject *parent = nullptr);
 };
 
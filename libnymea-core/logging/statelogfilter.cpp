@@ -0,0 +1,331 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::StateLogFilter
+    \brief Decides which state changes are written to the log database.
+
+    \ingroup logs
+    \inmodule core
+
+    The \l{StateLogFilter} evaluates the configured \l{StateLogPolicy}{StateLogPolicies} for each state change
+    before the \l{LogEngine} creates a database job for it. Suppressed values can be held back and written
+    later (sample and hold) so the log still ends with the latest value of a state.
+
+    \sa StateLogPolicy, LogEngine
+*/
+
+#include "statelogfilter.h"
+#include "nymeasettings.h"
+#include "loggingcategories.h"
+
+#include <QDateTime>
+
+namespace nymeaserver {
+
+// How long a value held back by the deadband is kept at most if the policy has no minimum interval
+static const qint64 defaultHoldInterval = 15 * 60 * 1000;
+
+StateLogFilter::StateLogFilter(QObject *parent) :
+    QObject(parent)
+{
+    m_releaseTimer.setSingleShot(true);
+    connect(&m_releaseTimer, &QTimer::timeout, this, &StateLogFilter::releaseDueSamples);
+
+    loadPolicies();
+}
+
+StateLogPolicies StateLogFilter::policies() const
+{
+    return m_policies;
+}
+
+Logging::LoggingError StateLogFilter::setPolicy(const StateLogPolicy &policy)
+{
+    if (!policy.isValid()) {
+        return Logging::LoggingErrorInvalidPolicy;
+    }
+
+    bool replaced = false;
+    for (int i = 0; i < m_policies.count(); i++) {
+        if (m_policies.at(i).hasSameScope(policy)) {
+            m_policies[i] = policy;
+            replaced = true;
+            break;
+        }
+    }
+    if (!replaced) {
+        m_policies.append(policy);
+    }
+    m_policyRevision++;
+    storePolicies();
+    qCDebug(dcLogEngine()) << "State logging policy set for thing class" << policy.thingClassId() << "thing" << policy.thingId() << "state type" << policy.stateTypeId() << "mode:" << policy.mode();
+    return Logging::LoggingErrorNoError;
+}
+
+Logging::LoggingError StateLogFilter::removePolicy(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    StateLogPolicy scope;
+    scope.setThingClassId(thingClassId);
+    scope.setThingId(thingId);
+    scope.setStateTypeId(stateTypeId);
+    for (int i = 0; i < m_policies.count(); i++) {
+        if (m_policies.at(i).hasSameScope(scope)) {
+            m_policies.removeAt(i);
+            m_policyRevision++;
+            storePolicies();
+            return Logging::LoggingErrorNoError;
+        }
+    }
+    return Logging::LoggingErrorPolicyNotFound;
+}
+
+bool StateLogFilter::accept(const ThingClassId &thingClassId, const Event &event)
+{
+    m_statistics.evaluated++;
+
+    // Nothing configured, log every change without keeping track of them
+    if (m_policies.isEmpty() && m_tracks.isEmpty()) {
+        m_statistics.written++;
+        return true;
+    }
+
+    StateTypeId stateTypeId(event.eventTypeId());
+    Track &track = m_tracks[qMakePair(event.thingId(), stateTypeId)];
+    if (track.policyRevision != m_policyRevision) {
+        track.policy = resolvePolicy(thingClassId, event.thingId(), stateTypeId);
+        track.policyRevision = m_policyRevision;
+    }
+    const StateLogPolicy &policy = track.policy;
+
+    if (policy.mode() == Logging::StateLoggingModeOff) {
+        m_statistics.suppressedOff++;
+        return false;
+    }
+
+    QVariant value = event.params().isEmpty() ? QVariant() : event.params().first().value();
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    if (track.lastValue.isValid() && !exceedsDeadband(policy, track.lastValue, value)) {
+        m_statistics.suppressedDeadband++;
+        if (policy.sampleAndHold()) {
+            // Like rate limited samples, written once the interval since the last written value has passed
+            qint64 holdInterval = policy.minimumInterval() > 0 ? policy.minimumInterval() : defaultHoldInterval;
+            hold(track, event, now, track.held ? track.releaseAt : qMax(track.lastTimestamp + holdInterval, now));
+        }
+        return false;
+    }
+
+    if (policy.minimumInterval() > 0 && track.lastTimestamp > 0 && now - track.lastTimestamp < policy.minimumInterval()) {
+        m_statistics.suppressedInterval++;
+        if (policy.sampleAndHold()) {
+            hold(track, event, now, track.lastTimestamp + policy.minimumInterval());
+        }
+        return false;
+    }
+
+    track.lastValue = value;
+    track.lastTimestamp = now;
+    track.held = false;
+    track.heldEvent = Event();
+    m_statistics.written++;
+    return true;
+}
+
+void StateLogFilter::flush()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (QHash<QPair<ThingId, StateTypeId>, Track>::iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        if (it.value().held) {
+            release(it.value(), now);
+        }
+    }
+    m_releaseTimer.stop();
+    m_nextRelease = 0;
+}
+
+void StateLogFilter::removeThing(const ThingId &thingId)
+{
+    for (QHash<QPair<ThingId, StateTypeId>, Track>::iterator it = m_tracks.begin(); it != m_tracks.end(); ) {
+        if (it.key().first == thingId) {
+            it = m_tracks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    bool changed = false;
+    for (int i = m_policies.count() - 1; i >= 0; i--) {
+        if (m_policies.at(i).thingId() == thingId) {
+            m_policies.removeAt(i);
+            changed = true;
+        }
+    }
+    if (changed) {
+        m_policyRevision++;
+        storePolicies();
+    }
+}
+
+StateLogFilter::Statistics StateLogFilter::statistics() const
+{
+    return m_statistics;
+}
+
+void StateLogFilter::releaseDueSamples()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_nextRelease = 0;
+    for (QHash<QPair<ThingId, StateTypeId>, Track>::iterator it = m_tracks.begin(); it != m_tracks.end(); ++it) {
+        Track &track = it.value();
+        if (!track.held || track.releaseAt == 0) {
+            continue;
+        }
+        if (track.releaseAt <= now) {
+            release(track, now);
+        } else {
+            scheduleRelease(track.releaseAt, now);
+        }
+    }
+}
+
+StateLogPolicy StateLogFilter::resolvePolicy(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    // Defaults to logging every change
+    StateLogPolicy ret;
+    int bestScore = -1;
+    foreach (const StateLogPolicy &policy, m_policies) {
+        int score = policy.matchScore(thingClassId, thingId, stateTypeId);
+        if (score > bestScore) {
+            ret = policy;
+            bestScore = score;
+        }
+    }
+    return ret;
+}
+
+bool StateLogFilter::exceedsDeadband(const StateLogPolicy &policy, const QVariant &lastValue, const QVariant &value)
+{
+    bool numeric = false;
+    switch (value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+        numeric = true;
+        break;
+    default:
+        break;
+    }
+
+    if (!numeric || policy.mode() == Logging::StateLoggingModeOnChange) {
+        return value != lastValue;
+    }
+
+    double difference = qAbs(value.toDouble() - lastValue.toDouble());
+    if (policy.mode() == Logging::StateLoggingModeRelativeDeadband) {
+        return difference > qAbs(lastValue.toDouble()) * policy.deadband() / 100;
+    }
+    return difference > policy.deadband();
+}
+
+void StateLogFilter::hold(Track &track, const Event &event, qint64 now, qint64 releaseAt)
+{
+    track.held = true;
+    track.heldEvent = event;
+    track.heldTimestamp = now;
+    track.releaseAt = releaseAt;
+    if (releaseAt > 0) {
+        scheduleRelease(releaseAt, now);
+    }
+}
+
+void StateLogFilter::release(Track &track, qint64 now)
+{
+    track.held = false;
+    track.lastValue = track.heldEvent.params().isEmpty() ? QVariant() : track.heldEvent.params().first().value();
+    track.lastTimestamp = now;
+    m_statistics.released++;
+    emit sampleReleased(track.heldEvent, QDateTime::fromMSecsSinceEpoch(track.heldTimestamp));
+    track.heldEvent = Event();
+}
+
+void StateLogFilter::scheduleRelease(qint64 releaseAt, qint64 now)
+{
+    if (m_nextRelease != 0 && m_nextRelease <= releaseAt && m_releaseTimer.isActive()) {
+        return;
+    }
+    m_nextRelease = releaseAt;
+    m_releaseTimer.start(static_cast<int>(qMax(releaseAt - now, static_cast<qint64>(0))));
+}
+
+void StateLogFilter::loadPolicies()
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("StateLoggingPolicies");
+    foreach (const QString &group, settings.childGroups()) {
+        settings.beginGroup(group);
+        StateLogPolicy policy;
+        policy.setThingClassId(ThingClassId(settings.value("thingClassId").toString()));
+        policy.setThingId(ThingId(settings.value("thingId").toString()));
+        policy.setStateTypeId(StateTypeId(settings.value("stateTypeId").toString()));
+        policy.setMode(static_cast<Logging::StateLoggingMode>(settings.value("mode", Logging::StateLoggingModeOnChange).toInt()));
+        policy.setDeadband(settings.value("deadband", 0).toDouble());
+        policy.setMinimumInterval(settings.value("minimumInterval", 0).toUInt());
+        policy.setSampleAndHold(settings.value("sampleAndHold", false).toBool());
+        m_policies.append(policy);
+        settings.endGroup();
+    }
+    settings.endGroup();
+    qCDebug(dcLogEngine()) << "Loaded" << m_policies.count() << "state logging policies";
+}
+
+void StateLogFilter::storePolicies()
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.remove("StateLoggingPolicies");
+    settings.beginGroup("StateLoggingPolicies");
+    for (int i = 0; i < m_policies.count(); i++) {
+        const StateLogPolicy &policy = m_policies.at(i);
+        settings.beginGroup(QString::number(i));
+        settings.setValue("thingClassId", policy.thingClassId().toString());
+        settings.setValue("thingId", policy.thingId().toString());
+        settings.setValue("stateTypeId", policy.stateTypeId().toString());
+        settings.setValue("mode", policy.mode());
+        settings.setValue("deadband", policy.deadband());
+        settings.setValue("minimumInterval", policy.minimumInterval());
+        settings.setValue("sampleAndHold", policy.sampleAndHold());
+        settings.endGroup();
+    }
+    settings.endGroup();
+}
+
+}
@@ -0,0 +1,119 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATELOGFILTER_H
+#define STATELOGFILTER_H
+
+#include "statelogpolicy.h"
+#include "types/event.h"
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+namespace nymeaserver {
+
+class StateLogFilter : public QObject
+{
+    Q_OBJECT
+public:
+    class Statistics
+    {
+    public:
+        quint64 evaluated = 0;
+        quint64 written = 0;
+        quint64 suppressedOff = 0;
+        quint64 suppressedDeadband = 0;
+        quint64 suppressedInterval = 0;
+        // Held samples written later on
+        quint64 released = 0;
+    };
+
+    explicit StateLogFilter(QObject *parent = nullptr);
+
+    StateLogPolicies policies() const;
+    // Replaces any existing policy with the same scope
+    Logging::LoggingError setPolicy(const StateLogPolicy &policy);
+    Logging::LoggingError removePolicy(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId);
+
+    // Returns true if the state change event should be written to the log
+    bool accept(const ThingClassId &thingClassId, const Event &event);
+
+    // Releases all held samples, e.g. on shutdown
+    void flush();
+
+    void removeThing(const ThingId &thingId);
+
+    Statistics statistics() const;
+
+signals:
+    void sampleReleased(const Event &event, const QDateTime &timestamp);
+
+private slots:
+    void releaseDueSamples();
+
+private:
+    class Track
+    {
+    public:
+        int policyRevision = -1;
+        StateLogPolicy policy;
+        QVariant lastValue;
+        qint64 lastTimestamp = 0;
+
+        bool held = false;
+        Event heldEvent;
+        qint64 heldTimestamp = 0;
+        // When the held sample is written at the latest
+        qint64 releaseAt = 0;
+    };
+
+    StateLogPolicy resolvePolicy(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId) const;
+    static bool exceedsDeadband(const StateLogPolicy &policy, const QVariant &lastValue, const QVariant &value);
+    void hold(Track &track, const Event &event, qint64 now, qint64 releaseAt);
+    void release(Track &track, qint64 now);
+    void scheduleRelease(qint64 releaseAt, qint64 now);
+
+    void loadPolicies();
+    void storePolicies();
+
+    StateLogPolicies m_policies;
+    int m_policyRevision = 0;
+    QHash<QPair<ThingId, StateTypeId>, Track> m_tracks;
+
+    QTimer m_releaseTimer;
+    qint64 m_nextRelease = 0;
+
+    Statistics m_statistics;
+};
+
+}
+
+#endif // STATELOGFILTER_H
@@ -0,0 +1,178 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::StateLogPolicy
+    \brief Describes how state changes are written to the log database.
+
+    \ingroup logs
+    \inmodule core
+
+    A \l{StateLogPolicy} applies to all states matching its scope, given by a thing class, a thing and/or a state type.
+    If more than one policy matches a state, the most specific one is used. States without any matching policy
+    are logged on every change.
+
+    \sa StateLogFilter, LogEngine
+*/
+
+#include "statelogpolicy.h"
+
+namespace nymeaserver {
+
+StateLogPolicy::StateLogPolicy()
+{
+
+}
+
+ThingClassId StateLogPolicy::thingClassId() const
+{
+    return m_thingClassId;
+}
+
+void StateLogPolicy::setThingClassId(const ThingClassId &thingClassId)
+{
+    m_thingClassId = thingClassId;
+}
+
+ThingId StateLogPolicy::thingId() const
+{
+    return m_thingId;
+}
+
+void StateLogPolicy::setThingId(const ThingId &thingId)
+{
+    m_thingId = thingId;
+}
+
+StateTypeId StateLogPolicy::stateTypeId() const
+{
+    return m_stateTypeId;
+}
+
+void StateLogPolicy::setStateTypeId(const StateTypeId &stateTypeId)
+{
+    m_stateTypeId = stateTypeId;
+}
+
+Logging::StateLoggingMode StateLogPolicy::mode() const
+{
+    return m_mode;
+}
+
+void StateLogPolicy::setMode(Logging::StateLoggingMode mode)
+{
+    m_mode = mode;
+}
+
+double StateLogPolicy::deadband() const
+{
+    return m_deadband;
+}
+
+void StateLogPolicy::setDeadband(double deadband)
+{
+    m_deadband = deadband;
+}
+
+uint StateLogPolicy::minimumInterval() const
+{
+    return m_minimumInterval;
+}
+
+void StateLogPolicy::setMinimumInterval(uint minimumInterval)
+{
+    m_minimumInterval = minimumInterval;
+}
+
+bool StateLogPolicy::sampleAndHold() const
+{
+    return m_sampleAndHold;
+}
+
+void StateLogPolicy::setSampleAndHold(bool sampleAndHold)
+{
+    m_sampleAndHold = sampleAndHold;
+}
+
+bool StateLogPolicy::isValid() const
+{
+    return m_deadband >= 0;
+}
+
+bool StateLogPolicy::hasSameScope(const StateLogPolicy &other) const
+{
+    return m_thingClassId == other.thingClassId() && m_thingId == other.thingId() && m_stateTypeId == other.stateTypeId();
+}
+
+int StateLogPolicy::matchScore(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    int score = 0;
+    if (!m_thingId.isNull()) {
+        if (m_thingId != thingId) {
+            return -1;
+        }
+        score += 4;
+    }
+    if (!m_stateTypeId.isNull()) {
+        if (m_stateTypeId != stateTypeId) {
+            return -1;
+        }
+        score += 2;
+    }
+    if (!m_thingClassId.isNull()) {
+        if (m_thingClassId != thingClassId) {
+            return -1;
+        }
+        score += 1;
+    }
+    return score;
+}
+
+StateLogPolicies::StateLogPolicies()
+{
+
+}
+
+StateLogPolicies::StateLogPolicies(const QList<StateLogPolicy> &other): QList<StateLogPolicy>(other)
+{
+
+}
+
+QVariant StateLogPolicies::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void StateLogPolicies::put(const QVariant &variant)
+{
+    append(variant.value<StateLogPolicy>());
+}
+
+}
@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STATELOGPOLICY_H
+#define STATELOGPOLICY_H
+
+#include "logging.h"
+#include "typeutils.h"
+
+#include <QObject>
+#include <QVariant>
+
+namespace nymeaserver {
+
+class StateLogPolicy
+{
+    Q_GADGET
+    Q_PROPERTY(QUuid thingClassId READ thingClassId WRITE setThingClassId USER true)
+    Q_PROPERTY(QUuid thingId READ thingId WRITE setThingId USER true)
+    Q_PROPERTY(QUuid stateTypeId READ stateTypeId WRITE setStateTypeId USER true)
+    Q_PROPERTY(Logging::StateLoggingMode mode READ mode WRITE setMode)
+    Q_PROPERTY(double deadband READ deadband WRITE setDeadband USER true)
+    Q_PROPERTY(uint minimumInterval READ minimumInterval WRITE setMinimumInterval USER true)
+    Q_PROPERTY(bool sampleAndHold READ sampleAndHold WRITE setSampleAndHold USER true)
+
+public:
+    StateLogPolicy();
+
+    // The scope of the policy. Any of them may be null, a policy without any scope applies to all states.
+    ThingClassId thingClassId() const;
+    void setThingClassId(const ThingClassId &thingClassId);
+
+    ThingId thingId() const;
+    void setThingId(const ThingId &thingId);
+
+    StateTypeId stateTypeId() const;
+    void setStateTypeId(const StateTypeId &stateTypeId);
+
+    Logging::StateLoggingMode mode() const;
+    void setMode(Logging::StateLoggingMode mode);
+
+    // Absolute value for StateLoggingModeAbsoluteDeadband, percent of the last logged value for StateLoggingModeRelativeDeadband
+    double deadband() const;
+    void setDeadband(double deadband);
+
+    // Milliseconds
+    uint minimumInterval() const;
+    void setMinimumInterval(uint minimumInterval);
+
+    // Keep the last suppressed value and write it once the minimum interval passed, or on shutdown.
+    // Values within the deadband are held for 15 minutes at most if there is no minimum interval.
+    bool sampleAndHold() const;
+    void setSampleAndHold(bool sampleAndHold);
+
+    bool isValid() const;
+    bool hasSameScope(const StateLogPolicy &other) const;
+    // -1 if the policy doesn't apply to the given state, the more specific the scope, the higher the score
+    int matchScore(const ThingClassId &thingClassId, const ThingId &thingId, const StateTypeId &stateTypeId) const;
+
+private:
+    ThingClassId m_thingClassId;
+    ThingId m_thingId;
+    StateTypeId m_stateTypeId;
+    Logging::StateLoggingMode m_mode = Logging::StateLoggingModeOnChange;
+    double m_deadband = 0;
+    uint m_minimumInterval = 0;
+    bool m_sampleAndHold = false;
+};
+
+class StateLogPolicies: public QList<StateLogPolicy>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    StateLogPolicies();
+    StateLogPolicies(const QList<StateLogPolicy> &other);
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+
+}
+Q_DECLARE_METATYPE(nymeaserver::StateLogPolicy)
+Q_DECLARE_METATYPE(nymeaserver::StateLogPolicies)
+
+#endif // STATELOGPOLICY_H
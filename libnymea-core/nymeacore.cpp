@@ -33,6 +33,7 @@
 #include "platform/platform.h"
 #include "jsonrpc/jsonrpcserverimplementation.h"
 #include "ruleengine/ruleengine.h"
+#include "ruleengine/ruleactionexecutor.h"
 #include "nymeasettings.h"
 #include "tagging/tagsstorage.h"
 #include "platform/platform.h"
@@ -50,6 +51,11 @@
 #include "cloud/cloudmanager.h"
 #include "cloud/cloudnotifications.h"
 #include "cloud/cloudtransport.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/eventloopmonitor.h"
+#include "diagnostics/tracer.h"
+#include "diagnostics/memoryaccounting.h"
+#include "diagnostics/allocationsampler.h"
 
 #include <networkmanager.h>
 
@@ -87,6 +93,27 @@ void NymeaCore::init() {
     qCDebug(dcCore()) << "Loading nymea configurations" << NymeaSettings(NymeaSettings::SettingsRoleGlobal).fileName();
     m_configuration = new NymeaConfiguration(this);
 
+    qCDebug(dcCore()) << "Creating Event Loop Monitor";
+    m_eventLoopMonitor = new EventLoopMonitor(this);
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("EventLoopMonitor");
+    m_eventLoopMonitor->setSlowDispatchThreshold(settings.value("slowDispatchThreshold", 100).toInt());
+    m_eventLoopMonitor->setStallThreshold(settings.value("stallThreshold", 2000).toInt());
+    m_eventLoopMonitor->setPluginCpuAccounting(settings.value("pluginCpuAccounting", false).toBool());
+    settings.endGroup();
+    settings.beginGroup("Tracing");
+    Tracer::instance()->setCapacity(settings.value("capacity", 10000).toInt());
+    Tracer::instance()->setEnabled(settings.value("enabled", false).toBool());
+    settings.endGroup();
+
+    qCDebug(dcCore()) << "Creating Memory Accounting";
+    m_memoryAccounting = new MemoryAccounting(this);
+    settings.beginGroup("MemoryAccounting");
+    m_memoryAccounting->setSnapshotInterval(settings.value("snapshotInterval", 300).toInt());
+    m_memoryAccounting->setSnapshotHistory(settings.value("snapshotHistory", 48).toInt());
+    AllocationSampler::setSamplingInterval(settings.value("allocationSamplingInterval", 0).toInt());
+    settings.endGroup();
+
     qCDebug(dcCore()) << "Creating Time Manager";
     // Migration path: nymea < 0.18 doesn't use system time zone but stores its own time zone in the config
     // For migration, let's set the system's time zone to the config now to upgrade to the system time zone based nymea >= 0.18
@@ -114,6 +141,19 @@ void NymeaCore::init() {
 
     qCDebug(dcCore) << "Creating Rule Engine";
     m_ruleEngine = new RuleEngine(this);
+    m_ruleActionExecutor = new RuleActionExecutor(m_thingManager, this);
+    settings.beginGroup("RuleActions");
+    m_ruleActionExecutor->setMaxActionsPerSecond(settings.value("maxActionsPerSecond", 0).toInt());
+    settings.beginGroup("PluginMaxActionsPerSecond");
+    foreach (const QString &pluginName, settings.childKeys()) {
+        m_ruleActionExecutor->setMaxActionsPerSecond(pluginName, settings.value(pluginName).toInt());
+    }
+    settings.endGroup();
+    settings.endGroup();
+
+    MetricsRegistry *metrics = MetricsRegistry::instance();
+    metrics->registerCounter("nymea_rule_evaluations_total", "Rule engine evaluations per trigger", "trigger");
+    metrics->registerCounter("nymea_rule_matches_total", "Rules matched by the rule engine per trigger", "trigger");
 
     qCDebug(dcCore()) << "Creating Script Engine";
     m_scriptEngine = new ScriptEngine(m_thingManager, this);
@@ -146,13 +186,31 @@ void NymeaCore::init() {
 
     connect(m_thingManager, &ThingManagerImplementation::pluginConfigChanged, this, &NymeaCore::pluginConfigChanged);
     connect(m_thingManager, &ThingManagerImplementation::eventTriggered, this, &NymeaCore::gotEvent);
-    connect(m_thingManager, &ThingManagerImplementation::thingStateChanged, this, &NymeaCore::thingStateChanged);
+    // State changes are consumed from the bus, the event for them is built only once there
+    StateChangeBus *stateChangeBus = m_thingManager->stateChangeBus();
+    stateChangeBus->addConsumer("logging", this, [this](const QList<StateChange> &changes){
+        foreach (const StateChange &change, changes) {
+            m_logger->logStateChange(change.thing()->thingClassId(), change.event());
+        }
+    });
+    stateChangeBus->addConsumer("jsonrpc", this, [this](const QList<StateChange> &changes){
+        foreach (const StateChange &change, changes) {
+            m_serverManager->jsonServer()->notifyStateChanged(change);
+            emit eventTriggered(change.event());
+        }
+    });
+    stateChangeBus->addConsumer("rules", this, [this](const QList<StateChange> &changes){
+        foreach (const StateChange &change, changes) {
+            evaluateRules(change.event());
+        }
+    });
     connect(m_thingManager, &ThingManagerImplementation::thingAdded, this, &NymeaCore::thingAdded);
     connect(m_thingManager, &ThingManagerImplementation::thingChanged, this, &NymeaCore::thingChanged);
     connect(m_thingManager, &ThingManagerImplementation::thingSettingChanged, this, &NymeaCore::thingSettingChanged);
     connect(m_thingManager, &ThingManagerImplementation::thingRemoved, this, &NymeaCore::thingRemoved);
     connect(m_thingManager, &ThingManagerImplementation::thingDisappeared, this, &NymeaCore::onThingDisappeared);
     connect(m_thingManager, &ThingManagerImplementation::loaded, this, &NymeaCore::thingManagerLoaded);
+    connect(m_thingManager, &ThingManagerImplementation::pluginsChanged, this, &NymeaCore::pluginsChanged);
 
     connect(m_ruleEngine, &RuleEngine::ruleAdded, this, &NymeaCore::ruleAdded);
     connect(m_ruleEngine, &RuleEngine::ruleRemoved, this, &NymeaCore::ruleRemoved);
@@ -172,6 +230,7 @@ NymeaCore::~NymeaCore()
     // Disconnect all signals/slots, we're going down now
     m_timeManager->disconnect(this);
     m_thingManager->disconnect(this);
+    m_thingManager->stateChangeBus()->removeConsumers(this);
     m_ruleEngine->disconnect(this);
 
     // At very first, cut off the outside world
@@ -408,11 +467,22 @@ BrowserItemActionInfo *NymeaCore::executeBrowserItemAction(const BrowserItemActi
     return info;
 }
 
-/*! Execute the given \a ruleActions. */
-void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
+/*! Execute the given \a ruleActions. The returned batch finishes once all of them have finished.
+
+    \sa RuleActionExecutor
+*/
+RuleActionBatch *NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
 {
+    if (ruleActions.isEmpty()) {
+        return m_ruleActionExecutor->execute(QList<Action>(), QList<BrowserAction>());
+    }
+
+    TraceScope traceScope("NymeaCore::executeRuleActions", "rules");
+    traceScope.setArg("actions", ruleActions.count());
+
     QList<Action> actions;
     QList<BrowserAction> browserActions;
+    QHash<QString, Things> interfaceThings;
     foreach (const RuleAction &ruleAction, ruleActions) {
         if (ruleAction.type() == RuleAction::TypeThing) {
             Thing *thing = m_thingManager->findConfiguredThing(ruleAction.thingId());
@@ -458,8 +528,11 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
             BrowserAction browserAction(ruleAction.thingId(), ruleAction.browserItemId());
             browserActions.append(browserAction);
         } else {
-            Things things = m_thingManager->findConfiguredThings(ruleAction.interface());
-            foreach (Thing* thing, things) {
+            // Scenes often address the same interface with several actions
+            if (!interfaceThings.contains(ruleAction.interface())) {
+                interfaceThings.insert(ruleAction.interface(), m_thingManager->findConfiguredThings(ruleAction.interface()));
+            }
+            foreach (Thing* thing, interfaceThings.value(ruleAction.interface())) {
                 ThingClass thingClass = m_thingManager->findThingClass(thing->thingClassId());
                 ActionType actionType = thingClass.actionTypes().findByName(ruleAction.interfaceAction());
                 if (actionType.id().isNull()) {
@@ -506,24 +579,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
         }
     }
 
-    foreach (const Action &action, actions) {
-        qCDebug(dcRuleEngine) << "Executing action" << action.actionTypeId() << action.params();
-        ThingActionInfo *info = executeAction(action);
-        connect(info, &ThingActionInfo::finished, this, [info](){
-            if (info->status() != Thing::ThingErrorNoError) {
-                qCWarning(dcRuleEngine) << "Error executing action:" << info->status() << info->displayMessage();
-            }
-        });
-    }
-
-    foreach (const BrowserAction &browserAction, browserActions) {
-        BrowserActionInfo *info = executeBrowserItem(browserAction);
-        connect(info, &BrowserActionInfo::finished, this, [info](){
-            if (info->status() != Thing::ThingErrorNoError) {
-                qCWarning(dcRuleEngine) << "Error executing browser action:" << info->status();
-            }
-        });
-    }
+    return m_ruleActionExecutor->execute(actions, browserActions);
 }
 
 /*! Calls the metheod RuleEngine::removeRule(\a id).
@@ -639,6 +695,16 @@ DebugServerHandler *NymeaCore::debugServerHandler() const
     return m_debugServerHandler;
 }
 
+EventLoopMonitor *NymeaCore::eventLoopMonitor() const
+{
+    return m_eventLoopMonitor;
+}
+
+MemoryAccounting *NymeaCore::memoryAccounting() const
+{
+    return m_memoryAccounting;
+}
+
 TagsStorage *NymeaCore::tagsStorage() const
 {
     return m_tagsStorage;
@@ -651,97 +717,132 @@ Platform *NymeaCore::platform() const
 
 void NymeaCore::gotEvent(const Event &event)
 {
+    // State change events are processed by the state change bus consumers
+    if (event.isStateChangeEvent()) {
+        return;
+    }
+
+    TraceScope traceScope("NymeaCore::gotEvent", "core");
     m_logger->logEvent(event);
     emit eventTriggered(event);
+    evaluateRules(event);
+}
 
-    QList<RuleAction> actions;
-    QList<RuleAction> eventBasedActions;
-    foreach (const Rule &rule, m_ruleEngine->evaluateEvent(event)) {
+void NymeaCore::evaluateRules(const Event &event)
+{
+    QList<Rule> rules;
+    {
+        TraceScope traceScope("RuleEngine::evaluateEvent", "rules");
+        rules = m_ruleEngine->evaluateEvent(event);
+        traceScope.setArg("matches", rules.count());
+    }
+    MetricsRegistry::instance()->counter("nymea_rule_evaluations_total", "event")->increment();
+    MetricsRegistry::instance()->counter("nymea_rule_matches_total", "event")->increment(rules.count());
+
+    // All matching rules are marked as executing before any of them runs its actions
+    QList<Rule> triggeredRules;
+    QList<bool> exitActions;
+    foreach (const Rule &rule, rules) {
         if (m_executingRules.contains(rule.id())) {
             qCWarning(dcRuleEngine()) << "WARNING: Loop detected in rule execution for rule" << rule.id() << rule.name();
             break;
         }
         m_executingRules.append(rule.id());
 
+        triggeredRules.append(rule);
         // Event based
         if (!rule.eventDescriptors().isEmpty()) {
             m_logger->logRuleTriggered(rule);
-            QList<RuleAction> tmp;
             if (rule.statesActive() && rule.timeActive()) {
                 qCDebug(dcRuleEngineDebug()) << "Executing actions";
-                tmp = rule.actions();
+                exitActions.append(false);
             } else {
                 qCDebug(dcRuleEngineDebug()) << "Executing exitActions";
-                tmp = rule.exitActions();
-            }
-            // check if we have an event based action or a normal action
-            foreach (const RuleAction &action, tmp) {
-                if (action.isEventBased()) {
-                    eventBasedActions.append(action);
-                } else {
-                    actions.append(action);
-                }
+                exitActions.append(true);
             }
         } else {
             // State based rule
             m_logger->logRuleActiveChanged(rule);
             emit ruleActiveChanged(rule);
-            if (rule.active()) {
-                actions.append(rule.actions());
-            } else {
-                actions.append(rule.exitActions());
-            }
+            exitActions.append(!rule.active());
         }
     }
 
-    // Set action params, depending on the event value
-    foreach (RuleAction ruleAction, eventBasedActions) {
-        RuleActionParams newParams;
-        foreach (RuleActionParam ruleActionParam, ruleAction.ruleActionParams()) {
-            // if this event param should be taken over in this action
-            if (event.eventTypeId() == ruleActionParam.eventTypeId()) {
-                QVariant eventValue = event.params().paramValue(ruleActionParam.eventParamTypeId());
+    for (int i = 0; i < triggeredRules.count(); i++) {
+        const Rule &rule = triggeredRules.at(i);
+        QList<RuleAction> actions;
+        foreach (RuleAction ruleAction, exitActions.at(i) ? rule.exitActions() : rule.actions()) {
+            if (!ruleAction.isEventBased()) {
+                actions.append(ruleAction);
+                continue;
+            }
 
-                // TODO: limits / scale calculation -> actionValue = eventValue * x
-                //       something like a EventParamDescriptor
+            // Set action params, depending on the event value
+            RuleActionParams newParams;
+            foreach (RuleActionParam ruleActionParam, ruleAction.ruleActionParams()) {
+                // if this event param should be taken over in this action
+                if (event.eventTypeId() == ruleActionParam.eventTypeId()) {
+                    QVariant eventValue = event.params().paramValue(ruleActionParam.eventParamTypeId());
 
-                ruleActionParam.setValue(eventValue);
-                qCDebug(dcRuleEngine) << "Using param value from event:" << ruleActionParam.value();
+                    // TODO: limits / scale calculation -> actionValue = eventValue * x
+                    //       something like a EventParamDescriptor
+
+                    ruleActionParam.setValue(eventValue);
+                    qCDebug(dcRuleEngine) << "Using param value from event:" << ruleActionParam.value();
+                }
+                newParams.append(ruleActionParam);
             }
-            newParams.append(ruleActionParam);
+            ruleAction.setRuleActionParams(newParams);
+            actions.append(ruleAction);
         }
-        ruleAction.setRuleActionParams(newParams);
-        actions.append(ruleAction);
+        executeRule(rule, actions, exitActions.at(i));
     }
-
-    executeRuleActions(actions);
     m_executingRules.clear();
 }
 
+/*! Executes the \a ruleActions of the given \a rule as one batch and logs the outcome once all of them
+    have finished, as the rule's exit actions if \a exitActions is true. */
+void NymeaCore::executeRule(const Rule &rule, const QList<RuleAction> &ruleActions, bool exitActions)
+{
+    if (ruleActions.isEmpty()) {
+        return;
+    }
+
+    RuleActionBatch *batch = executeRuleActions(ruleActions);
+    connect(batch, &RuleActionBatch::finished, this, [this, rule, batch, exitActions](){
+        if (exitActions) {
+            m_logger->logRuleExitActionsExecuted(rule, batch->errors());
+        } else {
+            m_logger->logRuleActionsExecuted(rule, batch->errors());
+        }
+    });
+}
+
 void NymeaCore::onDateTimeChanged(const QDateTime &dateTime)
 {
-    QList<RuleAction> actions;
-    foreach (const Rule &rule, m_ruleEngine->evaluateTime(dateTime)) {
+    QList<Rule> rules = m_ruleEngine->evaluateTime(dateTime);
+    MetricsRegistry::instance()->counter("nymea_rule_evaluations_total", "time")->increment();
+    MetricsRegistry::instance()->counter("nymea_rule_matches_total", "time")->increment(rules.count());
+    foreach (const Rule &rule, rules) {
         // TimeEvent based
         if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
             m_logger->logRuleTriggered(rule);
             if (rule.statesActive() && rule.timeActive()) {
-                actions.append(rule.actions());
+                executeRule(rule, rule.actions(), false);
             } else {
-                actions.append(rule.exitActions());
+                executeRule(rule, rule.exitActions(), true);
             }
         } else {
             // Calendar based rule
             m_logger->logRuleActiveChanged(rule);
             emit ruleActiveChanged(rule);
             if (rule.active()) {
-                actions.append(rule.actions());
+                executeRule(rule, rule.actions(), false);
             } else {
-                actions.append(rule.exitActions());
+                executeRule(rule, rule.exitActions(), true);
             }
         }
     }
-    executeRuleActions(actions);
 }
 
 LogEngine* NymeaCore::logEngine() const
@@ -66,6 +66,10 @@ class System;
 class ExperienceManager;
 class ScriptEngine;
 class CloudManager;
+class EventLoopMonitor;
+class MemoryAccounting;
+class RuleActionExecutor;
+class RuleActionBatch;
 
 class NymeaCore : public QObject
 {
@@ -87,7 +91,7 @@ public:
     BrowserActionInfo* executeBrowserItem(const BrowserAction &browserAction);
     BrowserItemActionInfo* executeBrowserItemAction(const BrowserItemAction &browserItemAction);
 
-    void executeRuleActions(const QList<RuleAction> ruleActions);
+    RuleActionBatch *executeRuleActions(const QList<RuleAction> ruleActions);
 
     RuleEngine::RuleError removeRule(const RuleId &id);
 
@@ -104,6 +108,8 @@ public:
     UserManager *userManager() const;
     CloudManager *cloudManager() const;
     DebugServerHandler *debugServerHandler() const;
+    EventLoopMonitor *eventLoopMonitor() const;
+    MemoryAccounting *memoryAccounting() const;
     TagsStorage *tagsStorage() const;
     Platform *platform() const;
 
@@ -113,10 +119,10 @@ public:
 
 signals:
     void initialized();
+    void pluginsChanged();
 
     void pluginConfigChanged(const PluginId &id, const ParamList &config);
     void eventTriggered(const Event &event);
-    void thingStateChanged(Thing *thing, const QUuid &stateTypeId, const QVariant &value);
     void thingRemoved(const ThingId &thingId);
     void thingAdded(Thing *thing);
     void thingChanged(Thing *thing);
@@ -143,6 +149,9 @@ private:
     CloudManager *m_cloudManager;
     HardwareManagerImplementation *m_hardwareManager;
     DebugServerHandler *m_debugServerHandler;
+    EventLoopMonitor *m_eventLoopMonitor = nullptr;
+    MemoryAccounting *m_memoryAccounting = nullptr;
+    RuleActionExecutor *m_ruleActionExecutor = nullptr;
     TagsStorage *m_tagsStorage;
 
     NetworkManager *m_networkManager;
@@ -152,6 +161,9 @@ private:
 
     QList<RuleId> m_executingRules;
 
+    void evaluateRules(const Event &event);
+    void executeRule(const Rule &rule, const QList<RuleAction> &ruleActions, bool exitActions);
+
 private slots:
     void gotEvent(const Event &event);
     void onDateTimeChanged(const QDateTime &dateTime);
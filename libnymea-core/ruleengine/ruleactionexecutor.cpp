@@ -0,0 +1,331 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::RuleActionExecutor
+    \brief Executes the actions of rules.
+
+    \ingroup rules
+    \inmodule core
+
+    Actions are queued per thing. An action is only dispatched once the previous action
+    for the same thing has finished, so they arrive at the thing in the order the rules
+    requested them, while actions for different things run concurrently.
+
+    Things waiting for their next action are dispatched round robin across plugins, one
+    action per plugin and round, so a plugin with many actions to execute doesn't hold
+    back the others. The rate of dispatching actions to a plugin can optionally be limited.
+
+    The time from queueing an action until it finished is recorded per plugin.
+
+    \sa RuleActionBatch
+*/
+
+/*!
+    \class nymeaserver::RuleActionBatch
+    \brief Tracks the actions of a rule passed to the RuleActionExecutor together.
+
+    \ingroup rules
+    \inmodule core
+
+    Emits finished() once all actions of the batch finished and deletes itself afterwards.
+*/
+
+#include "ruleactionexecutor.h"
+#include "nymeacore.h"
+#include "integrations/thingmanager.h"
+#include "integrations/integrationplugin.h"
+#include "integrations/thingactioninfo.h"
+#include "integrations/browseractioninfo.h"
+#include "diagnostics/metricsregistry.h"
+#include "diagnostics/memoryaccounting.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+RuleActionBatch::RuleActionBatch(int count, QObject *parent):
+    QObject(parent),
+    m_count(count),
+    m_pending(count)
+{
+    connect(this, &RuleActionBatch::finished, this, &RuleActionBatch::deleteLater, Qt::QueuedConnection);
+    if (m_pending == 0) {
+        staticMetaObject.invokeMethod(this, "finished", Qt::QueuedConnection);
+    }
+}
+
+/*! Returns the number of actions in this batch. */
+int RuleActionBatch::count() const
+{
+    return m_count;
+}
+
+/*! Returns true once all actions of this batch have finished. */
+bool RuleActionBatch::isFinished() const
+{
+    return m_pending == 0;
+}
+
+/*! Returns the actions of this batch which failed so far. */
+QList<RuleActionError> RuleActionBatch::errors() const
+{
+    return m_errors;
+}
+
+void RuleActionBatch::actionFinished(const ThingId &thingId, Thing::ThingError status)
+{
+    if (status != Thing::ThingErrorNoError) {
+        RuleActionError error;
+        error.thingId = thingId;
+        error.status = status;
+        m_errors.append(error);
+    }
+    m_pending--;
+    if (m_pending == 0) {
+        emit finished();
+    }
+}
+
+/*! Constructs a RuleActionExecutor executing actions on things of the given \a thingManager. */
+RuleActionExecutor::RuleActionExecutor(ThingManager *thingManager, QObject *parent):
+    QObject(parent),
+    m_thingManager(thingManager)
+{
+    m_clock.start();
+    m_rateLimitTimer.setSingleShot(true);
+    connect(&m_rateLimitTimer, &QTimer::timeout, this, &RuleActionExecutor::dispatch);
+
+    MetricsRegistry::instance()->registerHistogram("nymea_rule_action_duration_seconds", "Time from queueing a rule action until it finished, per plugin", MetricsRegistry::latencyBuckets(), 0.000001, "plugin");
+    MetricsRegistry::instance()->registerCounter("nymea_rule_action_errors_total", "Rule actions which failed, per plugin", "plugin");
+
+    if (MemoryAccounting *memoryAccounting = MemoryAccounting::instance()) {
+        memoryAccounting->addProbe("ruleengine.actionQueue", this, [this](){
+            MemoryAccounting::Usage usage;
+            usage.objects = queuedActions();
+            return usage;
+        });
+    }
+}
+
+/*! Returns the maximum number of actions per second dispatched to plugins without a limit of their own. */
+int RuleActionExecutor::maxActionsPerSecond() const
+{
+    return m_maxActionsPerSecond;
+}
+
+/*! Limits the number of actions per second dispatched to plugins without a limit of their own
+    to \a maxActionsPerSecond. 0 disables the limit.
+*/
+void RuleActionExecutor::setMaxActionsPerSecond(int maxActionsPerSecond)
+{
+    m_maxActionsPerSecond = qMax(0, maxActionsPerSecond);
+    m_pluginQueues.clear();
+    m_pluginOrder.clear();
+    rebuildReadyThings();
+}
+
+/*! Limits the number of actions per second dispatched to the plugin with the given \a pluginName
+    to \a maxActionsPerSecond. 0 disables the limit for this plugin.
+*/
+void RuleActionExecutor::setMaxActionsPerSecond(const QString &pluginName, int maxActionsPerSecond)
+{
+    m_pluginMaxActionsPerSecond.insert(pluginName, qMax(0, maxActionsPerSecond));
+    m_pluginQueues.clear();
+    m_pluginOrder.clear();
+    rebuildReadyThings();
+}
+
+/*! Queues the given \a actions and \a browserActions and dispatches as many of them as possible
+    right away. The returned batch emits finished() once all of them have finished.
+*/
+RuleActionBatch *RuleActionExecutor::execute(const QList<Action> &actions, const QList<BrowserAction> &browserActions)
+{
+    RuleActionBatch *batch = new RuleActionBatch(actions.count() + browserActions.count(), this);
+
+    foreach (const Action &action, actions) {
+        PendingAction pending;
+        pending.thingId = action.thingId();
+        pending.action = action;
+        pending.batch = batch;
+        enqueue(pending);
+    }
+    foreach (const BrowserAction &browserAction, browserActions) {
+        PendingAction pending;
+        pending.thingId = browserAction.thingId();
+        pending.browserAction = browserAction;
+        pending.isBrowserAction = true;
+        pending.batch = batch;
+        enqueue(pending);
+    }
+
+    dispatch();
+    return batch;
+}
+
+/*! Returns the number of actions waiting to be dispatched. */
+int RuleActionExecutor::queuedActions() const
+{
+    int count = 0;
+    foreach (const QList<PendingAction> &queue, m_thingQueues) {
+        count += queue.count();
+    }
+    return count;
+}
+
+void RuleActionExecutor::dispatch()
+{
+    // Starting an action may end up here again, the running loop picks up the new work
+    if (m_dispatching) {
+        m_dispatchAgain = true;
+        return;
+    }
+    m_dispatching = true;
+
+    qint64 wait = -1;
+    do {
+        m_dispatchAgain = false;
+        wait = -1;
+        bool dispatched = true;
+        while (dispatched) {
+            dispatched = false;
+            qint64 now = m_clock.elapsed();
+            foreach (const PluginId &pluginId, m_pluginOrder) {
+                PluginQueue &queue = m_pluginQueues[pluginId];
+                if (queue.readyThings.isEmpty()) {
+                    continue;
+                }
+                if (queue.minInterval > 0 && queue.lastDispatch >= 0) {
+                    qint64 remaining = queue.lastDispatch + queue.minInterval - now;
+                    if (remaining > 0) {
+                        wait = wait < 0 ? remaining : qMin(wait, remaining);
+                        continue;
+                    }
+                }
+                queue.lastDispatch = now;
+                ThingId thingId = queue.readyThings.takeFirst();
+                PendingAction pending = m_thingQueues[thingId].takeFirst();
+                if (m_thingQueues.value(thingId).isEmpty()) {
+                    m_thingQueues.remove(thingId);
+                }
+                m_busyThings.insert(thingId);
+                start(pending);
+                dispatched = true;
+            }
+        }
+    } while (m_dispatchAgain);
+
+    m_dispatching = false;
+    if (wait >= 0) {
+        m_rateLimitTimer.start(static_cast<int>(wait));
+    }
+}
+
+void RuleActionExecutor::enqueue(const PendingAction &pending)
+{
+    PendingAction queued = pending;
+    queued.traceContext = Tracer::currentContext();
+    queued.queuedAt = m_clock.nsecsElapsed() / 1000;
+
+    bool ready = !m_busyThings.contains(queued.thingId) && !m_thingQueues.contains(queued.thingId);
+    m_thingQueues[queued.thingId].append(queued);
+    if (ready) {
+        pluginQueue(queued.thingId)->readyThings.append(queued.thingId);
+    }
+}
+
+void RuleActionExecutor::start(const PendingAction &pending)
+{
+    TraceScope traceScope("RuleActionExecutor::dispatch", "rules", pending.traceContext);
+
+    if (pending.isBrowserAction) {
+        BrowserActionInfo *info = NymeaCore::instance()->executeBrowserItem(pending.browserAction);
+        connect(info, &BrowserActionInfo::finished, this, [this, info, pending](){
+            if (info->status() != Thing::ThingErrorNoError) {
+                qCWarning(dcRuleEngine) << "Error executing browser action:" << info->status();
+            }
+            actionFinished(pending, info->status());
+        });
+        return;
+    }
+
+    qCDebug(dcRuleEngine) << "Executing action" << pending.action.actionTypeId() << pending.action.params();
+    ThingActionInfo *info = NymeaCore::instance()->executeAction(pending.action);
+    connect(info, &ThingActionInfo::finished, this, [this, info, pending](){
+        if (info->status() != Thing::ThingErrorNoError) {
+            qCWarning(dcRuleEngine) << "Error executing action:" << info->status() << info->displayMessage();
+        }
+        actionFinished(pending, info->status());
+    });
+}
+
+void RuleActionExecutor::actionFinished(const PendingAction &pending, Thing::ThingError status)
+{
+    PluginQueue *queue = pluginQueue(pending.thingId);
+    MetricsRegistry::instance()->histogram("nymea_rule_action_duration_seconds", queue->pluginName)->observe(static_cast<quint64>(m_clock.nsecsElapsed() / 1000 - pending.queuedAt));
+    if (status != Thing::ThingErrorNoError) {
+        MetricsRegistry::instance()->counter("nymea_rule_action_errors_total", queue->pluginName)->increment();
+    }
+
+    m_busyThings.remove(pending.thingId);
+    if (m_thingQueues.contains(pending.thingId)) {
+        queue->readyThings.append(pending.thingId);
+    }
+
+    pending.batch->actionFinished(pending.thingId, status);
+    dispatch();
+}
+
+RuleActionExecutor::PluginQueue *RuleActionExecutor::pluginQueue(const ThingId &thingId)
+{
+    // Things which don't exist (any more) still get a queue, executing their actions reports the error
+    Thing *thing = m_thingManager->findConfiguredThing(thingId);
+    PluginId pluginId = thing ? thing->pluginId() : PluginId();
+    if (!m_pluginQueues.contains(pluginId)) {
+        PluginQueue queue;
+        IntegrationPlugin *plugin = thing ? m_thingManager->plugins().findById(pluginId) : nullptr;
+        queue.pluginName = plugin ? plugin->pluginName() : QString();
+        int maxActionsPerSecond = m_pluginMaxActionsPerSecond.value(queue.pluginName, m_maxActionsPerSecond);
+        queue.minInterval = maxActionsPerSecond > 0 ? 1000 / maxActionsPerSecond : 0;
+        m_pluginQueues.insert(pluginId, queue);
+        m_pluginOrder.append(pluginId);
+    }
+    return &m_pluginQueues[pluginId];
+}
+
+void RuleActionExecutor::rebuildReadyThings()
+{
+    foreach (const ThingId &thingId, m_thingQueues.keys()) {
+        if (!m_busyThings.contains(thingId)) {
+            pluginQueue(thingId)->readyThings.append(thingId);
+        }
+    }
+}
+
+}
@@ -0,0 +1,142 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef RULEACTIONEXECUTOR_H
+#define RULEACTIONEXECUTOR_H
+
+#include "integrations/thing.h"
+#include "types/action.h"
+#include "types/browseraction.h"
+#include "diagnostics/tracer.h"
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class ThingManager;
+
+namespace nymeaserver {
+
+class RuleActionError
+{
+public:
+    ThingId thingId;
+    Thing::ThingError status = Thing::ThingErrorNoError;
+};
+
+class RuleActionBatch : public QObject
+{
+    Q_OBJECT
+public:
+    int count() const;
+    bool isFinished() const;
+    QList<RuleActionError> errors() const;
+
+signals:
+    void finished();
+
+private:
+    friend class RuleActionExecutor;
+    explicit RuleActionBatch(int count, QObject *parent);
+
+    void actionFinished(const ThingId &thingId, Thing::ThingError status);
+
+    int m_count = 0;
+    int m_pending = 0;
+    QList<RuleActionError> m_errors;
+};
+
+class RuleActionExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RuleActionExecutor(ThingManager *thingManager, QObject *parent = nullptr);
+
+    // Limits the rate actions are dispatched to a plugin, 0 means unlimited
+    int maxActionsPerSecond() const;
+    void setMaxActionsPerSecond(int maxActionsPerSecond);
+    void setMaxActionsPerSecond(const QString &pluginName, int maxActionsPerSecond);
+
+    RuleActionBatch *execute(const QList<Action> &actions, const QList<BrowserAction> &browserActions);
+
+    int queuedActions() const;
+
+private slots:
+    void dispatch();
+
+private:
+    class PendingAction
+    {
+    public:
+        ThingId thingId;
+        Action action;
+        BrowserAction browserAction;
+        bool isBrowserAction = false;
+        RuleActionBatch *batch = nullptr;
+        TraceContext traceContext;
+        qint64 queuedAt = 0; // us
+    };
+
+    class PluginQueue
+    {
+    public:
+        QString pluginName;
+        int minInterval = 0; // ms
+        qint64 lastDispatch = -1; // ms
+        // Things with queued actions and none in flight, in the order they became ready
+        QList<ThingId> readyThings;
+    };
+
+    void enqueue(const PendingAction &pending);
+    void start(const PendingAction &pending);
+    void actionFinished(const PendingAction &pending, Thing::ThingError status);
+    PluginQueue *pluginQueue(const ThingId &thingId);
+    void rebuildReadyThings();
+
+    ThingManager *m_thingManager = nullptr;
+    QElapsedTimer m_clock;
+    QTimer m_rateLimitTimer;
+    bool m_dispatching = false;
+    bool m_dispatchAgain = false;
+
+    int m_maxActionsPerSecond = 0;
+    QHash<QString, int> m_pluginMaxActionsPerSecond;
+
+    QHash<ThingId, QList<PendingAction> > m_thingQueues;
+    QSet<ThingId> m_busyThings;
+    QHash<PluginId, PluginQueue> m_pluginQueues;
+    QList<PluginId> m_pluginOrder;
+};
+
+}
+
+#endif // RULEACTIONEXECUTOR_H
@@ -110,6 +110,7 @@
 
 
 #include "ruleengine.h"
+#include "ruleactionexecutor.h"
 #include "nymeacore.h"
 #include "loggingcategories.h"
 #include "time/calendaritem.h"
@@ -156,7 +157,7 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
         return QList<Rule>();
     }
     ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
-    EventType eventType = thingClass.eventTypes().findById(event.eventTypeId());
+    EventType eventType = thingClass.getEventType(event.eventTypeId());
 
 
     if (event.params().count() == 0) {
@@ -587,8 +588,11 @@ RuleEngine::RuleError RuleEngine::executeActions(const RuleId &ruleId)
     }
 
     qCDebug(dcRuleEngine) << "Executing rule actions of rule" << rule.name() << rule.id();
-    NymeaCore::instance()->logEngine()->logRuleActionsExecuted(rule);
-    NymeaCore::instance()->executeRuleActions(rule.actions());
+    // Logged once all actions finished, so their errors can be included
+    RuleActionBatch *batch = NymeaCore::instance()->executeRuleActions(rule.actions());
+    connect(batch, &RuleActionBatch::finished, this, [rule, batch](){
+        NymeaCore::instance()->logEngine()->logRuleActionsExecuted(rule, batch->errors());
+    });
     return RuleErrorNoError;
 }
 
@@ -619,8 +623,10 @@ RuleEngine::RuleError RuleEngine::executeExitActions(const RuleId &ruleId)
     }
 
     qCDebug(dcRuleEngine) << "Executing rule exit actions of rule" << rule.name() << rule.id();
-    NymeaCore::instance()->logEngine()->logRuleExitActionsExecuted(rule);
-    NymeaCore::instance()->executeRuleActions(rule.exitActions());
+    RuleActionBatch *batch = NymeaCore::instance()->executeRuleActions(rule.exitActions());
+    connect(batch, &RuleActionBatch::finished, this, [rule, batch](){
+        NymeaCore::instance()->logEngine()->logRuleExitActionsExecuted(rule, batch->errors());
+    });
     return RuleErrorNoError;
 }
 
@@ -826,7 +832,7 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
                 continue;
             }
 
-            EventType et = dc.eventTypes().findById(event.eventTypeId());
+            EventType et = dc.getEventType(event.eventTypeId());
             if (et.name() != eventDescriptor.interfaceEvent()) {
                 // The fired event name does not match with the eventDescriptor's interfaceEvent
                 continue;
@@ -846,7 +852,7 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
                     continue;
                 }
                 ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-                EventType et = dc.eventTypes().findById(event.eventTypeId());
+                EventType et = dc.getEventType(event.eventTypeId());
                 ParamType pt = et.paramTypes().findByName(paramDescriptor.paramName());
                 paramValue = event.param(pt.id()).value();
             }
@@ -940,7 +946,7 @@ RuleEngine::RuleError RuleEngine::checkRuleAction(const RuleAction &ruleAction,
             return RuleErrorActionTypeNotFound;
         }
 
-        actionType = thingClass.actionTypes().findById(ruleAction.actionTypeId());
+        actionType = thingClass.getActionType(ruleAction.actionTypeId());
     } else if (ruleAction.type() == RuleAction::TypeInterface) {
         Interface iface = NymeaCore::instance()->thingManager()->supportedInterfaces().findByName(ruleAction.interface());
         if (!iface.isValid()) {
@@ -1037,7 +1043,7 @@ RuleEngine::RuleError RuleEngine::checkRuleActionParam(const RuleActionParam &ru
             return RuleErrorThingNotFound;
         }
         ThingClass stateThingClass = NymeaCore::instance()->thingManager()->findThingClass(d->thingClassId());
-        StateType stateType = stateThingClass.stateTypes().findById(ruleActionParam.stateTypeId());
+        StateType stateType = stateThingClass.getStateType(ruleActionParam.stateTypeId());
         QVariant::Type actionParamType = getActionParamType(actionType.id(), ruleActionParam.paramTypeId());
         QVariant v(stateType.type());
         if (actionParamType != stateType.type() && !v.canConvert(static_cast<int>(actionParamType))) {
@@ -97,7 +97,7 @@ bool StateEvaluator::evaluate() const
                 ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
                 if (thing->hasState(m_stateDescriptor.stateTypeId())) {
                     if (m_stateDescriptor == thing->state(m_stateDescriptor.stateTypeId())) {
-                        qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "State" << thing->name() << thingClass.stateTypes().findById(m_stateDescriptor.stateTypeId()).name() << (descriptorMatching ? "is" : "not") << "matching:" << m_stateDescriptor.stateValue() << m_stateDescriptor.operatorType() << thing->stateValue(m_stateDescriptor.stateTypeId());
+                        qCDebug(dcRuleEngineDebug()) << "StateEvaluator:" << this << "State" << thing->name() << thingClass.getStateType(m_stateDescriptor.stateTypeId()).name() << (descriptorMatching ? "is" : "not") << "matching:" << m_stateDescriptor.stateValue() << m_stateDescriptor.operatorType() << thing->stateValue(m_stateDescriptor.stateTypeId());
                         descriptorMatching = true;
                     }
                 } else {
@@ -129,7 +129,7 @@ void ScriptAction::execute(const QVariantMap &params)
     foreach (Thing *thing, things) {
         ActionType actionType;
         if (!ActionTypeId(m_actionTypeId).isNull()) {
-            actionType = thing->thingClass().actionTypes().findById(ActionTypeId(m_actionTypeId));
+            actionType = thing->thingClass().getActionType(ActionTypeId(m_actionTypeId));
         } else {
             actionType = thing->thingClass().actionTypes().findByName(m_actionName);
         }
@@ -39,6 +39,7 @@
 #include "scriptinterfaceevent.h"
 
 #include "nymeasettings.h"
+#include "diagnostics/memoryaccounting.h"
 
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
@@ -73,6 +74,15 @@ ScriptEngine::ScriptEngine(ThingManager *deviceManager, QObject *parent) : QObje
     m_engine = new QQmlEngine(this);
     m_engine->setProperty("thingManager", reinterpret_cast<quint64>(m_deviceManager));
 
+    // The JS heap size is not available through public API
+    if (MemoryAccounting *memoryAccounting = MemoryAccounting::instance()) {
+        memoryAccounting->addProbe("scriptengine.scripts", this, [this](){
+            MemoryAccounting::Usage usage;
+            usage.objects = m_scripts.count();
+            return usage;
+        });
+    }
+
     // Don't automatically print script warnings (that is, runtime errors, *not* console.warn() messages)
     // to stdout as they'd end up on the "default" logging category.
     // We collect them ourselves through the warnings() signal and print them to the dcScriptEngine category.
@@ -91,7 +91,7 @@ void ScriptInterfaceEvent::onEventTriggered(const Event &event)
     QVariantMap params;
     foreach (const Param &param, event.params()) {
         params.insert(param.paramTypeId().toString().remove(QRegExp("[{}]")), param.value().toByteArray());
-        QString paramName = thing->thingClass().eventTypes().findById(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
+        QString paramName = thing->thingClass().getEventType(event.eventTypeId()).paramTypes().findById(param.paramTypeId()).name();
         params.insert(paramName, param.value().toByteArray());
     }
 
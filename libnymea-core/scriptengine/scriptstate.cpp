@@ -150,7 +150,7 @@ void ScriptState::setValue(const QVariant &value)
 
     ActionTypeId actionTypeId;
     if (!m_stateTypeId.isNull()) {
-        actionTypeId = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId)).id();
+        actionTypeId = thing->thingClass().getStateType(StateTypeId(m_stateTypeId)).id();
         if (actionTypeId.isNull()) {
             qCDebug(dcScriptEngine) << "Thing" << thing->name() << "does not have a state with type id" << m_stateTypeId;
         }
@@ -189,7 +189,7 @@ QVariant ScriptState::minimumValue() const
     if (!thing) {
         return QVariant();
     }
-    StateType stateType = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId));
+    StateType stateType = thing->thingClass().getStateType(StateTypeId(m_stateTypeId));
     if (stateType.id().isNull()) {
         stateType = thing->thingClass().stateTypes().findByName(m_stateName);
     }
@@ -202,7 +202,7 @@ QVariant ScriptState::maximumValue() const
     if (!thing) {
         return QVariant();
     }
-    StateType stateType = thing->thingClass().stateTypes().findById(StateTypeId(m_stateTypeId));
+    StateType stateType = thing->thingClass().getStateType(StateTypeId(m_stateTypeId));
     if (stateType.id().isNull()) {
         stateType = thing->thingClass().stateTypes().findByName(m_stateName);
     }
@@ -82,7 +82,9 @@ void BluetoothServer::sendData(const QUuid &clientId, const QByteArray &data)
         return;
 
     qCDebug(dcBluetoothServerTraffic()) << "Send data:" << qUtf8Printable(data);
-    client->write(data + '\n');
+    client->write(frameHeader(clientId, data.size()));
+    client->write(data);
+    client->write(frameTrailer(clientId));
 }
 
 /*! Send the given \a data to the \a clients. */
@@ -92,6 +94,19 @@ void BluetoothServer::sendData(const QList<QUuid> &clients, const QByteArray &da
         sendData(client, data);
 }
 
+/*! Returns the framings supported by the bluetooth server. */
+QList<TransportInterface::Framing> BluetoothServer::supportedFramings() const
+{
+    return {FramingNewline, FramingLengthPrefixed};
+}
+
+/*! Returns the number of bytes buffered for the client with the given \a clientId. */
+qint64 BluetoothServer::bytesToWrite(const QUuid &clientId) const
+{
+    QBluetoothSocket *client = m_clientList.value(clientId);
+    return client ? client->bytesToWrite() : 0;
+}
+
 void BluetoothServer::terminateClientConnection(const QUuid &clientId)
 {
     QBluetoothSocket *client = m_clientList.value(clientId);
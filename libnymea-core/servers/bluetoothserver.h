@@ -54,6 +54,9 @@ public:
 
     void terminateClientConnection(const QUuid &clientId) override;
 
+    QList<Framing> supportedFramings() const override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+
 private:
     QBluetoothServer *m_server = nullptr;
     QBluetoothLocalDevice *m_localDevice = nullptr;
@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::DeflateStream
+    \brief A per-connection zlib stream used to compress outgoing JSON-RPC messages.
+
+    \ingroup server
+    \inmodule core
+
+    All messages sent to a client share one compression context, so repeated
+    structures (e.g. thing and state type ids) are encoded as back references
+    into the previous messages. Every message is terminated with a sync flush,
+    which makes it decodable by the client as soon as it arrives without
+    having to close the stream.
+
+    \sa TcpServer, WebSocketServer
+*/
+
+#include "deflatestream.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+static const int chunkSize = 16 * 1024;
+
+/*! Constructs a new compression stream with the given compression \a level. */
+DeflateStream::DeflateStream(int level)
+{
+    m_stream.zalloc = Z_NULL;
+    m_stream.zfree = Z_NULL;
+    m_stream.opaque = Z_NULL;
+    m_valid = deflateInit(&m_stream, level) == Z_OK;
+    if (!m_valid) {
+        qCWarning(dcJsonRpc()) << "Failed to initialize deflate stream:" << m_stream.msg;
+    }
+}
+
+DeflateStream::~DeflateStream()
+{
+    if (m_valid) {
+        deflateEnd(&m_stream);
+    }
+}
+
+/*! Returns true if the stream has been initialized successfully and no error occurred while compressing. */
+bool DeflateStream::isValid() const
+{
+    return m_valid;
+}
+
+/*! Compresses the \a header, \a data and \a trailer of one message and flushes the stream.
+    The parts are fed to the stream one after the other, so the payload does not need to be
+    copied in order to add the framing. Returns an empty QByteArray on error.
+*/
+QByteArray DeflateStream::compress(const QByteArray &header, const QByteArray &data, const QByteArray &trailer)
+{
+    QByteArray output;
+    if (!m_valid) {
+        return output;
+    }
+    int inputSize = header.size() + data.size() + trailer.size();
+    output.reserve(qMin(static_cast<int>(deflateBound(&m_stream, static_cast<uLong>(inputSize))), chunkSize));
+
+    if (!deflateInto(header.constData(), header.size(), Z_NO_FLUSH, output)
+            || !deflateInto(data.constData(), data.size(), Z_NO_FLUSH, output)
+            || !deflateInto(trailer.constData(), trailer.size(), Z_SYNC_FLUSH, output)) {
+        qCWarning(dcJsonRpc()) << "Failed to compress data:" << m_stream.msg;
+        deflateEnd(&m_stream);
+        m_valid = false;
+        return QByteArray();
+    }
+    return output;
+}
+
+bool DeflateStream::deflateInto(const char *data, int length, int flush, QByteArray &output)
+{
+    if (length == 0 && flush == Z_NO_FLUSH) {
+        return true;
+    }
+    m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    m_stream.avail_in = static_cast<uInt>(length);
+    do {
+        int offset = output.size();
+        output.resize(offset + chunkSize);
+        m_stream.next_out = reinterpret_cast<Bytef*>(output.data() + offset);
+        m_stream.avail_out = chunkSize;
+        int ret = deflate(&m_stream, flush);
+        output.resize(offset + chunkSize - static_cast<int>(m_stream.avail_out));
+        if (ret == Z_STREAM_ERROR) {
+            return false;
+        }
+    } while (m_stream.avail_out == 0);
+    return m_stream.avail_in == 0;
+}
+
+}
@@ -50,16 +50,28 @@ MockTcpServer::MockTcpServer(QObject *parent):
 
     connect(this, &TransportInterface::clientDisconnected, this, [this](const QUuid &clientId){
         m_connectedClients.removeAll(clientId);
+        delete m_compressors.take(clientId);
+        m_bytesToWrite.remove(clientId);
     });
 }
 
 MockTcpServer::~MockTcpServer()
 {
     s_allServers.removeAll(this);
+    qDeleteAll(m_compressors);
 }
 
 void MockTcpServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
+    DeflateStream *compressor = m_compressors.value(clientId);
+    if (compressor) {
+        emit outgoingData(clientId, compressor->compress(frameHeader(clientId, data.size()), data, frameTrailer(clientId)));
+        return;
+    }
+    if (framing(clientId) == FramingLengthPrefixed) {
+        emit outgoingData(clientId, frameHeader(clientId, data.size()) + data);
+        return;
+    }
     emit outgoingData(clientId, data);
 }
 
@@ -76,6 +88,33 @@ void MockTcpServer::terminateClientConnection(const QUuid &clientId)
     emit clientDisconnected(clientId);
 }
 
+QList<TransportInterface::Compression> MockTcpServer::supportedCompressions() const
+{
+    return {CompressionNone, CompressionDeflate};
+}
+
+QList<TransportInterface::Framing> MockTcpServer::supportedFramings() const
+{
+    return {FramingNewline, FramingLengthPrefixed};
+}
+
+qint64 MockTcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    return m_bytesToWrite.value(clientId);
+}
+
+bool MockTcpServer::setCompression(const QUuid &clientId, TransportInterface::Compression compression)
+{
+    if (!m_connectedClients.contains(clientId)) {
+        return false;
+    }
+    delete m_compressors.take(clientId);
+    if (compression == CompressionDeflate) {
+        m_compressors.insert(clientId, new DeflateStream());
+    }
+    return true;
+}
+
 QList<MockTcpServer *> MockTcpServer::servers()
 {
     return s_allServers;
@@ -87,6 +126,11 @@ void MockTcpServer::injectData(const QUuid &clientId, const QByteArray &data)
     emit dataAvailable(clientId, data);
 }
 
+void MockTcpServer::setBytesToWrite(const QUuid &clientId, qint64 bytesToWrite)
+{
+    m_bytesToWrite[clientId] = bytesToWrite;
+}
+
 bool MockTcpServer::reconfigureServer(const QHostAddress &address, const uint &port)
 {
     Q_UNUSED(address)
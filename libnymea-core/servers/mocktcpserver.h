@@ -36,6 +36,7 @@
 #include <QDebug>
 
 #include "transportinterface.h"
+#include "deflatestream.h"
 
 class JsonRPCServer;
 
@@ -52,9 +53,15 @@ public:
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
     void terminateClientConnection(const QUuid &clientId) override;
 
+    QList<Compression> supportedCompressions() const override;
+    bool setCompression(const QUuid &clientId, Compression compression) override;
+    QList<Framing> supportedFramings() const override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+
 /************** Used for testing **************************/
     static QList<MockTcpServer*> servers();
     void injectData(const QUuid &clientId, const QByteArray &data);
+    void setBytesToWrite(const QUuid &clientId, qint64 bytesToWrite);
 signals:
     void outgoingData(const QUuid &clientId, const QByteArray &data);
     void connectionTerminated(const QUuid &clientId);
@@ -69,6 +76,8 @@ private:
     static QList<MockTcpServer*> s_allServers;
 
     QList<QUuid> m_connectedClients;
+    QHash<QUuid, DeflateStream *> m_compressors;
+    QHash<QUuid, qint64> m_bytesToWrite;
 };
 
 }
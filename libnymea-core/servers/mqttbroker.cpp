@@ -42,16 +42,16 @@ public:
 
     Mqtt::ConnectReturnCode authorizeConnect(int serverAddressId, const QString &clientId, const QString &username, const QString &password, const QHostAddress &peerAddress) override {
         Q_UNUSED(peerAddress)
-        if (!m_broker->m_configs.value(serverAddressId).authenticationEnabled) {
+        if (!authenticationEnabled(serverAddressId)) {
             qCDebug(dcMqtt) << "Accepting client" << clientId << ". Server configuration does not require authentication.";
             return Mqtt::ConnectReturnCodeAccepted;
         }
-        if (!m_broker->m_policies.contains(clientId)) {
+        QHash<QString, MqttPolicy>::const_iterator policy = m_broker->m_policies.constFind(clientId);
+        if (policy == m_broker->m_policies.constEnd()) {
             qCDebug(dcMqtt) << "Rejecting client" << clientId << ". No policy for this client installed.";
             return Mqtt::ConnectReturnCodeIdentifierRejected;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        if (policy.username != username || policy.password != password) {
+        if (policy->username != username || policy->password != password) {
             qCDebug(dcMqtt) << "Rejecting client" << clientId << ". Bad username or password.";
             return Mqtt::ConnectReturnCodeBadUsernameOrPassword;
         }
@@ -60,63 +60,35 @@ public:
     }
 
     bool authorizeSubscribe(int serverAddressId, const QString &clientId, const QString &topicFilter) override {
-        if (!m_broker->m_configs.value(serverAddressId).authenticationEnabled) {
+        if (!authenticationEnabled(serverAddressId)) {
             return true;
         }
-        if (!m_broker->m_policies.contains(clientId)) {
+        QHash<QString, MqttBroker::PolicyMatchers>::const_iterator matchers = m_broker->m_policyMatchers.constFind(clientId);
+        if (matchers == m_broker->m_policyMatchers.constEnd()) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedSubscribeTopicFilters, topicFilter);
+        return matchers->subscribe.matches(topicFilter);
     }
 
     bool authorizePublish(int serverAddressId, const QString &clientId, const QString &topic) override {
-        if (!m_broker->m_configs.value(serverAddressId).authenticationEnabled) {
+        if (!authenticationEnabled(serverAddressId)) {
             return true;
         }
-        if (!m_broker->m_policies.contains(clientId)) {
+        QHash<QString, MqttBroker::PolicyMatchers>::const_iterator matchers = m_broker->m_policyMatchers.constFind(clientId);
+        if (matchers == m_broker->m_policyMatchers.constEnd()) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedPublishTopicFilters, topic);
-    }
-
-    bool matchPolicy(const QStringList &policies, const QString &topic) {
-        foreach (const QString &policyFilter, policies) {
-            QStringList policyParts = policyFilter.split('/');
-            QStringList topicParts = topic.split('/');
-            if (topicParts.count() < policyParts.count() - 1) {
-                // Nope... actual topic is shorter than filter
-                continue;
-            }
-            bool bad = false;
-            for (int i = 0; i < policyParts.length(); i++) {
-                if (policyParts.at(i) == QStringLiteral("+")) {
-                    continue;
-                }
-                if (policyParts.at(i) == QStringLiteral("#")) {
-                    continue;
-                }
-                if (policyParts.at(i) == topicParts.at(i)) {
-                    continue;
-                }
-                // Nope... this part does neither match nor is covered by a wildcard in the policy
-                bad = true;
-            }
-            if (bad) {
-                continue;
-            }
-            if (policyParts.count() == topicParts.count() || policyFilter.endsWith('#')) {
-                // OK, either the policy is matching or the topicFilter is longer as the policy and policy ends with #
-                return true;
-            }
-        }
-        // Nope... none of the policies matched...
-        return false;
+        return matchers->publish.matches(topic);
     }
 
 private:
     MqttBroker *m_broker;
+
+    bool authenticationEnabled(int serverAddressId) const {
+        QHash<int, ServerConfiguration>::const_iterator config = m_broker->m_configs.constFind(serverAddressId);
+        // Unknown servers require authentication, like the default configuration
+        return config == m_broker->m_configs.constEnd() || config->authenticationEnabled;
+    }
 };
 
 MqttBroker::MqttBroker(QObject *parent) : QObject(parent)
@@ -200,6 +172,12 @@ MqttPolicy MqttBroker::policy(const QString &clientId)
 
 void MqttBroker::updatePolicy(const MqttPolicy &policy)
 {
+    // Compile the topic filters once, authorization runs on every publish and subscribe
+    PolicyMatchers matchers;
+    matchers.publish = MqttTopicMatcher(policy.allowedPublishTopicFilters);
+    matchers.subscribe = MqttTopicMatcher(policy.allowedSubscribeTopicFilters);
+    m_policyMatchers.insert(policy.clientId, matchers);
+
     if (m_policies.contains(policy.clientId)) {
         m_policies[policy.clientId] = policy;
         qCDebug(dcMqtt) << "Policy for client" << policy.clientId << "updated.";
@@ -227,6 +205,7 @@ bool MqttBroker::removePolicy(const QString &clientId)
         }
 
         qCDebug(dcMqtt) << "Policy for client" << clientId << "removed";
+        m_policyMatchers.remove(clientId);
         emit policyRemoved(m_policies.take(clientId));
         return true;
     }
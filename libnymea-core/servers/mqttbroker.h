@@ -37,6 +37,7 @@
 
 #include "nymea-mqtt/mqtt.h"
 #include "nymeaconfiguration.h"
+#include "mqtttopicmatcher.h"
 
 class MqttServer;
 
@@ -88,6 +89,14 @@ private:
     QHash<int, ServerConfiguration> m_configs;
     QHash<QString, MqttPolicy> m_policies;
 
+    class PolicyMatchers
+    {
+    public:
+        MqttTopicMatcher publish;
+        MqttTopicMatcher subscribe;
+    };
+    QHash<QString, PolicyMatchers> m_policyMatchers;
+
 
     friend class NymeaMqttAuthorizer;
 };
@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MqttTopicMatcher
+    \brief Matches MQTT topics against a precompiled set of topic filters.
+
+    \ingroup server
+    \inmodule core
+
+    The topic filters of an \l{MqttPolicy} are compiled into a tree of topic levels once. Matching
+    a topic walks its levels through the tree without splitting or copying the topic.
+
+    "+" matches exactly one level. "#" matches one level in the middle of a filter. At the end of
+    a filter, "#" matches any number of remaining levels, including the parent level itself.
+    Topics are compared literally, so when authorizing a subscription, the wildcards of the
+    subscribed filter only match wildcards in the policy.
+*/
+
+#include "mqtttopicmatcher.h"
+
+namespace nymeaserver {
+
+/*! Constructs a matcher which doesn't match any topic. */
+MqttTopicMatcher::MqttTopicMatcher()
+{
+    m_nodes.append(Node());
+}
+
+/*! Constructs a matcher for the given \a topicFilters. */
+MqttTopicMatcher::MqttTopicMatcher(const QStringList &topicFilters)
+{
+    m_nodes.append(Node());
+
+    foreach (const QString &topicFilter, topicFilters) {
+        int current = 0;
+        foreach (const QString &part, topicFilter.split('/')) {
+            if (part == QStringLiteral("+") || part == QStringLiteral("#")) {
+                if (m_nodes.at(current).wildcard < 0) {
+                    m_nodes.append(Node());
+                    m_nodes[current].wildcard = m_nodes.count() - 1;
+                }
+                current = m_nodes.at(current).wildcard;
+                continue;
+            }
+
+            int child = -1;
+            foreach (int index, m_nodes.at(current).children) {
+                if (m_nodes.at(index).segment == part) {
+                    child = index;
+                    break;
+                }
+            }
+            if (child < 0) {
+                Node node;
+                node.segment = part;
+                m_nodes.append(node);
+                child = m_nodes.count() - 1;
+                m_nodes[current].children.append(child);
+            }
+            current = child;
+        }
+        m_nodes[current].terminal = true;
+        if (topicFilter.endsWith('#')) {
+            m_nodes[current].matchesDeeper = true;
+        }
+    }
+}
+
+/*! Returns true if this matcher has no topic filters. */
+bool MqttTopicMatcher::isEmpty() const
+{
+    return m_nodes.count() == 1;
+}
+
+/*! Returns true if the given \a topic matches any of the topic filters. */
+bool MqttTopicMatcher::matches(const QString &topic) const
+{
+    return matchNode(0, topic, 0);
+}
+
+bool MqttTopicMatcher::matchNode(int nodeIndex, const QString &topic, int position) const
+{
+    const Node &node = m_nodes.at(nodeIndex);
+
+    // All levels of the topic consumed
+    if (position > topic.length()) {
+        if (node.terminal)
+            return true;
+
+        // "a/#" also matches "a"
+        return node.wildcard >= 0 && m_nodes.at(node.wildcard).matchesDeeper;
+    }
+
+    if (node.terminal && node.matchesDeeper)
+        return true;
+
+    int end = topic.indexOf('/', position);
+    if (end < 0)
+        end = topic.length();
+
+    QStringRef segment = topic.midRef(position, end - position);
+    for (int i = 0; i < node.children.count(); i++) {
+        int child = node.children.at(i);
+        if (m_nodes.at(child).segment == segment && matchNode(child, topic, end + 1)) {
+            return true;
+        }
+    }
+
+    return node.wildcard >= 0 && matchNode(node.wildcard, topic, end + 1);
+}
+
+}
@@ -96,6 +96,7 @@ TcpServer::~TcpServer()
 {
     qCDebug(dcTcpServer()) << "Shutting down \"TCP Server\"" << serverUrl().toString();
     stopServer();
+    qDeleteAll(m_compressors);
 }
 
 /*! Returns the URL of this server. */
@@ -127,12 +128,66 @@ void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
-        client->write(data + '\n');
+        QByteArray header = frameHeader(clientId, data.size());
+        QByteArray trailer = frameTrailer(clientId);
+        DeflateStream *compressor = m_compressors.value(clientId);
+        if (compressor) {
+            QByteArray compressed = compressor->compress(header, data, trailer);
+            if (!compressor->isValid()) {
+                // The client can't decode anything sent on this stream from here on
+                qCWarning(dcTcpServer()) << "Compressing data for client" << clientId.toString() << "failed. Closing the connection.";
+                terminateClientConnection(clientId);
+                return;
+            }
+            client->write(compressed);
+        } else {
+            // The socket buffers internally, no need to copy the payload in order to add the framing
+            client->write(header);
+            client->write(data);
+            client->write(trailer);
+        }
     } else {
         qCWarning(dcTcpServer()) << "Client" << clientId << "unknown to this transport";
     }
 }
 
+/*! Returns the compressions supported by the TCP server. */
+QList<TransportInterface::Compression> TcpServer::supportedCompressions() const
+{
+    return {CompressionNone, CompressionDeflate};
+}
+
+/*! Returns the framings supported by the TCP server. */
+QList<TransportInterface::Framing> TcpServer::supportedFramings() const
+{
+    return {FramingNewline, FramingLengthPrefixed};
+}
+
+/*! Returns the number of bytes buffered for the client with the given \a clientId. */
+qint64 TcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    if (!client) {
+        return 0;
+    }
+    QSslSocket *sslSocket = qobject_cast<QSslSocket*>(client);
+    return client->bytesToWrite() + (sslSocket ? sslSocket->encryptedBytesToWrite() : 0);
+}
+
+/*! Enables the given \a compression for the client with the given \a clientId. */
+bool TcpServer::setCompression(const QUuid &clientId, TransportInterface::Compression compression)
+{
+    if (!m_clientList.contains(clientId)) {
+        return false;
+    }
+    delete m_compressors.take(clientId);
+    if (compression == CompressionDeflate) {
+        m_compressors.insert(clientId, new DeflateStream());
+    }
+    qCDebug(dcTcpServer()) << "Compression for client" << clientId.toString() << "set to" << compression;
+    return true;
+}
+
 void TcpServer::onClientConnected(QSslSocket *socket)
 {
     QUuid clientId = QUuid::createUuid();
@@ -146,6 +201,7 @@ void TcpServer::onClientDisconnected(QSslSocket *socket)
     QUuid clientId = m_clientList.key(socket);
     qCDebug(dcTcpServer()) << "Client disconnected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
     m_clientList.take(clientId);
+    delete m_compressors.take(clientId);
     emit clientDisconnected(clientId);
 }
 
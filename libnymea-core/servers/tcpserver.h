@@ -41,6 +41,7 @@
 #include <QDebug>
 
 #include "transportinterface.h"
+#include "deflatestream.h"
 
 #include "loggingcategories.h"
 
@@ -89,11 +90,17 @@ public:
 
     void terminateClientConnection(const QUuid &clientId) override;
 
+    QList<Compression> supportedCompressions() const override;
+    bool setCompression(const QUuid &clientId, Compression compression) override;
+    QList<Framing> supportedFramings() const override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+
 private:
     QTimer *m_timer;
 
     SslServer * m_server;
     QHash<QUuid, QTcpSocket *> m_clientList;
+    QHash<QUuid, DeflateStream *> m_compressors;
 
     QSslConfiguration m_sslConfig;
 
@@ -56,6 +56,9 @@
 
     You can turn on the HTTPS server in the \tt WebServer section of the \tt /etc/nymea/nymead.conf file.
 
+    If the debug server is enabled, runtime metrics can be scraped in the Prometheus text format from:
+    \code http://localhost:3333/metrics\endcode
+
     \note For \tt HTTPS you need to have a certificate and configure it in the \tt SSL-configuration
     section of the \tt /etc/nymea/nymead.conf file.
 
@@ -87,6 +90,7 @@
 #include "httpreply.h"
 #include "httprequest.h"
 #include "debugserverhandler.h"
+#include "diagnostics/metricsregistry.h"
 #include "version.h"
 
 #include <QJsonDocument>
@@ -365,6 +369,23 @@ void WebServer::readClient()
         return;
     }
 
+    // Check metrics call. The metrics are available together with the debug server.
+    if (request.url().path() == "/metrics" && request.method() == HttpRequest::Get) {
+        HttpReply *reply = nullptr;
+        if (NymeaCore::instance()->configuration()->debugServerEnabled()) {
+            reply = HttpReply::createSuccessReply();
+            reply->setHeader(HttpReply::ContentTypeHeader, "text/plain; version=0.0.4; charset=utf-8");
+            reply->setPayload(MetricsRegistry::instance()->toPrometheusText());
+        } else {
+            qCWarning(dcWebServer()) << "Metrics are only available when the debug server is enabled.";
+            reply = HttpReply::createErrorReply(HttpReply::NotFound);
+        }
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
+    }
+
     // Check if this is a debug call
     if (request.url().path().startsWith("/debug")) {
         // Check if debug server is enabled
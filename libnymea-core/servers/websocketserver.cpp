@@ -82,6 +82,7 @@ WebSocketServer::~WebSocketServer()
 {
     qCDebug(dcWebSocketServer()) << "Shutting down \"Websocket server\"" << serverUrl().toString();
     stopServer();
+    qDeleteAll(m_compressors);
 }
 
 /*! Returns the url of this server. */
@@ -100,7 +101,33 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
+        QByteArray header = frameHeader(clientId, data.size());
+        QByteArray trailer = frameTrailer(clientId);
+        DeflateStream *compressor = m_compressors.value(clientId);
+        qint64 sent = 0;
+        if (compressor) {
+            QByteArray compressed = compressor->compress(header, data, trailer);
+            if (!compressor->isValid()) {
+                // The client can't decode anything sent on this stream from here on
+                qCWarning(dcWebSocketServer()) << "Compressing data for client" << clientId.toString() << "failed. Closing the connection.";
+                terminateClientConnection(clientId);
+                return;
+            }
+            sent = client->sendBinaryMessage(compressed);
+        } else if (framing(clientId) == FramingLengthPrefixed) {
+            QByteArray message;
+            message.reserve(header.size() + data.size());
+            message.append(header).append(data);
+            sent = client->sendBinaryMessage(message);
+        } else {
+            // Build the UTF-8 message with its delimiter in one buffer and decode it once. Appending
+            // the delimiter to the decoded string would reallocate the whole UTF-16 copy.
+            QByteArray message;
+            message.reserve(data.size() + 1);
+            message.append(data).append('\n');
+            sent = client->sendTextMessage(QString::fromUtf8(message));
+        }
+        m_bytesToWrite[clientId] += sent;
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
     }
@@ -125,6 +152,41 @@ void WebSocketServer::terminateClientConnection(const QUuid &clientId)
     }
 }
 
+/*! Returns the compressions supported by the WebSocket server. Compressed messages are sent as binary frames. */
+QList<TransportInterface::Compression> WebSocketServer::supportedCompressions() const
+{
+    return {CompressionNone, CompressionDeflate};
+}
+
+/*! Returns the framings supported by the WebSocket server. Length prefixed messages are sent as binary frames. */
+QList<TransportInterface::Framing> WebSocketServer::supportedFramings() const
+{
+    return {FramingNewline, FramingLengthPrefixed};
+}
+
+/*! Returns an estimate of the number of bytes buffered for the client with the given \a clientId.
+ *  QWebSocket does not expose its socket buffer, so this is the payload sent minus the bytes
+ *  reported as written to the network.
+ */
+qint64 WebSocketServer::bytesToWrite(const QUuid &clientId) const
+{
+    return m_bytesToWrite.value(clientId);
+}
+
+/*! Enables the given \a compression for the client with the given \a clientId. */
+bool WebSocketServer::setCompression(const QUuid &clientId, TransportInterface::Compression compression)
+{
+    if (!m_clientList.contains(clientId)) {
+        return false;
+    }
+    delete m_compressors.take(clientId);
+    if (compression == CompressionDeflate) {
+        m_compressors.insert(clientId, new DeflateStream());
+    }
+    qCDebug(dcWebSocketServer()) << "Compression for client" << clientId.toString() << "set to" << compression;
+    return true;
+}
+
 void WebSocketServer::onClientConnected()
 {
     // got a new client connected
@@ -150,6 +212,7 @@ void WebSocketServer::onClientConnected()
     connect(client, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClientError(QAbstractSocket::SocketError)));
     connect(client, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
+    connect(client, &QWebSocket::bytesWritten, this, &WebSocketServer::onBytesWritten);
 
     emit clientConnected(clientId);
 }
@@ -160,6 +223,8 @@ void WebSocketServer::onClientDisconnected()
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServer()) << "Client" << clientId.toString() << "disconnected. (Remote address:" << client->peerAddress().toString() << ")" ;
     m_clientList.take(clientId)->deleteLater();
+    delete m_compressors.take(clientId);
+    m_bytesToWrite.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -168,6 +233,7 @@ void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data;
+    emit dataAvailable(clientId, data);
 }
 
 void WebSocketServer::onTextMessageReceived(const QString &message)
@@ -197,6 +263,16 @@ void WebSocketServer::onPing(quint64 elapsedTime, const QByteArray &payload)
     qCDebug(dcWebSocketServer) << "Ping response from" << clientId.toString() << elapsedTime << payload;
 }
 
+void WebSocketServer::onBytesWritten(qint64 bytes)
+{
+    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+    QUuid clientId = m_clientList.key(client);
+    if (m_bytesToWrite.contains(clientId)) {
+        // Written bytes include the frame headers, don't let that drift below zero
+        m_bytesToWrite[clientId] = qMax<qint64>(0, m_bytesToWrite.value(clientId) - bytes);
+    }
+}
+
 /*! Sets the server name to the given \a serverName. */
 void WebSocketServer::setServerName(const QString &serverName)
 {
@@ -39,6 +39,7 @@
 #include <QWebSocketServer>
 
 #include "transportinterface.h"
+#include "deflatestream.h"
 
 // Note: WebSocket Protocol from the Internet Engineering Task Force (IETF) -> RFC6455 V13:
 //       http://tools.ietf.org/html/rfc6455
@@ -61,9 +62,16 @@ public:
 
     void terminateClientConnection(const QUuid &clientId) override;
 
+    QList<Compression> supportedCompressions() const override;
+    bool setCompression(const QUuid &clientId, Compression compression) override;
+    QList<Framing> supportedFramings() const override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+
 private:
     QWebSocketServer *m_server = nullptr;
     QHash<QUuid, QWebSocket *> m_clientList;
+    QHash<QUuid, DeflateStream *> m_compressors;
+    QHash<QUuid, qint64> m_bytesToWrite;
     QSslConfiguration m_sslConfiguration;
     bool m_enabled;
 
@@ -75,6 +83,7 @@ private slots:
     void onClientError(QAbstractSocket::SocketError error);
     void onServerError(QAbstractSocket::SocketError error);
     void onPing(quint64 elapsedTime, const QByteArray & payload);
+    void onBytesWritten(qint64 bytes);
 
 public slots:
     void setServerName(const QString &serverName) override;
@@ -80,6 +80,20 @@
     abort the connection but close it after flushing outgoing  buffers.
 */
 
+/*! \enum nymeaserver::TransportInterface::Compression
+    \value CompressionNone
+        Messages are sent as plain text.
+    \value CompressionDeflate
+        Messages are sent through a per-client deflate stream, each one terminated with a sync flush.
+*/
+
+/*! \enum nymeaserver::TransportInterface::Framing
+    \value FramingNewline
+        Each message is followed by a newline character.
+    \value FramingLengthPrefixed
+        Each message is preceded by its size in bytes as a 32 bit big endian integer.
+*/
+
 /*! \fn void nymeaserver::TransportInterface::dataAvailable(const QUuid &clientId, const QByteArray &data);
     This signal is emitted when valid \a data from the client with the given \a clientId are available.
 
@@ -90,6 +104,7 @@
 #include "loggingcategories.h"
 
 #include <QJsonDocument>
+#include <QtEndian>
 
 namespace nymeaserver {
 
@@ -98,6 +113,9 @@ TransportInterface::TransportInterface(const ServerConfiguration &config, QObjec
     QObject(parent),
     m_config(config)
 {
+    connect(this, &TransportInterface::clientDisconnected, this, [this](const QUuid &clientId){
+        m_framings.remove(clientId);
+    });
 }
 
 /*! Set the ServerConfiguration of this TransportInterface to the given \a config. */
@@ -112,6 +130,85 @@ ServerConfiguration TransportInterface::configuration() const
     return m_config;
 }
 
+/*! Returns the list of compressions this transport can apply to outgoing data. The default
+    implementation supports only \l{TransportInterface::CompressionNone}.
+*/
+QList<TransportInterface::Compression> TransportInterface::supportedCompressions() const
+{
+    return {CompressionNone};
+}
+
+/*! Enables the given \a compression for all data sent to the client with the given \a clientId
+    from now on. Returns false if the compression is not supported by this transport.
+*/
+bool TransportInterface::setCompression(const QUuid &clientId, Compression compression)
+{
+    Q_UNUSED(clientId)
+    return compression == CompressionNone;
+}
+
+/*! Returns the list of framings this transport can use to delimit messages. The default
+    implementation supports only \l{TransportInterface::FramingNewline}.
+*/
+QList<TransportInterface::Framing> TransportInterface::supportedFramings() const
+{
+    return {FramingNewline};
+}
+
+/*! Sets the \a framing used for messages sent to the client with the given \a clientId.
+    Returns false if the framing is not supported by this transport.
+*/
+bool TransportInterface::setFraming(const QUuid &clientId, Framing framing)
+{
+    if (!supportedFramings().contains(framing)) {
+        return false;
+    }
+    if (framing == FramingNewline) {
+        m_framings.remove(clientId);
+    } else {
+        m_framings.insert(clientId, framing);
+    }
+    return true;
+}
+
+/*! Returns the framing used for messages sent to the client with the given \a clientId. */
+TransportInterface::Framing TransportInterface::framing(const QUuid &clientId) const
+{
+    return m_framings.value(clientId, FramingNewline);
+}
+
+/*! Returns the number of bytes queued for the client with the given \a clientId which have
+    not been written to the network yet. Used to detect slow clients. The default implementation
+    returns 0 for transports which can't tell.
+*/
+qint64 TransportInterface::bytesToWrite(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return 0;
+}
+
+/*! Returns the bytes a transport needs to write before a message of \a payloadSize bytes
+    for the client with the given \a clientId.
+*/
+QByteArray TransportInterface::frameHeader(const QUuid &clientId, int payloadSize) const
+{
+    if (framing(clientId) != FramingLengthPrefixed) {
+        return QByteArray();
+    }
+    QByteArray header(4, 0);
+    qToBigEndian<quint32>(static_cast<quint32>(payloadSize), reinterpret_cast<uchar*>(header.data()));
+    return header;
+}
+
+/*! Returns the bytes a transport needs to write after each message for the client with the given \a clientId. */
+QByteArray TransportInterface::frameTrailer(const QUuid &clientId) const
+{
+    if (framing(clientId) != FramingNewline) {
+        return QByteArray();
+    }
+    return QByteArrayLiteral("\n");
+}
+
 /*! Set the name of this TransportInterface to the given \a serverName. */
 void TransportInterface::setServerName(const QString &serverName)
 {
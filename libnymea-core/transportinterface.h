@@ -34,6 +34,7 @@
 #include <QVariant>
 #include <QString>
 #include <QList>
+#include <QHash>
 #include <QUuid>
 
 #include "nymeaconfiguration.h"
@@ -44,6 +45,18 @@ class TransportInterface : public QObject
 {
     Q_OBJECT
 public:
+    enum Compression {
+        CompressionNone,
+        CompressionDeflate
+    };
+    Q_ENUM(Compression)
+
+    enum Framing {
+        FramingNewline,
+        FramingLengthPrefixed
+    };
+    Q_ENUM(Framing)
+
     explicit TransportInterface(const ServerConfiguration &config, QObject *parent = nullptr);
     virtual ~TransportInterface() = 0;
 
@@ -52,12 +65,24 @@ public:
 
     virtual void terminateClientConnection(const QUuid &clientId) = 0;
 
+    virtual QList<Compression> supportedCompressions() const;
+    virtual bool setCompression(const QUuid &clientId, Compression compression);
+
+    virtual QList<Framing> supportedFramings() const;
+    bool setFraming(const QUuid &clientId, Framing framing);
+    Framing framing(const QUuid &clientId) const;
+
+    virtual qint64 bytesToWrite(const QUuid &clientId) const;
+
     void setConfiguration(const ServerConfiguration &config);
     ServerConfiguration configuration() const;
 
 protected:
     QString m_serverName;
 
+    QByteArray frameHeader(const QUuid &clientId, int payloadSize) const;
+    QByteArray frameTrailer(const QUuid &clientId) const;
+
 signals:
     void clientConnected(const QUuid &clientId);
     void clientDisconnected(const QUuid &clientId);
@@ -70,6 +95,7 @@ public slots:
 
 private:
     ServerConfiguration m_config;
+    QHash<QUuid, Framing> m_framings;
 };
 
 }
@@ -41,6 +41,10 @@
     This class supports also blockwise transfere according to the \l{https://tools.ietf.org/html/draft-ietf-core-block-18}{IETF V18} specifications and
     observing resources according to the \l{https://tools.ietf.org/html/rfc7641}{RFC7641}.
 
+    Requests to different endpoints are sent in parallel. For each endpoint (host and port) at most
+    \l{maxConcurrentRequests()} requests are outstanding at the same time (NSTART in RFC7252), further
+    requests to that endpoint are queued. Responses are matched to their request by message ID and token.
+
     \sa CoapReply, CoapRequest
 
     \section2 Example
@@ -83,14 +87,24 @@
 #include "coap.h"
 #include "coappdu.h"
 #include "coapoption.h"
+#include "coappduview.h"
+
+#include <QDateTime>
 
 Q_LOGGING_CATEGORY(dcCoap, "Coap")
 
+static QString endpointKey(const QUrl &url)
+{
+    return url.host() + ':' + QString::number(url.port(5683));
+}
+
 /*! Constructs a Coap access manager with the given \a parent and \a port. */
 Coap::Coap(QObject *parent, const quint16 &port) :
-    QObject(parent),
-    m_reply(nullptr)
+    QObject(parent)
 {
+    // Seed once for message IDs and tokens
+    qsrand(QDateTime::currentMSecsSinceEpoch());
+
     m_socket = new QUdpSocket(this);
 
     if (!m_socket->bind(QHostAddress::Any, port, QAbstractSocket::ShareAddress))
@@ -99,6 +113,24 @@ Coap::Coap(QObject *parent, const quint16 &port) :
     connect(m_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
 }
 
+/*! Returns the maximum number of requests sent to the same endpoint without having received their response. */
+int Coap::maxConcurrentRequests() const
+{
+    return m_maxConcurrentRequests;
+}
+
+/*! Sets the maximum number of outstanding requests per endpoint to \a maxConcurrentRequests. The default is 1,
+ *  as recommended by RFC7252. Requests to different endpoints are never serialized. */
+void Coap::setMaxConcurrentRequests(int maxConcurrentRequests)
+{
+    m_maxConcurrentRequests = qMax(1, maxConcurrentRequests);
+
+    // Start queued requests which fit into the new limit
+    foreach (const QString &key, m_endpoints.keys()) {
+        startQueuedRequests(key);
+    }
+}
+
 /*! Performs a ping request to the CoAP server specified in the given \a request.
  *  Returns a \l{CoapReply} to match the response with the request. */
 CoapReply *Coap::ping(const CoapRequest &request)
@@ -115,13 +147,7 @@ CoapReply *Coap::ping(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
@@ -142,13 +168,7 @@ CoapReply *Coap::get(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
     return reply;
 }
 
@@ -169,13 +189,7 @@ CoapReply *Coap::put(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
@@ -197,13 +211,7 @@ CoapReply *Coap::post(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
@@ -224,13 +232,7 @@ CoapReply *Coap::deleteResource(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
@@ -254,13 +256,7 @@ CoapReply *Coap::enableResourceNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
@@ -285,21 +281,83 @@ CoapReply *Coap::disableNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    startRequest(reply);
 
     return reply;
 }
 
-void Coap::lookupHost()
+void Coap::startRequest(CoapReply *reply)
+{
+    QString key = endpointKey(reply->request().url());
+    m_replyContexts[reply].endpointKey = key;
+    connect(reply, &QObject::destroyed, this, [this, reply](){
+        releaseReply(reply);
+    });
+
+    m_endpoints[key].queuedReplies.enqueue(reply);
+    startQueuedRequests(key);
+}
+
+void Coap::startQueuedRequests(const QString &key)
+{
+    Endpoint &endpoint = m_endpoints[key];
+    while (!endpoint.queuedReplies.isEmpty() && endpoint.activeReplies.count() < m_maxConcurrentRequests) {
+        CoapReply *reply = endpoint.queuedReplies.dequeue();
+        endpoint.activeReplies.append(reply);
+        lookupHost(reply);
+    }
+}
+
+void Coap::releaseReply(CoapReply *reply)
+{
+    if (!m_replyContexts.contains(reply))
+        return;
+
+    ReplyContext context = m_replyContexts.take(reply);
+    QString key = context.endpointKey;
+
+    // Note: the reply might be in destruction already, only compare the pointer
+    if (context.hasMessageId && m_messageIdReplies.value(context.messageId) == reply)
+        m_messageIdReplies.remove(context.messageId);
+
+    foreach (const QByteArray &token, context.tokens) {
+        if (m_tokenReplies.value(token) == reply) {
+            m_tokenReplies.remove(token);
+        }
+    }
+    if (context.lookupId >= 0 && m_runningHostLookups.value(context.lookupId) == reply)
+        m_runningHostLookups.remove(context.lookupId);
+
+    Endpoint &endpoint = m_endpoints[key];
+    endpoint.queuedReplies.removeAll(reply);
+    if (endpoint.activeReplies.removeAll(reply) > 0) {
+        startQueuedRequests(key);
+    }
+    if (endpoint.activeReplies.isEmpty() && endpoint.queuedReplies.isEmpty()) {
+        m_endpoints.remove(key);
+    }
+}
+
+void Coap::setReplyMessageId(CoapReply *reply, quint16 messageId)
 {
-    int lookupId = QHostInfo::lookupHost(m_reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
-    m_runningHostLookups.insert(lookupId, m_reply);
+    if (m_messageIdReplies.value(reply->messageId()) == reply)
+        m_messageIdReplies.remove(reply->messageId());
+
+    reply->setMessageId(messageId);
+    m_messageIdReplies.insert(messageId, reply);
+
+    QHash<CoapReply *, ReplyContext>::iterator context = m_replyContexts.find(reply);
+    if (context != m_replyContexts.end()) {
+        context->hasMessageId = true;
+        context->messageId = messageId;
+    }
+}
+
+void Coap::lookupHost(CoapReply *reply)
+{
+    int lookupId = QHostInfo::lookupHost(reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
+    m_runningHostLookups.insert(lookupId, reply);
+    m_replyContexts[reply].lookupId = lookupId;
 }
 
 void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
@@ -307,8 +365,14 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
     CoapPdu pdu;
     pdu.setMessageType(reply->request().messageType());
     pdu.setStatusCode(reply->requestMethod());
-    pdu.createMessageId();
-    pdu.createToken();
+
+    // Message ID and token have to be unique among the outstanding requests
+    do {
+        pdu.createMessageId();
+    } while (m_messageIdReplies.contains(pdu.messageId()));
+    do {
+        pdu.createToken();
+    } while (m_tokenReplies.contains(pdu.token()) || m_observeResources.contains(pdu.token()));
 
     // Add the options in correct order
     // Option number 3
@@ -368,8 +432,10 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
 
     QByteArray pduData = pdu.pack();
     reply->setRequestData(pduData);
-    reply->setMessageId(pdu.messageId());
+    setReplyMessageId(reply, pdu.messageId());
     reply->setMessageToken(pdu.token());
+    m_tokenReplies.insert(pdu.token(), reply);
+    m_replyContexts[reply].tokens.append(pdu.token());
     reply->m_lockedUp = lookedUp;
     reply->m_timer->start();
 
@@ -394,31 +460,64 @@ void Coap::sendCoapPdu(const QHostAddress &hostAddress, const quint16 &port, con
     m_socket->writeDatagram(pdu.pack(), hostAddress, port);
 }
 
-void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
+void Coap::sendEmptyMessage(const QHostAddress &hostAddress, const quint16 &port, const CoapPdu::MessageType &messageType, quint16 messageId, const QByteArray &token)
 {
-    // if we are waiting for a reply response
-    if (m_reply) {
-        qCDebug(dcCoap) << "<---" << QString("%1:%2").arg(address.toString()).arg(QString::number(port)) << pdu;
-        if (!pdu.isValid()) {
-            qCWarning(dcCoap) << "Got invalid PDU";
-            m_reply->setError(CoapReply::InvalidPduError);
-            m_reply->setFinished();
-            return;
-        }
+    m_pduBuilder.begin(messageType, CoapPdu::Empty, messageId, token);
+    m_socket->writeDatagram(m_pduBuilder.data(), hostAddress, port);
+}
 
-        // check if the message is a response to a reply (message id based check)
-        if (m_reply->messageId() == pdu.messageId()) {
-            processIdBasedResponse(m_reply, pdu);
-            return;
+bool Coap::isPlainNotification(const CoapPduView &view) const
+{
+    if (!view.isValid() || m_observerReply)
+        return false;
+
+    if ((view.messageType() == CoapPdu::Acknowledgement || view.messageType() == CoapPdu::Reset) && m_messageIdReplies.contains(view.messageId()))
+        return false;
+
+    QByteArray token = view.token();
+    return !m_tokenReplies.contains(token) && m_observeResources.contains(token) && !view.hasOption(CoapOption::Block2);
+}
+
+/* Message ids and tokens are only unique per endpoint. Responses from any other address or port
+   don't belong to the reply, even if they carry the same message id or token. */
+bool Coap::isFromReplyEndpoint(CoapReply *reply, const QHostAddress &address, quint16 port) const
+{
+    if (reply->hostAddress().isMulticast())
+        return true;
+
+    return reply->port() == port && reply->hostAddress().isEqual(address, QHostAddress::ConvertV4MappedToIPv4);
+}
+
+void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
+{
+    qCDebug(dcCoap) << "<---" << QString("%1:%2").arg(address.toString()).arg(QString::number(port)) << pdu;
+
+    if (!pdu.isValid()) {
+        qCWarning(dcCoap) << "Got invalid PDU";
+        CoapReply *reply = m_messageIdReplies.value(pdu.messageId());
+        if (reply && isFromReplyEndpoint(reply, address, port)) {
+            reply->setError(CoapReply::InvalidPduError);
+            reply->setFinished();
         }
+        return;
+    }
 
-        // check if we know the message by token (message token based check)
-        if (m_reply->messageToken() == pdu.token()) {
-            processTokenBasedResponse(m_reply, pdu);
+    // check if the message is a response to a request (message id based check). Only acknowledgements
+    // and resets carry our message id, other messages use the message id space of the server.
+    if (pdu.messageType() == CoapPdu::Acknowledgement || pdu.messageType() == CoapPdu::Reset) {
+        CoapReply *reply = m_messageIdReplies.value(pdu.messageId());
+        if (reply && isFromReplyEndpoint(reply, address, port)) {
+            processIdBasedResponse(reply, pdu);
             return;
         }
     }
 
+    // check if we know the message by token (message token based check)
+    CoapReply *reply = m_tokenReplies.value(pdu.token());
+    if (reply && isFromReplyEndpoint(reply, address, port)) {
+        processTokenBasedResponse(reply, pdu);
+        return;
+    }
 
     if (m_observerReply) {
         processBlock2Notification(m_observerReply, pdu);
@@ -426,17 +525,13 @@ void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, cons
     }
 
     // check if this is a notification
-    if (m_observeResources.keys().contains(pdu.token())) {
+    if (m_observeResources.contains(pdu.token())) {
         processNotification(pdu, address, port);
         return;
     }
 
     qCDebug(dcCoap) << "Got message without request or registered observe resource." << endl << "<---" << pdu;
-    CoapPdu responsePdu;
-    responsePdu.setMessageType(CoapPdu::Reset);
-    responsePdu.setMessageId(pdu.messageId());
-    responsePdu.setToken(pdu.token());
-    sendCoapPdu(address, port, responsePdu);
+    sendEmptyMessage(address, port, CoapPdu::Reset, pdu.messageId(), pdu.token());
 }
 
 void Coap::processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu)
@@ -470,11 +565,7 @@ void Coap::processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu)
 void Coap::processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu)
 {
     // Separate Response
-    CoapPdu responsePdu;
-    responsePdu.setMessageType(CoapPdu::Acknowledgement);
-    responsePdu.setStatusCode(CoapPdu::Empty);
-    responsePdu.setMessageId(pdu.messageId());
-    sendCoapPdu(reply->hostAddress(), reply->port(), responsePdu);
+    sendEmptyMessage(reply->hostAddress(), reply->port(), CoapPdu::Acknowledgement, pdu.messageId());
 
     reply->setStatusCode(pdu.statusCode());
     reply->setContentType(pdu.contentType());
@@ -485,24 +576,18 @@ void Coap::processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu)
 void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
 {
     CoapObserveResource resource = m_observeResources.value(pdu.token());
-    qCDebug(dcCoap) << "<--- Notification" << endl << pdu;
 
     // check if it is a blockwise notification
     if (pdu.hasOption(CoapOption::Block2)) {
         if (!m_observeReplyResource.values().contains(resource)) {
 
+            qCDebug(dcCoap) << "<--- Notification" << endl << pdu;
             qCDebug(dcCoap) << "Got first part of blocked notification";
 
             // First part of the blocked notification
             // respond with ACK
-            CoapPdu responsePdu;
-            responsePdu.setMessageType(CoapPdu::Acknowledgement);
-            responsePdu.setStatusCode(CoapPdu::Empty);
-            responsePdu.setMessageId(pdu.messageId());
-            responsePdu.setToken(pdu.token());
-
-            qCDebug(dcCoap) << "---> Notification" << endl << responsePdu;
-            sendCoapPdu(address, port, responsePdu);
+            qCDebug(dcCoap) << "---> Notification ACK" << pdu.messageId();
+            sendEmptyMessage(address, port, CoapPdu::Acknowledgement, pdu.messageId(), pdu.token());
 
             // create reply for blockwise transfere
             if (!m_observerReply.isNull()) {
@@ -565,24 +650,24 @@ void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address,
         }
     }
 
-    // respond with ACK
-    CoapPdu responsePdu;
-    responsePdu.setMessageType(CoapPdu::Acknowledgement);
-    responsePdu.setStatusCode(CoapPdu::Empty);
-    responsePdu.setMessageId(pdu.messageId());
-    responsePdu.setToken(pdu.token());
+    // Everything else is acknowledged and delivered like a plain notification
+    processNotification(CoapPduView(pdu.pack()), address, port);
+}
+
+void Coap::processNotification(const CoapPduView &view, const QHostAddress &address, const quint16 &port)
+{
+    CoapObserveResource resource = m_observeResources.value(view.token());
+    qCDebug(dcCoap) << "<--- Notification" << view;
 
-    qCDebug(dcCoap) << "---> Notification" << endl << responsePdu;
-    sendCoapPdu(address, port, responsePdu);
+    qCDebug(dcCoap) << "---> Notification ACK" << view.messageId();
+    sendEmptyMessage(address, port, CoapPdu::Acknowledgement, view.messageId(), view.token());
 
+    CoapPduView::Option observeOption;
     int notificationNumber = 0;
-    foreach (const CoapOption &option, pdu.options()) {
-        if (option.option() == CoapOption::Observe) {
-            notificationNumber = option.data().toHex().toInt(0, 16);
-        }
-    }
+    if (view.findOption(CoapOption::Observe, &observeOption))
+        notificationNumber = observeOption.toUInt();
 
-    emit notificationReceived(resource, notificationNumber, pdu.payload());
+    emit notificationReceived(resource, notificationNumber, view.payload());
 }
 
 void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
@@ -643,7 +728,7 @@ void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
     reply->m_timer->start();
     reply->m_retransmissions = 1;
 
-    reply->setMessageId(nextBlockRequest.messageId());
+    setReplyMessageId(reply, nextBlockRequest.messageId());
 
     qCDebug(dcCoap) << "--->" << nextBlockRequest;
     sendData(reply->hostAddress(), reply->port(), pduData);
@@ -695,7 +780,7 @@ void Coap::processBlock2Response(CoapReply *reply, const CoapPdu &pdu)
     reply->setRequestData(pduData);
     reply->m_timer->start();
 
-    reply->setMessageId(nextBlockRequest.messageId());
+    setReplyMessageId(reply, nextBlockRequest.messageId());
 
     qCDebug(dcCoap) << "--->" << nextBlockRequest;
     sendData(reply->hostAddress(), reply->port(), pduData);
@@ -714,14 +799,8 @@ void Coap::processBlock2Notification(CoapReply *reply, const CoapPdu &pdu)
     // check if this was the last block
     if (!pdu.block().moreFlag()) {
         // respond with ACK
-        CoapPdu responsePdu;
-        responsePdu.setMessageType(CoapPdu::Acknowledgement);
-        responsePdu.setStatusCode(CoapPdu::Empty);
-        responsePdu.setMessageId(pdu.messageId());
-        responsePdu.setToken(pdu.token());
-
-        qCDebug(dcCoap) << "---> Notification" << endl << responsePdu;
-        sendCoapPdu(reply->hostAddress(), reply->port(), responsePdu);
+        qCDebug(dcCoap) << "---> Notification ACK" << pdu.messageId();
+        sendEmptyMessage(reply->hostAddress(), reply->port(), CoapPdu::Acknowledgement, pdu.messageId(), pdu.token());
 
         reply->appendPayloadData(pdu.payload());
 
@@ -776,7 +855,12 @@ void Coap::processBlock2Notification(CoapReply *reply, const CoapPdu &pdu)
 
 void Coap::hostLookupFinished(const QHostInfo &hostInfo)
 {
-    CoapReply *reply = m_runningHostLookups.take(hostInfo.lookupId());;
+    CoapReply *reply = m_runningHostLookups.take(hostInfo.lookupId());
+    if (!reply) {
+        // The reply has been deleted in the meantime
+        return;
+    }
+
     reply->setPort(reply->request().url().port(5683));
 
     if (hostInfo.error() != QHostInfo::NoError) {
@@ -804,13 +888,21 @@ void Coap::onReadyRead()
     QByteArray data;
     quint16 port;
 
+    // With several requests in flight, more than one response may be pending
     while (m_socket->hasPendingDatagrams()) {
         data.resize(m_socket->pendingDatagramSize());
         m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
-    }
 
-    CoapPdu pdu(data);
-    processResponse(pdu, hostAddress, port);
+        // Observe notifications are the bulk of the incoming traffic, handle them straight from the datagram
+        CoapPduView view(data);
+        if (isPlainNotification(view)) {
+            processNotification(view, hostAddress, port);
+            continue;
+        }
+
+        CoapPdu pdu(data);
+        processResponse(pdu, hostAddress, port);
+    }
 }
 
 void Coap::onReplyTimeout()
@@ -820,6 +912,9 @@ void Coap::onReplyTimeout()
         qCDebug(dcCoap) << QString("Reply timeout: resending message %1/4").arg(reply->m_retransmissions);
     }
     reply->resend();
+    if (reply->isFinished())
+        return;
+
     m_socket->writeDatagram(reply->requestData(), reply->hostAddress(), reply->port());
 }
 
@@ -835,16 +930,10 @@ void Coap::onReplyFinished()
         return;
     }
 
-    if (reply != m_reply)
+    if (!m_replyContexts.contains(reply))
         qCWarning(dcCoap) << "This should never happen!! Please report a bug if you get this message!";
 
+    // Free the slot of this endpoint before the reply gets handed out, it may be deleted right away
+    releaseReply(reply);
     emit replyFinished(reply);
-    m_reply.clear();
-
-    // check if there is a request in the queue
-    if (!m_replyQueue.isEmpty()) {
-        m_reply = m_replyQueue.dequeue();
-        if (m_reply)
-            lookupHost();
-    }
 }
@@ -43,6 +43,9 @@
 #include "coaprequest.h"
 #include "coapreply.h"
 #include "coapobserveresource.h"
+#include "coappdubuilder.h"
+
+class CoapPduView;
 
 /* Information about CoAP
  *
@@ -70,12 +73,36 @@ public:
     CoapReply *enableResourceNotifications(const CoapRequest &request);
     CoapReply *disableNotifications(const CoapRequest &request);
 
+    int maxConcurrentRequests() const;
+    void setMaxConcurrentRequests(int maxConcurrentRequests);
 
 private:
-    QUdpSocket *m_socket;
+    class Endpoint
+    {
+    public:
+        QList<CoapReply *> activeReplies;
+        QQueue<CoapReply *> queuedReplies;
+    };
 
-    QPointer<CoapReply> m_reply;
-    QQueue<CoapReply *> m_replyQueue;
+    QUdpSocket *m_socket;
+    CoapPduBuilder m_pduBuilder;
+
+    int m_maxConcurrentRequests = 1;
+    QHash<QString, Endpoint> m_endpoints;                               // host:port | endpoint
+    // Everything a started reply is registered with, so it can be released without scanning all outstanding replies
+    class ReplyContext
+    {
+    public:
+        QString endpointKey;                                            // host:port
+        bool hasMessageId = false;
+        quint16 messageId = 0;
+        QList<QByteArray> tokens;
+        int lookupId = -1;
+    };
+
+    QHash<CoapReply *, ReplyContext> m_replyContexts;                   // reply | context
+    QHash<quint16, CoapReply *> m_messageIdReplies;                     // message id | outstanding reply
+    QHash<QByteArray, CoapReply *> m_tokenReplies;                      // token | outstanding reply
 
     QHash<int, CoapReply *> m_runningHostLookups;
 
@@ -86,16 +113,26 @@ private:
     QHash<CoapReply *, CoapObserveResource> m_observeReplyResource;     // observe reply | resource
     QHash<CoapReply *, int> m_observeBlockwise;                         // observe reply | observe nr.
 
-    void lookupHost();
+    void startRequest(CoapReply *reply);
+    void startQueuedRequests(const QString &key);
+    void releaseReply(CoapReply *reply);
+    void setReplyMessageId(CoapReply *reply, quint16 messageId);
+
+    void lookupHost(CoapReply *reply);
     void sendRequest(CoapReply *reply, const bool &lookedUp = false);
     void sendData(const QHostAddress &hostAddress, const quint16 &port, const QByteArray &data);
     void sendCoapPdu(const QHostAddress &address, const quint16 &port, const CoapPdu &pdu);
+    void sendEmptyMessage(const QHostAddress &hostAddress, const quint16 &port, const CoapPdu::MessageType &messageType, quint16 messageId, const QByteArray &token = QByteArray());
+
+    bool isPlainNotification(const CoapPduView &view) const;
 
+    bool isFromReplyEndpoint(CoapReply *reply, const QHostAddress &address, quint16 port) const;
     void processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
     void processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu);
     void processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu);
 
     void processNotification(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
+    void processNotification(const CoapPduView &view, const QHostAddress &address, const quint16 &port);
 
     void processBlock1Response(CoapReply *reply, const CoapPdu &pdu);
     void processBlock2Response(CoapReply *reply, const CoapPdu &pdu);
@@ -9,6 +9,8 @@ DEPENDPATH += $$PWD
 HEADERS += \
     $$PWD/coap.h \
     $$PWD/coappdu.h \
+    $$PWD/coappduview.h \
+    $$PWD/coappdubuilder.h \
     $$PWD/coapoption.h \
     $$PWD/coaprequest.h \
     $$PWD/coapreply.h \
@@ -20,6 +22,8 @@ HEADERS += \
 SOURCES += \
     $$PWD/coap.cpp \
     $$PWD/coappdu.cpp \
+    $$PWD/coappduview.cpp \
+    $$PWD/coappdubuilder.cpp \
     $$PWD/coapoption.cpp \
     $$PWD/coaprequest.cpp \
     $$PWD/coapreply.cpp \
@@ -35,6 +35,9 @@
     \ingroup coap-group
     \inmodule libnymea
 
+    CoapPdu is a value type holding all fields of a message, including copies of its options and payload.
+    For parsing received datagrams without copying them see \l{CoapPduView}, for serializing into a
+    reusable buffer see \l{CoapPduBuilder}.
 */
 
 /*! \enum CoapPdu::MessageType
@@ -160,13 +163,14 @@
 
 #include "coappdu.h"
 #include "coapoption.h"
+#include "coappduview.h"
+#include "coappdubuilder.h"
 
 #include <QMetaEnum>
 #include <QTime>
 
-/*! Constructs a CoapPdu with the given \a parent. */
-CoapPdu::CoapPdu(QObject *parent) :
-    QObject(parent),
+/*! Constructs an empty CoapPdu. */
+CoapPdu::CoapPdu() :
     m_version(1),
     m_messageType(Confirmable),
     m_statusCode(Empty),
@@ -175,12 +179,11 @@ CoapPdu::CoapPdu(QObject *parent) :
     m_payload(QByteArray()),
     m_error(NoError)
 {
-    qsrand(QDateTime::currentMSecsSinceEpoch());
+
 }
 
-/*! Constructs a CoapPdu from the given \a data with the given \a parent. */
-CoapPdu::CoapPdu(const QByteArray &data, QObject *parent) :
-    QObject(parent),
+/*! Constructs a CoapPdu from the given \a data. */
+CoapPdu::CoapPdu(const QByteArray &data) :
     m_version(1),
     m_messageType(Confirmable),
     m_statusCode(Empty),
@@ -189,10 +192,29 @@ CoapPdu::CoapPdu(const QByteArray &data, QObject *parent) :
     m_payload(QByteArray()),
     m_error(NoError)
 {
-    qsrand(QDateTime::currentMSecsSinceEpoch());
     unpack(data);
 }
 
+/*! \obsolete
+    Constructs an empty CoapPdu. The \a parent is ignored: CoapPdu is a value type and
+    no longer a QObject. Use CoapPdu() instead.
+*/
+CoapPdu::CoapPdu(QObject *parent) :
+    CoapPdu()
+{
+    Q_UNUSED(parent)
+}
+
+/*! \obsolete
+    Constructs a CoapPdu from the given \a data. The \a parent is ignored: CoapPdu is a value
+    type and no longer a QObject. Use CoapPdu(const QByteArray &data) instead.
+*/
+CoapPdu::CoapPdu(const QByteArray &data, QObject *parent) :
+    CoapPdu(data)
+{
+    Q_UNUSED(parent)
+}
+
 /*! Returns the human readable status code for the given \a statusCode. */
 QString CoapPdu::getStatusCodeString(const CoapPdu::StatusCode &statusCode)
 {
@@ -357,12 +379,10 @@ void CoapPdu::addOption(const CoapOption::Option &option, const QByteArray &data
     }
 
     // insert option (keep the list sorted to ensure a positiv option delta)
-    int index = 0;
+    int index = m_options.length();
     for (int i = 0; i < m_options.length(); i ++) {
-        index = i;
-        if (m_options.at(i).option() <= option) {
-            continue;
-        } else {
+        if (m_options.at(i).option() > option) {
+            index = i;
             break;
         }
     }
@@ -370,7 +390,7 @@ void CoapPdu::addOption(const CoapOption::Option &option, const QByteArray &data
     CoapOption o;
     o.setOption(option);
     o.setData(data);
-    m_options.insert(index + 1, o);
+    m_options.insert(index, o);
 }
 
 /*! Returns the block of this \l{CoapPdu}. */
@@ -412,163 +432,41 @@ bool CoapPdu::isValid() const
 /*! Returns the packed \l{CoapPdu} as byte array which are ready to send to the server.*/
 QByteArray CoapPdu::pack() const
 {
-    QByteArray pduData;
-
-    // header
-    QByteArray header;
-    header.resize(4);
-    header.fill('0');
-    quint8 *rawHeader = (quint8 *)header.data();
-    rawHeader[0] = m_version << 6;
-    rawHeader[0] |= (quint8)m_messageType << 4;
-    rawHeader[0] |= (quint8)m_token.size();
-    rawHeader[1] = (quint8)m_statusCode;
-    rawHeader[2] = (quint8)(m_messageId >> 8);
-    rawHeader[3] = (quint8)(m_messageId & 0xff);
-    pduData = QByteArray::fromRawData((char *)rawHeader, 4);
-
-    // token
-    pduData.append(m_token);
-
-    // options
-    QByteArray optionsData;
-    quint8 prevOption = 0;
+    int size = 5 + m_token.size() + m_payload.size();
     foreach (const CoapOption &option, m_options) {
-        quint8 optionByte = 0;
-
-        // encode option delta
-        quint16 optionDelta = (quint8)option.option() - prevOption;
-        prevOption = (quint8)option.option();
-
-        quint8 extendedOptionDeltaByte = 0;
-        quint16 bigExtendedOptionDeltaByte = 0;
-        if (optionDelta < 13) {
-            optionByte = optionDelta << 4;
-        } else if (optionDelta < 270) {
-            // extended 8 bit option delta
-            optionByte = 13 << 4;
-            extendedOptionDeltaByte = optionDelta - 13;
-        } else {
-            // extended 16 bit option delta
-            optionByte = 14 << 4;
-            bigExtendedOptionDeltaByte = ((optionDelta - 269) >> 8) & 0xff;
-            bigExtendedOptionDeltaByte = (optionDelta - 269) & 0xff;
-        }
-
-        // encode option length
-        int optionLength = option.data().length();
-        quint8 extendedOptionLengthByte = 0;
-        quint16 bigExtendedOptionLengthByte = 0;
-        if (optionLength < 13) {
-            optionByte |= optionLength;
-        } else if (optionLength < 270) {
-            // extended 8 bit option length
-            optionByte |= 13;
-            extendedOptionLengthByte = optionLength - 13;
-        } else {
-            // extended 16 bit option length
-            optionByte |= 14;
-            bigExtendedOptionLengthByte = ((optionLength - 269) >> 8) & 0xff;
-            bigExtendedOptionLengthByte = (optionLength - 269) & 0xff;
-        }
-
-        // add obligatory option byte
-        pduData.append((char)optionByte);
-
-        // check extended option delta bytes
-        if (extendedOptionDeltaByte != 0)
-            pduData.append((char)extendedOptionDeltaByte);
-
-        if (bigExtendedOptionDeltaByte != 0)
-            pduData.append((char)bigExtendedOptionDeltaByte);
-
-        // check extended option length bytes
-        if (extendedOptionLengthByte != 0)
-            pduData.append((char)extendedOptionLengthByte);
-
-        if (bigExtendedOptionLengthByte != 0)
-            pduData.append((char)extendedOptionLengthByte);
-
-        // add the option data
-        pduData.append(option.data());
+        size += 5 + option.data().size();
     }
-    pduData.append(optionsData);
 
-    if (!m_payload.isEmpty()) {
-        pduData.append((char)255);
-        pduData.append(m_payload.data());
+    CoapPduBuilder builder(size);
+    builder.begin(m_messageType, m_statusCode, m_messageId, m_token, m_version);
+    foreach (const CoapOption &option, m_options) {
+        builder.addOption(option.option(), option.data());
     }
-
-    return pduData;
+    builder.setPayload(m_payload);
+    return builder.data();
 }
 
 void CoapPdu::unpack(const QByteArray &data)
 {
-    // create a CoapPDU
-    if (data.length() < 4) {
-        m_error = InvalidPduSizeError;
-    }
-
-    quint8 *rawData = (quint8 *)data.data();
-    setVersion((rawData[0] & 0xc0) >> 6);
-    setMessageType(static_cast<MessageType>((rawData[0] & 0x30) >> 4));
-    quint8 tokenLength = (rawData[0] & 0xf);
-
-    if (tokenLength > 8) {
-        m_error = InvalidTokenError;
+    CoapPduView view(data);
+    if (data.length() >= 4) {
+        setVersion(view.version());
+        setMessageType(view.messageType());
+        setStatusCode(view.statusCode());
+        setMessageId(view.messageId());
+        setToken(view.token());
     }
 
-    setToken(QByteArray((const char *)rawData + 4, tokenLength));
-    setStatusCode(static_cast<StatusCode>(rawData[1]));
-    setMessageId((qint16)data.mid(2,2).toHex().toUInt(0,16));
-
-    // parse options
-    int index = 4 + tokenLength;
-    quint8 optionByte = rawData[index];
-    quint16 delta = 0;
-    while (QByteArray::number(optionByte, 16) != "ff" && optionByte != 0) {
-        quint16 optionNumber = ((optionByte & 0xf0) >> 4);
-
-        // check option delta
-        if (optionNumber < 13) {
-            delta += optionNumber;
-        } else if (optionNumber == 13) {
-            // extended 8 bit option delta
-            delta += (quint8)(rawData[index + 1] + 13);
-            index += 1;
-        } else if (optionNumber == 14) {
-            // extended 16 bit option delta
-            delta += ((rawData[index + 1] << 8) | rawData[index + 2]) + 269;
-            index += 2;
-        } else if (optionNumber == 15) {
-            m_error = InvalidOptionDeltaError;
-        }
-
-        // check option length
-        quint16 optionLength = (optionByte & 0xf);
-        if (optionLength == 13) {
-            // extended 8 bit option length
-            optionLength = (quint8)(rawData[index + 1] - 13);
-            index += 1;
-        } else if (optionLength == 14) {
-            // extended 16 bit option delta
-            optionLength = ((rawData[index + 1] << 8) | rawData[index + 2]) - 269;
-            index += 2;
-        } else if (optionLength == 15) {
-            m_error = InvalidOptionLengthError;
-        }
+    m_error = view.error();
+    if (!view.isValid())
+        return;
 
-        QByteArray optionData = QByteArray((const char *)rawData + index + 1, optionLength);
-        addOption(static_cast<CoapOption::Option>(delta), optionData);
-
-        index += optionLength + 1;
-        optionByte = rawData[index];
-
-        if (QByteArray::number(optionByte, 16) == "ff") {
-            setPayload(data.right(data.length() - index - 1));
-            break;
-        }
+    CoapPduView::OptionIterator it = view.options();
+    while (it.hasNext()) {
+        CoapPduView::Option option = it.next();
+        addOption(option.option(), option.toByteArray());
     }
+    setPayload(view.payload());
 }
 
 /*! Writes the data of the given \a coapPdu to \a dbg.
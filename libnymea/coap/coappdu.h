@@ -53,9 +53,9 @@
  *      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  */
 
-class LIBNYMEA_EXPORT CoapPdu : public QObject
+class LIBNYMEA_EXPORT CoapPdu
 {
-    Q_OBJECT
+    Q_GADGET
     Q_ENUMS(MessageType)
     Q_ENUMS(StatusCode)
     Q_ENUMS(ContentType)
@@ -121,8 +121,10 @@ public:
         UnknownOptionError
     };
 
-    CoapPdu(QObject *parent = 0);
-    CoapPdu(const QByteArray &data, QObject *parent = 0);
+    CoapPdu();
+    CoapPdu(const QByteArray &data);
+    Q_DECL_DEPRECATED explicit CoapPdu(QObject *parent);
+    Q_DECL_DEPRECATED CoapPdu(const QByteArray &data, QObject *parent);
 
     static QString getStatusCodeString(const StatusCode &statusCode);
 
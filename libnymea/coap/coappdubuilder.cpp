@@ -0,0 +1,147 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class CoapPduBuilder
+    \brief Serializes a CoAP protocol data unit (PDU) into a reusable buffer.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    The builder writes the message directly into its buffer while the header, options and payload
+    are added. Calling \l{begin()} starts a new message in the same buffer, so a builder kept around
+    for sending does not allocate once its buffer is large enough.
+
+    Options have to be added in ascending order of their option number, as they are encoded as
+    delta to the previous one.
+
+    \code
+        CoapPduBuilder builder;
+        builder.begin(CoapPdu::Acknowledgement, CoapPdu::Empty, messageId);
+        socket->writeDatagram(builder.data(), address, port);
+    \endcode
+
+    \sa CoapPdu, CoapPduView
+*/
+
+#include "coappdubuilder.h"
+
+static quint8 optionNibble(quint32 value)
+{
+    if (value < 13)
+        return value;
+
+    return value < 269 ? 13 : 14;
+}
+
+static void appendExtended(QByteArray &buffer, quint32 value)
+{
+    if (value < 13)
+        return;
+
+    if (value < 269) {
+        buffer.append(static_cast<char>(value - 13));
+    } else {
+        buffer.append(static_cast<char>(((value - 269) >> 8) & 0xff));
+        buffer.append(static_cast<char>((value - 269) & 0xff));
+    }
+}
+
+/*! Constructs a builder with a buffer of the given \a capacity. The buffer grows as needed. */
+CoapPduBuilder::CoapPduBuilder(int capacity)
+{
+    // Reserving also keeps the capacity when the buffer gets truncated in begin()
+    m_buffer.reserve(capacity);
+}
+
+/*! Starts a new message with the given \a messageType, \a statusCode, \a messageId, \a token and \a version.
+    Anything written before is discarded.
+*/
+void CoapPduBuilder::begin(const CoapPdu::MessageType &messageType, const CoapPdu::StatusCode &statusCode, quint16 messageId, const QByteArray &token, quint8 version)
+{
+    m_buffer.resize(0);
+    m_lastOption = 0;
+    m_hasPayload = false;
+
+    int tokenLength = qMin(token.size(), 8);
+    m_buffer.append(static_cast<char>(((version & 0x03) << 6) | ((static_cast<quint8>(messageType) & 0x03) << 4) | tokenLength));
+    m_buffer.append(static_cast<char>(statusCode));
+    m_buffer.append(static_cast<char>(messageId >> 8));
+    m_buffer.append(static_cast<char>(messageId & 0xff));
+    m_buffer.append(token.constData(), tokenLength);
+}
+
+/*! Appends the given \a option with \a size bytes of \a data. Returns false if the option number is lower
+    than the one of the previous option, if the payload has been set already or if the data is too large.
+*/
+bool CoapPduBuilder::addOption(const CoapOption::Option &option, const char *data, int size)
+{
+    quint16 number = static_cast<quint16>(option);
+    if (m_hasPayload || number < m_lastOption || size < 0 || size > 0xffff + 269)
+        return false;
+
+    quint32 delta = number - m_lastOption;
+    m_lastOption = number;
+
+    m_buffer.append(static_cast<char>((optionNibble(delta) << 4) | optionNibble(size)));
+    appendExtended(m_buffer, delta);
+    appendExtended(m_buffer, size);
+    m_buffer.append(data, size);
+    return true;
+}
+
+/*! Appends the given \a option with the given \a data. */
+bool CoapPduBuilder::addOption(const CoapOption::Option &option, const QByteArray &data)
+{
+    return addOption(option, data.constData(), data.size());
+}
+
+/*! Sets the payload to \a size bytes of \a data. This finishes the message, no options can be added afterwards. */
+void CoapPduBuilder::setPayload(const char *data, int size)
+{
+    if (m_hasPayload || size <= 0)
+        return;
+
+    m_buffer.append(static_cast<char>(0xff));
+    m_buffer.append(data, size);
+    m_hasPayload = true;
+}
+
+/*! Sets the given \a payload. */
+void CoapPduBuilder::setPayload(const QByteArray &payload)
+{
+    setPayload(payload.constData(), payload.size());
+}
+
+/*! Returns the serialized message. The data stays valid until the next call to \l{begin()}. */
+const QByteArray &CoapPduBuilder::data() const
+{
+    return m_buffer;
+}
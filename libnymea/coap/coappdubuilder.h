@@ -0,0 +1,61 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPPDUBUILDER_H
+#define COAPPDUBUILDER_H
+
+#include <QByteArray>
+
+#include "libnymea.h"
+#include "coappdu.h"
+#include "coapoption.h"
+
+class LIBNYMEA_EXPORT CoapPduBuilder
+{
+public:
+    explicit CoapPduBuilder(int capacity = 256);
+
+    void begin(const CoapPdu::MessageType &messageType, const CoapPdu::StatusCode &statusCode, quint16 messageId, const QByteArray &token = QByteArray(), quint8 version = 1);
+
+    bool addOption(const CoapOption::Option &option, const char *data, int size);
+    bool addOption(const CoapOption::Option &option, const QByteArray &data);
+
+    void setPayload(const char *data, int size);
+    void setPayload(const QByteArray &payload);
+
+    const QByteArray &data() const;
+
+private:
+    QByteArray m_buffer;
+    quint16 m_lastOption = 0;
+    bool m_hasPayload = false;
+};
+
+#endif // COAPPDUBUILDER_H
@@ -0,0 +1,354 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class CoapPduView
+    \brief A read only view on a received CoAP protocol data unit (PDU).
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    Unlike \l{CoapPdu}, the view does not copy anything out of the datagram. The header is
+    read and the option list is validated once on construction, without allocating. Options
+    are decoded on demand while iterating over them with \l{options()}, and their data points
+    into the datagram held by the view.
+
+    \code
+        CoapPduView view(datagram);
+        if (!view.isValid())
+            return;
+
+        CoapPduView::OptionIterator it = view.options();
+        while (it.hasNext()) {
+            CoapPduView::Option option = it.next();
+            qDebug() << option.option() << option.toByteArray();
+        }
+    \endcode
+
+    \sa CoapPdu, CoapPduBuilder
+*/
+
+/*! \class CoapPduView::Option
+    \brief A single option of a \l{CoapPduView}.
+
+    \inmodule libnymea
+
+    The option data points into the datagram of the view it has been read from and is only valid as long as that view exists.
+*/
+
+/*! \class CoapPduView::OptionIterator
+    \brief Iterates over the options of a \l{CoapPduView} in the order they appear in the datagram.
+
+    \inmodule libnymea
+*/
+
+#include "coappduview.h"
+
+/*! Returns the option number as \l{CoapOption::Option}. */
+CoapOption::Option CoapPduView::Option::option() const
+{
+    return static_cast<CoapOption::Option>(m_number);
+}
+
+/*! Returns the option number. */
+quint16 CoapPduView::Option::number() const
+{
+    return m_number;
+}
+
+/*! Returns a pointer to the option data within the datagram. */
+const char *CoapPduView::Option::data() const
+{
+    return m_data;
+}
+
+/*! Returns the length of the option data. */
+int CoapPduView::Option::size() const
+{
+    return m_size;
+}
+
+/*! Returns a copy of the option data. */
+QByteArray CoapPduView::Option::toByteArray() const
+{
+    return QByteArray(m_data, m_size);
+}
+
+/*! Returns the option data interpreted as unsigned integer in network byte order (e.g. for Observe or Max-Age). */
+quint32 CoapPduView::Option::toUInt() const
+{
+    quint32 value = 0;
+    for (int i = 0; i < m_size && i < 4; i++) {
+        value = (value << 8) | static_cast<quint8>(m_data[i]);
+    }
+    return value;
+}
+
+/*! Returns true if there are more options to read. */
+bool CoapPduView::OptionIterator::hasNext() const
+{
+    return m_position < m_end;
+}
+
+/*! Returns the next option and advances the iterator. */
+CoapPduView::Option CoapPduView::OptionIterator::next()
+{
+    Option option;
+    // The options have been validated when the view was created
+    CoapPduView::readOption(&m_position, m_end, &m_number, &option);
+    return option;
+}
+
+/*! Constructs an empty, invalid view. */
+CoapPduView::CoapPduView()
+{
+}
+
+/*! Constructs a view on the given \a data. The view shares the data, no copy is made. */
+CoapPduView::CoapPduView(const QByteArray &data) :
+    m_data(data)
+{
+    if (m_data.size() < 4)
+        return;
+
+    const uchar *rawData = reinterpret_cast<const uchar *>(m_data.constData());
+    m_tokenLength = rawData[0] & 0x0f;
+    if (m_tokenLength > 8) {
+        m_tokenLength = 0;
+        m_error = CoapPdu::InvalidTokenError;
+        return;
+    }
+
+    if (4 + m_tokenLength > m_data.size())
+        return;
+
+    // Walk over the options once to make sure they are well formed and to find the payload
+    const uchar *position = rawData + 4 + m_tokenLength;
+    const uchar *end = rawData + m_data.size();
+    quint16 number = 0;
+    while (position < end && *position != 0xff) {
+        CoapPdu::Error error = readOption(&position, end, &number, nullptr);
+        if (error != CoapPdu::NoError) {
+            m_error = error;
+            return;
+        }
+    }
+
+    m_optionsEnd = position - rawData;
+    if (position < end) {
+        // A payload marker followed by an empty payload is a format error
+        if (position + 1 == end)
+            return;
+
+        m_payloadOffset = m_optionsEnd + 1;
+    } else {
+        m_payloadOffset = m_data.size();
+    }
+    m_error = CoapPdu::NoError;
+}
+
+/*! Returns true if the datagram is a well formed CoAP message. */
+bool CoapPduView::isValid() const
+{
+    return m_error == CoapPdu::NoError;
+}
+
+/*! Returns the reason why the datagram could not be parsed. */
+CoapPdu::Error CoapPduView::error() const
+{
+    return m_error;
+}
+
+/*! Returns the CoAP version of the message. */
+quint8 CoapPduView::version() const
+{
+    return m_data.size() < 4 ? 0 : (static_cast<quint8>(m_data.at(0)) & 0xc0) >> 6;
+}
+
+/*! Returns the \l{CoapPdu::MessageType} of the message. */
+CoapPdu::MessageType CoapPduView::messageType() const
+{
+    return m_data.size() < 4 ? CoapPdu::Confirmable : static_cast<CoapPdu::MessageType>((static_cast<quint8>(m_data.at(0)) & 0x30) >> 4);
+}
+
+/*! Returns the \l{CoapPdu::StatusCode} of the message. */
+CoapPdu::StatusCode CoapPduView::statusCode() const
+{
+    return m_data.size() < 4 ? CoapPdu::Empty : static_cast<CoapPdu::StatusCode>(static_cast<quint8>(m_data.at(1)));
+}
+
+/*! Returns the message ID of the message. */
+quint16 CoapPduView::messageId() const
+{
+    if (m_data.size() < 4)
+        return 0;
+
+    return (static_cast<quint8>(m_data.at(2)) << 8) | static_cast<quint8>(m_data.at(3));
+}
+
+/*! Returns a copy of the token of the message. */
+QByteArray CoapPduView::token() const
+{
+    if (4 + m_tokenLength > m_data.size())
+        return QByteArray();
+
+    return QByteArray(m_data.constData() + 4, m_tokenLength);
+}
+
+/*! Returns an iterator over the options of the message. The iterator is empty for an invalid message. */
+CoapPduView::OptionIterator CoapPduView::options() const
+{
+    OptionIterator iterator;
+    if (!isValid())
+        return iterator;
+
+    const uchar *rawData = reinterpret_cast<const uchar *>(m_data.constData());
+    iterator.m_position = rawData + 4 + m_tokenLength;
+    iterator.m_end = rawData + m_optionsEnd;
+    return iterator;
+}
+
+/*! Returns true if the message contains the given \a option. The first occurrence of the option is stored in \a result if given. */
+bool CoapPduView::findOption(const CoapOption::Option &option, CoapPduView::Option *result) const
+{
+    OptionIterator iterator = options();
+    while (iterator.hasNext()) {
+        Option current = iterator.next();
+        if (current.number() == option) {
+            if (result)
+                *result = current;
+
+            return true;
+        }
+        // Options are ordered by their number
+        if (current.number() > option) {
+            break;
+        }
+    }
+    return false;
+}
+
+/*! Returns true if the message contains the given \a option. */
+bool CoapPduView::hasOption(const CoapOption::Option &option) const
+{
+    return findOption(option);
+}
+
+/*! Returns a pointer to the payload within the datagram. */
+const char *CoapPduView::payloadData() const
+{
+    return m_data.constData() + m_payloadOffset;
+}
+
+/*! Returns the size of the payload. */
+int CoapPduView::payloadSize() const
+{
+    return isValid() ? m_data.size() - m_payloadOffset : 0;
+}
+
+/*! Returns a copy of the payload. */
+QByteArray CoapPduView::payload() const
+{
+    return QByteArray(payloadData(), payloadSize());
+}
+
+/*! Returns the datagram this view has been created on. */
+QByteArray CoapPduView::data() const
+{
+    return m_data;
+}
+
+CoapPdu::Error CoapPduView::readOption(const uchar **position, const uchar *end, quint16 *number, CoapPduView::Option *option)
+{
+    const uchar *current = *position;
+    quint32 delta = *current >> 4;
+    quint32 length = *current & 0x0f;
+    current++;
+
+    // https://tools.ietf.org/html/rfc7252#section-3.1
+    if (delta == 15)
+        return CoapPdu::InvalidOptionDeltaError;
+
+    if (length == 15)
+        return CoapPdu::InvalidOptionLengthError;
+
+    if (delta == 13) {
+        if (end - current < 1)
+            return CoapPdu::InvalidOptionDeltaError;
+
+        delta = current[0] + 13;
+        current += 1;
+    } else if (delta == 14) {
+        if (end - current < 2)
+            return CoapPdu::InvalidOptionDeltaError;
+
+        delta = ((current[0] << 8) | current[1]) + 269;
+        current += 2;
+    }
+
+    if (length == 13) {
+        if (end - current < 1)
+            return CoapPdu::InvalidOptionLengthError;
+
+        length = current[0] + 13;
+        current += 1;
+    } else if (length == 14) {
+        if (end - current < 2)
+            return CoapPdu::InvalidOptionLengthError;
+
+        length = ((current[0] << 8) | current[1]) + 269;
+        current += 2;
+    }
+
+    if (static_cast<quint32>(end - current) < length)
+        return CoapPdu::InvalidOptionLengthError;
+
+    if (*number + delta > 0xffff)
+        return CoapPdu::InvalidOptionDeltaError;
+
+    *number += delta;
+    if (option) {
+        option->m_number = *number;
+        option->m_data = reinterpret_cast<const char *>(current);
+        option->m_size = length;
+    }
+    *position = current + length;
+    return CoapPdu::NoError;
+}
+
+/*! Writes the header fields of the given \a view to \a debug. */
+QDebug operator<<(QDebug debug, const CoapPduView &view)
+{
+    debug.nospace() << "CoapPduView(" << CoapPdu::getStatusCodeString(view.statusCode());
+    debug.nospace() << ", ID: " << view.messageId();
+    debug.nospace() << ", Token: 0x" << view.token().toHex();
+    debug.nospace() << ", Payload size: " << view.payloadSize() << ")";
+    return debug.space();
+}
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPPDUVIEW_H
+#define COAPPDUVIEW_H
+
+#include <QDebug>
+#include <QByteArray>
+
+#include "libnymea.h"
+#include "coappdu.h"
+#include "coapoption.h"
+
+class LIBNYMEA_EXPORT CoapPduView
+{
+public:
+    class Option
+    {
+    public:
+        CoapOption::Option option() const;
+        quint16 number() const;
+
+        const char *data() const;
+        int size() const;
+
+        QByteArray toByteArray() const;
+        quint32 toUInt() const;
+
+    private:
+        friend class CoapPduView;
+        quint16 m_number = 0;
+        const char *m_data = nullptr;
+        int m_size = 0;
+    };
+
+    class OptionIterator
+    {
+    public:
+        bool hasNext() const;
+        Option next();
+
+    private:
+        friend class CoapPduView;
+        const uchar *m_position = nullptr;
+        const uchar *m_end = nullptr;
+        quint16 m_number = 0;
+    };
+
+    CoapPduView();
+    explicit CoapPduView(const QByteArray &data);
+
+    bool isValid() const;
+    CoapPdu::Error error() const;
+
+    quint8 version() const;
+    CoapPdu::MessageType messageType() const;
+    CoapPdu::StatusCode statusCode() const;
+    quint16 messageId() const;
+    QByteArray token() const;
+
+    OptionIterator options() const;
+    bool findOption(const CoapOption::Option &option, Option *result = nullptr) const;
+    bool hasOption(const CoapOption::Option &option) const;
+
+    const char *payloadData() const;
+    int payloadSize() const;
+    QByteArray payload() const;
+
+    QByteArray data() const;
+
+private:
+    QByteArray m_data;
+    CoapPdu::Error m_error = CoapPdu::InvalidPduSizeError;
+    int m_tokenLength = 0;
+    int m_optionsEnd = 0;
+    int m_payloadOffset = 0;
+
+    static CoapPdu::Error readOption(const uchar **position, const uchar *end, quint16 *number, Option *option);
+};
+
+QDebug operator<<(QDebug debug, const CoapPduView &view);
+
+#endif // COAPPDUVIEW_H
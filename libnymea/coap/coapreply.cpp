@@ -199,7 +199,8 @@ CoapReply::CoapReply(const CoapRequest &request, QObject *parent) :
     m_contentType(CoapPdu::TextPlain),
     m_messageType(CoapPdu::Acknowledgement),
     m_statusCode(CoapPdu::Empty),
-    m_lockedUp(false)
+    m_lockedUp(false),
+    m_messageId(0)
 {
     m_timer = new QTimer(this);
     m_timer->setSingleShot(false);
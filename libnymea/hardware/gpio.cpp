@@ -92,7 +92,11 @@
   \endcode
 
 
-  \sa GpioMonitor
+  If a \l{GpioChip} provides the GPIO, the Linux GPIO character device is used and the line stays requested
+  from \l{exportGpio()} until \l{unexportGpio()}. Otherwise the deprecated sysfs interface is used, which opens
+  a file in \tt {/sys/class/gpio} for each access.
+
+  \sa GpioMonitor, GpioChip
 */
 
 /*! \enum Gpio::Direction
@@ -135,6 +139,7 @@
 */
 
 #include "gpio.h"
+#include "gpiochip.h"
 #include "loggingcategories.h"
 
 #include <QDebug>
@@ -146,7 +151,10 @@ Gpio::Gpio(const int &gpio, QObject *parent) :
     m_direction(Gpio::DirectionInvalid),
     m_gpioDirectory(QDir(QString("/sys/class/gpio/gpio%1/").arg(QString::number(gpio))))
 {
-    m_direction = direction();
+    m_chip = GpioChip::chipForGpio(gpio, &m_line);
+    if (!m_chip) {
+        m_direction = direction();
+    }
 }
 
 /*! Destroys and unexports the \l{Gpio}. */
@@ -168,15 +176,19 @@ int Gpio::gpioNumber() const
 }
 
 
-/*! Returns true if the directories \tt {/sys/class/gpio} and \tt {/sys/class/gpio/export} do exist. */
+/*! Returns true if a \l{GpioChip} is available or the directories \tt {/sys/class/gpio} and \tt {/sys/class/gpio/export} do exist. */
 bool Gpio::isAvailable()
 {
-    return QFile("/sys/class/gpio/export").exists();
+    return GpioChip::hasChips() || QFile("/sys/class/gpio/export").exists();
 }
 
 /*! Returns true if this \l{Gpio} could be exported in the system file \tt {/sys/class/gpio/export}. If this Gpio is already exported, this function will return true. */
 bool Gpio::exportGpio()
 {
+    if (m_chip) {
+        return m_lineRequest || applyLineConfig();
+    }
+
     // Check if already exported
     if (m_gpioDirectory.exists())
         return true;
@@ -196,6 +208,13 @@ bool Gpio::exportGpio()
 /*! Returns true if this \l{Gpio} could be unexported in the system file \tt {/sys/class/gpio/unexport}. */
 bool Gpio::unexportGpio()
 {
+    if (m_chip) {
+        delete m_lineRequest;
+        m_lineRequest = nullptr;
+        m_direction = Gpio::DirectionInvalid;
+        return true;
+    }
+
     QFile unexportFile("/sys/class/gpio/unexport");
     if (!unexportFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO unexport file:" << unexportFile.errorString();
@@ -216,6 +235,17 @@ bool Gpio::setDirection(Gpio::Direction direction)
         return false;
     }
 
+    if (m_chip) {
+        Gpio::Direction previous = m_lineDirection;
+        m_lineDirection = direction;
+        if (!applyLineConfig()) {
+            m_lineDirection = previous;
+            return false;
+        }
+        m_direction = direction;
+        return true;
+    }
+
     QFile directionFile(m_gpioDirectory.path() + "/direction");
     if (!directionFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "direction file:" << directionFile.errorString();
@@ -243,6 +273,10 @@ bool Gpio::setDirection(Gpio::Direction direction)
 /*! Returns the direction of this \l{Gpio}. */
 Gpio::Direction Gpio::direction()
 {
+    if (m_chip) {
+        return m_lineRequest ? m_lineDirection : Gpio::DirectionInvalid;
+    }
+
     QFile directionFile(m_gpioDirectory.path() + "/direction");
     if (!directionFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "direction file:" << directionFile.errorString();
@@ -285,6 +319,15 @@ bool Gpio::setValue(Gpio::Value value)
         return false;
     }
 
+    if (m_chip) {
+        if (!m_lineRequest || !m_lineRequest->setValue(m_line, value)) {
+            qCWarning(dcHardware()) << "Gpio: Could not set value of GPIO" << m_gpio;
+            return false;
+        }
+        m_lineOutputValue = value;
+        return true;
+    }
+
     QFile valueFile(m_gpioDirectory.path() + "/value");
     if (!valueFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "value file:" << valueFile.errorString();
@@ -311,6 +354,10 @@ bool Gpio::setValue(Gpio::Value value)
 /*! Returns the current digital value of this \l{Gpio}. */
 Gpio::Value Gpio::value()
 {
+    if (m_chip) {
+        return m_lineRequest ? m_lineRequest->value(m_line) : Gpio::ValueInvalid;
+    }
+
     QFile valueFile(m_gpioDirectory.path() + "/value");
     if (!valueFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "value file:" << valueFile.errorString();
@@ -334,6 +381,16 @@ Gpio::Value Gpio::value()
 /*! This method allows to invert the logic of this \l{Gpio}. Returns true, if the GPIO could be set \a activeLow. */
 bool Gpio::setActiveLow(bool activeLow)
 {
+    if (m_chip) {
+        bool previous = m_lineActiveLow;
+        m_lineActiveLow = activeLow;
+        if (!applyLineConfig()) {
+            m_lineActiveLow = previous;
+            return false;
+        }
+        return true;
+    }
+
     QFile activeLowFile(m_gpioDirectory.path() + "/active_low");
     if (!activeLowFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "active_low file:" << activeLowFile.errorString();
@@ -354,6 +411,10 @@ bool Gpio::setActiveLow(bool activeLow)
 /*! Returns true if the logic of this \l{Gpio} is inverted (1 = low, 0 = high). */
 bool Gpio::activeLow()
 {
+    if (m_chip) {
+        return m_lineActiveLow;
+    }
+
     QFile activeLowFile(m_gpioDirectory.path() + "/active_low");
     if (!activeLowFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "active_low file:" << activeLowFile.errorString();
@@ -380,6 +441,16 @@ bool Gpio::setEdgeInterrupt(Gpio::Edge edge)
         return false;
     }
 
+    if (m_chip) {
+        Gpio::Edge previous = m_lineEdge;
+        m_lineEdge = edge;
+        if (!applyLineConfig()) {
+            m_lineEdge = previous;
+            return false;
+        }
+        return true;
+    }
+
     QFile edgeFile(m_gpioDirectory.path() + "/edge");
     if (!edgeFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "edge file:" << edgeFile.errorString();
@@ -411,6 +482,10 @@ bool Gpio::setEdgeInterrupt(Gpio::Edge edge)
 /*! Returns the edge interrupt of this \l{Gpio}. */
 Gpio::Edge Gpio::edgeInterrupt()
 {
+    if (m_chip) {
+        return m_lineEdge;
+    }
+
     QFile edgeFile(m_gpioDirectory.path() + "/edge");
     if (!edgeFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "edge file:" << edgeFile.errorString();
@@ -435,7 +510,59 @@ Gpio::Edge Gpio::edgeInterrupt()
     return Gpio::EdgeNone;
 }
 
+/*! Sets the debounce interval of this input \l{Gpio} to \a microseconds. Edges following a reported edge within
+    this interval are dropped. Returns false if the GPIO is not provided by a \l{GpioChip}, as sysfs doesn't
+    support debouncing. */
+bool Gpio::setDebounceInterval(uint microseconds)
+{
+    if (!m_chip) {
+        qCWarning(dcHardware()) << "Gpio: Debouncing is not supported by the sysfs GPIO interface.";
+        return false;
+    }
+
+    uint previous = m_lineDebounceInterval;
+    m_lineDebounceInterval = microseconds;
+    if (!applyLineConfig()) {
+        m_lineDebounceInterval = previous;
+        return false;
+    }
+    return true;
+}
+
+/*! Returns the debounce interval of this \l{Gpio} in microseconds. */
+uint Gpio::debounceInterval() const
+{
+    return m_lineDebounceInterval;
+}
+
+/*! Returns the \l{GpioLineRequest} of this \l{Gpio} if it is provided by a \l{GpioChip} and exported, otherwise nullptr. */
+GpioLineRequest *Gpio::lineRequest() const
+{
+    return m_lineRequest;
+}
+
+bool Gpio::applyLineConfig()
+{
+    GpioLineConfig config;
+    config.direction = m_lineDirection;
+    config.activeLow = m_lineActiveLow;
+    config.edge = m_lineDirection == Gpio::DirectionInput ? m_lineEdge : Gpio::EdgeNone;
+    config.debounceInterval = m_lineDebounceInterval;
+    config.outputValue = m_lineOutputValue;
+
+    // Keep the line requested, only reconfigure it
+    if (m_lineRequest) {
+        return m_lineRequest->setConfig(config);
+    }
 
+    m_lineRequest = m_chip->requestLines({m_line}, config, this);
+    if (!m_lineRequest) {
+        qCWarning(dcHardware()) << "Gpio: Could not request line" << m_line << "of" << m_chip->name() << "for GPIO" << m_gpio;
+        return false;
+    }
+    m_direction = m_lineDirection;
+    return true;
+}
 
 QDebug operator<<(QDebug debug, Gpio *gpio)
 {
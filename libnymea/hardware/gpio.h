@@ -39,6 +39,9 @@
 
 #include "libnymea.h"
 
+class GpioChip;
+class GpioLineRequest;
+
 class LIBNYMEA_EXPORT Gpio : public QObject
 {
     Q_OBJECT
@@ -85,12 +88,27 @@ public:
     bool setEdgeInterrupt(Gpio::Edge edge);
     Gpio::Edge edgeInterrupt();
 
+    bool setDebounceInterval(uint microseconds);
+    uint debounceInterval() const;
+
+    // The line request of the character device backend, nullptr if using sysfs or not exported
+    GpioLineRequest *lineRequest() const;
 
 private:
+    bool applyLineConfig();
+
     int m_gpio;
     Gpio::Direction m_direction;
     QDir m_gpioDirectory;
 
+    GpioChip *m_chip = nullptr;
+    int m_line = -1;
+    GpioLineRequest *m_lineRequest = nullptr;
+    Gpio::Direction m_lineDirection = Gpio::DirectionInput;
+    bool m_lineActiveLow = false;
+    Gpio::Edge m_lineEdge = Gpio::EdgeNone;
+    uint m_lineDebounceInterval = 0;
+    Gpio::Value m_lineOutputValue = Gpio::ValueLow;
 };
 
 QDebug operator<< (QDebug debug, Gpio *gpio);
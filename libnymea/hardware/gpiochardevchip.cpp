@@ -0,0 +1,361 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class GpioCharDevChip
+  \brief The GpioCharDevChip class provides GPIO lines using the Linux GPIO character device.
+
+  \ingroup hardware
+  \inmodule libnymea
+
+  In contrast to the deprecated sysfs interface, the character device keeps requested lines open, reads and
+  writes multiple lines with a single ioctl and queues edge events in the kernel, including a timestamp for each
+  edge. Debouncing is done by the kernel as well. This requires the GPIO uAPI v2, available since Linux 5.10.
+
+  \sa GpioChip, Gpio
+*/
+
+#include "gpiochardevchip.h"
+#include "loggingcategories.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <linux/gpio.h>
+#endif
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+#define NYMEA_GPIO_CHARDEV
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef NYMEA_GPIO_CHARDEV
+
+static void fillLineConfig(struct gpio_v2_line_config *lineConfig, int lineCount, const GpioLineConfig &config)
+{
+    memset(lineConfig, 0, sizeof(struct gpio_v2_line_config));
+    quint64 allLines = lineCount >= 64 ? ~0ULL : (1ULL << lineCount) - 1;
+
+    if (config.direction == Gpio::DirectionOutput) {
+        lineConfig->flags |= GPIO_V2_LINE_FLAG_OUTPUT;
+    } else {
+        lineConfig->flags |= GPIO_V2_LINE_FLAG_INPUT;
+        if (config.edge == Gpio::EdgeRising || config.edge == Gpio::EdgeBoth) {
+            lineConfig->flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+        }
+        if (config.edge == Gpio::EdgeFalling || config.edge == Gpio::EdgeBoth) {
+            lineConfig->flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+    }
+    if (config.activeLow) {
+        lineConfig->flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+    }
+
+    if (config.direction == Gpio::DirectionOutput) {
+        struct gpio_v2_line_config_attribute *attribute = &lineConfig->attrs[lineConfig->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        attribute->attr.values = config.outputValue == Gpio::ValueHigh ? allLines : 0;
+        attribute->mask = allLines;
+    } else if (config.debounceInterval > 0) {
+        struct gpio_v2_line_config_attribute *attribute = &lineConfig->attrs[lineConfig->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        attribute->attr.debounce_period_us = config.debounceInterval;
+        attribute->mask = allLines;
+    }
+}
+
+class GpioCharDevLineRequest : public GpioLineRequest
+{
+public:
+    GpioCharDevLineRequest(int fd, const QList<int> &lines, const GpioLineConfig &config, QObject *parent):
+        GpioLineRequest(lines, config, parent),
+        m_fd(fd)
+    {
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, [this](){
+            readEvents();
+        });
+    }
+
+    ~GpioCharDevLineRequest() override
+    {
+        delete m_notifier;
+        ::close(m_fd);
+    }
+
+    QHash<int, Gpio::Value> values() override
+    {
+        QHash<int, Gpio::Value> ret;
+        struct gpio_v2_line_values lineValues;
+        memset(&lineValues, 0, sizeof(lineValues));
+        lineValues.mask = lines().count() >= 64 ? ~0ULL : (1ULL << lines().count()) - 1;
+        if (ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &lineValues) < 0) {
+            qCWarning(dcHardware()) << "Gpio: Could not read line values:" << strerror(errno);
+            return ret;
+        }
+        for (int i = 0; i < lines().count(); i++) {
+            ret.insert(lines().at(i), (lineValues.bits & (1ULL << i)) ? Gpio::ValueHigh : Gpio::ValueLow);
+        }
+        return ret;
+    }
+
+    bool setValues(const QHash<int, Gpio::Value> &values) override
+    {
+        struct gpio_v2_line_values lineValues;
+        memset(&lineValues, 0, sizeof(lineValues));
+        foreach (int line, values.keys()) {
+            int index = lines().indexOf(line);
+            if (index < 0 || values.value(line) == Gpio::ValueInvalid) {
+                qCWarning(dcHardware()) << "Gpio: Invalid value for line" << line;
+                return false;
+            }
+            lineValues.mask |= 1ULL << index;
+            if (values.value(line) == Gpio::ValueHigh) {
+                lineValues.bits |= 1ULL << index;
+            }
+        }
+        if (ioctl(m_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &lineValues) < 0) {
+            qCWarning(dcHardware()) << "Gpio: Could not set line values:" << strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool setConfig(const GpioLineConfig &config) override
+    {
+        struct gpio_v2_line_config lineConfig;
+        fillLineConfig(&lineConfig, lines().count(), config);
+        if (ioctl(m_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &lineConfig) < 0) {
+            qCWarning(dcHardware()) << "Gpio: Could not configure lines" << lines() << strerror(errno);
+            return false;
+        }
+        updateConfig(config);
+        return true;
+    }
+
+private:
+    void readEvents()
+    {
+        QList<GpioEdgeEvent> batch;
+        struct gpio_v2_line_event events[16];
+        forever {
+            ssize_t count = read(m_fd, events, sizeof(events));
+            if (count <= 0) {
+                if (count < 0 && errno != EAGAIN) {
+                    qCWarning(dcHardware()) << "Gpio: Error reading line events:" << strerror(errno);
+                }
+                break;
+            }
+            for (uint i = 0; i < count / sizeof(struct gpio_v2_line_event); i++) {
+                GpioEdgeEvent event;
+                event.line = static_cast<int>(events[i].offset);
+                event.edge = events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? Gpio::EdgeRising : Gpio::EdgeFalling;
+                event.timestamp = events[i].timestamp_ns;
+                event.sequenceNumber = events[i].seqno;
+                batch.append(event);
+            }
+        }
+        if (!batch.isEmpty()) {
+            emit edgeEvents(batch);
+        }
+    }
+
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+};
+
+#endif // NYMEA_GPIO_CHARDEV
+
+/*! Constructs a \l{GpioCharDevChip} for the character device at \a devicePath (e.g. /dev/gpiochip0) with the given \a parent. */
+GpioCharDevChip::GpioCharDevChip(const QString &devicePath, QObject *parent) :
+    GpioChip(parent),
+    m_devicePath(devicePath)
+{
+
+}
+
+/*! Closes the character device. Line requests stay valid until they are deleted. */
+GpioCharDevChip::~GpioCharDevChip()
+{
+#ifdef NYMEA_GPIO_CHARDEV
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#endif
+}
+
+/*! Returns true if nymea has been built with support for the GPIO character device uAPI v2 and there are GPIO chips. */
+bool GpioCharDevChip::isSupported()
+{
+#ifdef NYMEA_GPIO_CHARDEV
+    return !QDir("/dev").entryList({"gpiochip*"}, QDir::Files | QDir::System).isEmpty();
+#else
+    return false;
+#endif
+}
+
+/*! Returns the available character devices along with the global GPIO number of their first line. The base is
+    looked up in the sysfs GPIO class. Chips without a readable base get a base of -1, global GPIO numbers can't
+    be mapped to their lines. */
+QList<GpioCharDevChip::ChipInfo> GpioCharDevChip::discoverChips()
+{
+    QList<ChipInfo> ret;
+    if (!isSupported()) {
+        return ret;
+    }
+
+    // /sys/class/gpio/gpiochip<base>/device links to the gpiochip<N> device the character device is named after
+    QHash<QString, int> bases;
+    foreach (const QFileInfo &chipDir, QDir("/sys/class/gpio").entryInfoList({"gpiochip*"}, QDir::Dirs)) {
+        QFile baseFile(chipDir.absoluteFilePath() + "/base");
+        if (!baseFile.open(QFile::ReadOnly)) {
+            continue;
+        }
+        QString device = QFileInfo(QFileInfo(chipDir.absoluteFilePath() + "/device").canonicalFilePath()).fileName();
+        bases.insert(device, baseFile.readAll().trimmed().toInt());
+    }
+
+    QStringList devices = QDir("/dev").entryList({"gpiochip*"}, QDir::Files | QDir::System);
+    std::sort(devices.begin(), devices.end(), [](const QString &a, const QString &b){
+        return a.mid(8).toInt() < b.mid(8).toInt();
+    });
+
+    foreach (const QString &device, devices) {
+        GpioCharDevChip chip("/dev/" + device);
+        if (!chip.open()) {
+            continue;
+        }
+        ChipInfo info;
+        info.devicePath = chip.devicePath();
+        // Guessing a base would silently drive the wrong pins
+        info.base = bases.value(device, -1);
+        ret.append(info);
+    }
+    return ret;
+}
+
+/*! Opens the character device and reads the chip information. Returns false if this fails. */
+bool GpioCharDevChip::open()
+{
+#ifdef NYMEA_GPIO_CHARDEV
+    if (m_fd >= 0) {
+        return true;
+    }
+
+    m_fd = ::open(m_devicePath.toUtf8().constData(), O_RDWR | O_CLOEXEC);
+    if (m_fd < 0) {
+        qCWarning(dcHardware()) << "Gpio: Could not open" << m_devicePath << strerror(errno);
+        return false;
+    }
+
+    struct gpiochip_info info;
+    memset(&info, 0, sizeof(info));
+    if (ioctl(m_fd, GPIO_GET_CHIPINFO_IOCTL, &info) < 0) {
+        qCWarning(dcHardware()) << "Gpio: Could not read chip info of" << m_devicePath << strerror(errno);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_name = QString::fromUtf8(info.name);
+    m_lineCount = static_cast<int>(info.lines);
+    return true;
+#else
+    qCWarning(dcHardware()) << "Gpio: GPIO character device support not available in this build.";
+    return false;
+#endif
+}
+
+/*! Returns true if the character device has been opened successfully. */
+bool GpioCharDevChip::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+/*! Returns the path of the character device. */
+QString GpioCharDevChip::devicePath() const
+{
+    return m_devicePath;
+}
+
+/*! Returns the name of the chip as reported by the kernel. */
+QString GpioCharDevChip::name() const
+{
+    return m_name;
+}
+
+/*! Returns the number of lines of this chip. */
+int GpioCharDevChip::lineCount() const
+{
+    return m_lineCount;
+}
+
+/*! Requests the given \a lines with the given \a config. The lines stay claimed until the returned request is deleted. */
+GpioLineRequest *GpioCharDevChip::requestLines(const QList<int> &lines, const GpioLineConfig &config, QObject *parent)
+{
+#ifdef NYMEA_GPIO_CHARDEV
+    if (!open()) {
+        return nullptr;
+    }
+    if (lines.isEmpty() || lines.count() > GPIO_V2_LINES_MAX) {
+        qCWarning(dcHardware()) << "Gpio: Invalid number of lines requested:" << lines.count();
+        return nullptr;
+    }
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    for (int i = 0; i < lines.count(); i++) {
+        request.offsets[i] = static_cast<__u32>(lines.at(i));
+    }
+    request.num_lines = static_cast<__u32>(lines.count());
+    strncpy(request.consumer, "nymea", sizeof(request.consumer) - 1);
+    fillLineConfig(&request.config, lines.count(), config);
+
+    if (ioctl(m_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        qCWarning(dcHardware()) << "Gpio: Could not request lines" << lines << "on" << m_devicePath << strerror(errno);
+        return nullptr;
+    }
+    return new GpioCharDevLineRequest(request.fd, lines, config, parent);
+#else
+    Q_UNUSED(lines)
+    Q_UNUSED(config)
+    Q_UNUSED(parent)
+    return nullptr;
+#endif
+}
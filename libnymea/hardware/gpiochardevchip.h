@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GPIOCHARDEVCHIP_H
+#define GPIOCHARDEVCHIP_H
+
+#include <QObject>
+
+#include "libnymea.h"
+#include "gpiochip.h"
+
+class LIBNYMEA_EXPORT GpioCharDevChip : public GpioChip
+{
+    Q_OBJECT
+public:
+    class ChipInfo
+    {
+    public:
+        QString devicePath;
+        // The global GPIO number of line 0, -1 if unknown
+        int base = -1;
+    };
+
+    explicit GpioCharDevChip(const QString &devicePath, QObject *parent = nullptr);
+    ~GpioCharDevChip() override;
+
+    static bool isSupported();
+    static QList<ChipInfo> discoverChips();
+
+    bool open();
+    bool isOpen() const;
+    QString devicePath() const;
+
+    QString name() const override;
+    int lineCount() const override;
+
+    GpioLineRequest *requestLines(const QList<int> &lines, const GpioLineConfig &config, QObject *parent = nullptr) override;
+
+private:
+    QString m_devicePath;
+    int m_fd = -1;
+    QString m_name;
+    int m_lineCount = 0;
+};
+
+#endif // GPIOCHARDEVCHIP_H
@@ -0,0 +1,204 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class GpioChip
+  \brief The GpioChip class represents a GPIO controller providing a set of lines.
+
+  \ingroup hardware
+  \inmodule libnymea
+
+  Lines of a chip are requested as a \l{GpioLineRequest}, which keeps them claimed until the request is deleted.
+  Multiple lines can be requested at once and read or written in a single call.
+
+  \l{Gpio} objects are mapped to chips by their global GPIO number. Chips registered with \l{registerChip()} take
+  precedence, which allows to plug in a \l{GpioMockChip} in tests. Otherwise the Linux GPIO character devices are
+  used if available, and the deprecated sysfs interface is used as a fallback. Setting the environment variable
+  \tt NYMEA_GPIO_BACKEND to \tt sysfs forces the fallback.
+
+  \sa Gpio, GpioCharDevChip, GpioMockChip
+*/
+
+/*!
+  \class GpioLineRequest
+  \brief The GpioLineRequest class represents a set of requested lines of a \l{GpioChip}.
+
+  \ingroup hardware
+  \inmodule libnymea
+
+  Edge events of input lines configured with an edge are delivered in batches by the \l{edgeEvents()} signal.
+*/
+
+/*! \fn void GpioLineRequest::edgeEvents(const QList<GpioEdgeEvent> &events);
+    This signal is emitted with all \a events read in one go from the chip.
+*/
+
+#include "gpiochip.h"
+#include "gpiochardevchip.h"
+#include "loggingcategories.h"
+
+#include <QPointer>
+
+class RegisteredGpioChip
+{
+public:
+    QPointer<GpioChip> chip;
+    int base = 0;
+};
+
+static QList<RegisteredGpioChip> &registeredChips()
+{
+    static QList<RegisteredGpioChip> chips;
+    return chips;
+}
+
+/*! Constructs a \l{GpioLineRequest} for the given \a lines and \a config with the given \a parent. */
+GpioLineRequest::GpioLineRequest(const QList<int> &lines, const GpioLineConfig &config, QObject *parent) :
+    QObject(parent),
+    m_lines(lines),
+    m_config(config)
+{
+
+}
+
+/*! Returns the requested lines. */
+QList<int> GpioLineRequest::lines() const
+{
+    return m_lines;
+}
+
+/*! Returns the current configuration of the requested lines. */
+GpioLineConfig GpioLineRequest::config() const
+{
+    return m_config;
+}
+
+/*! Returns the logical value of the given \a line of this request. */
+Gpio::Value GpioLineRequest::value(int line)
+{
+    return values().value(line, Gpio::ValueInvalid);
+}
+
+/*! Sets the logical \a value of the given output \a line. */
+bool GpioLineRequest::setValue(int line, Gpio::Value value)
+{
+    QHash<int, Gpio::Value> lineValues;
+    lineValues.insert(line, value);
+    return setValues(lineValues);
+}
+
+/*! Implementations call this once the \a config has been applied. */
+void GpioLineRequest::updateConfig(const GpioLineConfig &config)
+{
+    m_config = config;
+}
+
+/*! Constructs a \l{GpioChip} with the given \a parent. */
+GpioChip::GpioChip(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+/*! Registers the \a chip to provide the global GPIO numbers starting at \a base. A negative \a base registers the
+    chip without global GPIO numbers. */
+void GpioChip::registerChip(GpioChip *chip, int base)
+{
+    RegisteredGpioChip registered;
+    registered.chip = chip;
+    registered.base = base;
+    registeredChips().prepend(registered);
+}
+
+/*! Removes the \a chip registered with \l{registerChip()}. */
+void GpioChip::unregisterChip(GpioChip *chip)
+{
+    for (int i = registeredChips().count() - 1; i >= 0; i--) {
+        if (registeredChips().at(i).chip.isNull() || registeredChips().at(i).chip == chip) {
+            registeredChips().removeAt(i);
+        }
+    }
+}
+
+/*! Returns true if any chip has been registered or a GPIO character device is available. */
+bool GpioChip::hasChips()
+{
+    loadSystemChips();
+    foreach (const RegisteredGpioChip &registered, registeredChips()) {
+        if (!registered.chip.isNull()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Returns the chip providing the global GPIO number \a gpio and stores the offset on that chip in \a line.
+    Returns nullptr if no chip is providing it, in which case the sysfs interface has to be used. */
+GpioChip *GpioChip::chipForGpio(int gpio, int *line)
+{
+    loadSystemChips();
+    foreach (const RegisteredGpioChip &registered, registeredChips()) {
+        if (registered.chip.isNull() || registered.base < 0) {
+            continue;
+        }
+        if (gpio >= registered.base && gpio < registered.base + registered.chip->lineCount()) {
+            *line = gpio - registered.base;
+            return registered.chip;
+        }
+    }
+    return nullptr;
+}
+
+void GpioChip::loadSystemChips()
+{
+    static bool loaded = false;
+    if (loaded || qgetenv("NYMEA_GPIO_BACKEND") == "sysfs") {
+        return;
+    }
+    loaded = true;
+
+    foreach (const GpioCharDevChip::ChipInfo &info, GpioCharDevChip::discoverChips()) {
+        GpioCharDevChip *chip = new GpioCharDevChip(info.devicePath);
+        if (!chip->open()) {
+            delete chip;
+            continue;
+        }
+        if (info.base < 0) {
+            qCWarning(dcHardware()) << "Gpio: Could not determine the GPIO numbers of" << info.devicePath << "Global GPIO numbers on this chip will use sysfs.";
+        } else {
+            qCDebug(dcHardware()) << "Gpio: Using character device" << info.devicePath << "for GPIOs" << info.base << "-" << info.base + chip->lineCount() - 1;
+        }
+        // Registered chips always take precedence
+        RegisteredGpioChip registered;
+        registered.chip = chip;
+        registered.base = info.base;
+        registeredChips().append(registered);
+    }
+}
@@ -0,0 +1,114 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GPIOCHIP_H
+#define GPIOCHIP_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+
+#include "libnymea.h"
+#include "gpio.h"
+
+class LIBNYMEA_EXPORT GpioLineConfig
+{
+public:
+    Gpio::Direction direction = Gpio::DirectionInput;
+    bool activeLow = false;
+    Gpio::Edge edge = Gpio::EdgeNone;
+    // Microseconds, 0 disables debouncing
+    uint debounceInterval = 0;
+    // Applied to output lines when requesting or reconfiguring them
+    Gpio::Value outputValue = Gpio::ValueLow;
+};
+
+class LIBNYMEA_EXPORT GpioEdgeEvent
+{
+public:
+    int line = -1;
+    // Either Gpio::EdgeRising or Gpio::EdgeFalling, in terms of the logical (active low applied) value
+    Gpio::Edge edge = Gpio::EdgeNone;
+    // CLOCK_MONOTONIC, as provided by the kernel
+    quint64 timestamp = 0;
+    quint32 sequenceNumber = 0;
+};
+
+class LIBNYMEA_EXPORT GpioLineRequest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GpioLineRequest(const QList<int> &lines, const GpioLineConfig &config, QObject *parent = nullptr);
+
+    QList<int> lines() const;
+    GpioLineConfig config() const;
+
+    virtual QHash<int, Gpio::Value> values() = 0;
+    virtual bool setValues(const QHash<int, Gpio::Value> &values) = 0;
+    virtual bool setConfig(const GpioLineConfig &config) = 0;
+
+    Gpio::Value value(int line);
+    bool setValue(int line, Gpio::Value value);
+
+signals:
+    void edgeEvents(const QList<GpioEdgeEvent> &events);
+
+protected:
+    void updateConfig(const GpioLineConfig &config);
+
+private:
+    QList<int> m_lines;
+    GpioLineConfig m_config;
+};
+
+class LIBNYMEA_EXPORT GpioChip : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GpioChip(QObject *parent = nullptr);
+
+    virtual QString name() const = 0;
+    virtual int lineCount() const = 0;
+
+    // Returns nullptr if the lines can't be requested, e.g. because they are in use already
+    virtual GpioLineRequest *requestLines(const QList<int> &lines, const GpioLineConfig &config, QObject *parent = nullptr) = 0;
+
+    static void registerChip(GpioChip *chip, int base);
+    static void unregisterChip(GpioChip *chip);
+    static bool hasChips();
+    static GpioChip *chipForGpio(int gpio, int *line);
+
+private:
+    static void loadSystemChips();
+};
+
+Q_DECLARE_METATYPE(GpioEdgeEvent)
+
+#endif // GPIOCHIP_H
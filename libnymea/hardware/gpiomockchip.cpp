@@ -0,0 +1,237 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+  \class GpioMockChip
+  \brief The GpioMockChip class simulates a GPIO chip without hardware.
+
+  \ingroup hardware
+  \inmodule libnymea
+
+  Register a mock chip with \l{GpioChip::registerChip()} to make \l{Gpio} and \l{GpioMonitor} objects use it.
+  Input levels are changed with \l{setLevel()}, which generates edge events the same way the kernel does,
+  including debouncing. Events are delivered in batches on the next event loop iteration.
+
+  \sa GpioChip
+*/
+
+#include "gpiomockchip.h"
+#include "loggingcategories.h"
+
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTimer>
+
+class GpioMockLineRequest : public GpioLineRequest
+{
+public:
+    GpioMockLineRequest(GpioMockChip *chip, const QList<int> &lines, const GpioLineConfig &config, QObject *parent):
+        GpioLineRequest(lines, config, parent),
+        m_chip(chip)
+    {
+        applyOutputValue(config);
+    }
+
+    ~GpioMockLineRequest() override
+    {
+        if (m_chip.isNull()) {
+            return;
+        }
+        foreach (int line, lines()) {
+            m_chip->m_owners.remove(line);
+        }
+    }
+
+    QHash<int, Gpio::Value> values() override
+    {
+        QHash<int, Gpio::Value> ret;
+        if (m_chip.isNull()) {
+            return ret;
+        }
+        foreach (int line, lines()) {
+            ret.insert(line, m_chip->level(line) != config().activeLow ? Gpio::ValueHigh : Gpio::ValueLow);
+        }
+        return ret;
+    }
+
+    bool setValues(const QHash<int, Gpio::Value> &values) override
+    {
+        if (m_chip.isNull() || config().direction != Gpio::DirectionOutput) {
+            return false;
+        }
+        foreach (int line, values.keys()) {
+            if (!lines().contains(line) || values.value(line) == Gpio::ValueInvalid) {
+                return false;
+            }
+        }
+        foreach (int line, values.keys()) {
+            m_chip->m_levels[line] = (values.value(line) == Gpio::ValueHigh) != config().activeLow;
+        }
+        return true;
+    }
+
+    bool setConfig(const GpioLineConfig &config) override
+    {
+        updateConfig(config);
+        applyOutputValue(config);
+        return true;
+    }
+
+    void levelChanged(int line, bool high, quint64 timestamp)
+    {
+        if (config().direction != Gpio::DirectionInput || config().edge == Gpio::EdgeNone) {
+            return;
+        }
+
+        // Like the kernel, ignore transitions within the debounce interval of the last reported one
+        quint64 debounce = static_cast<quint64>(config().debounceInterval) * 1000;
+        if (debounce > 0 && m_lastEventTimestamps.contains(line) && timestamp - m_lastEventTimestamps.value(line) < debounce) {
+            return;
+        }
+
+        Gpio::Edge edge = high != config().activeLow ? Gpio::EdgeRising : Gpio::EdgeFalling;
+        if (config().edge != Gpio::EdgeBoth && config().edge != edge) {
+            return;
+        }
+
+        GpioEdgeEvent event;
+        event.line = line;
+        event.edge = edge;
+        event.timestamp = timestamp;
+        event.sequenceNumber = ++m_sequenceNumber;
+        m_lastEventTimestamps[line] = timestamp;
+
+        m_pendingEvents.append(event);
+        if (m_pendingEvents.count() == 1) {
+            QTimer::singleShot(0, this, [this](){
+                QList<GpioEdgeEvent> batch = m_pendingEvents;
+                m_pendingEvents.clear();
+                emit edgeEvents(batch);
+            });
+        }
+    }
+
+private:
+    void applyOutputValue(const GpioLineConfig &config)
+    {
+        if (m_chip.isNull() || config.direction != Gpio::DirectionOutput) {
+            return;
+        }
+        foreach (int line, lines()) {
+            m_chip->m_levels[line] = (config.outputValue == Gpio::ValueHigh) != config.activeLow;
+        }
+    }
+
+    QPointer<GpioMockChip> m_chip;
+    QHash<int, quint64> m_lastEventTimestamps;
+    quint32 m_sequenceNumber = 0;
+    QList<GpioEdgeEvent> m_pendingEvents;
+};
+
+/*! Constructs a \l{GpioMockChip} with \a lineCount lines, all low, and the given \a name and \a parent. */
+GpioMockChip::GpioMockChip(int lineCount, const QString &name, QObject *parent) :
+    GpioChip(parent),
+    m_name(name),
+    m_levels(lineCount, false)
+{
+
+}
+
+/*! Returns the name of this mock chip. */
+QString GpioMockChip::name() const
+{
+    return m_name;
+}
+
+/*! Returns the number of lines of this mock chip. */
+int GpioMockChip::lineCount() const
+{
+    return m_levels.count();
+}
+
+/*! Requests the given \a lines with the given \a config. Fails if any of the lines is out of range or requested already. */
+GpioLineRequest *GpioMockChip::requestLines(const QList<int> &lines, const GpioLineConfig &config, QObject *parent)
+{
+    if (lines.isEmpty()) {
+        return nullptr;
+    }
+    foreach (int line, lines) {
+        if (line < 0 || line >= m_levels.count() || m_owners.contains(line)) {
+            qCWarning(dcHardware()) << "Gpio: Mock line" << line << "not available";
+            return nullptr;
+        }
+    }
+
+    GpioMockLineRequest *request = new GpioMockLineRequest(this, lines, config, parent);
+    foreach (int line, lines) {
+        m_owners.insert(line, request);
+    }
+    m_requestCount++;
+    return request;
+}
+
+/*! Sets the physical level of the given \a line to \a high, generating an edge event at \a timestamp (nanoseconds)
+    if the line is requested as input with edge detection. */
+void GpioMockChip::setLevel(int line, bool high, quint64 timestamp)
+{
+    if (line < 0 || line >= m_levels.count() || m_levels.at(line) == high) {
+        return;
+    }
+    m_levels[line] = high;
+
+    if (timestamp == 0) {
+        QElapsedTimer timer;
+        timer.start();
+        timestamp = static_cast<quint64>(timer.msecsSinceReference()) * 1000000;
+    }
+
+    GpioMockLineRequest *request = m_owners.value(line);
+    if (request) {
+        request->levelChanged(line, high, timestamp);
+    }
+}
+
+/*! Returns the physical level of the given \a line. */
+bool GpioMockChip::level(int line) const
+{
+    return m_levels.value(line, false);
+}
+
+/*! Returns true if the given \a line is currently requested. */
+bool GpioMockChip::isRequested(int line) const
+{
+    return m_owners.contains(line);
+}
+
+/*! Returns how many line requests have been made on this chip. */
+int GpioMockChip::requestCount() const
+{
+    return m_requestCount;
+}
@@ -0,0 +1,71 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GPIOMOCKCHIP_H
+#define GPIOMOCKCHIP_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+
+#include "libnymea.h"
+#include "gpiochip.h"
+
+class GpioMockLineRequest;
+
+class LIBNYMEA_EXPORT GpioMockChip : public GpioChip
+{
+    Q_OBJECT
+public:
+    explicit GpioMockChip(int lineCount = 32, const QString &name = "gpio-mock", QObject *parent = nullptr);
+
+    QString name() const override;
+    int lineCount() const override;
+
+    GpioLineRequest *requestLines(const QList<int> &lines, const GpioLineConfig &config, QObject *parent = nullptr) override;
+
+    // Simulates the physical level of a line. A timestamp of 0 uses the current monotonic time.
+    void setLevel(int line, bool high, quint64 timestamp = 0);
+    bool level(int line) const;
+
+    bool isRequested(int line) const;
+    // Number of successful requestLines() calls, to verify handles are kept open
+    int requestCount() const;
+
+private:
+    friend class GpioMockLineRequest;
+
+    QString m_name;
+    QVector<bool> m_levels;
+    QHash<int, GpioMockLineRequest*> m_owners;
+    int m_requestCount = 0;
+};
+
+#endif // GPIOMOCKCHIP_H
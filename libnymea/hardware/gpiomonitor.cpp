@@ -79,6 +79,10 @@
 /*! \fn void GpioMonitor::valueChanged(const bool &value);
  *  This signal will be emitted, if the monitored \l{Gpio}{Gpios} changed his \a value. */
 
+/*! \fn void GpioMonitor::edgeEvents(const QList<GpioEdgeEvent> &events);
+ *  This signal will be emitted with each batch of timestamped edge \a events if the \l{Gpio} is provided by a
+ *  \l{GpioChip}. \l{valueChanged()} is emitted for each of the events as well, so no edge is lost. */
+
 #include "gpiomonitor.h"
 #include "loggingcategories.h"
 
@@ -94,6 +98,9 @@ GpioMonitor::GpioMonitor(int gpio, QObject *parent) :
     With the \a edgeInterrupt parameter the interrupt type can be specified. */
 bool GpioMonitor::enable(bool activeLow, Gpio::Edge edgeInterrupt)
 {
+    // Start over if this monitor has been enabled before
+    disable();
+
     if (!Gpio::isAvailable())
         return false;
 
@@ -103,11 +110,23 @@ bool GpioMonitor::enable(bool activeLow, Gpio::Edge edgeInterrupt)
             !m_gpio->setActiveLow(activeLow) ||
             !m_gpio->setEdgeInterrupt(edgeInterrupt)) {
         qCWarning(dcHardware()) << "GpioMonitor: Error while initializing GPIO" << m_gpio->gpioNumber();
+        disable();
         return false;
     }
 
+    if (m_gpio->lineRequest()) {
+        if (m_debounceInterval > 0 && !m_gpio->setDebounceInterval(m_debounceInterval)) {
+            qCWarning(dcHardware()) << "GpioMonitor: Could not set debounce interval for GPIO" << m_gpio->gpioNumber();
+        }
+        m_currentValue = m_gpio->value() == Gpio::ValueHigh;
+        connect(m_gpio->lineRequest(), &GpioLineRequest::edgeEvents, this, &GpioMonitor::onEdgeEvents);
+        m_running = true;
+        return true;
+    }
+
     if (!m_valueFile.open(QFile::ReadOnly)) {
         qWarning(dcHardware()) << "GpioMonitor: Could not open value file for gpio monitor" << m_gpio->gpioNumber();
+        disable();
         return false;
     }
 
@@ -115,6 +134,7 @@ bool GpioMonitor::enable(bool activeLow, Gpio::Edge edgeInterrupt)
     connect(m_notifier, &QSocketNotifier::activated, this, &GpioMonitor::readyReady);
 
     m_notifier->setEnabled(true);
+    m_running = true;
     return true;
 }
 
@@ -126,17 +146,27 @@ void GpioMonitor::disable()
 
     m_notifier = 0;
     m_gpio = 0;
+    m_running = false;
 
     m_valueFile.close();
 }
 
-/*! Returns true if this \l{GpioMonitor} is running. */
+/*! Returns true if this \l{GpioMonitor} has been enabled successfully and not been disabled since. */
 bool GpioMonitor::isRunning() const
 {
-    if (!m_notifier)
-        return false;
+    return m_running;
+}
 
-    return m_notifier->isEnabled();
+/*! Sets the debounce interval to \a microseconds. Needs to be called before \l{enable()}. Debouncing is not supported with the sysfs interface. */
+void GpioMonitor::setDebounceInterval(uint microseconds)
+{
+    m_debounceInterval = microseconds;
+}
+
+/*! Returns the debounce interval in microseconds. */
+uint GpioMonitor::debounceInterval() const
+{
+    return m_debounceInterval;
 }
 
 /*! Returns the current value of this \l{GpioMonitor}. */
@@ -170,3 +200,13 @@ void GpioMonitor::readyReady(const int &ready)
     m_currentValue = value;
     emit valueChanged(value);
 }
+
+void GpioMonitor::onEdgeEvents(const QList<GpioEdgeEvent> &events)
+{
+    emit edgeEvents(events);
+
+    foreach (const GpioEdgeEvent &event, events) {
+        m_currentValue = event.edge == Gpio::EdgeRising;
+        emit valueChanged(m_currentValue);
+    }
+}
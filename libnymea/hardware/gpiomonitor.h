@@ -38,6 +38,7 @@
 
 #include "libnymea.h"
 #include "gpio.h"
+#include "gpiochip.h"
 
 class LIBNYMEA_EXPORT GpioMonitor : public QObject
 {
@@ -49,6 +50,10 @@ public:
     bool enable(bool activeLow = false, Gpio::Edge edgeInterrupt = Gpio::EdgeBoth);
     void disable();
 
+    // Only supported by the character device backend, to be set before enabling
+    void setDebounceInterval(uint microseconds);
+    uint debounceInterval() const;
+
     bool isRunning() const;
     bool value() const;
 
@@ -56,16 +61,20 @@ public:
 
 private:
     int m_gpioNumber;
-    Gpio *m_gpio;
-    QSocketNotifier *m_notifier;
+    Gpio *m_gpio = nullptr;
+    QSocketNotifier *m_notifier = nullptr;
     QFile m_valueFile;
-    bool m_currentValue;
+    bool m_currentValue = false;
+    bool m_running = false;
+    uint m_debounceInterval = 0;
 
 signals:
     void valueChanged(const bool &value);
+    void edgeEvents(const QList<GpioEdgeEvent> &events);
 
 private slots:
     void readyReady(const int &ready);
+    void onEdgeEvents(const QList<GpioEdgeEvent> &events);
 
 };
 
@@ -473,10 +473,10 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
                 stateTypes.append(stateType);
 
                 // Events for state changed (Not checking for duplicate UUID, this is expected to be the same as the state!)
-                EventType eventType(EventTypeId(stateType.id().toString()));
+                EventType eventType(EventTypeId(stateType.id()));
                 eventType.setName(st.value("name").toString());
                 eventType.setDisplayName(st.value("displayNameEvent").toString());
-                ParamType paramType(ParamTypeId(stateType.id().toString()), st.value("name").toString(), stateType.type());
+                ParamType paramType(ParamTypeId(stateType.id()), st.value("name").toString(), stateType.type());
                 paramType.setDisplayName(st.value("displayName").toString());
                 paramType.setAllowedValues(stateType.possibleValues());
                 paramType.setDefaultValue(stateType.defaultValue());
@@ -489,7 +489,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
 
                 // ActionTypes for writeable StateTypes
                 if (writableState) {
-                    ActionType actionType(ActionTypeId(stateType.id().toString()));
+                    ActionType actionType(ActionTypeId(stateType.id()));
                     actionType.setName(stateType.name());
                     actionType.setDisplayName(st.value("displayNameAction").toString());
                     actionType.setIndex(stateType.index());
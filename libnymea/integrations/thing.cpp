@@ -305,82 +305,75 @@ void Thing::setStates(const States &states)
 /*! Returns true, a \l{State} with the given \a stateTypeId exists for this thing. */
 bool Thing::hasState(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return stateIndex(stateTypeId) >= 0;
 }
 
 /*! For convenience, this finds the \l{State} matching the given \a stateTypeId and returns the current valie in this thing. */
 QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return state.value();
-        }
+    int index = stateIndex(stateTypeId);
+    if (index < 0) {
+        return QVariant();
     }
-    return QVariant();
+    return m_states.at(index).value();
 }
 
 /*! For convenience, this finds the \l{State} matching the given \a stateTypeId in this thing and sets the current value to \a value. */
 void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
 {
-    StateType stateType = m_thingClass.stateTypes().findById(stateTypeId);
+    StateType stateType = m_thingClass.getStateType(stateTypeId);
     if (!stateType.isValid()) {
         qCWarning(dcThing()) << "No such state type" << stateTypeId.toString() << "in" << m_name << "(" + thingClass().name() + ")";
         return;
     }
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            if (m_states.at(i).value() == value)
-                return;
+    int i = stateIndex(stateTypeId);
+    if (i < 0) {
+        Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType.name()).arg(value.toString()).toUtf8());
+        qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType.name() << "to" << value;
+        return;
+    }
 
-            QVariant newValue = value;
-            if (!newValue.convert(stateType.type())) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType.type()) << " (Discarding change)";
-                return;
-            }
-            if (stateType.minValue().isValid() && value < stateType.minValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << stateType.minValue() << " - " << stateType.maxValue() << " (Correcting to closest value within range)";
-                newValue = stateType.minValue();
-            }
-            if (stateType.maxValue().isValid() && value > stateType.maxValue()) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << stateType.minValue() << " - " << stateType.maxValue() << " (Correcting to closest value within range)";
-                newValue = stateType.maxValue();
-            }
-            if (!stateType.possibleValues().isEmpty() && !stateType.possibleValues().contains(value)) {
-                qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Not an accepted value. Possible values: " << stateType.possibleValues() << " (Discarding change)";
-                return;
-            }
+    if (m_states.at(i).value() == value)
+        return;
 
-            QVariant oldValue = m_states.at(i).value();
+    QVariant newValue = value;
+    if (!newValue.convert(stateType.type())) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Type mismatch. Expected type: " << QVariant::typeToName(stateType.type()) << " (Discarding change)";
+        return;
+    }
+    if (stateType.minValue().isValid() && value < stateType.minValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << stateType.minValue() << " - " << stateType.maxValue() << " (Correcting to closest value within range)";
+        newValue = stateType.minValue();
+    }
+    if (stateType.maxValue().isValid() && value > stateType.maxValue()) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Out of range: " << stateType.minValue() << " - " << stateType.maxValue() << " (Correcting to closest value within range)";
+        newValue = stateType.maxValue();
+    }
+    if (!stateType.possibleValues().isEmpty() && !stateType.possibleValues().contains(value)) {
+        qCWarning(dcThing()).nospace() << m_name << ": Invalid value " << value << " for state " << stateType.name() << ". Not an accepted value. Possible values: " << stateType.possibleValues() << " (Discarding change)";
+        return;
+    }
 
-            if (oldValue == newValue) {
-                qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
-                return;
-            }
+    QVariant oldValue = m_states.at(i).value();
 
-            qCDebug(dcThing()).nospace() << m_name << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
-            m_states[i].setValue(newValue);
-            emit stateValueChanged(stateTypeId, value);
-            return;
-        }
+    if (oldValue == newValue) {
+        qCDebug(dcThing()).nospace() << m_name << ": Discarding state change for " << stateType.name() << " as the value did not actually change. Old value:" << oldValue << "New value:" << newValue;
+        return;
     }
-    Q_ASSERT_X(false, m_name.toUtf8(), QString("Failed setting state %1 to %2").arg(stateType.name()).arg(value.toString()).toUtf8());
-    qCWarning(dcThing).nospace() << m_name << ": Failed setting state " << stateType.name() << "to" << value;
+
+    qCDebug(dcThing()).nospace() << m_name << ": State " << stateType.name() << " changed from " << oldValue << " to " << newValue;
+    m_states[i].setValue(newValue);
+    emit stateValueChanged(stateTypeId, value);
 }
 
 /*! Returns the \l{State} with the given \a stateTypeId of this thing. */
 State Thing::state(const StateTypeId &stateTypeId) const
 {
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            return m_states.at(i);
-        }
+    int index = stateIndex(stateTypeId);
+    if (index < 0) {
+        return State(StateTypeId(), ThingId());
     }
-    return State(StateTypeId(), ThingId());
+    return m_states.at(index);
 }
 
 /*! Returns the \l{ThingId} of the parent of this thing. If the parentId
@@ -434,6 +427,21 @@ Thing::ThingError Thing::setupError() const
     return m_setupError;
 }
 
+int Thing::stateIndex(const StateTypeId &stateTypeId) const
+{
+    // States are created in the order of the thing class' state types
+    int index = m_thingClass.stateTypeIndex(stateTypeId);
+    if (index >= 0 && index < m_states.count() && m_states.at(index).stateTypeId() == stateTypeId) {
+        return index;
+    }
+    for (int i = 0; i < m_states.count(); ++i) {
+        if (m_states.at(i).stateTypeId() == stateTypeId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void Thing::setSetupStatus(Thing::ThingSetupStatus status, Thing::ThingError setupError, const QString &displayMessage)
 {
     m_setupStatus = status;
@@ -161,6 +161,7 @@ private:
     Thing(const PluginId &pluginId, const ThingClass &thingClass, QObject *parent = nullptr);
 
     void setSetupStatus(ThingSetupStatus status, ThingError setupError, const QString &displayMessage = QString());
+    int stateIndex(const StateTypeId &stateTypeId) const;
 
 private:
     ThingClass m_thingClass;
@@ -35,6 +35,194 @@
 #include <QFileInfo>
 #include <QJsonParseError>
 #include <QMetaEnum>
+#include <QHash>
+
+namespace {
+
+// Flattened interface definitions from the resources. As the definitions are compiled
+// into the library they can't change at runtime and only need to be parsed once.
+class InterfaceRegistry
+{
+public:
+    InterfaceRegistry();
+
+    QStringList names;
+    QHash<QString, Interface> interfaces;
+    QHash<QString, QStringList> parentLists;
+
+private:
+    Interface flatten(const QString &name);
+    QStringList buildParentList(const QString &name);
+    Interface parseInterface(const QString &name, const QVariantMap &content, const Interface &iface) const;
+
+    QHash<QString, QVariantMap> m_definitions;
+};
+
+InterfaceRegistry::InterfaceRegistry()
+{
+    QDir dir(":/interfaces/");
+    foreach (const QFileInfo &ifaceFile, dir.entryInfoList()) {
+        QFile f(ifaceFile.absoluteFilePath());
+        if (!f.open(QFile::ReadOnly)) {
+            qCWarning(dcThingManager()) << "Failed to load interface" << ifaceFile.baseName();
+            continue;
+        }
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
+        if (error.error != QJsonParseError::NoError) {
+            qCWarning(dcThingManager) << "Cannot load interface definition for interface" << ifaceFile.baseName() << ":" << error.errorString();
+            continue;
+        }
+        names.append(ifaceFile.baseName());
+        m_definitions.insert(ifaceFile.baseName(), jsonDoc.toVariant().toMap());
+    }
+
+    foreach (const QString &name, names) {
+        flatten(name);
+        buildParentList(name);
+    }
+    m_definitions.clear();
+}
+
+Interface InterfaceRegistry::flatten(const QString &name)
+{
+    if (interfaces.contains(name)) {
+        return interfaces.value(name);
+    }
+    if (!m_definitions.contains(name)) {
+        qCWarning(dcThingManager()) << "Failed to load interface" << name;
+        return Interface();
+    }
+
+    Interface iface;
+    QVariantMap content = m_definitions.value(name);
+    if (content.contains("extends")) {
+        if (!content.value("extends").toString().isEmpty()) {
+            iface = flatten(content.value("extends").toString());
+        } else if (content.value("extends").toList().count() > 0) {
+            foreach (const QVariant &extendedIface, content.value("extends").toList()) {
+                Interface tmp = flatten(extendedIface.toString());
+                iface = ThingUtils::mergeInterfaces(iface, tmp);
+            }
+        }
+    }
+
+    Interface flattened = parseInterface(name, content, iface);
+    interfaces.insert(name, flattened);
+    return flattened;
+}
+
+QStringList InterfaceRegistry::buildParentList(const QString &name)
+{
+    if (parentLists.contains(name)) {
+        return parentLists.value(name);
+    }
+    if (!m_definitions.contains(name)) {
+        qCWarning(dcThingManager()) << "Failed to load interface" << name;
+        return QStringList();
+    }
+
+    QStringList ret = {name};
+    QVariantMap content = m_definitions.value(name);
+    if (content.contains("extends")) {
+        if (!content.value("extends").toString().isEmpty()) {
+            ret << buildParentList(content.value("extends").toString());
+        } else if (content.value("extends").toList().count() > 0) {
+            foreach (const QVariant &extendedIface, content.value("extends").toList()) {
+                ret << buildParentList(extendedIface.toString());
+            }
+        }
+    }
+    parentLists.insert(name, ret);
+    return ret;
+}
+
+Interface InterfaceRegistry::parseInterface(const QString &name, const QVariantMap &content, const Interface &iface) const
+{
+    InterfaceStateTypes stateTypes;
+    InterfaceActionTypes actionTypes;
+    InterfaceEventTypes eventTypes;
+    foreach (const QVariant &stateVariant, content.value("states").toList()) {
+        InterfaceStateType stateType;
+        stateType.setName(stateVariant.toMap().value("name").toString());
+        stateType.setType(QVariant::nameToType(stateVariant.toMap().value("type").toByteArray()));
+        stateType.setPossibleValues(stateVariant.toMap().value("allowedValues").toList());
+        stateType.setMinValue(stateVariant.toMap().value("minValue"));
+        stateType.setMaxValue(stateVariant.toMap().value("maxValue"));
+        stateType.setOptional(stateVariant.toMap().value("optional", false).toBool());
+        if (stateVariant.toMap().contains("unit")) {
+            QMetaEnum unitEnum = QMetaEnum::fromType<Types::Unit>();
+            int enumValue = unitEnum.keyToValue("Unit" + stateVariant.toMap().value("unit").toByteArray());
+            if (enumValue == -1) {
+                qCWarning(dcThingManager) << "Invalid unit" << stateVariant.toMap().value("unit").toString() << "in interface" << name;
+            } else {
+                stateType.setUnit(static_cast<Types::Unit>(unitEnum.keyToValue("Unit" + stateVariant.toMap().value("unit").toByteArray())));
+            }
+        }
+        stateTypes.append(stateType);
+
+        InterfaceEventType stateChangeEventType;
+        stateChangeEventType.setName(stateType.name());
+        stateChangeEventType.setOptional(stateType.optional());
+        ParamType stateChangeEventParamType;
+        stateChangeEventParamType.setName(stateType.name());
+        stateChangeEventParamType.setType(stateType.type());
+        stateChangeEventParamType.setAllowedValues(stateType.possibleValues());
+        stateChangeEventParamType.setMinValue(stateType.minValue());
+        stateChangeEventParamType.setMaxValue(stateType.maxValue());
+        stateChangeEventType.setParamTypes(ParamTypes() << stateChangeEventParamType);
+        eventTypes.append(stateChangeEventType);
+
+        if (stateVariant.toMap().value("writable", false).toBool()) {
+            InterfaceActionType stateChangeActionType;
+            stateChangeActionType.setName(stateType.name());
+            stateChangeActionType.setOptional(stateType.optional());
+            stateChangeActionType.setParamTypes(ParamTypes() << stateChangeEventParamType);
+            actionTypes.append(stateChangeActionType);
+        }
+    }
+
+    foreach (const QVariant &actionVariant, content.value("actions").toList()) {
+        InterfaceActionType actionType;
+        actionType.setName(actionVariant.toMap().value("name").toString());
+        actionType.setOptional(actionVariant.toMap().value("optional").toBool());
+        ParamTypes paramTypes;
+        foreach (const QVariant &actionParamVariant, actionVariant.toMap().value("params").toList()) {
+            ParamType paramType;
+            paramType.setName(actionParamVariant.toMap().value("name").toString());
+            paramType.setType(QVariant::nameToType(actionParamVariant.toMap().value("type").toByteArray()));
+            paramType.setAllowedValues(actionParamVariant.toMap().value("allowedValues").toList());
+            paramType.setMinValue(actionParamVariant.toMap().value("min"));
+            paramTypes.append(paramType);
+        }
+        actionType.setParamTypes(paramTypes);
+        actionTypes.append(actionType);
+    }
+
+    foreach (const QVariant &eventVariant, content.value("events").toList()) {
+        InterfaceEventType eventType;
+        eventType.setName(eventVariant.toMap().value("name").toString());
+        eventType.setOptional(eventVariant.toMap().value("optional").toBool());
+        ParamTypes paramTypes;
+        foreach (const QVariant &eventParamVariant, eventVariant.toMap().value("params").toList()) {
+            ParamType paramType;
+            paramType.setName(eventParamVariant.toMap().value("name").toString());
+            paramType.setType(QVariant::nameToType(eventParamVariant.toMap().value("type").toByteArray()));
+            paramType.setAllowedValues(eventParamVariant.toMap().value("allowedValues").toList());
+            paramType.setMinValue(eventParamVariant.toMap().value("minValue"));
+            paramType.setMaxValue(eventParamVariant.toMap().value("maxValue"));
+            paramTypes.append(paramType);
+        }
+        eventType.setParamTypes(paramTypes);
+        eventTypes.append(eventType);
+    }
+
+    return Interface(name, iface.actionTypes() << actionTypes, iface.eventTypes() << eventTypes, iface.stateTypes() << stateTypes);
+}
+
+}
+
+Q_GLOBAL_STATIC(InterfaceRegistry, interfaceRegistry)
 
 ThingUtils::ThingUtils()
 {
@@ -156,118 +344,23 @@ Thing::ThingError ThingUtils::verifyParam(const ParamType &paramType, const Para
 Interfaces ThingUtils::allInterfaces()
 {
     Interfaces ret;
-    QDir dir(":/interfaces/");
-    foreach (const QFileInfo &ifaceFile, dir.entryInfoList()) {
-        ret.append(loadInterface(ifaceFile.baseName()));
+    InterfaceRegistry *registry = interfaceRegistry();
+    foreach (const QString &name, registry->names) {
+        ret.append(registry->interfaces.value(name));
     }
     return ret;
 }
 
+/*! Returns the interface with the given \a name including all the states, events and actions
+    of the interfaces it extends. The interface definitions are parsed only once. */
 Interface ThingUtils::loadInterface(const QString &name)
 {
-    Interface iface;
-    QFile f(QString(":/interfaces/%1.json").arg(name));
-    if (!f.open(QFile::ReadOnly)) {
+    InterfaceRegistry *registry = interfaceRegistry();
+    if (!registry->interfaces.contains(name)) {
         qCWarning(dcThingManager()) << "Failed to load interface" << name;
-        return iface;
+        return Interface();
     }
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(dcThingManager) << "Cannot load interface definition for interface" << name << ":" << error.errorString();
-        return iface;
-    }
-    QVariantMap content = jsonDoc.toVariant().toMap();
-    if (content.contains("extends")) {
-        if (!content.value("extends").toString().isEmpty()) {
-            iface = loadInterface(content.value("extends").toString());
-        } else if (content.value("extends").toList().count() > 0) {
-            foreach (const QVariant &extendedIface, content.value("extends").toList()) {
-                Interface tmp = loadInterface(extendedIface.toString());
-                iface = mergeInterfaces(iface, tmp);
-            }
-        }
-    }
-
-    InterfaceStateTypes stateTypes;
-    InterfaceActionTypes actionTypes;
-    InterfaceEventTypes eventTypes;
-    foreach (const QVariant &stateVariant, content.value("states").toList()) {
-        InterfaceStateType stateType;
-        stateType.setName(stateVariant.toMap().value("name").toString());
-        stateType.setType(QVariant::nameToType(stateVariant.toMap().value("type").toByteArray()));
-        stateType.setPossibleValues(stateVariant.toMap().value("allowedValues").toList());
-        stateType.setMinValue(stateVariant.toMap().value("minValue"));
-        stateType.setMaxValue(stateVariant.toMap().value("maxValue"));
-        stateType.setOptional(stateVariant.toMap().value("optional", false).toBool());
-        if (stateVariant.toMap().contains("unit")) {
-            QMetaEnum unitEnum = QMetaEnum::fromType<Types::Unit>();
-            int enumValue = unitEnum.keyToValue("Unit" + stateVariant.toMap().value("unit").toByteArray());
-            if (enumValue == -1) {
-                qCWarning(dcThingManager) << "Invalid unit" << stateVariant.toMap().value("unit").toString() << "in interface" << name;
-            } else {
-                stateType.setUnit(static_cast<Types::Unit>(unitEnum.keyToValue("Unit" + stateVariant.toMap().value("unit").toByteArray())));
-            }
-        }
-        stateTypes.append(stateType);
-
-        InterfaceEventType stateChangeEventType;
-        stateChangeEventType.setName(stateType.name());
-        stateChangeEventType.setOptional(stateType.optional());
-        ParamType stateChangeEventParamType;
-        stateChangeEventParamType.setName(stateType.name());
-        stateChangeEventParamType.setType(stateType.type());
-        stateChangeEventParamType.setAllowedValues(stateType.possibleValues());
-        stateChangeEventParamType.setMinValue(stateType.minValue());
-        stateChangeEventParamType.setMaxValue(stateType.maxValue());
-        stateChangeEventType.setParamTypes(ParamTypes() << stateChangeEventParamType);
-        eventTypes.append(stateChangeEventType);
-
-        if (stateVariant.toMap().value("writable", false).toBool()) {
-            InterfaceActionType stateChangeActionType;
-            stateChangeActionType.setName(stateType.name());
-            stateChangeActionType.setOptional(stateType.optional());
-            stateChangeActionType.setParamTypes(ParamTypes() << stateChangeEventParamType);
-            actionTypes.append(stateChangeActionType);
-        }
-    }
-
-    foreach (const QVariant &actionVariant, content.value("actions").toList()) {
-        InterfaceActionType actionType;
-        actionType.setName(actionVariant.toMap().value("name").toString());
-        actionType.setOptional(actionVariant.toMap().value("optional").toBool());
-        ParamTypes paramTypes;
-        foreach (const QVariant &actionParamVariant, actionVariant.toMap().value("params").toList()) {
-            ParamType paramType;
-            paramType.setName(actionParamVariant.toMap().value("name").toString());
-            paramType.setType(QVariant::nameToType(actionParamVariant.toMap().value("type").toByteArray()));
-            paramType.setAllowedValues(actionParamVariant.toMap().value("allowedValues").toList());
-            paramType.setMinValue(actionParamVariant.toMap().value("min"));
-            paramTypes.append(paramType);
-        }
-        actionType.setParamTypes(paramTypes);
-        actionTypes.append(actionType);
-    }
-
-    foreach (const QVariant &eventVariant, content.value("events").toList()) {
-        InterfaceEventType eventType;
-        eventType.setName(eventVariant.toMap().value("name").toString());
-        eventType.setOptional(eventVariant.toMap().value("optional").toBool());
-        ParamTypes paramTypes;
-        foreach (const QVariant &eventParamVariant, eventVariant.toMap().value("params").toList()) {
-            ParamType paramType;
-            paramType.setName(eventParamVariant.toMap().value("name").toString());
-            paramType.setType(QVariant::nameToType(eventParamVariant.toMap().value("type").toByteArray()));
-            paramType.setAllowedValues(eventParamVariant.toMap().value("allowedValues").toList());
-            paramType.setMinValue(eventParamVariant.toMap().value("minValue"));
-            paramType.setMaxValue(eventParamVariant.toMap().value("maxValue"));
-            paramTypes.append(paramType);
-        }
-        eventType.setParamTypes(paramTypes);
-        eventTypes.append(eventType);
-    }
-
-    return Interface(name, iface.actionTypes() << actionTypes, iface.eventTypes() << eventTypes, iface.stateTypes() << stateTypes);
+    return registry->interfaces.value(name);
 }
 
 Interface ThingUtils::mergeInterfaces(const Interface &iface1, const Interface &iface2)
@@ -295,27 +388,10 @@ Interface ThingUtils::mergeInterfaces(const Interface &iface1, const Interface &
 
 QStringList ThingUtils::generateInterfaceParentList(const QString &interface)
 {
-    QFile f(QString(":/interfaces/%1.json").arg(interface));
-    if (!f.open(QFile::ReadOnly)) {
+    InterfaceRegistry *registry = interfaceRegistry();
+    if (!registry->parentLists.contains(interface)) {
         qCWarning(dcThingManager()) << "Failed to load interface" << interface;
         return QStringList();
     }
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(f.readAll(), &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(dcThingManager) << "Cannot load interface definition for interface" << interface << ":" << error.errorString();
-        return QStringList();
-    }
-    QStringList ret = {interface};
-    QVariantMap content = jsonDoc.toVariant().toMap();
-    if (content.contains("extends")) {
-        if (!content.value("extends").toString().isEmpty()) {
-            ret << generateInterfaceParentList(content.value("extends").toString());
-        } else if (content.value("extends").toList().count() > 0) {
-            foreach (const QVariant &extendedIface, content.value("extends").toList()) {
-                ret << generateInterfaceParentList(extendedIface.toString());
-            }
-        }
-    }
-    return ret;
+    return registry->parentLists.value(interface);
 }
@@ -35,6 +35,306 @@
 #include <QDebug>
 #include <QDateTime>
 
+namespace {
+
+class ObjectPacker;
+
+// Everything needed to pack one property of a gadget, looked up once when the type is registered
+class PropertyPacker
+{
+public:
+    enum Kind {
+        KindValue,
+        KindDateTime,
+        KindTime,
+        KindEnum,
+        KindFlags,
+        KindBasicType,
+        KindIntList,
+        KindUuidList,
+        KindObject
+    };
+
+    QMetaProperty metaProperty;
+    QString name;
+    bool optional = false;
+    Kind kind = KindValue;
+    // Enum keys indexed like QMetaEnum::key(), flags as value/key pairs
+    QStringList enumKeys;
+    QList<QPair<int, QString> > flagKeys;
+    // Nested objects and lists are resolved on first use as they might be registered later
+    QByteArray typeName;
+    mutable const ObjectPacker *packer = nullptr;
+};
+
+class ObjectPacker
+{
+public:
+    bool isList = false;
+
+    // Objects
+    QList<PropertyPacker> properties;
+    QMetaMethod isValidMethod;
+
+    // Lists
+    QMetaProperty countProperty;
+    QMetaMethod getMethod;
+    QByteArray entryTypeName;
+    mutable const ObjectPacker *entryPacker = nullptr;
+};
+
+// The packers describe the registered types, not the handlers, so they are shared between all
+// handlers. This also keeps the JsonHandler layout stable for handlers implemented in plugins.
+class PackerRegistry
+{
+public:
+    ~PackerRegistry() {
+        qDeleteAll(m_packers);
+    }
+
+    // Packers are keyed on the fully qualified class name. Handlers are created again on restart and
+    // register the same types again. Keep the first packer as other packers might have resolved a
+    // pointer to it already.
+    void insert(const QMetaObject &metaObject, ObjectPacker *packer) {
+        QByteArray name(metaObject.className());
+        if (m_packers.contains(name)) {
+            if (!m_packersByClassName.contains(metaObject.className())) {
+                qCWarning(dcJsonRpc()) << "Type" << name << "is registered by different libraries. Using the first registration.";
+            }
+            delete packer;
+            packer = m_packers.value(name);
+        } else {
+            m_packers.insert(name, packer);
+            // Property type names are not always fully qualified. Resolve short names only if they are unique.
+            QByteArray alias = shortName(metaObject.className());
+            if (!m_shortNames.contains(alias)) {
+                m_shortNames.insert(alias, name);
+            } else if (!m_shortNames.value(alias).isEmpty()) {
+                qCWarning(dcJsonRpc()) << "Registered types" << m_shortNames.value(alias) << "and" << name << "share the name" << alias << "in the API. Nested properties of this type need to be fully qualified.";
+                m_shortNames.insert(alias, QByteArray());
+            }
+        }
+        m_packersByClassName.insert(metaObject.className(), packer);
+    }
+
+    const ObjectPacker *find(const QMetaObject &metaObject) const {
+        // Fast path: className() points to the static meta object data, no need to compare strings
+        const ObjectPacker *packer = m_packersByClassName.value(metaObject.className());
+        if (!packer) {
+            packer = m_packers.value(metaObject.className());
+        }
+        return packer;
+    }
+
+    const ObjectPacker *find(const QByteArray &name) const {
+        const ObjectPacker *packer = m_packers.value(name);
+        if (!packer && m_shortNames.contains(name)) {
+            // Ambiguous short names map to an empty name and are not resolved
+            packer = m_packers.value(m_shortNames.value(name));
+        }
+        return packer;
+    }
+
+    static QByteArray shortName(const char *className) {
+        QByteArray name(className);
+        int index = name.lastIndexOf("::");
+        return index >= 0 ? name.mid(index + 2) : name;
+    }
+
+private:
+    QHash<QByteArray, ObjectPacker*> m_packers;
+    QHash<QByteArray, QByteArray> m_shortNames;
+    QHash<const char*, ObjectPacker*> m_packersByClassName;
+};
+
+}
+
+Q_GLOBAL_STATIC(PackerRegistry, packerRegistry)
+
+// Returns nullptr if a property of the given type can't be handled. Such types keep using the generic pack code.
+static ObjectPacker *createObjectPacker(const QMetaObject &metaObject, const QHash<QString, QMetaEnum> &metaEnums, const QHash<QString, QMetaEnum> &metaFlags)
+{
+    ObjectPacker *packer = new ObjectPacker();
+    int isValidIndex = metaObject.indexOfMethod("isValid()");
+    if (isValidIndex >= 0) {
+        packer->isValidMethod = metaObject.method(isValidIndex);
+    }
+
+    for (int i = 0; i < metaObject.propertyCount(); i++) {
+        QMetaProperty metaProperty = metaObject.property(i);
+        if (metaProperty.name() == QStringLiteral("objectName")) {
+            continue;
+        }
+
+        PropertyPacker property;
+        property.metaProperty = metaProperty;
+        property.name = metaProperty.name();
+        property.optional = metaProperty.isUser();
+        QByteArray typeName = PackerRegistry::shortName(metaProperty.typeName());
+
+        if (metaProperty.isFlagType()) {
+            QMetaEnum metaFlag = metaFlags.value(QString::fromUtf8(typeName), metaProperty.enumerator());
+            if (!metaFlag.isValid()) {
+                delete packer;
+                return nullptr;
+            }
+            property.kind = PropertyPacker::KindFlags;
+            for (int j = 0; j < metaFlag.keyCount(); j++) {
+                property.flagKeys.append(qMakePair(metaFlag.value(j), QString(metaFlag.key(j))));
+            }
+        } else if (metaProperty.isEnumType()) {
+            QMetaEnum metaEnum = metaEnums.value(QString::fromUtf8(typeName), metaProperty.enumerator());
+            if (!metaEnum.isValid()) {
+                delete packer;
+                return nullptr;
+            }
+            property.kind = PropertyPacker::KindEnum;
+            for (int j = 0; j < metaEnum.keyCount(); j++) {
+                property.enumKeys.append(metaEnum.key(j));
+            }
+        } else if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
+            property.kind = PropertyPacker::KindBasicType;
+        } else if (metaProperty.type() == QVariant::UserType) {
+            if (typeName == "QList<int>") {
+                property.kind = PropertyPacker::KindIntList;
+            } else if (typeName == "QList<QUuid>") {
+                property.kind = PropertyPacker::KindUuidList;
+            } else if (typeName.startsWith("QList<")) {
+                delete packer;
+                return nullptr;
+            } else {
+                property.kind = PropertyPacker::KindObject;
+                // The meta type name is fully qualified, unlike the name used in the property declaration
+                const char *metaTypeName = metaProperty.userType() != QMetaType::UnknownType ? QMetaType::typeName(metaProperty.userType()) : nullptr;
+                property.typeName = metaTypeName ? QByteArray(metaTypeName) : QByteArray(metaProperty.typeName());
+            }
+        } else if (metaProperty.type() == QVariant::DateTime) {
+            property.kind = PropertyPacker::KindDateTime;
+        } else if (metaProperty.type() == QVariant::Time) {
+            property.kind = PropertyPacker::KindTime;
+        }
+        packer->properties.append(property);
+    }
+    return packer;
+}
+
+// Returns an invalid QVariant if a nested type has no packer. The caller falls back to the generic pack code then.
+static QVariant packObject(const ObjectPacker *packer, const void *value)
+{
+    if (packer->isList) {
+        if (!packer->entryPacker) {
+            packer->entryPacker = packerRegistry()->find(packer->entryTypeName);
+        }
+        QVariantList ret;
+        int count = packer->countProperty.readOnGadget(value).toInt();
+        ret.reserve(count);
+        for (int i = 0; i < count; i++) {
+            QVariant entry;
+            packer->getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+            if (!packer->entryPacker) {
+                return QVariant();
+            }
+            QVariant packed = packObject(packer->entryPacker, entry.data());
+            if (!packed.isValid()) {
+                return QVariant();
+            }
+            ret.append(packed);
+        }
+        return ret;
+    }
+
+    QVariantMap ret;
+    foreach (const PropertyPacker &property, packer->properties) {
+        QVariant propertyValue = property.metaProperty.readOnGadget(value);
+        // If it's optional and empty, we may skip it
+        if (property.optional && (!propertyValue.isValid() || propertyValue.isNull())) {
+            continue;
+        }
+
+        switch (property.kind) {
+        case PropertyPacker::KindFlags: {
+            int flagValue = propertyValue.toInt();
+            QStringList flags;
+            for (int i = 0; i < property.flagKeys.count(); i++) {
+                if ((property.flagKeys.at(i).first & flagValue) > 0) {
+                    flags.append(property.flagKeys.at(i).second);
+                }
+            }
+            ret.insert(property.name, flags);
+            break;
+        }
+        case PropertyPacker::KindEnum:
+            ret.insert(property.name, property.enumKeys.value(propertyValue.toInt()));
+            break;
+        case PropertyPacker::KindBasicType:
+            ret.insert(property.name, QMetaEnum::fromType<JsonHandler::BasicType>().key(JsonHandler::variantTypeToBasicType(propertyValue.value<QVariant::Type>())));
+            break;
+        case PropertyPacker::KindIntList: {
+            QVariantList list;
+            foreach (int entry, propertyValue.value<QList<int> >()) {
+                list << entry;
+            }
+            if (!list.isEmpty() || !property.optional) {
+                ret.insert(property.name, list);
+            }
+            break;
+        }
+        case PropertyPacker::KindUuidList: {
+            QVariantList list;
+            foreach (const QUuid &entry, propertyValue.value<QList<QUuid> >()) {
+                list << entry;
+            }
+            if (!list.isEmpty() || !property.optional) {
+                ret.insert(property.name, list);
+            }
+            break;
+        }
+        case PropertyPacker::KindObject: {
+            if (!property.packer) {
+                property.packer = packerRegistry()->find(property.typeName);
+            }
+            if (!property.packer) {
+                return QVariant();
+            }
+            QVariant packed = packObject(property.packer, propertyValue.data());
+            if (!packed.isValid()) {
+                return QVariant();
+            }
+            if (property.packer->isList) {
+                if (!property.optional || packed.toList().count() > 0) {
+                    ret.insert(property.name, packed);
+                }
+                break;
+            }
+            bool isValid = true;
+            if (property.packer->isValidMethod.isValid()) {
+                property.packer->isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
+            }
+            if (isValid || !property.optional) {
+                ret.insert(property.name, packed);
+            }
+            break;
+        }
+        case PropertyPacker::KindDateTime: {
+            // Special treatment for QDateTime (converting to time_t)
+            QDateTime dateTime = propertyValue.toDateTime();
+            if (property.optional && dateTime.toTime_t() == 0) {
+                break;
+            }
+            ret.insert(property.name, dateTime.toTime_t());
+            break;
+        }
+        case PropertyPacker::KindTime:
+            ret.insert(property.name, propertyValue.toTime().toString("hh:mm"));
+            break;
+        case PropertyPacker::KindValue:
+            ret.insert(property.name, propertyValue);
+            break;
+        }
+    }
+    return ret;
+}
+
 JsonHandler::JsonHandler(QObject *parent) : QObject(parent)
 {
     qRegisterMetaType<QVariant::Type>();
@@ -225,6 +525,11 @@ void JsonHandler::registerObject(const QMetaObject &metaObject)
     }
     m_objects.insert(className, description);
     m_metaObjects.insert(className, metaObject);
+
+    ObjectPacker *packer = createObjectPacker(metaObject, m_metaEnums, m_metaFlags);
+    if (packer) {
+        packerRegistry()->insert(metaObject, packer);
+    }
 }
 
 void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject)
@@ -239,10 +544,29 @@ void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObjec
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
+
+    if (!packerRegistry()->find(metaObject)) {
+        return;
+    }
+    ObjectPacker *packer = new ObjectPacker();
+    packer->isList = true;
+    packer->countProperty = listMetaObject.property(listMetaObject.indexOfProperty("count"));
+    packer->getMethod = listMetaObject.method(listMetaObject.indexOfMethod("get(int)"));
+    packer->entryTypeName = metaObject.className();
+    packerRegistry()->insert(listMetaObject, packer);
 }
 
 QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
 {
+    // Types registered with registerObject() are packed using the precompiled packers.
+    const ObjectPacker *packer = packerRegistry()->find(metaObject);
+    if (packer) {
+        QVariant packed = packObject(packer, value);
+        if (packed.isValid()) {
+            return packed;
+        }
+    }
+
     QString className = QString(metaObject.className()).split("::").last();
     if (m_listMetaObjects.contains(className)) {
         QVariantList ret;
@@ -98,6 +98,32 @@ void JsonReply::setData(const QVariantMap &data)
     m_data = data;
 }
 
+/*! Returns the already serialized params of this \l{JsonReply}. If set, the params will be sent
+    as they are instead of serializing \l{data()}. This allows handlers to cache large replies. */
+QByteArray JsonReply::serializedData() const
+{
+    return m_serializedData;
+}
+
+/*! Sets the \a serializedData of this \l{JsonReply}. It must contain a compact JSON object. */
+void JsonReply::setSerializedData(const QByteArray &serializedData)
+{
+    m_serializedData = serializedData;
+}
+
+/*! Returns the already CBOR encoded params of this \l{JsonReply}. Used instead of \l{serializedData()}
+    for clients which talk CBOR. */
+QByteArray JsonReply::serializedCborData() const
+{
+    return m_serializedCborData;
+}
+
+/*! Sets the \a serializedCborData of this \l{JsonReply}. It must contain a CBOR encoded map. */
+void JsonReply::setSerializedCborData(const QByteArray &serializedCborData)
+{
+    m_serializedCborData = serializedCborData;
+}
+
 /*! Returns the handler of this \l{JsonReply}.*/
 JsonHandler *JsonReply::handler() const
 {
@@ -54,6 +54,12 @@ public:
     QVariantMap data() const;
     void setData(const QVariantMap &data);
 
+    QByteArray serializedData() const;
+    void setSerializedData(const QByteArray &serializedData);
+
+    QByteArray serializedCborData() const;
+    void setSerializedCborData(const QByteArray &serializedCborData);
+
     JsonHandler *handler() const;
     QString method() const;
 
@@ -78,6 +84,8 @@ private:
     JsonReply(Type type, JsonHandler *handler, const QString &method, const QVariantMap &data = QVariantMap());
     Type m_type;
     QVariantMap m_data;
+    QByteArray m_serializedData;
+    QByteArray m_serializedCborData;
 
     JsonHandler *m_handler;
     QString m_method;
@@ -46,8 +46,14 @@ HEADERS += \
     typeutils.h \
     loggingcategories.h \
     nymeasettings.h \
+    settings/settingsbackend.h \
+    settings/inisettingsbackend.h \
+    settings/logsettingsbackend.h \
     hardware/gpio.h \
     hardware/gpiomonitor.h \
+    hardware/gpiochip.h \
+    hardware/gpiochardevchip.h \
+    hardware/gpiomockchip.h \
     hardware/pwm.h \
     hardware/radio433/radio433.h \
     network/upnp/upnpdiscovery.h \
@@ -126,10 +132,16 @@ SOURCES += \
     network/apikeys/apikeysprovider.cpp \
     network/apikeys/apikeystorage.cpp \
     nymeasettings.cpp \
+    typeutils.cpp \
+    settings/inisettingsbackend.cpp \
+    settings/logsettingsbackend.cpp \
     platform/package.cpp \
     platform/repository.cpp \
     hardware/gpio.cpp \
     hardware/gpiomonitor.cpp \
+    hardware/gpiochip.cpp \
+    hardware/gpiochardevchip.cpp \
+    hardware/gpiomockchip.cpp \
     hardware/pwm.cpp \
     hardware/radio433/radio433.cpp \
     network/upnp/upnpdiscovery.cpp \
@@ -41,6 +41,7 @@ NYMEA_LOGGING_CATEGORY(dcPluginMetadata, "PluginMetadata")
 NYMEA_LOGGING_CATEGORY(dcThing, "Thing")
 NYMEA_LOGGING_CATEGORY(dcThingManager, "ThingManager")
 NYMEA_LOGGING_CATEGORY(dcSystem, "System")
+NYMEA_LOGGING_CATEGORY(dcSettings, "Settings")
 NYMEA_LOGGING_CATEGORY(dcPlatform, "Platform")
 NYMEA_LOGGING_CATEGORY(dcPlatformUpdate, "PlatformUpdate")
 NYMEA_LOGGING_CATEGORY(dcPlatformZeroConf, "PlatformZeroConf")
@@ -57,6 +58,8 @@ NYMEA_LOGGING_CATEGORY(dcTcpServerTraffic, "TcpServerTraffic")
 NYMEA_LOGGING_CATEGORY(dcWebServer, "WebServer")
 NYMEA_LOGGING_CATEGORY(dcWebServerTraffic, "WebServerTraffic")
 NYMEA_LOGGING_CATEGORY(dcDebugServer, "DebugServer")
+NYMEA_LOGGING_CATEGORY(dcEventLoop, "EventLoop")
+NYMEA_LOGGING_CATEGORY(dcMemory, "Memory")
 NYMEA_LOGGING_CATEGORY(dcWebSocketServer, "WebSocketServer")
 NYMEA_LOGGING_CATEGORY(dcWebSocketServerTraffic, "WebSocketServerTraffic")
 NYMEA_LOGGING_CATEGORY(dcJsonRpc, "JsonRpc")
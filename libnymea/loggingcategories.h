@@ -53,6 +53,7 @@ Q_DECLARE_LOGGING_CATEGORY(dcPluginMetadata)
 Q_DECLARE_LOGGING_CATEGORY(dcThing)
 Q_DECLARE_LOGGING_CATEGORY(dcThingManager)
 Q_DECLARE_LOGGING_CATEGORY(dcSystem)
+Q_DECLARE_LOGGING_CATEGORY(dcSettings)
 Q_DECLARE_LOGGING_CATEGORY(dcPlatform)
 Q_DECLARE_LOGGING_CATEGORY(dcPlatformUpdate)
 Q_DECLARE_LOGGING_CATEGORY(dcPlatformZeroConf)
@@ -69,6 +70,8 @@ Q_DECLARE_LOGGING_CATEGORY(dcTcpServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcWebServer)
 Q_DECLARE_LOGGING_CATEGORY(dcWebServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcDebugServer)
+Q_DECLARE_LOGGING_CATEGORY(dcEventLoop)
+Q_DECLARE_LOGGING_CATEGORY(dcMemory)
 Q_DECLARE_LOGGING_CATEGORY(dcWebSocketServer)
 Q_DECLARE_LOGGING_CATEGORY(dcWebSocketServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcJsonRpc)
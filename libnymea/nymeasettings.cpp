@@ -40,6 +40,13 @@
     settings of the system. The different settings are represented ba the \l{SettingsRole} and
     can be used everywhere in the project.
 
+    Depending on the \l{StorageFormat}, the things, rules, thing states, tags and IO connections
+    are stored in an INI file or in a settings log which only appends the actually changed values
+    instead of rewriting the entire file on each change. The format can be selected with the
+    \tt{settingsFormat} key in the \tt{nymead} group of \b{nymead.conf} or the
+    \tt{NYMEA_SETTINGS_FORMAT} environment variable (\tt{log} or \tt{ini}). Existing settings
+    are migrated when the format changes.
+
 */
 
 /*! \enum NymeaSettings::SettingsRole
@@ -67,18 +74,28 @@
 
 */
 
+/*! \enum NymeaSettings::StorageFormat
+    The format used to store settings with a role that supports it.
+
+    \value StorageFormatIni
+        Settings are stored in INI files which are rewritten entirely whenever they are synced.
+    \value StorageFormatLog
+        Settings are stored in \b{.store} files. Changes are appended as records and the file
+        is compacted from time to time. This is the default.
+*/
+
 #include "nymeasettings.h"
+#include "settings/inisettingsbackend.h"
+#include "settings/logsettingsbackend.h"
 #include "unistd.h"
 
 #include <QSettings>
+#include <QFile>
 #include <QCoreApplication>
 #include <QDir>
 #include <QDebug>
 
-/*! Constructs a \l{NymeaSettings} instance with the given \a role and \a parent. */
-NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
-    QObject(parent),
-    m_role(role)
+static QString settingsBasePath()
 {
     QString settingsPrefix = QCoreApplication::instance()->organizationName() + "/";
 
@@ -88,49 +105,80 @@ NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
         settingsPrefix.clear(); // We don't want that in the snappy case...
     } else if (settingsPrefix == "nymea-test/") {
         basePath = "/tmp/";
-    } else if (isRoot()) {
+    } else if (NymeaSettings::isRoot()) {
         basePath = "/etc/";
     } else {
         basePath = QDir::homePath() + "/.config/";
     }
+    return basePath + settingsPrefix;
+}
 
+/*! Constructs a \l{NymeaSettings} instance with the given \a role and \a parent. */
+NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
+    QObject(parent),
+    m_role(role)
+{
     QString fileName;
+    bool logFormatSupported = false;
     switch (role) {
     case SettingsRoleNone:
         break;
     case SettingsRoleThings:
-        fileName = "things.conf";
+        fileName = "things";
+        logFormatSupported = true;
         break;
     case SettingsRoleRules:
-        fileName = "rules.conf";
+        fileName = "rules";
+        logFormatSupported = true;
         break;
     case SettingsRolePlugins:
-        fileName = "plugins.conf";
+        fileName = "plugins";
         break;
     case SettingsRoleGlobal:
-        fileName = "nymead.conf";
+        fileName = "nymead";
         break;
     case SettingsRoleThingStates:
-        fileName = "thingstates.conf";
+        fileName = "thingstates";
+        logFormatSupported = true;
         break;
     case SettingsRoleTags:
-        fileName = "tags.conf";
+        fileName = "tags";
+        logFormatSupported = true;
         break;
     case SettingsRoleMqttPolicies:
-        fileName = "mqttpolicies.conf";
+        fileName = "mqttpolicies";
         break;
     case SettingsRoleIOConnections:
-        fileName = "ioconnections.conf";
+        fileName = "ioconnections";
+        logFormatSupported = true;
         break;
     }
-    m_settings = new QSettings(basePath + settingsPrefix + fileName, QSettings::IniFormat, this);
+
+    QString basePath = settingsBasePath();
+    if (fileName.isEmpty()) {
+        m_backend = new IniSettingsBackend(basePath);
+        return;
+    }
+
+    QString iniFileName = basePath + fileName + ".conf";
+    QString logFileName = basePath + fileName + ".store";
+    if (logFormatSupported && storageFormat() == StorageFormatLog) {
+        m_backend = new LogSettingsBackend(logFileName, iniFileName);
+        return;
+    }
+
+    // The settings log is renamed once migrated. If it is still there, it holds the latest settings,
+    // even if an INI file exists, e.g. an outdated one restored by a legacy config migration.
+    if (logFormatSupported && QFile::exists(logFileName)) {
+        LogSettingsBackend::migrateToIni(logFileName, iniFileName);
+    }
+    m_backend = new IniSettingsBackend(iniFileName);
 }
 
-/*! Destructor of the NymeaSettings.*/
+/*! Destructor of the NymeaSettings. Pending changes are written to disk.*/
 NymeaSettings::~NymeaSettings()
 {
-    m_settings->sync();
-    delete m_settings;
+    delete m_backend;
 }
 
 /*! Returns the \l{SettingsRole} of this \l{NymeaSettings}.*/
@@ -139,6 +187,21 @@ NymeaSettings::SettingsRole NymeaSettings::settingsRole() const
     return m_role;
 }
 
+/*! Returns the \l{StorageFormat} used for the roles supporting it. The format is read once from the
+    \tt{NYMEA_SETTINGS_FORMAT} environment variable or the \b{nymead.conf} file. */
+NymeaSettings::StorageFormat NymeaSettings::storageFormat()
+{
+    static const StorageFormat format = [](){
+        QString formatName = qgetenv("NYMEA_SETTINGS_FORMAT");
+        if (formatName.isEmpty()) {
+            QSettings globalSettings(settingsBasePath() + "nymead.conf", QSettings::IniFormat);
+            formatName = globalSettings.value("nymead/settingsFormat", "log").toString();
+        }
+        return formatName.toLower() == "ini" ? StorageFormatIni : StorageFormatLog;
+    }();
+    return format;
+}
+
 /*! Returns true if nymead is started as \b{root}.*/
 bool NymeaSettings::isRoot()
 {
@@ -200,104 +263,110 @@ QString NymeaSettings::storagePath()
 /*! Return a list of all settings keys.*/
 QStringList NymeaSettings::allKeys() const
 {
-    return m_settings->allKeys();
+    return m_backend->allKeys();
 }
 
 /*! Adds \a prefix to the current group and starts writing an array of size size. If size is -1 (the default),
  * it is automatically determined based on the indexes of the entries written. */
 void NymeaSettings::beginWriteArray(const QString &prefix)
 {
-    m_settings->beginWriteArray(prefix);
+    m_backend->beginWriteArray(prefix);
 }
 
 /*! Sets the current array index to \a i. */
 void NymeaSettings::setArrayIndex(int i)
 {
-    m_settings->setArrayIndex(i);
+    m_backend->setArrayIndex(i);
 }
 
 /*! Adds \a prefix to the current group and starts reading from an array. Returns the size of the array.*/
 int NymeaSettings::beginReadArray(const QString &prefix)
 {
-    return m_settings->beginReadArray(prefix);
+    return m_backend->beginReadArray(prefix);
 }
 
 /*! End an array. */
 void NymeaSettings::endArray()
 {
-    m_settings->endArray();
+    m_backend->endArray();
 }
 
 /*! Begins a new group with the given \a prefix.*/
 void NymeaSettings::beginGroup(const QString &prefix)
 {
-    m_settings->beginGroup(prefix);
+    m_backend->beginGroup(prefix);
 }
 
 /*! Returns a list of all key top-level groups that contain keys that can be read
  *  using the \l{NymeaSettings} object.*/
 QStringList NymeaSettings::childGroups() const
 {
-    return m_settings->childGroups();
+    return m_backend->childGroups();
 }
 
 /*! Returns a list of all top-level keys that can be read using the \l{NymeaSettings} object.*/
 QStringList NymeaSettings::childKeys() const
 {
-    return m_settings->childKeys();
+    return m_backend->childKeys();
 }
 
 /*! Removes all entries in the primary location associated to this \l{NymeaSettings} object.*/
 void NymeaSettings::clear()
 {
-    m_settings->clear();
+    m_backend->clear();
 }
 
 /*! Returns true if there exists a setting called \a key; returns false otherwise. */
 bool NymeaSettings::contains(const QString &key) const
 {
-    return m_settings->contains(key);
+    return m_backend->contains(key);
 }
 
 /*! Resets the group to what it was before the corresponding beginGroup() call. */
 void NymeaSettings::endGroup()
 {
-    m_settings->endGroup();
+    m_backend->endGroup();
 }
 
 /*! Returns the current group. */
 QString NymeaSettings::group() const
 {
-    return m_settings->group();
+    return m_backend->group();
 }
 
 /*! Returns the path where settings written using this \l{NymeaSettings} object are stored. */
 QString NymeaSettings::fileName() const
 {
-    return m_settings->fileName();
+    return m_backend->fileName();
 }
 
 /*! Returns true if settings can be written using this \l{NymeaSettings} object; returns false otherwise. */
 bool NymeaSettings::isWritable() const
 {
-    return m_settings->isWritable();
+    return m_backend->isWritable();
 }
 
 /*! Removes the setting key and any sub-settings of \a key. */
 void NymeaSettings::remove(const QString &key)
 {
-    m_settings->remove(key);
+    m_backend->remove(key);
 }
 
 /*! Sets the \a value of setting \a key to value. If the \a key already exists, the previous value is overwritten. */
 void NymeaSettings::setValue(const QString &key, const QVariant &value)
 {
-    m_settings->setValue(key, value);
+    m_backend->setValue(key, value);
 }
 
 /*! Returns the value for setting \a key. If the setting doesn't exist, returns \a defaultValue. */
 QVariant NymeaSettings::value(const QString &key, const QVariant &defaultValue) const
 {
-    return m_settings->value(key, defaultValue);
+    return m_backend->value(key, defaultValue);
 }
 
+
+/*! Writes any pending changes to disk. This also happens when the \l{NymeaSettings} object is destroyed. */
+void NymeaSettings::sync()
+{
+    m_backend->sync();
+}
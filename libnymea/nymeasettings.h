@@ -36,7 +36,7 @@
 
 #include "libnymea.h"
 
-class QSettings;
+class SettingsBackend;
 
 class LIBNYMEA_EXPORT NymeaSettings : public QObject
 {
@@ -54,11 +54,18 @@ public:
         SettingsRoleIOConnections,
     };
 
+    enum StorageFormat {
+        StorageFormatIni,
+        StorageFormatLog
+    };
+
     explicit NymeaSettings(const SettingsRole &role = SettingsRoleNone, QObject *parent = nullptr);
     ~NymeaSettings();
 
     SettingsRole settingsRole() const;
 
+    static StorageFormat storageFormat();
+
     static bool isRoot();
     static QString settingsPath();
     static QString translationsPath();
@@ -84,8 +91,10 @@ public:
     void setValue(const QString & key, const QVariant &value);
     QVariant value(const QString & key, const QVariant & defaultValue = QVariant()) const;
 
+    void sync();
+
 private:
-    QSettings *m_settings;
+    SettingsBackend *m_backend;
     SettingsRole m_role;
 
 };
@@ -0,0 +1,135 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "inisettingsbackend.h"
+
+#include <QSettings>
+
+IniSettingsBackend::IniSettingsBackend(const QString &fileName):
+    m_settings(new QSettings(fileName, QSettings::IniFormat))
+{
+
+}
+
+IniSettingsBackend::~IniSettingsBackend()
+{
+    m_settings->sync();
+    delete m_settings;
+}
+
+QStringList IniSettingsBackend::allKeys() const
+{
+    return m_settings->allKeys();
+}
+
+void IniSettingsBackend::beginWriteArray(const QString &prefix)
+{
+    m_settings->beginWriteArray(prefix);
+}
+
+void IniSettingsBackend::setArrayIndex(int i)
+{
+    m_settings->setArrayIndex(i);
+}
+
+int IniSettingsBackend::beginReadArray(const QString &prefix)
+{
+    return m_settings->beginReadArray(prefix);
+}
+
+void IniSettingsBackend::endArray()
+{
+    m_settings->endArray();
+}
+
+void IniSettingsBackend::beginGroup(const QString &prefix)
+{
+    m_settings->beginGroup(prefix);
+}
+
+QStringList IniSettingsBackend::childGroups() const
+{
+    return m_settings->childGroups();
+}
+
+QStringList IniSettingsBackend::childKeys() const
+{
+    return m_settings->childKeys();
+}
+
+void IniSettingsBackend::clear()
+{
+    m_settings->clear();
+}
+
+bool IniSettingsBackend::contains(const QString &key) const
+{
+    return m_settings->contains(key);
+}
+
+void IniSettingsBackend::endGroup()
+{
+    m_settings->endGroup();
+}
+
+QString IniSettingsBackend::group() const
+{
+    return m_settings->group();
+}
+
+QString IniSettingsBackend::fileName() const
+{
+    return m_settings->fileName();
+}
+
+bool IniSettingsBackend::isWritable() const
+{
+    return m_settings->isWritable();
+}
+
+void IniSettingsBackend::remove(const QString &key)
+{
+    m_settings->remove(key);
+}
+
+void IniSettingsBackend::setValue(const QString &key, const QVariant &value)
+{
+    m_settings->setValue(key, value);
+}
+
+QVariant IniSettingsBackend::value(const QString &key, const QVariant &defaultValue) const
+{
+    return m_settings->value(key, defaultValue);
+}
+
+void IniSettingsBackend::sync()
+{
+    m_settings->sync();
+}
@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INISETTINGSBACKEND_H
+#define INISETTINGSBACKEND_H
+
+#include "settingsbackend.h"
+
+class QSettings;
+
+class IniSettingsBackend: public SettingsBackend
+{
+public:
+    explicit IniSettingsBackend(const QString &fileName);
+    ~IniSettingsBackend() override;
+
+    QStringList allKeys() const override;
+    void beginWriteArray(const QString &prefix) override;
+    void setArrayIndex(int i) override;
+    int beginReadArray(const QString &prefix) override;
+    void endArray() override;
+
+    void beginGroup(const QString &prefix) override;
+    QStringList childGroups() const override;
+    QStringList childKeys() const override;
+    void clear() override;
+    bool contains(const QString &key) const override;
+    void endGroup() override;
+    QString group() const override;
+    QString fileName() const override;
+    bool isWritable() const override;
+    void remove(const QString &key) override;
+    void setValue(const QString &key, const QVariant &value) override;
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const override;
+
+    void sync() override;
+
+private:
+    QSettings *m_settings = nullptr;
+};
+
+#endif // INISETTINGSBACKEND_H
@@ -0,0 +1,679 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+  The log backend keeps all values of a settings file in memory and appends the changes made by a
+  NymeaSettings instance as a single checksummed block when it is synced or destroyed. A block
+  that was not written completely (e.g. because of a power loss) is discarded when loading. Once the
+  log has grown to more than twice the size of the last snapshot, it is compacted by writing a new
+  snapshot containing only the current values.
+
+  File layout:
+      quint32 magic, quint32 format version
+      blocks of: quint32 payload length, quint16 payload checksum, payload
+      payload: quint32 record count, records of: quint8 type, QString key[, QVariant value]
+*/
+
+#include "logsettingsbackend.h"
+#include "loggingcategories.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSettings>
+
+#include <unistd.h>
+
+static const quint32 logMagic = 0x6e796d73;
+static const quint32 logFormatVersion = 1;
+static const QDataStream::Version logStreamVersion = QDataStream::Qt_5_0;
+// Don't bother compacting small files
+static const qint64 compactionThreshold = 64 * 1024;
+
+class LogSettingsStore
+{
+public:
+    enum RecordType {
+        RecordTypeSet = 1,
+        RecordTypeRemove = 2
+    };
+
+    class Record {
+    public:
+        RecordType type;
+        QString key;
+        QVariant value;
+    };
+
+    static LogSettingsStore *open(const QString &fileName, const QString &iniFileName);
+    static void close(const QString &fileName);
+
+    QString fileName() const;
+    bool isWritable() const;
+
+    bool contains(const QString &key) const;
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    QStringList keys(const QString &group) const;
+
+    bool setValue(const QString &key, const QVariant &value);
+    void remove(const QString &key);
+
+    bool commit(const QList<Record> &records);
+
+private:
+    explicit LogSettingsStore(const QString &fileName);
+
+    bool load();
+    bool migrateFromIni(const QString &iniFileName);
+    bool writeSnapshot();
+    bool parseBlock(const QByteArray &payload, QList<Record> &records) const;
+    static bool serialize(const QList<Record> &records, QByteArray &payload);
+
+    QString m_fileName;
+    bool m_writable = false;
+    qint64 m_snapshotSize = 0;
+    QMap<QString, QVariant> m_values;
+    mutable QMutex m_mutex;
+};
+
+namespace {
+
+class LogSettingsStores
+{
+public:
+    ~LogSettingsStores() {
+        qDeleteAll(stores);
+    }
+
+    QMutex mutex;
+    QHash<QString, LogSettingsStore*> stores;
+};
+
+}
+
+Q_GLOBAL_STATIC(LogSettingsStores, logSettingsStores)
+
+LogSettingsStore *LogSettingsStore::open(const QString &fileName, const QString &iniFileName)
+{
+    QMutexLocker locker(&logSettingsStores()->mutex);
+    LogSettingsStore *store = logSettingsStores()->stores.value(fileName);
+    if (store) {
+        return store;
+    }
+
+    store = new LogSettingsStore(fileName);
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    if (!QFile::exists(fileName) && !iniFileName.isEmpty() && QFile::exists(iniFileName)) {
+        store->migrateFromIni(iniFileName);
+    } else if (QFile::exists(fileName)) {
+        store->load();
+    } else {
+        store->writeSnapshot();
+    }
+    store->m_writable = QFileInfo(fileName).isWritable();
+    logSettingsStores()->stores.insert(fileName, store);
+    return store;
+}
+
+void LogSettingsStore::close(const QString &fileName)
+{
+    QMutexLocker locker(&logSettingsStores()->mutex);
+    delete logSettingsStores()->stores.take(fileName);
+}
+
+LogSettingsStore::LogSettingsStore(const QString &fileName):
+    m_fileName(fileName)
+{
+
+}
+
+QString LogSettingsStore::fileName() const
+{
+    return m_fileName;
+}
+
+bool LogSettingsStore::isWritable() const
+{
+    return m_writable;
+}
+
+bool LogSettingsStore::contains(const QString &key) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_values.contains(key);
+}
+
+QVariant LogSettingsStore::value(const QString &key, const QVariant &defaultValue) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_values.value(key, defaultValue);
+}
+
+QStringList LogSettingsStore::keys(const QString &group) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (group.isEmpty()) {
+        return m_values.keys();
+    }
+    QStringList ret;
+    QString prefix = group + '/';
+    for (QMap<QString, QVariant>::const_iterator it = m_values.lowerBound(prefix); it != m_values.constEnd() && it.key().startsWith(prefix); ++it) {
+        ret.append(it.key());
+    }
+    return ret;
+}
+
+bool LogSettingsStore::setValue(const QString &key, const QVariant &value)
+{
+    // Refuse values which can't be written, a broken record would make load() drop every block after it
+    Record record;
+    record.type = RecordTypeSet;
+    record.key = key;
+    record.value = value;
+    QByteArray payload;
+    if (!serialize(QList<Record>() << record, payload)) {
+        qCWarning(dcSettings()) << "Not storing" << key << "in" << m_fileName << "as its value cannot be serialized:" << value;
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_values.insert(key, value);
+    return true;
+}
+
+void LogSettingsStore::remove(const QString &key)
+{
+    QMutexLocker locker(&m_mutex);
+    m_values.remove(key);
+}
+
+bool LogSettingsStore::commit(const QList<Record> &records)
+{
+    if (records.isEmpty()) {
+        return true;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    QByteArray payload;
+    if (!serialize(records, payload)) {
+        qCWarning(dcSettings()) << "Not writing changes to" << m_fileName << "as they cannot be serialized";
+        return false;
+    }
+
+    QFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Append)) {
+        qCWarning(dcSettings()) << "Cannot open" << m_fileName << "for writing:" << file.errorString();
+        return false;
+    }
+    qint64 validSize = file.size();
+    QDataStream stream(&file);
+    stream.setVersion(logStreamVersion);
+    stream << static_cast<quint32>(payload.size()) << qChecksum(payload.constData(), static_cast<uint>(payload.size()));
+    stream.writeRawData(payload.constData(), payload.size());
+    file.flush();
+    if (stream.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        // Don't leave a partial block behind for the next commit to append to
+        qCWarning(dcSettings()) << "Error writing changes to" << m_fileName << file.errorString();
+        file.close();
+        QFile::resize(m_fileName, validSize);
+        return false;
+    }
+    fsync(file.handle());
+    qint64 fileSize = file.size();
+    file.close();
+
+    if (fileSize > 2 * m_snapshotSize + compactionThreshold) {
+        qCDebug(dcSettings()) << "Compacting" << m_fileName << "from" << fileSize << "bytes";
+        writeSnapshot();
+    }
+    return true;
+}
+
+bool LogSettingsStore::load()
+{
+    QFile file(m_fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcSettings()) << "Cannot open" << m_fileName << "for reading:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(logStreamVersion);
+    quint32 magic = 0, formatVersion = 0;
+    stream >> magic >> formatVersion;
+    if (magic != logMagic || formatVersion != logFormatVersion) {
+        qCWarning(dcSettings()) << m_fileName << "is not a valid settings file. Moving it out of the way.";
+        file.close();
+        QFile::remove(m_fileName + ".broken");
+        QFile::rename(m_fileName, m_fileName + ".broken");
+        return writeSnapshot();
+    }
+
+    qint64 validSize = file.pos();
+    int recordCount = 0;
+    while (!stream.atEnd()) {
+        quint32 length = 0;
+        quint16 checksum = 0;
+        stream >> length >> checksum;
+        if (stream.status() != QDataStream::Ok || length > file.size() - file.pos()) {
+            break;
+        }
+        QByteArray payload(static_cast<int>(length), Qt::Uninitialized);
+        if (stream.readRawData(payload.data(), payload.size()) != payload.size()) {
+            break;
+        }
+        QList<Record> records;
+        if (qChecksum(payload.constData(), length) != checksum || !parseBlock(payload, records)) {
+            break;
+        }
+        foreach (const Record &record, records) {
+            if (record.type == RecordTypeSet) {
+                m_values.insert(record.key, record.value);
+            } else {
+                m_values.remove(record.key);
+            }
+        }
+        recordCount += records.count();
+        validSize = file.pos();
+    }
+    qint64 fileSize = file.size();
+    file.close();
+
+    if (validSize < fileSize) {
+        qCWarning(dcSettings()) << "Discarding" << fileSize - validSize << "bytes of incomplete changes in" << m_fileName;
+        QFile::resize(m_fileName, validSize);
+    }
+
+    m_snapshotSize = validSize;
+    if (recordCount > 2 * m_values.count() + 1000) {
+        writeSnapshot();
+    }
+    qCDebug(dcSettings()) << "Loaded" << m_values.count() << "settings from" << m_fileName;
+    return true;
+}
+
+bool LogSettingsStore::migrateFromIni(const QString &iniFileName)
+{
+    qCInfo(dcSettings()) << "Migrating settings from" << iniFileName << "to" << m_fileName;
+    QSettings ini(iniFileName, QSettings::IniFormat);
+    foreach (const QString &key, ini.allKeys()) {
+        m_values.insert(key, ini.value(key));
+    }
+    if (!writeSnapshot()) {
+        return false;
+    }
+    QFile::remove(iniFileName + ".migrated");
+    QFile::rename(iniFileName, iniFileName + ".migrated");
+    return true;
+}
+
+bool LogSettingsStore::writeSnapshot()
+{
+    QList<Record> records;
+    for (QMap<QString, QVariant>::const_iterator it = m_values.constBegin(); it != m_values.constEnd(); ++it) {
+        Record record;
+        record.type = RecordTypeSet;
+        record.key = it.key();
+        record.value = it.value();
+        records.append(record);
+    }
+    QByteArray payload;
+    if (!serialize(records, payload)) {
+        qCWarning(dcSettings()) << "Not writing snapshot of" << m_fileName << "as it cannot be serialized";
+        return false;
+    }
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcSettings()) << "Cannot open" << m_fileName << "for writing:" << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(logStreamVersion);
+    stream << logMagic << logFormatVersion;
+    stream << static_cast<quint32>(payload.size()) << qChecksum(payload.constData(), static_cast<uint>(payload.size()));
+    stream.writeRawData(payload.constData(), payload.size());
+    if (stream.status() != QDataStream::Ok) {
+        // Leaves the existing file untouched
+        qCWarning(dcSettings()) << "Error writing" << m_fileName << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    qint64 size = file.size();
+    if (!file.commit()) {
+        qCWarning(dcSettings()) << "Error writing" << m_fileName << file.errorString();
+        return false;
+    }
+    m_snapshotSize = size;
+    return true;
+}
+
+bool LogSettingsStore::parseBlock(const QByteArray &payload, QList<Record> &records) const
+{
+    QDataStream stream(payload);
+    stream.setVersion(logStreamVersion);
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count; i++) {
+        quint8 type = 0;
+        Record record;
+        stream >> type >> record.key;
+        if (type == RecordTypeSet) {
+            stream >> record.value;
+        } else if (type != RecordTypeRemove) {
+            return false;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        record.type = static_cast<RecordType>(type);
+        records.append(record);
+    }
+    return true;
+}
+
+bool LogSettingsStore::serialize(const QList<Record> &records, QByteArray &payload)
+{
+    payload.clear();
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(logStreamVersion);
+    stream << static_cast<quint32>(records.count());
+    foreach (const Record &record, records) {
+        stream << static_cast<quint8>(record.type) << record.key;
+        if (record.type == RecordTypeSet) {
+            stream << record.value;
+        }
+        // E.g. a QVariant of a type without stream operators
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(dcSettings()) << "Cannot serialize the value of" << record.key;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+LogSettingsBackend::LogSettingsBackend(const QString &fileName, const QString &iniFileName):
+    m_store(LogSettingsStore::open(fileName, iniFileName))
+{
+
+}
+
+LogSettingsBackend::~LogSettingsBackend()
+{
+    sync();
+}
+
+/* Moves the content of the settings log in fileName to the INI file iniFileName, used when switching back to the INI format. */
+bool LogSettingsBackend::migrateToIni(const QString &fileName, const QString &iniFileName)
+{
+    qCInfo(dcSettings()) << "Migrating settings from" << fileName << "to" << iniFileName;
+    LogSettingsStore *store = LogSettingsStore::open(fileName, QString());
+    QSettings ini(iniFileName, QSettings::IniFormat);
+    // Don't keep anything from an outdated INI file
+    ini.clear();
+    foreach (const QString &key, store->keys(QString())) {
+        ini.setValue(key, store->value(key));
+    }
+    ini.sync();
+    LogSettingsStore::close(fileName);
+    if (ini.status() != QSettings::NoError) {
+        qCWarning(dcSettings()) << "Error writing" << iniFileName;
+        return false;
+    }
+    QFile::remove(fileName + ".migrated");
+    return QFile::rename(fileName, fileName + ".migrated");
+}
+
+QStringList LogSettingsBackend::allKeys() const
+{
+    return relativeKeys();
+}
+
+void LogSettingsBackend::beginWriteArray(const QString &prefix)
+{
+    ArrayState array;
+    array.prefix = fullKey(prefix);
+    array.write = true;
+    m_arrays.append(array);
+    m_groups.append(array.prefix);
+}
+
+void LogSettingsBackend::setArrayIndex(int i)
+{
+    if (m_arrays.isEmpty()) {
+        qCWarning(dcSettings()) << "setArrayIndex() called without beginReadArray() or beginWriteArray()";
+        return;
+    }
+    ArrayState &array = m_arrays.last();
+    if (array.indexSet) {
+        m_groups.removeLast();
+    }
+    m_groups.append(array.prefix + '/' + QString::number(i + 1));
+    array.indexSet = true;
+    if (array.write) {
+        array.size = qMax(array.size, i + 1);
+    }
+}
+
+int LogSettingsBackend::beginReadArray(const QString &prefix)
+{
+    ArrayState array;
+    array.prefix = fullKey(prefix);
+    m_arrays.append(array);
+    m_groups.append(array.prefix);
+    return m_store->value(array.prefix + "/size").toInt();
+}
+
+void LogSettingsBackend::endArray()
+{
+    if (m_arrays.isEmpty()) {
+        qCWarning(dcSettings()) << "endArray() called without beginReadArray() or beginWriteArray()";
+        return;
+    }
+    ArrayState array = m_arrays.takeLast();
+    if (array.indexSet) {
+        m_groups.removeLast();
+    }
+    m_groups.removeLast();
+    if (array.write && array.size >= 0) {
+        touch(array.prefix + "/size");
+        m_store->setValue(array.prefix + "/size", array.size);
+    }
+}
+
+void LogSettingsBackend::beginGroup(const QString &prefix)
+{
+    m_groups.append(fullKey(prefix));
+}
+
+QStringList LogSettingsBackend::childGroups() const
+{
+    QStringList groups;
+    foreach (const QString &key, relativeKeys()) {
+        int index = key.indexOf('/');
+        if (index > 0) {
+            QString group = key.left(index);
+            if (groups.isEmpty() || groups.last() != group) {
+                groups.append(group);
+            }
+        }
+    }
+    return groups;
+}
+
+QStringList LogSettingsBackend::childKeys() const
+{
+    QStringList keys;
+    foreach (const QString &key, relativeKeys()) {
+        if (!key.contains('/')) {
+            keys.append(key);
+        }
+    }
+    return keys;
+}
+
+void LogSettingsBackend::clear()
+{
+    foreach (const QString &key, m_store->keys(QString())) {
+        touch(key);
+        m_store->remove(key);
+    }
+}
+
+bool LogSettingsBackend::contains(const QString &key) const
+{
+    return m_store->contains(fullKey(key));
+}
+
+void LogSettingsBackend::endGroup()
+{
+    if (m_groups.isEmpty()) {
+        qCWarning(dcSettings()) << "endGroup() called without beginGroup()";
+        return;
+    }
+    m_groups.removeLast();
+}
+
+QString LogSettingsBackend::group() const
+{
+    return m_groups.isEmpty() ? QString() : m_groups.last();
+}
+
+QString LogSettingsBackend::fileName() const
+{
+    return m_store->fileName();
+}
+
+bool LogSettingsBackend::isWritable() const
+{
+    return m_store->isWritable();
+}
+
+void LogSettingsBackend::remove(const QString &key)
+{
+    QString fullName = fullKey(key);
+    QStringList keys = m_store->keys(fullName);
+    if (!fullName.isEmpty() && m_store->contains(fullName)) {
+        keys.append(fullName);
+    }
+    foreach (const QString &name, keys) {
+        touch(name);
+        m_store->remove(name);
+    }
+}
+
+void LogSettingsBackend::setValue(const QString &key, const QVariant &value)
+{
+    QString fullName = fullKey(key);
+    if (fullName.isEmpty()) {
+        return;
+    }
+    touch(fullName);
+    m_store->setValue(fullName, value);
+}
+
+QVariant LogSettingsBackend::value(const QString &key, const QVariant &defaultValue) const
+{
+    return m_store->value(fullKey(key), defaultValue);
+}
+
+void LogSettingsBackend::sync()
+{
+    QList<LogSettingsStore::Record> records;
+    for (QHash<QString, QVariant>::const_iterator it = m_originalValues.constBegin(); it != m_originalValues.constEnd(); ++it) {
+        LogSettingsStore::Record record;
+        record.key = it.key();
+        if (!m_store->contains(it.key())) {
+            record.type = LogSettingsStore::RecordTypeRemove;
+        } else if (m_store->value(it.key()) != it.value()) {
+            record.type = LogSettingsStore::RecordTypeSet;
+            record.value = m_store->value(it.key());
+        } else {
+            continue;
+        }
+        records.append(record);
+    }
+    foreach (const QString &key, m_originallyMissing) {
+        if (m_store->contains(key)) {
+            LogSettingsStore::Record record;
+            record.type = LogSettingsStore::RecordTypeSet;
+            record.key = key;
+            record.value = m_store->value(key);
+            records.append(record);
+        }
+    }
+    m_originalValues.clear();
+    m_originallyMissing.clear();
+    m_store->commit(records);
+}
+
+QString LogSettingsBackend::fullKey(const QString &key) const
+{
+    // Normalize like QSettings does: no leading, trailing or duplicate separators
+    QStringList parts;
+    if (!m_groups.isEmpty()) {
+        parts.append(m_groups.last());
+    }
+    foreach (const QString &part, QString(key).replace('\\', '/').split('/')) {
+        if (!part.isEmpty()) {
+            parts.append(part);
+        }
+    }
+    return parts.join('/');
+}
+
+QStringList LogSettingsBackend::relativeKeys() const
+{
+    QString currentGroup = group();
+    QStringList keys = m_store->keys(currentGroup);
+    if (!currentGroup.isEmpty()) {
+        for (int i = 0; i < keys.count(); i++) {
+            keys[i] = keys.at(i).mid(currentGroup.length() + 1);
+        }
+    }
+    return keys;
+}
+
+void LogSettingsBackend::touch(const QString &key)
+{
+    if (m_originalValues.contains(key) || m_originallyMissing.contains(key)) {
+        return;
+    }
+    if (m_store->contains(key)) {
+        m_originalValues.insert(key, m_store->value(key));
+    } else {
+        m_originallyMissing.insert(key);
+    }
+}
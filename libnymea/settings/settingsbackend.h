@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SETTINGSBACKEND_H
+#define SETTINGSBACKEND_H
+
+#include <QStringList>
+#include <QVariant>
+
+class SettingsBackend
+{
+public:
+    virtual ~SettingsBackend() = default;
+
+    virtual QStringList allKeys() const = 0;
+    virtual void beginWriteArray(const QString &prefix) = 0;
+    virtual void setArrayIndex(int i) = 0;
+    virtual int beginReadArray(const QString &prefix) = 0;
+    virtual void endArray() = 0;
+
+    virtual void beginGroup(const QString &prefix) = 0;
+    virtual QStringList childGroups() const = 0;
+    virtual QStringList childKeys() const = 0;
+    virtual void clear() = 0;
+    virtual bool contains(const QString &key) const = 0;
+    virtual void endGroup() = 0;
+    virtual QString group() const = 0;
+    virtual QString fileName() const = 0;
+    virtual bool isWritable() const = 0;
+    virtual void remove(const QString &key) = 0;
+    virtual void setValue(const QString &key, const QVariant &value) = 0;
+    virtual QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const = 0;
+
+    // Writes pending changes to disk
+    virtual void sync() = 0;
+};
+
+#endif // SETTINGSBACKEND_H
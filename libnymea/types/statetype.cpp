@@ -41,7 +41,26 @@
 
 #include "statetype.h"
 
-StateType::StateType()
+class StateTypePrivate: public QSharedData
+{
+public:
+    StateTypeId id;
+    QString name;
+    QString displayName;
+    int index = 0;
+    QVariant::Type type = QVariant::Invalid;
+    QVariant defaultValue;
+    QVariant minValue;
+    QVariant maxValue;
+    QVariantList possibleValues;
+    Types::Unit unit = Types::UnitNone;
+    Types::IOType ioType = Types::IOTypeNone;
+    bool writable = false;
+    bool cached = true;
+};
+
+StateType::StateType():
+    d(new StateTypePrivate)
 {
 
 }
@@ -50,162 +69,181 @@ StateType::StateType()
  *  When creating a \l{DevicePlugin} generate a new uuid for each StateType you define and
  *  hardcode it into the plugin json file. */
 StateType::StateType(const StateTypeId &id):
-    m_id(id)
+    d(new StateTypePrivate)
+{
+    d->id = id;
+}
+
+/*! Constructs a copy of \a other. The data is shared until one of the copies is modified. */
+StateType::StateType(const StateType &other):
+    d(other.d)
+{
+
+}
+
+StateType::~StateType()
 {
 
 }
 
+/*! Assigns \a other to this StateType. */
+StateType &StateType::operator=(const StateType &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id of the StateType. */
 StateTypeId StateType::id() const
 {
-    return m_id;
+    return d->id;
 }
 
 /*! Returns the name of the StateType. This is used internally, e.g. to match \l{Interfaces for DeviceClasses}{interfaces}. */
 QString StateType::name() const
 {
-    return m_name;
+    return d->name;
 }
 
 /*! Set the name of the StateType to \a name. This is used internally, e.g. to match \l{Interfaces for DeviceClasses}{interfaces}. */
 void StateType::setName(const QString &name)
 {
-    m_name = name;
+    d->name = name;
 }
 
 /*! Returns the displayName of the StateType. This is visible to the user (e.g. "Color temperature"). */
 QString StateType::displayName() const
 {
-    return m_displayName;
+    return d->displayName;
 }
 
 /*! Set the displayName of the StateType to \a displayName. This is visible to the user (e.g. "Color temperature"). */
 void StateType::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->displayName = displayName;
 }
 
 /*! Returns the index of this \l{StateType}. The index of an \l{StateType} indicates the order in the \l{DeviceClass}.
  *  This guarantees that a \l{Device} will look always the same (\l{State} order). */
 int StateType::index() const
 {
-    return m_index;
+    return d->index;
 }
 
 /*! Set the \a index of this \l{StateType}. */
 void StateType::setIndex(const int &index)
 {
-    m_index = index;
+    d->index = index;
 }
 
 /*! Returns the Type of the StateType (e.g. QVariant::Real). */
 QVariant::Type StateType::type() const
 {
-    return m_type;
+    return d->type;
 }
 
 /*! Set the type fo the StateType to \a type (e.g. QVariant::Real). */
 void StateType::setType(const QVariant::Type &type)
 {
-    m_type = type;
+    d->type = type;
 }
 
 /*! Returns the default value of this StateType (e.g. 21.5). */
 QVariant StateType::defaultValue() const
 {
-    return m_defaultValue;
+    return d->defaultValue;
 }
 
 /*! Set the default value of this StateType to \a defaultValue (e.g. 21.5). */
 void StateType::setDefaultValue(const QVariant &defaultValue)
 {
-    m_defaultValue = defaultValue;
+    d->defaultValue = defaultValue;
 }
 
 /*! Returns the minimum value of this StateType. If this value is not set, the QVariant will be invalid. */
 QVariant StateType::minValue() const
 {
-    return m_minValue;
+    return d->minValue;
 }
 
 /*! Set the minimum value of this StateType to \a minValue. If this value is not set,
  *  there is now lower limit. */
 void StateType::setMinValue(const QVariant &minValue)
 {
-    m_minValue = minValue;
+    d->minValue = minValue;
 }
 
 /*! Returns the maximum value of this StateType. If this value is not set, the QVariant will be invalid. */
 QVariant StateType::maxValue() const
 {
-    return m_maxValue;
+    return d->maxValue;
 }
 
 /*! Set the maximum value of this StateType to \a maxValue. If this value is not set,
  *  there is now upper limit. */
 void StateType::setMaxValue(const QVariant &maxValue)
 {
-    m_maxValue = maxValue;
+    d->maxValue = maxValue;
 }
 
 /*! Returns the list of possible values of this StateType. If the list is empty or invalid the \l{State} value can take every value. */
 QVariantList StateType::possibleValues() const
 {
-    return m_possibleValues;
+    return d->possibleValues;
 }
 
 /*! Set the list of possible values of this StateType to \a possibleValues. */
 void StateType::setPossibleValues(const QVariantList &possibleValues)
 {
-    m_possibleValues = possibleValues;
+    d->possibleValues = possibleValues;
 }
 
 /*! Returns the unit of this StateType. */
 Types::Unit StateType::unit() const
 {
-    return m_unit;
+    return d->unit;
 }
 
 /*! Sets the unit of this StateType to the given \a unit. */
 void StateType::setUnit(const Types::Unit &unit)
 {
-    m_unit = unit;
+    d->unit = unit;
 }
 
 /*! Returns the IO type of this StateType. */
 Types::IOType StateType::ioType() const
 {
-    return m_ioType;
+    return d->ioType;
 }
 
 /*! Sets the IO type of this StateType. */
 void StateType::setIOType(Types::IOType ioType)
 {
-    m_ioType = ioType;
+    d->ioType = ioType;
 }
 
 /*! Returns whether the StateType is writable or not. A writable StateType will have an according ActionType defined.*/
 bool StateType::writable() const
 {
-    return m_writable;
+    return d->writable;
 }
 
 /*! Sets the writable property to true */
 void StateType::setWritable(bool writable)
 {
-    m_writable = writable;
+    d->writable = writable;
 }
 
 /*! Returns true if this StateType is to be cached. This means, the last state value will be stored to disk upon shutdown and restored on reboot. If this is false, states will be initialized with the default value on each boot. By default all states are cached by the system. */
 bool StateType::cached() const
 {
-    return m_cached;
+    return d->cached;
 }
 
 /*! Sets whether this StateType should be \a cached or not. If a state value gets cached, the state will be initialized with the cached value on start.*/
 void StateType::setCached(bool cached)
 {
-    m_cached = cached;
+    d->cached = cached;
 }
 
 /*! Returns a list of all valid properties a DeviceClass definition can have. */
@@ -225,7 +263,7 @@ QStringList StateType::mandatoryTypeProperties()
 /*! Returns true if this state type has an ID, a type and a name set. */
 bool StateType::isValid() const
 {
-    return !m_id.isNull() && m_type != QVariant::Invalid && !m_name.isEmpty();
+    return !d->id.isNull() && d->type != QVariant::Invalid && !d->name.isEmpty();
 }
 
 StateTypes::StateTypes(const QList<StateType> &other)
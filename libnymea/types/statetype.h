@@ -35,6 +35,9 @@
 #include "typeutils.h"
 
 #include <QVariant>
+#include <QSharedDataPointer>
+
+class StateTypePrivate;
 
 class LIBNYMEA_EXPORT StateType
 {
@@ -54,6 +57,9 @@ class LIBNYMEA_EXPORT StateType
 public:
     StateType();
     StateType(const StateTypeId &id);
+    StateType(const StateType &other);
+    ~StateType();
+    StateType &operator=(const StateType &other);
 
     StateTypeId id() const;
 
@@ -99,19 +105,7 @@ public:
     bool isValid() const;
 
 private:
-    StateTypeId m_id;
-    QString m_name;
-    QString m_displayName;
-    int m_index = 0;
-    QVariant::Type m_type = QVariant::Invalid;
-    QVariant m_defaultValue;
-    QVariant m_minValue;
-    QVariant m_maxValue;
-    QVariantList m_possibleValues;
-    Types::Unit m_unit = Types::UnitNone;
-    Types::IOType m_ioType = Types::IOTypeNone;
-    bool m_writable = false;
-    bool m_cached = true;
+    QSharedDataPointer<StateTypePrivate> d;
 };
 Q_DECLARE_METATYPE(StateType)
 
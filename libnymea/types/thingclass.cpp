@@ -72,250 +72,392 @@
 
 #include "thingclass.h"
 
+#include <QHash>
+#include <QVector>
+
+class ThingClassPrivate: public QSharedData
+{
+public:
+    template <typename Types, typename Id>
+    static QHash<Id, int> buildIndex(const Types &types) {
+        QHash<Id, int> index;
+        index.reserve(types.count());
+        for (int i = 0; i < types.count(); i++) {
+            // Like a linear search, lookups return the first match in case of duplicates
+            if (!index.contains(types.at(i).id())) {
+                index.insert(types.at(i).id(), i);
+            }
+        }
+        return index;
+    }
+
+    int stateTypeIndex(const StateTypeId &stateTypeId) const {
+        TypeIdRegistry::Handle handle = stateTypeId.handle();
+        if (handle < stateTypeHandleBase || handle - stateTypeHandleBase >= static_cast<uint>(stateTypeIndexes.count())) {
+            return -1;
+        }
+        return stateTypeIndexes.at(static_cast<int>(handle - stateTypeHandleBase));
+    }
+
+    ThingClassId id;
+    VendorId vendorId;
+    PluginId pluginId;
+    QString name;
+    QString displayName;
+    bool browsable = false;
+    StateTypes stateTypes;
+    EventTypes eventTypes;
+    ActionTypes actionTypes;
+    ActionTypes browserItemActionTypes;
+    ParamTypes paramTypes;
+    ParamTypes settingsTypes;
+    ParamTypes discoveryParamTypes;
+    ThingClass::CreateMethods createMethods = ThingClass::CreateMethodUser;
+    ThingClass::SetupMethod setupMethod = ThingClass::SetupMethodJustAdd;
+    QStringList interfaces;
+
+    // Positions of the types in the above lists, updated whenever a list is set. State types are
+    // interned when set and looked up by their handle, relative to the lowest handle of this class.
+    TypeIdRegistry::Handle stateTypeHandleBase = 1;
+    QVector<int> stateTypeIndexes;
+    QHash<EventTypeId, int> eventTypeIndexes;
+    QHash<ActionTypeId, int> actionTypeIndexes;
+    QHash<ActionTypeId, int> browserItemActionTypeIndexes;
+    QHash<ParamTypeId, int> paramTypeIndexes;
+    QHash<ParamTypeId, int> settingsTypeIndexes;
+};
+
 /*! Constructs a DeviceClass with the give \a pluginId ,\a vendorId and \a id .
     When implementing a plugin, create a DeviceClass for each device you support.
     Generate a new uuid (e.g. uuidgen) and hardode it into the plugin. The id
     should never change or it will appear as a new DeviceClass in the system. */
 ThingClass::ThingClass(const PluginId &pluginId, const VendorId &vendorId, const ThingClassId &id):
-    m_id(id),
-    m_vendorId(vendorId),
-    m_pluginId(pluginId),
-    m_createMethods(CreateMethodUser),
-    m_setupMethod(SetupMethodJustAdd)
+    d(new ThingClassPrivate)
+{
+    d->id = id;
+    d->vendorId = vendorId;
+    d->pluginId = pluginId;
+}
+
+/*! Constructs a copy of \a other. ThingClasses are implicitly shared, copying them only copies a pointer
+    until one of the copies is modified. */
+ThingClass::ThingClass(const ThingClass &other):
+    d(other.d)
+{
+
+}
+
+ThingClass::~ThingClass()
 {
 
 }
 
+/*! Assigns \a other to this ThingClass. */
+ThingClass &ThingClass::operator=(const ThingClass &other)
+{
+    d = other.d;
+    return *this;
+}
+
 /*! Returns the id of this \l{DeviceClass}. */
 ThingClassId ThingClass::id() const
 {
-    return m_id;
+    return d->id;
 }
 
 /*! Returns the VendorId for this \l{DeviceClass} */
 VendorId ThingClass::vendorId() const
 {
-    return m_vendorId;
+    return d->vendorId;
 }
 
 /*! Returns the pluginId this \l{DeviceClass} is managed by. */
 PluginId ThingClass::pluginId() const
 {
-    return m_pluginId;
+    return d->pluginId;
 }
 
 /*! Returns true if this \l{DeviceClass} id, vendorId and pluginId are valid uuids. */
 bool ThingClass::isValid() const
 {
-    return !m_id.isNull() && !m_vendorId.isNull() && !m_pluginId.isNull();
+    return !d->id.isNull() && !d->vendorId.isNull() && !d->pluginId.isNull();
 }
 
 /*! Returns the name of this \l{DeviceClass}. This is visible to the user. */
 QString ThingClass::name() const
 {
-    return m_name;
+    return d->name;
 }
 
 /*! Set the \a name of this \l{DeviceClass}. This is visible to the user. */
 void ThingClass::setName(const QString &name)
 {
-    m_name = name;
+    d->name = name;
 }
 
 /*! Returns the displayed name of this \l{DeviceClass}. This is visible to the user. */
 QString ThingClass::displayName() const
 {
-    return m_displayName;
+    return d->displayName;
 }
 
 /*! Set the \a displayName of this \l{DeviceClass}. This is visible to the user. */
 void ThingClass::setDisplayName(const QString &displayName)
 {
-    m_displayName = displayName;
+    d->displayName = displayName;
 }
 
 /*! Returns the statesTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their states matching to this template. */
 StateTypes ThingClass::stateTypes() const
 {
-    return m_stateTypes;
+    return d->stateTypes;
 }
 
 /*! Returns the \l{StateType} with the given \a stateTypeId of this \l{DeviceClass}.
  * If there is no matching \l{StateType}, an invalid \l{StateType} will be returned.*/
-StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
+StateType ThingClass::getStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId)
-            return stateType;
+    int index = d->stateTypeIndex(stateTypeId);
+    if (index < 0) {
+        return StateType(StateTypeId());
     }
-    return StateType(StateTypeId());
+    return d->stateTypes.at(index);
+}
+
+/*! Returns the position of the \l{StateType} with the given \a stateTypeId in \l{stateTypes()} or -1 if there
+    is no such \l{StateType}. */
+int ThingClass::stateTypeIndex(const StateTypeId &stateTypeId) const
+{
+    return d->stateTypeIndex(stateTypeId);
 }
 
 /*! Set the \a stateTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their states matching to this template. */
 void ThingClass::setStateTypes(const StateTypes &stateTypes)
 {
-    m_stateTypes = stateTypes;
+    d->stateTypes = stateTypes;
+
+    QVector<TypeIdRegistry::Handle> handles;
+    handles.reserve(stateTypes.count());
+    TypeIdRegistry::Handle first = 0;
+    TypeIdRegistry::Handle last = 0;
+    foreach (const StateType &stateType, stateTypes) {
+        TypeIdRegistry::Handle handle = TypeIdRegistry::intern(stateType.id());
+        handles.append(handle);
+        if (handle == 0) {
+            continue;
+        }
+        first = first == 0 ? handle : qMin(first, handle);
+        last = qMax(last, handle);
+    }
+    d->stateTypeHandleBase = qMax(first, 1u);
+    d->stateTypeIndexes = QVector<int>(first == 0 ? 0 : static_cast<int>(last - first + 1), -1);
+    for (int i = 0; i < handles.count(); i++) {
+        // Like a linear search, lookups return the first match in case of duplicates
+        if (handles.at(i) != 0 && d->stateTypeIndexes.at(static_cast<int>(handles.at(i) - first)) < 0) {
+            d->stateTypeIndexes[static_cast<int>(handles.at(i) - first)] = i;
+        }
+    }
 }
 
 /*! Returns true if this DeviceClass has a \l{StateType} with the given \a stateTypeId. */
-bool ThingClass::hasStateType(const StateTypeId &stateTypeId)
+bool ThingClass::hasStateType(const StateTypeId &stateTypeId) const
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return d->stateTypeIndex(stateTypeId) >= 0;
 }
 
 /*! Returns the eventTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their events matching to this template. */
 EventTypes ThingClass::eventTypes() const
 {
-    return m_eventTypes;
+    return d->eventTypes;
 }
 
 /*! Set the \a eventTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their events matching to this template. */
 void ThingClass::setEventTypes(const EventTypes &eventTypes)
 {
-    m_eventTypes = eventTypes;
+    d->eventTypes = eventTypes;
+    d->eventTypeIndexes = ThingClassPrivate::buildIndex<EventTypes, EventTypeId>(eventTypes);
 }
 
-/*! Returns true if this DeviceClass has a \l{EventType} with the given \a eventTypeId. */
-bool ThingClass::hasEventType(const EventTypeId &eventTypeId)
+/*! Returns the \l{EventType} with the given \a eventTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{EventType}, an invalid \l{EventType} will be returned.*/
+EventType ThingClass::getEventType(const EventTypeId &eventTypeId) const
 {
-    foreach (const EventType &eventType, m_eventTypes) {
-        if (eventType.id() == eventTypeId) {
-            return true;
-        }
+    int index = d->eventTypeIndexes.value(eventTypeId, -1);
+    if (index < 0) {
+        return EventType(EventTypeId());
     }
-    return false;
+    return d->eventTypes.at(index);
+}
+
+/*! Returns true if this DeviceClass has a \l{EventType} with the given \a eventTypeId. */
+bool ThingClass::hasEventType(const EventTypeId &eventTypeId) const
+{
+    return d->eventTypeIndexes.contains(eventTypeId);
 }
 
 /*! Returns the actionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 ActionTypes ThingClass::actionTypes() const
 {
-    return m_actionTypes;
+    return d->actionTypes;
 }
 
 /*! Set the \a actionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 void ThingClass::setActionTypes(const ActionTypes &actionTypes)
 {
-    m_actionTypes = actionTypes;
+    d->actionTypes = actionTypes;
+    d->actionTypeIndexes = ThingClassPrivate::buildIndex<ActionTypes, ActionTypeId>(actionTypes);
 }
 
-/*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
-bool ThingClass::hasActionType(const ActionTypeId &actionTypeId)
+/*! Returns the \l{ActionType} with the given \a actionTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{ActionType}, an invalid \l{ActionType} will be returned.*/
+ActionType ThingClass::getActionType(const ActionTypeId &actionTypeId) const
 {
-    foreach (const ActionType &actionType, m_actionTypes) {
-        if (actionType.id() == actionTypeId) {
-            return true;
-        }
+    int index = d->actionTypeIndexes.value(actionTypeId, -1);
+    if (index < 0) {
+        return ActionType(ActionTypeId());
     }
-    return false;
+    return d->actionTypes.at(index);
+}
+
+/*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
+bool ThingClass::hasActionType(const ActionTypeId &actionTypeId) const
+{
+    return d->actionTypeIndexes.contains(actionTypeId);
 }
 
 /*! Returns the browserItemActionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} may set those actions to their browser items. */
 ActionTypes ThingClass::browserItemActionTypes() const
 {
-    return m_browserItemActionTypes;
+    return d->browserItemActionTypes;
 }
 
 /*! Set the \a browserActionTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} may set those actions to their browser items. */
 void ThingClass::setBrowserItemActionTypes(const ActionTypes &browserItemActionTypes)
 {
-    m_browserItemActionTypes = browserItemActionTypes;
+    d->browserItemActionTypes = browserItemActionTypes;
+    d->browserItemActionTypeIndexes = ThingClassPrivate::buildIndex<ActionTypes, ActionTypeId>(browserItemActionTypes);
 }
 
-/*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
-bool ThingClass::hasBrowserItemActionType(const ActionTypeId &actionTypeId)
+/*! Returns the browser item \l{ActionType} with the given \a actionTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{ActionType}, an invalid \l{ActionType} will be returned.*/
+ActionType ThingClass::getBrowserItemActionType(const ActionTypeId &actionTypeId) const
 {
-    foreach (const ActionType &actionType, m_browserItemActionTypes) {
-        if (actionType.id() == actionTypeId) {
-            return true;
-        }
+    int index = d->browserItemActionTypeIndexes.value(actionTypeId, -1);
+    if (index < 0) {
+        return ActionType(ActionTypeId());
     }
-    return false;
+    return d->browserItemActionTypes.at(index);
+}
+
+/*! Returns true if this DeviceClass has a \l{ActionType} with the given \a actionTypeId. */
+bool ThingClass::hasBrowserItemActionType(const ActionTypeId &actionTypeId) const
+{
+    return d->browserItemActionTypeIndexes.contains(actionTypeId);
 }
 
 /*! Returns the params description of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their params matching to this template. */
 ParamTypes ThingClass::paramTypes() const
 {
-    return m_paramTypes;
+    return d->paramTypes;
 }
 
 /*! Set the \a paramsTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their params matching to this template. */
 void ThingClass::setParamTypes(const ParamTypes &params)
 {
-    m_paramTypes = params;
+    d->paramTypes = params;
+    d->paramTypeIndexes = ThingClassPrivate::buildIndex<ParamTypes, ParamTypeId>(params);
+}
+
+/*! Returns the \l{ParamType} with the given \a paramTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{ParamType}, an invalid \l{ParamType} will be returned.*/
+ParamType ThingClass::getParamType(const ParamTypeId &paramTypeId) const
+{
+    int index = d->paramTypeIndexes.value(paramTypeId, -1);
+    if (index < 0) {
+        return ParamType();
+    }
+    return d->paramTypes.at(index);
 }
 
 /*! Returns the settings description of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their settings matching to this template. */
 ParamTypes ThingClass::settingsTypes() const
 {
-    return m_settingsTypes;
+    return d->settingsTypes;
 }
 
 /*! Set the \a settingsTypes of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their settings matching to this template. */
 void ThingClass::setSettingsTypes(const ParamTypes &settingsTypes)
 {
-    m_settingsTypes = settingsTypes;
+    d->settingsTypes = settingsTypes;
+    d->settingsTypeIndexes = ThingClassPrivate::buildIndex<ParamTypes, ParamTypeId>(settingsTypes);
+}
+
+/*! Returns the settings \l{ParamType} with the given \a paramTypeId of this \l{DeviceClass}.
+ * If there is no matching \l{ParamType}, an invalid \l{ParamType} will be returned.*/
+ParamType ThingClass::getSettingsType(const ParamTypeId &paramTypeId) const
+{
+    int index = d->settingsTypeIndexes.value(paramTypeId, -1);
+    if (index < 0) {
+        return ParamType();
+    }
+    return d->settingsTypes.at(index);
 }
 
 /*! Returns the discovery params description of this DeviceClass. \{Device}{Devices} created
     from this \l{DeviceClass} must have their params matching to this template. */
 ParamTypes ThingClass::discoveryParamTypes() const
 {
-    return m_discoveryParamTypes;
+    return d->discoveryParamTypes;
 }
 /*! Set the \a params of this DeviceClass for the discovery. \{Device}{Devices} created
     from this \l{DeviceClass} must have their actions matching to this template. */
 void ThingClass::setDiscoveryParamTypes(const ParamTypes &params)
 {
-    m_discoveryParamTypes = params;
+    d->discoveryParamTypes = params;
 }
 
 /*! Returns the \l{DeviceClass::CreateMethod}s of this \l{DeviceClass}.*/
 ThingClass::CreateMethods ThingClass::createMethods() const
 {
-    return m_createMethods;
+    return d->createMethods;
 }
 
 /*! Set the \a createMethods of this \l{DeviceClass}.
     \sa CreateMethod, */
 void ThingClass::setCreateMethods(ThingClass::CreateMethods createMethods)
 {
-    m_createMethods = createMethods;
+    d->createMethods = createMethods;
 }
 
 /*! Returns the \l{DeviceClass::SetupMethod} of this \l{DeviceClass}.*/
 ThingClass::SetupMethod ThingClass::setupMethod() const
 {
-    return m_setupMethod;
+    return d->setupMethod;
 }
 
 /*! Set the \a setupMethod of this \l{DeviceClass}.
     \sa SetupMethod, */
 void ThingClass::setSetupMethod(ThingClass::SetupMethod setupMethod)
 {
-    m_setupMethod = setupMethod;
+    d->setupMethod = setupMethod;
 }
 
 /*! Returns the \l{Interfaces for DeviceClasses}{interfaces} of this \l{DeviceClass}.*/
 QStringList ThingClass::interfaces() const
 {
-    return m_interfaces;
+    return d->interfaces;
 }
 
 /*! Set the \a interfaces of this \l{DeviceClass}.
@@ -324,25 +466,25 @@ QStringList ThingClass::interfaces() const
 */
 void ThingClass::setInterfaces(const QStringList &interfaces)
 {
-    m_interfaces = interfaces;
+    d->interfaces = interfaces;
 }
 
 /*! Returns whether \l{Device}{Devices} created from this \l{DeviceClass} are browsable */
 bool ThingClass::browsable() const
 {
-    return m_browsable;
+    return d->browsable;
 }
 
 /*! Sets whether \l{Device}{Devices} created from this \l{DeviceClass} are browsable */
 void ThingClass::setBrowsable(bool browsable)
 {
-    m_browsable = browsable;
+    d->browsable = browsable;
 }
 
 /*! Compare this \a deviceClass to another. This is effectively the same as calling a.id() == b.id(). Returns true if the ids match.*/
 bool ThingClass::operator==(const ThingClass &deviceClass) const
 {
-    return m_id == deviceClass.id();
+    return d->id == deviceClass.id();
 }
 
 QDebug operator<<(QDebug &dbg, const ThingClass &deviceClass)
@@ -41,6 +41,9 @@
 
 #include <QList>
 #include <QUuid>
+#include <QSharedDataPointer>
+
+class ThingClassPrivate;
 
 class LIBNYMEA_EXPORT ThingClass
 {
@@ -83,6 +86,9 @@ public:
     Q_ENUM(SetupMethod)
 
     ThingClass(const PluginId &pluginId = PluginId(), const VendorId &vendorId = VendorId(), const ThingClassId &id = ThingClassId());
+    ThingClass(const ThingClass &other);
+    ~ThingClass();
+    ThingClass &operator=(const ThingClass &other);
 
     ThingClassId id() const;
     VendorId vendorId() const;
@@ -96,29 +102,35 @@ public:
     void setDisplayName(const QString &displayName);
 
     StateTypes stateTypes() const;
-    StateType getStateType(const StateTypeId &stateTypeId);
+    StateType getStateType(const StateTypeId &stateTypeId) const;
+    int stateTypeIndex(const StateTypeId &stateTypeId) const;
     void setStateTypes(const StateTypes &stateTypes);
-    bool hasStateType(const StateTypeId &stateTypeId);
+    bool hasStateType(const StateTypeId &stateTypeId) const;
 
     EventTypes eventTypes() const;
+    EventType getEventType(const EventTypeId &eventTypeId) const;
     void setEventTypes(const EventTypes &eventTypes);
-    bool hasEventType(const EventTypeId &eventTypeId);
+    bool hasEventType(const EventTypeId &eventTypeId) const;
 
     ActionTypes actionTypes() const;
+    ActionType getActionType(const ActionTypeId &actionTypeId) const;
     void setActionTypes(const ActionTypes &actionTypes);
-    bool hasActionType(const ActionTypeId &actionTypeId);
+    bool hasActionType(const ActionTypeId &actionTypeId) const;
 
     bool browsable() const;
     void setBrowsable(bool browsable);
 
     ActionTypes browserItemActionTypes() const;
+    ActionType getBrowserItemActionType(const ActionTypeId &actionTypeId) const;
     void setBrowserItemActionTypes(const ActionTypes &browserItemActionTypes);
-    bool hasBrowserItemActionType(const ActionTypeId &actionTypeId);
+    bool hasBrowserItemActionType(const ActionTypeId &actionTypeId) const;
 
     ParamTypes paramTypes() const;
+    ParamType getParamType(const ParamTypeId &paramTypeId) const;
     void setParamTypes(const ParamTypes &paramTypes);
 
     ParamTypes settingsTypes() const;
+    ParamType getSettingsType(const ParamTypeId &paramTypeId) const;
     void setSettingsTypes(const ParamTypes &settingsTypes);
 
     ParamTypes discoveryParamTypes() const;
@@ -136,22 +148,7 @@ public:
     bool operator==(const ThingClass &device) const;
 
 private:
-    ThingClassId m_id;
-    VendorId m_vendorId;
-    PluginId m_pluginId;
-    QString m_name;
-    QString m_displayName;
-    bool m_browsable = false;
-    StateTypes m_stateTypes;
-    EventTypes m_eventTypes;
-    ActionTypes m_actionTypes;
-    ActionTypes m_browserItemActionTypes;
-    ParamTypes m_paramTypes;
-    ParamTypes m_settingsTypes;
-    ParamTypes m_discoveryParamTypes;
-    CreateMethods m_createMethods;
-    SetupMethod m_setupMethod;
-    QStringList m_interfaces;
+    QSharedDataPointer<ThingClassPrivate> d;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(ThingClass::CreateMethods)
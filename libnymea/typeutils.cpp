@@ -0,0 +1,155 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "typeutils.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+#include <atomic>
+
+namespace {
+
+// An open addressing table which is only ever appended to. Writers fill in the id of a slot before
+// publishing its handle, so readers can probe it without locking.
+class TypeIdTable
+{
+public:
+    class Slot
+    {
+    public:
+        std::atomic<TypeIdRegistry::Handle> handle{0};
+        QUuid id;
+    };
+
+    explicit TypeIdTable(int capacity): mask(static_cast<uint>(capacity - 1)), slots(new Slot[capacity]) {}
+    ~TypeIdTable() { delete [] slots; }
+
+    TypeIdRegistry::Handle find(const QUuid &id) const {
+        uint index = qHash(id) & mask;
+        forever {
+            TypeIdRegistry::Handle handle = slots[index].handle.load(std::memory_order_acquire);
+            if (handle == 0 || slots[index].id == id) {
+                return handle;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    void insert(const QUuid &id, TypeIdRegistry::Handle handle) {
+        uint index = qHash(id) & mask;
+        while (slots[index].handle.load(std::memory_order_relaxed) != 0) {
+            index = (index + 1) & mask;
+        }
+        slots[index].id = id;
+        slots[index].handle.store(handle, std::memory_order_release);
+    }
+
+    const uint mask;
+    Slot *slots;
+};
+
+class TypeIdRegistryData
+{
+public:
+    TypeIdRegistryData() {
+        TypeIdTable *initial = new TypeIdTable(1024);
+        tables.append(initial);
+        table.store(initial, std::memory_order_release);
+    }
+    ~TypeIdRegistryData() {
+        qDeleteAll(tables);
+    }
+
+    // Serializes writers only. Tables are replaced by bigger ones when they fill up, but never freed
+    // as a reader might still be probing them. They double in size, so this costs at most as much as
+    // the current table.
+    QMutex mutex;
+    QList<TypeIdTable *> tables;
+    std::atomic<TypeIdTable *> table{nullptr};
+    std::atomic<int> count{0};
+};
+
+}
+
+Q_GLOBAL_STATIC(TypeIdRegistryData, typeIdRegistryData)
+
+/*! Returns the handle for the given \a id. If the \a id hasn't been interned before, a new handle is assigned.
+    This is meant to be called when things and types are registered, not for lookups. */
+TypeIdRegistry::Handle TypeIdRegistry::intern(const QUuid &id)
+{
+    if (id.isNull()) {
+        return 0;
+    }
+    TypeIdRegistryData *data = typeIdRegistryData();
+    QMutexLocker locker(&data->mutex);
+    TypeIdTable *table = data->table.load(std::memory_order_relaxed);
+    Handle handle = table->find(id);
+    if (handle != 0) {
+        return handle;
+    }
+
+    int count = data->count.load(std::memory_order_relaxed);
+    int capacity = static_cast<int>(table->mask) + 1;
+    // Keep the load factor below 1/2 so probe sequences stay short
+    if ((count + 1) * 2 > capacity) {
+        TypeIdTable *grown = new TypeIdTable(capacity * 2);
+        for (int i = 0; i < capacity; i++) {
+            Handle existing = table->slots[i].handle.load(std::memory_order_relaxed);
+            if (existing != 0) {
+                grown->insert(table->slots[i].id, existing);
+            }
+        }
+        data->tables.append(grown);
+        data->table.store(grown, std::memory_order_release);
+        table = grown;
+    }
+
+    handle = static_cast<Handle>(count + 1);
+    table->insert(id, handle);
+    data->count.store(count + 1, std::memory_order_release);
+    return handle;
+}
+
+/*! Returns the handle for the given \a id or 0 if the \a id has not been interned. This does not lock. */
+TypeIdRegistry::Handle TypeIdRegistry::handle(const QUuid &id)
+{
+    if (id.isNull()) {
+        return 0;
+    }
+    return typeIdRegistryData()->table.load(std::memory_order_acquire)->find(id);
+}
+
+/*! Returns the number of handles assigned so far. Valid handles range from 1 to count(). */
+int TypeIdRegistry::count()
+{
+    return typeIdRegistryData()->count.load(std::memory_order_acquire);
+}
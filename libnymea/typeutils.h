@@ -36,6 +36,22 @@
 
 #include "libnymea.h"
 
+/*
+  Maps the UUIDs of things and types to dense 32 bit handles, starting at 1. 0 is the handle of the
+  null UUID and of UUIDs which have not been interned. Handles are assigned with intern() when things
+  and types are registered and are never released, so they can be used as indexes into arrays.
+  Looking up a handle with handle() does not take any lock.
+*/
+class LIBNYMEA_EXPORT TypeIdRegistry
+{
+public:
+    typedef quint32 Handle;
+
+    static Handle intern(const QUuid &id);
+    static Handle handle(const QUuid &id);
+    static int count();
+};
+
 #define DECLARE_TYPE_ID(type) class type##Id: public QUuid \
 { \
 public: \
@@ -43,9 +59,18 @@ public: \
     type##Id(): QUuid() {} \
     static type##Id create##type##Id() { return type##Id(QUuid::createUuid()); } \
     bool operator==(const type##Id &other) const { \
-        return toString() == other.toString(); \
+        return QUuid::operator==(other); \
+    } \
+    bool operator!=(const type##Id &other) const { \
+        return QUuid::operator!=(other); \
+    } \
+    TypeIdRegistry::Handle handle() const { \
+        return TypeIdRegistry::handle(*this); \
     } \
 }; \
+inline uint qHash(const type##Id &id, uint seed = 0) { \
+    return qHash(static_cast<const QUuid &>(id), seed); \
+} \
 Q_DECLARE_METATYPE(type##Id);
 
 DECLARE_TYPE_ID(Vendor)
@@ -39,6 +39,9 @@
     and is responsable to catch system signals like SIGQUIT, SIGINT, SIGTERM, SIGHUP, SIGSEGV. This class
     will provide a backtrace on a segmentation fault (SIGSEGV).
 
+    Every event dispatched in the main thread is measured by the \l{EventLoopMonitor} in order to
+    find handlers blocking the event loop.
+
 
     \sa NymeaService
 */
@@ -46,6 +49,7 @@
 #include "nymeaapplication.h"
 #include "loggingcategories.h"
 #include "nymeacore.h"
+#include "diagnostics/eventloopmonitor.h"
 
 #include <execinfo.h>
 #include <signal.h>
@@ -226,4 +230,11 @@ NymeaApplication::NymeaApplication(int &argc, char **argv) :
     catchUnixSignals({SIGQUIT, SIGINT, SIGTERM, SIGHUP, SIGSEGV});
 }
 
+/*! Delivers the \a event to the \a receiver and lets the \l{EventLoopMonitor} measure how long the handler takes. */
+bool NymeaApplication::notify(QObject *receiver, QEvent *event)
+{
+    EventDispatchScope scope(receiver, event);
+    return QCoreApplication::notify(receiver, event);
+}
+
 }
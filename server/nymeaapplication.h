@@ -41,6 +41,8 @@ class NymeaApplication : public QCoreApplication
 {
 public:
     NymeaApplication(int &argc, char **argv);
+
+    bool notify(QObject *receiver, QEvent *event) override;
 };
 
 }
@@ -30,7 +30,10 @@
 
 #include "nymeatestbase.h"
 #include "integrations/thing.h"
+#include "nymeacore.h"
 #include "jsonrpc/devicehandler.h"
+#include "integrations/thingmanagerimplementation.h"
+#include "diagnostics/tracer.h"
 
 using namespace nymeaserver;
 
@@ -45,6 +48,8 @@ private slots:
     void getActionType_data();
     void getActionType();
 
+    void executeActionTrace();
+
 };
 
 void TestActions::executeAction_data()
@@ -149,5 +154,75 @@ void TestActions::getActionType()
     }
 }
 
+void TestActions::executeActionTrace()
+{
+    Tracer::instance()->clear();
+    Tracer::instance()->setEnabled(true);
+
+    bool power = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId)->stateValue(mockPowerStateTypeId).toBool();
+
+    QVariantMap powerParam;
+    powerParam.insert("paramTypeId", mockPowerActionPowerParamTypeId);
+    powerParam.insert("value", !power);
+    QVariantMap params;
+    params.insert("actionTypeId", mockPowerActionTypeId);
+    params.insert("deviceId", m_mockThingId);
+    params.insert("params", QVariantList() << powerParam);
+    QVariant response = injectAndWait("Actions.ExecuteAction", params);
+    verifyError(response, "deviceError", enumValueName(Device::DeviceErrorNoError));
+
+    Tracer::instance()->setEnabled(false);
+
+    QHash<QString, Tracer::Span> spans;
+    QList<quint64> stageTraces;
+    foreach (const Tracer::Span &span, Tracer::instance()->spans()) {
+        if (span.name == "StateChangeBus::rules") {
+            stageTraces.append(span.traceId);
+        }
+        if (span.name == "JsonRPCServer::request" && span.args.value("method").toString() != "Actions.ExecuteAction") {
+            continue;
+        }
+        spans.insert(span.name, span);
+    }
+
+    // The whole chain from the request down to the rule evaluation of the resulting state change is one trace
+    QVERIFY(spans.contains("JsonRPCServer::request"));
+    QVERIFY(spans.contains("ThingManager::executeAction"));
+    QVERIFY(spans.contains("IntegrationPlugin::executeAction"));
+    QVERIFY(spans.contains("ThingManager::stateChanged"));
+
+    Tracer::Span request = spans.value("JsonRPCServer::request");
+    Tracer::Span action = spans.value("ThingManager::executeAction");
+    Tracer::Span plugin = spans.value("IntegrationPlugin::executeAction");
+    Tracer::Span stateChange = spans.value("ThingManager::stateChanged");
+
+    QCOMPARE(request.parentSpanId, quint64(0));
+    QCOMPARE(request.traceId, request.spanId);
+    QVERIFY(action.async);
+    QCOMPARE(action.traceId, request.traceId);
+    QCOMPARE(action.parentSpanId, request.spanId);
+    QCOMPARE(action.args.value("status").toInt(), static_cast<int>(Thing::ThingErrorNoError));
+    QCOMPARE(plugin.parentSpanId, action.spanId);
+    QCOMPARE(stateChange.parentSpanId, plugin.spanId);
+    QCOMPARE(stateChange.traceId, request.traceId);
+    QVERIFY(stageTraces.contains(request.traceId));
+
+    QVERIFY(request.start <= action.start);
+    QVERIFY(request.start + request.duration >= plugin.start + plugin.duration);
+
+    QJsonParseError error;
+    QJsonDocument trace = QJsonDocument::fromJson(Tracer::instance()->toChromeTraceJson(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QStringList phases;
+    foreach (const QVariant &event, trace.toVariant().toMap().value("traceEvents").toList()) {
+        phases.append(event.toMap().value("ph").toString());
+    }
+    QVERIFY(phases.contains("X"));
+    QCOMPARE(phases.count("b"), phases.count("e"));
+    QVERIFY(phases.count("b") >= 1);
+
+    Tracer::instance()->clear();
+}
+
 #include "testactions.moc"
 QTEST_MAIN(TestActions)
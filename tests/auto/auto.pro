@@ -5,6 +5,8 @@ SUBDIRS = \
         configurations \
         devices \
         events \
+        eventloop \
+        gpio \
         integrations \
         ioconnections \
         jsonrpc \
@@ -16,9 +18,11 @@ SUBDIRS = \
         pythonplugins \
         rules \
         scripts \
+        settings \
         states \
         tags \
         timemanager \
+        upnp \
         userloading \
         usermanager \
         versioning \
@@ -523,6 +523,120 @@ void CoapTests::multipleCalls()
     qDeleteAll(replies);
 }
 
+void CoapTests::concurrentRequests()
+{
+    // Local server answering in reverse order once it got the expected number of requests
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+
+    QList<QByteArray> requests;
+    int expectedRequests = 1;
+    int maxOutstanding = 0;
+    connect(&server, &QUdpSocket::readyRead, this, [&](){
+        QHostAddress clientAddress;
+        quint16 clientPort = 0;
+        while (server.hasPendingDatagrams()) {
+            QByteArray data;
+            data.resize(server.pendingDatagramSize());
+            server.readDatagram(data.data(), data.size(), &clientAddress, &clientPort);
+            requests.append(data);
+        }
+        maxOutstanding = qMax(maxOutstanding, requests.count());
+        if (requests.count() < expectedRequests)
+            return;
+
+        while (!requests.isEmpty()) {
+            CoapPdu request(requests.takeLast());
+            CoapPdu response;
+            response.setMessageType(CoapPdu::Acknowledgement);
+            response.setStatusCode(CoapPdu::Content);
+            response.setMessageId(request.messageId());
+            response.setToken(request.token());
+            foreach (const CoapOption &option, request.options()) {
+                if (option.option() == CoapOption::UriPath) {
+                    response.setPayload(option.data());
+                }
+            }
+            server.writeDatagram(response.pack(), clientAddress, clientPort);
+        }
+    });
+
+    QString baseUrl = QString("coap://127.0.0.1:%1/").arg(server.localPort());
+    QSignalSpy spy(m_coap, SIGNAL(replyFinished(CoapReply*)));
+
+    // By default only one request per endpoint is outstanding
+    QList<CoapReply *> replies;
+    for (int i = 0; i < 3; i++) {
+        replies.append(m_coap->get(CoapRequest(QUrl(baseUrl + QString("resource%1").arg(i)))));
+    }
+    while (spy.count() < 3 && spy.wait(2000)) { }
+    QCOMPARE(spy.count(), 3);
+    QCOMPARE(maxOutstanding, 1);
+    for (int i = 0; i < replies.count(); i++) {
+        QCOMPARE(replies.at(i)->error(), CoapReply::NoError);
+        QCOMPARE(replies.at(i)->payload(), QString("resource%1").arg(i).toUtf8());
+    }
+    qDeleteAll(replies);
+    replies.clear();
+    spy.clear();
+
+    // Allow all of them in parallel, the server only answers once all are there
+    m_coap->setMaxConcurrentRequests(3);
+    expectedRequests = 3;
+    maxOutstanding = 0;
+    for (int i = 0; i < 3; i++) {
+        replies.append(m_coap->get(CoapRequest(QUrl(baseUrl + QString("resource%1").arg(i)))));
+    }
+    while (spy.count() < 3 && spy.wait(2000)) { }
+    QCOMPARE(spy.count(), 3);
+    QCOMPARE(maxOutstanding, 3);
+    for (int i = 0; i < replies.count(); i++) {
+        QCOMPARE(replies.at(i)->error(), CoapReply::NoError);
+        QCOMPARE(replies.at(i)->statusCode(), CoapPdu::Content);
+        QCOMPARE(replies.at(i)->payload(), QString("resource%1").arg(i).toUtf8());
+    }
+    qDeleteAll(replies);
+    m_coap->setMaxConcurrentRequests(1);
+}
+
+void CoapTests::responseFromOtherEndpoint()
+{
+    // Another host answers first with the message id and token of the request
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    QUdpSocket spoofer;
+    QVERIFY(spoofer.bind(QHostAddress::LocalHost, 0));
+
+    connect(&server, &QUdpSocket::readyRead, this, [&](){
+        QHostAddress clientAddress;
+        quint16 clientPort = 0;
+        QByteArray data;
+        data.resize(server.pendingDatagramSize());
+        server.readDatagram(data.data(), data.size(), &clientAddress, &clientPort);
+
+        CoapPdu request(data);
+        CoapPdu response;
+        response.setMessageType(CoapPdu::Acknowledgement);
+        response.setStatusCode(CoapPdu::Content);
+        response.setMessageId(request.messageId());
+        response.setToken(request.token());
+        response.setPayload("spoofed");
+        spoofer.writeDatagram(response.pack(), clientAddress, clientPort);
+        spoofer.waitForBytesWritten();
+
+        response.setPayload("genuine");
+        server.writeDatagram(response.pack(), clientAddress, clientPort);
+    });
+
+    QSignalSpy spy(m_coap, SIGNAL(replyFinished(CoapReply*)));
+    CoapReply *reply = m_coap->get(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/resource").arg(server.localPort()))));
+    spy.wait(2000);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(reply->error(), CoapReply::NoError);
+    QCOMPARE(reply->payload(), QByteArray("genuine"));
+    reply->deleteLater();
+}
+
 void CoapTests::coreLinkParser()
 {
     CoapRequest request(QUrl("coap://coap.me/.well-known/core"));
@@ -548,6 +662,172 @@ void CoapTests::coreLinkParser()
     reply->deleteLater();
 }
 
+// Deterministic pseudo random numbers for reproducible fuzzing (xorshift32)
+static quint32 nextRandom(quint32 &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static QByteArray randomBytes(quint32 &state, int size)
+{
+    QByteArray data(size, 0);
+    for (int i = 0; i < size; i++) {
+        data[i] = static_cast<char>(nextRandom(state) & 0xff);
+    }
+    return data;
+}
+
+static QByteArray createNotificationPdu(quint16 messageId, int observeNumber)
+{
+    CoapPduBuilder builder;
+    builder.begin(CoapPdu::Confirmable, CoapPdu::Content, messageId, QByteArray::fromHex("a1b2c3d4"));
+    builder.addOption(CoapOption::Observe, QByteArray(1, static_cast<char>(observeNumber)));
+    builder.addOption(CoapOption::ContentFormat, QByteArray(1, static_cast<char>(CoapPdu::ApplicationJson)));
+    builder.addOption(CoapOption::MaxAge, QByteArray(1, 60));
+    builder.setPayload(QByteArray("{\"temperature\": 21.5, \"humidity\": 43, \"battery\": 87}"));
+    return builder.data();
+}
+
+void CoapTests::pduRoundTrip()
+{
+    quint32 state = 0x2545f491;
+
+    for (int i = 0; i < 500; i++) {
+        QList<QPair<quint16, QByteArray> > options;
+        quint16 number = 0;
+        int optionCount = nextRandom(state) % 6;
+        for (int j = 0; j < optionCount; j++) {
+            // Cover all delta and length encodings
+            static const quint16 deltas[] = {0, 1, 12, 13, 268, 269, 1000};
+            static const int lengths[] = {0, 1, 12, 13, 268, 269, 600};
+            number += deltas[nextRandom(state) % 7];
+            options.append(qMakePair(number, randomBytes(state, lengths[nextRandom(state) % 7])));
+        }
+        QByteArray token = randomBytes(state, nextRandom(state) % 9);
+        QByteArray payload = randomBytes(state, nextRandom(state) % 100);
+        quint16 messageId = nextRandom(state) & 0xffff;
+
+        CoapPduBuilder builder(16);
+        builder.begin(CoapPdu::NonConfirmable, CoapPdu::Content, messageId, token);
+        for (int j = 0; j < options.count(); j++) {
+            QVERIFY(builder.addOption(static_cast<CoapOption::Option>(options.at(j).first), options.at(j).second));
+        }
+        builder.setPayload(payload);
+
+        CoapPduView view(builder.data());
+        QVERIFY2(view.isValid(), QString("Could not parse PDU %1").arg(QString(builder.data().toHex())).toUtf8());
+        QCOMPARE(view.version(), static_cast<quint8>(1));
+        QCOMPARE(view.messageType(), CoapPdu::NonConfirmable);
+        QCOMPARE(view.statusCode(), CoapPdu::Content);
+        QCOMPARE(view.messageId(), messageId);
+        QCOMPARE(view.token(), token);
+        QCOMPARE(view.payload(), payload);
+
+        CoapPduView::OptionIterator it = view.options();
+        for (int j = 0; j < options.count(); j++) {
+            QVERIFY(it.hasNext());
+            CoapPduView::Option option = it.next();
+            QCOMPARE(option.number(), options.at(j).first);
+            QCOMPARE(option.toByteArray(), options.at(j).second);
+        }
+        QVERIFY(!it.hasNext());
+
+        // CoapPdu parses and packs to the very same datagram
+        CoapPdu pdu(builder.data());
+        QVERIFY(pdu.isValid());
+        QCOMPARE(pdu.options().count(), options.count());
+        QCOMPARE(pdu.pack(), builder.data());
+    }
+
+    // Options out of order are refused
+    CoapPduBuilder builder;
+    builder.begin(CoapPdu::Confirmable, CoapPdu::Get, 1);
+    QVERIFY(builder.addOption(CoapOption::UriPath, "a", 1));
+    QVERIFY(!builder.addOption(CoapOption::UriHost, "b", 1));
+}
+
+void CoapTests::pduFuzzing()
+{
+    quint32 state = 0x9e3779b9;
+    QByteArray notification = createNotificationPdu(4711, 3);
+
+    for (int i = 0; i < 20000; i++) {
+        QByteArray data;
+        if (i % 2 == 0) {
+            data = randomBytes(state, nextRandom(state) % 64);
+        } else {
+            // Flip some bytes of a valid message and cut it at a random position
+            data = notification;
+            int flips = 1 + nextRandom(state) % 4;
+            for (int j = 0; j < flips; j++) {
+                data[nextRandom(state) % data.size()] = static_cast<char>(nextRandom(state) & 0xff);
+            }
+            data.truncate(nextRandom(state) % (data.size() + 1));
+        }
+
+        CoapPduView view(data);
+        if (view.isValid()) {
+            int size = 4 + view.token().size() + view.payloadSize();
+            CoapPduView::OptionIterator it = view.options();
+            while (it.hasNext()) {
+                CoapPduView::Option option = it.next();
+                QVERIFY(option.data() >= data.constData() && option.data() + option.size() <= data.constData() + data.size());
+                size += 1 + option.size();
+            }
+            QVERIFY(size <= data.size());
+            QVERIFY(view.payloadData() + view.payloadSize() == data.constData() + data.size());
+        } else {
+            QVERIFY(!view.options().hasNext());
+            QCOMPARE(view.payloadSize(), 0);
+        }
+
+        // Must not crash on any input and agree with the view
+        CoapPdu pdu(data);
+        QCOMPARE(pdu.isValid(), view.isValid());
+        if (pdu.isValid()) {
+            QCOMPARE(pdu.payload(), view.payload());
+        }
+    }
+}
+
+void CoapTests::pduParsingBenchmark_data()
+{
+    QTest::addColumn<bool>("view");
+
+    QTest::newRow("CoapPdu") << false;
+    QTest::newRow("CoapPduView") << true;
+}
+
+void CoapTests::pduParsingBenchmark()
+{
+    QFETCH(bool, view);
+
+    // Parse an observe notification and read what Coap needs to dispatch it
+    QByteArray data = createNotificationPdu(4711, 3);
+    int notificationNumber = 0;
+    if (view) {
+        QBENCHMARK {
+            CoapPduView pduView(data);
+            CoapPduView::Option observeOption;
+            if (pduView.findOption(CoapOption::Observe, &observeOption))
+                notificationNumber = observeOption.toUInt();
+        }
+    } else {
+        QBENCHMARK {
+            CoapPdu pdu(data);
+            foreach (const CoapOption &option, pdu.options()) {
+                if (option.option() == CoapOption::Observe) {
+                    notificationNumber = option.data().toHex().toInt(0, 16);
+                }
+            }
+        }
+    }
+    QCOMPARE(notificationNumber, 3);
+}
+
 void CoapTests::observeResource()
 {
     CoapRequest request(QUrl("coap://vs0.inf.ethz.ch/obs"));
@@ -31,6 +31,8 @@
 
 #include "coap/coap.h"
 #include "coap/coappdu.h"
+#include "coap/coappduview.h"
+#include "coap/coappdubuilder.h"
 #include "coap/coapreply.h"
 #include "coap/corelinkparser.h"
 
@@ -77,9 +79,16 @@ private slots:
     void largeUpdate();
 
     void multipleCalls();
+    void concurrentRequests();
+    void responseFromOtherEndpoint();
 
     void coreLinkParser();
 
+    void pduRoundTrip();
+    void pduFuzzing();
+    void pduParsingBenchmark_data();
+    void pduParsingBenchmark();
+
     void observeResource();
     void observeLargeResource();
 
@@ -0,0 +1,243 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+
+#include "diagnostics/eventloopmonitor.h"
+#include "diagnostics/metricsregistry.h"
+
+using namespace nymeaserver;
+
+// Routes every dispatch through the monitor the same way NymeaApplication does
+class MonitoredApplication: public QCoreApplication
+{
+public:
+    MonitoredApplication(int &argc, char **argv): QCoreApplication(argc, argv) {}
+
+    bool notify(QObject *receiver, QEvent *event) override
+    {
+        EventDispatchScope scope(receiver, event);
+        return QCoreApplication::notify(receiver, event);
+    }
+};
+
+class SlowReceiver: public QObject
+{
+    Q_OBJECT
+public:
+    bool event(QEvent *event) override
+    {
+        if (event->type() == QEvent::User) {
+            QThread::msleep(120);
+            return true;
+        }
+        return QObject::event(event);
+    }
+};
+
+class TestEventLoop: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void slowTimerHandler();
+    void fastHandlersIgnored();
+    void nestedEventLoopNotBlamed();
+    void nestedDispatchAccountedSeparately();
+    void stallWatchdog();
+    void pluginCpuAccounting();
+};
+
+void TestEventLoop::initTestCase()
+{
+    qRegisterMetaType<nymeaserver::EventLoopMonitor::SlowDispatch>();
+}
+
+void TestEventLoop::slowTimerHandler()
+{
+    EventLoopMonitor monitor;
+    monitor.setStallThreshold(0);
+    monitor.setSlowDispatchThreshold(50);
+    QCOMPARE(EventLoopMonitor::instance(), &monitor);
+
+    QSignalSpy spy(&monitor, &EventLoopMonitor::slowDispatchDetected);
+
+    QTimer timer;
+    timer.setObjectName("slowTimer");
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, [](){
+        QThread::msleep(120);
+    });
+    timer.start(0);
+
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    EventLoopMonitor::SlowDispatch dispatch = spy.first().first().value<EventLoopMonitor::SlowDispatch>();
+    QCOMPARE(dispatch.receiverClass, QString("QTimer"));
+    QCOMPARE(dispatch.receiverName, QString("slowTimer"));
+    QCOMPARE(dispatch.signal, QString("timeout()"));
+    QCOMPARE(dispatch.eventType, QString("Timer"));
+    QVERIFY2(dispatch.duration >= 100000, QString::number(dispatch.duration).toUtf8());
+    QVERIFY(dispatch.pluginId.isNull());
+
+    QCOMPARE(monitor.slowDispatches().count(), 1);
+    QCOMPARE(monitor.toVariantMap().value("slowDispatches").toList().count(), 1);
+    QVERIFY(MetricsRegistry::instance()->counter("nymea_event_loop_slow_dispatches_total", "core")->value() >= 1);
+}
+
+void TestEventLoop::fastHandlersIgnored()
+{
+    EventLoopMonitor monitor;
+    monitor.setStallThreshold(0);
+    monitor.setSlowDispatchThreshold(50);
+
+    QSignalSpy spy(&monitor, &EventLoopMonitor::slowDispatchDetected);
+    quint64 dispatchesBefore = MetricsRegistry::instance()->histogram("nymea_event_loop_dispatch_seconds")->count();
+
+    int calls = 0;
+    for (int i = 0; i < 100; i++) {
+        QTimer::singleShot(0, this, [&calls](){ calls++; });
+    }
+    QTRY_COMPARE(calls, 100);
+
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(MetricsRegistry::instance()->histogram("nymea_event_loop_dispatch_seconds")->count() >= dispatchesBefore + 100);
+}
+
+void TestEventLoop::nestedEventLoopNotBlamed()
+{
+    EventLoopMonitor monitor;
+    monitor.setStallThreshold(0);
+    monitor.setSlowDispatchThreshold(50);
+
+    QSignalSpy spy(&monitor, &EventLoopMonitor::slowDispatchDetected);
+
+    // Waiting in a nested event loop doesn't block the event loop
+    bool finished = false;
+    QTimer timer;
+    timer.setObjectName("waitingTimer");
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, [&finished](){
+        QEventLoop loop;
+        QTimer::singleShot(200, &loop, &QEventLoop::quit);
+        loop.exec();
+        finished = true;
+    });
+    timer.start(0);
+
+    QTRY_VERIFY(finished);
+    QTest::qWait(10);
+    QCOMPARE(spy.count(), 0);
+}
+
+void TestEventLoop::nestedDispatchAccountedSeparately()
+{
+    EventLoopMonitor monitor;
+    monitor.setStallThreshold(0);
+    monitor.setSlowDispatchThreshold(50);
+
+    QSignalSpy spy(&monitor, &EventLoopMonitor::slowDispatchDetected);
+
+    // The time spent in the slow receiver is not accounted to the timer sending the event
+    SlowReceiver receiver;
+    QTimer timer;
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, [&receiver](){
+        QEvent event(QEvent::User);
+        QCoreApplication::sendEvent(&receiver, &event);
+    });
+    timer.start(0);
+
+    QVERIFY(spy.wait());
+    QTest::qWait(10);
+    QCOMPARE(spy.count(), 1);
+    EventLoopMonitor::SlowDispatch dispatch = spy.first().first().value<EventLoopMonitor::SlowDispatch>();
+    QCOMPARE(dispatch.receiverClass, QString("SlowReceiver"));
+    QCOMPARE(dispatch.eventType, QString("Event(%1)").arg(QEvent::User));
+}
+
+void TestEventLoop::stallWatchdog()
+{
+    EventLoopMonitor monitor;
+    monitor.setSlowDispatchThreshold(0);
+    monitor.setStallThreshold(100);
+
+    QSignalSpy spy(&monitor, &EventLoopMonitor::stallDetected);
+    quint64 stallsBefore = MetricsRegistry::instance()->counter("nymea_event_loop_stalls_total")->value();
+
+    QTimer timer;
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, [](){
+        QThread::msleep(400);
+    });
+    timer.start(0);
+
+    // Reported once while blocked, delivered as soon as the event loop runs again
+    QVERIFY(spy.wait());
+    QTest::qWait(50);
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy.first().at(0).toLongLong() >= 100);
+    QCOMPARE(spy.first().at(1).toString(), QString("QTimer"));
+    QCOMPARE(MetricsRegistry::instance()->counter("nymea_event_loop_stalls_total")->value(), stallsBefore + 1);
+}
+
+void TestEventLoop::pluginCpuAccounting()
+{
+    EventLoopMonitor monitor;
+    monitor.setStallThreshold(0);
+    monitor.setSlowDispatchThreshold(0);
+    monitor.setPluginCpuAccounting(true);
+
+    // Sleeping doesn't use CPU time, spinning does
+    bool finished = false;
+    QTimer::singleShot(0, this, [&finished](){
+        QThread::msleep(100);
+        QElapsedTimer busy;
+        busy.start();
+        while (busy.elapsed() < 50) { }
+        finished = true;
+    });
+    QTRY_VERIFY(finished);
+
+    qint64 cpuTime = monitor.pluginCpuTime().value("core");
+    QVERIFY2(cpuTime >= 40000, QString::number(cpuTime).toUtf8());
+    QVERIFY2(cpuTime < 100000, QString::number(cpuTime).toUtf8());
+}
+
+int main(int argc, char *argv[])
+{
+    MonitoredApplication application(argc, argv);
+    TestEventLoop test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "testeventloop.moc"
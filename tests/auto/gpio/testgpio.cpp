@@ -0,0 +1,229 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+
+#include "hardware/gpio.h"
+#include "hardware/gpiomonitor.h"
+#include "hardware/gpiomockchip.h"
+
+class TestGpio: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void persistentLineRequest();
+    void activeLow();
+    void multiLine();
+    void busyLine();
+    void chipWithoutBase();
+    void edgeEventBatches();
+    void debounce();
+
+private:
+    GpioMockChip *m_chip = nullptr;
+};
+
+void TestGpio::initTestCase()
+{
+    qRegisterMetaType<QList<GpioEdgeEvent> >();
+    m_chip = new GpioMockChip(32, "gpio-mock", this);
+    GpioChip::registerChip(m_chip, 0);
+}
+
+void TestGpio::cleanupTestCase()
+{
+    GpioChip::unregisterChip(m_chip);
+}
+
+void TestGpio::persistentLineRequest()
+{
+    int requestsBefore = m_chip->requestCount();
+
+    Gpio gpio(3);
+    QVERIFY(gpio.exportGpio());
+    QVERIFY(gpio.setDirection(Gpio::DirectionOutput));
+    QVERIFY(gpio.lineRequest() != nullptr);
+
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(gpio.setValue(i % 2 ? Gpio::ValueHigh : Gpio::ValueLow));
+        QCOMPARE(m_chip->level(3), i % 2 == 1);
+    }
+    QCOMPARE(gpio.value(), Gpio::ValueHigh);
+
+    // The line is requested once and only reconfigured afterwards
+    QCOMPARE(m_chip->requestCount(), requestsBefore + 1);
+
+    QVERIFY(gpio.unexportGpio());
+    QVERIFY(!m_chip->isRequested(3));
+}
+
+void TestGpio::activeLow()
+{
+    Gpio gpio(4);
+    QVERIFY(gpio.exportGpio());
+    QVERIFY(gpio.setDirection(Gpio::DirectionOutput));
+    QVERIFY(gpio.setActiveLow(true));
+    QVERIFY(gpio.activeLow());
+
+    QVERIFY(gpio.setValue(Gpio::ValueHigh));
+    QCOMPARE(m_chip->level(4), false);
+    QCOMPARE(gpio.value(), Gpio::ValueHigh);
+}
+
+void TestGpio::multiLine()
+{
+    GpioLineConfig config;
+    config.direction = Gpio::DirectionOutput;
+    GpioLineRequest *request = m_chip->requestLines({10, 11, 12}, config, this);
+    QVERIFY(request != nullptr);
+
+    QHash<int, Gpio::Value> values;
+    values.insert(10, Gpio::ValueHigh);
+    values.insert(12, Gpio::ValueHigh);
+    QVERIFY(request->setValues(values));
+
+    QHash<int, Gpio::Value> current = request->values();
+    QCOMPARE(current.count(), 3);
+    QCOMPARE(current.value(10), Gpio::ValueHigh);
+    QCOMPARE(current.value(11), Gpio::ValueLow);
+    QCOMPARE(current.value(12), Gpio::ValueHigh);
+
+    // Lines not part of the request can't be set
+    values.insert(13, Gpio::ValueHigh);
+    QVERIFY(!request->setValues(values));
+
+    delete request;
+}
+
+void TestGpio::busyLine()
+{
+    GpioLineRequest *request = m_chip->requestLines({20}, GpioLineConfig(), this);
+    QVERIFY(request != nullptr);
+    QVERIFY(m_chip->requestLines({19, 20}, GpioLineConfig(), this) == nullptr);
+    QVERIFY(!m_chip->isRequested(19));
+
+    Gpio gpio(20);
+    QVERIFY(!gpio.exportGpio());
+
+    // A monitor which could not be enabled is not running
+    GpioMonitor monitor(20);
+    QVERIFY(!monitor.enable());
+    QVERIFY(!monitor.isRunning());
+    QVERIFY(monitor.gpio() == nullptr);
+
+    delete request;
+    QVERIFY(gpio.exportGpio());
+}
+
+void TestGpio::chipWithoutBase()
+{
+    GpioMockChip chip(8, "gpio-nobase");
+    GpioChip::registerChip(&chip, -1);
+
+    // Global numbers past the mock chip must not end up on a chip with unknown numbering
+    int line = -1;
+    QVERIFY(GpioChip::chipForGpio(32, &line) == nullptr);
+    QVERIFY(GpioChip::chipForGpio(0, &line) == m_chip);
+    QCOMPARE(line, 0);
+
+    GpioChip::unregisterChip(&chip);
+}
+
+void TestGpio::edgeEventBatches()
+{
+    GpioMonitor monitor(5);
+    QVERIFY(monitor.enable(false, Gpio::EdgeBoth));
+    QVERIFY(monitor.isRunning());
+
+    QSignalSpy valueSpy(&monitor, &GpioMonitor::valueChanged);
+    QSignalSpy batchSpy(&monitor, &GpioMonitor::edgeEvents);
+
+    // Several edges before the event loop runs end up in a single batch, none of them lost
+    m_chip->setLevel(5, true, 1000);
+    m_chip->setLevel(5, false, 2000);
+    m_chip->setLevel(5, true, 3000);
+
+    QVERIFY(batchSpy.wait());
+    QCOMPARE(batchSpy.count(), 1);
+    QList<GpioEdgeEvent> events = batchSpy.first().first().value<QList<GpioEdgeEvent> >();
+    QCOMPARE(events.count(), 3);
+    QCOMPARE(events.at(0).edge, Gpio::EdgeRising);
+    QCOMPARE(events.at(1).edge, Gpio::EdgeFalling);
+    QCOMPARE(events.at(2).edge, Gpio::EdgeRising);
+    QCOMPARE(events.at(1).timestamp, static_cast<quint64>(2000));
+    QVERIFY(events.at(2).sequenceNumber > events.at(1).sequenceNumber);
+
+    QCOMPARE(valueSpy.count(), 3);
+    QCOMPARE(valueSpy.last().first().toBool(), true);
+    QCOMPARE(monitor.value(), true);
+
+    monitor.disable();
+    QVERIFY(!monitor.isRunning());
+    m_chip->setLevel(5, false);
+}
+
+void TestGpio::debounce()
+{
+    GpioMonitor monitor(6);
+    monitor.setDebounceInterval(5000);
+    QVERIFY(monitor.enable(false, Gpio::EdgeRising));
+    QCOMPARE(monitor.gpio()->debounceInterval(), static_cast<uint>(5000));
+
+    QSignalSpy batchSpy(&monitor, &GpioMonitor::edgeEvents);
+
+    // A bouncing contact, 0.5 ms steps. Only the first rising edge is reported.
+    quint64 timestamp = 1000000000;
+    for (int i = 0; i < 4; i++) {
+        m_chip->setLevel(6, true, timestamp);
+        timestamp += 500000;
+        m_chip->setLevel(6, false, timestamp);
+        timestamp += 500000;
+    }
+    m_chip->setLevel(6, true, timestamp);
+
+    QVERIFY(batchSpy.wait());
+    QList<GpioEdgeEvent> events = batchSpy.first().first().value<QList<GpioEdgeEvent> >();
+    QCOMPARE(events.count(), 1);
+    QCOMPARE(events.first().line, 6);
+
+    // Once stable for longer than the interval, the next edge is reported again
+    batchSpy.clear();
+    m_chip->setLevel(6, false, timestamp + 10000000);
+    m_chip->setLevel(6, true, timestamp + 20000000);
+    QVERIFY(batchSpy.wait());
+    QCOMPARE(batchSpy.first().first().value<QList<GpioEdgeEvent> >().count(), 1);
+}
+
+QTEST_MAIN(TestGpio)
+#include "testgpio.moc"
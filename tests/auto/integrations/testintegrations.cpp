@@ -68,6 +68,8 @@ private slots:
     void getThingClasses_data();
     void getThingClasses();
 
+    void getThingClassesCached();
+
     void verifyInterfaces();
 
     void addThing_data();
@@ -79,6 +81,8 @@ private slots:
 
     void getThings();
 
+    void getThingChanges();
+
     void getThing_data();
     void getThing();
 
@@ -312,6 +316,25 @@ void TestIntegrations::getThingClasses()
     QCOMPARE(thingClasses.count(), resultCount);
 }
 
+void TestIntegrations::getThingClassesCached()
+{
+    // The second call is served from the reply cache and must be identical
+    QVariantMap first = injectAndWait("Integrations.GetThingClasses").toMap();
+    QVariantMap second = injectAndWait("Integrations.GetThingClasses").toMap();
+    QCOMPARE(second.value("status").toString(), QString("success"));
+    QCOMPARE(second.value("params").toMap(), first.value("params").toMap());
+
+    QVariantMap params;
+    params.insert("vendorId", nymeaVendorId);
+    QVariantMap filtered = injectAndWait("Integrations.GetThingClasses", params).toMap();
+    QCOMPARE(filtered.value("params").toMap().value("thingClasses").toList().count(), 17);
+
+    // An empty vendorId must not be answered with the cached unfiltered list
+    params.insert("vendorId", QString());
+    QVariantMap emptyVendor = injectAndWait("Integrations.GetThingClasses", params).toMap();
+    QVERIFY(emptyVendor.value("params").toMap().value("thingClasses").toList().isEmpty());
+}
+
 void TestIntegrations::verifyInterfaces()
 {
     QVariantMap params;
@@ -550,6 +573,51 @@ void TestIntegrations::getThings()
     QCOMPARE(things.count(), 3); // There should be: one auto created mock, one created in NymeaTestBase::initTestcase() and one created in TestIntegrations::initTestCase()
 }
 
+void TestIntegrations::getThingChanges()
+{
+    QVariantMap response = injectAndWait("Integrations.GetThings").toMap();
+    QVariant revision = response.value("params").toMap().value("revision");
+    QVERIFY(!revision.isNull());
+
+    // Nothing changed yet
+    QVariantMap params;
+    params.insert("sinceRevision", revision);
+    response = injectAndWait("Integrations.GetThingChanges", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("fullSync").toBool(), false);
+    QCOMPARE(response.value("params").toMap().value("things").toList().count(), 0);
+    QCOMPARE(response.value("params").toMap().value("stateChanges").toList().count(), 0);
+    QCOMPARE(response.value("params").toMap().value("revision"), revision);
+
+    // Change a state and fetch the delta
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThings(mockThingClassId).first();
+    QSignalSpy stateSpy(NymeaCore::instance()->thingManager(), &ThingManager::thingStateChanged);
+    int port = thing->paramValue(mockThingHttpportParamTypeId).toInt();
+    QNetworkAccessManager nam;
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(42))));
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    stateSpy.wait();
+    QVERIFY(stateSpy.count() > 0);
+
+    response = injectAndWait("Integrations.GetThingChanges", params).toMap();
+    QVariantMap changes = response.value("params").toMap();
+    QCOMPARE(changes.value("fullSync").toBool(), false);
+    QVERIFY(changes.value("revision").toULongLong() > revision.toULongLong());
+    bool found = false;
+    foreach (const QVariant &stateChange, changes.value("stateChanges").toList()) {
+        if (stateChange.toMap().value("thingId").toUuid() == thing->id() && stateChange.toMap().value("stateTypeId").toUuid() == mockIntStateTypeId) {
+            QCOMPARE(stateChange.toMap().value("value").toInt(), 42);
+            found = true;
+        }
+    }
+    QVERIFY2(found, "State change not contained in the delta");
+
+    // An unknown revision results in a full sync
+    params.insert("sinceRevision", 1);
+    response = injectAndWait("Integrations.GetThingChanges", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("fullSync").toBool(), true);
+    QCOMPARE(response.value("params").toMap().value("things").toList().count(), 3);
+}
+
 void TestIntegrations::getThing_data()
 {
     QTest::addColumn<ThingId>("thingId");
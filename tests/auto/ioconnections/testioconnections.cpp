@@ -65,6 +65,8 @@ private slots:
 
     void testAnalogIO_data();
     void testAnalogIO();
+
+    void testNotificationOrder();
 };
 
 void TestIOConnections::initTestCase()
@@ -330,6 +332,64 @@ void TestIOConnections::testAnalogIO()
 
 }
 
+void TestIOConnections::testNotificationOrder()
+{
+    QVariantMap params;
+    params.insert("inputThingId", m_lightThingId);
+    params.insert("inputStateTypeId", virtualIoLightMockPowerStateTypeId);
+    params.insert("outputThingId", m_ioThingId);
+    params.insert("outputStateTypeId", genericIoMockDigitalOutput1StateTypeId);
+    QVariant response = injectAndWait("Integrations.ConnectIO", params);
+    verifyThingError(response);
+    IOConnectionId ioConnectionId = response.toMap().value("params").toMap().value("ioConnectionId").toUuid();
+
+    params.clear();
+    params.insert("thingId", m_lightThingId);
+    params.insert("stateTypeId", virtualIoLightMockPowerStateTypeId);
+    response = injectAndWait("Integrations.GetStateValue", params);
+    verifyThingError(response);
+    bool power = !response.toMap().value("params").toMap().value("value").toBool();
+
+    enableNotifications({"Integrations"});
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+
+    params.clear();
+    params.insert("thingId", m_lightThingId);
+    params.insert("actionTypeId", virtualIoLightMockPowerActionTypeId);
+    QVariantMap actionParam;
+    actionParam.insert("paramTypeId", virtualIoLightMockPowerActionPowerParamTypeId);
+    actionParam.insert("value", power);
+    params.insert("params", QVariantList() << actionParam);
+    response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyThingError(response);
+
+    // The input change must be notified before the output change it caused
+    int inputIndex = -1;
+    int outputIndex = -1;
+    do {
+        QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+        for (int i = 0; i < stateChangedVariants.count(); i++) {
+            QVariantMap notificationParams = stateChangedVariants.at(i).toMap().value("params").toMap();
+            if (inputIndex < 0 && notificationParams.value("thingId").toUuid() == m_lightThingId && notificationParams.value("stateTypeId").toUuid() == virtualIoLightMockPowerStateTypeId) {
+                inputIndex = i;
+            }
+            if (outputIndex < 0 && notificationParams.value("thingId").toUuid() == m_ioThingId && notificationParams.value("stateTypeId").toUuid() == genericIoMockDigitalOutput1StateTypeId) {
+                outputIndex = i;
+            }
+        }
+    } while ((inputIndex < 0 || outputIndex < 0) && clientSpy.wait());
+    QVERIFY2(inputIndex >= 0, "No state change notification for the IO connection input");
+    QVERIFY2(outputIndex >= 0, "No state change notification for the IO connection output");
+    QVERIFY2(inputIndex < outputIndex, "The IO connection output changed before its input was notified");
+
+    QVERIFY(disableNotifications());
+
+    params.clear();
+    params.insert("ioConnectionId", ioConnectionId);
+    response = injectAndWait("Integrations.DisconnectIO", params);
+    verifyThingError(response);
+}
+
 #include "testioconnections.moc"
 QTEST_MAIN(TestIOConnections)
 
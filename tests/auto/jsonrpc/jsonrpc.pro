@@ -2,6 +2,7 @@ include(../../../nymea.pri)
 include(../autotests.pri)
 
 TARGET = testjsonrpc
+LIBS += -lz
 SOURCES += testjsonrpc.cpp \
            ../../utils/pushbuttonagent.cpp
 
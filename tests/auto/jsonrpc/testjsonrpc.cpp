@@ -32,12 +32,84 @@
 #include "../../utils/pushbuttonagent.h"
 #include "nymeacore.h"
 #include "version.h"
+#include "jsonrpc/jsonhandler.h"
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
 #include "nymeadbusservice.h"
 
+#include <zlib.h>
+#include <QtEndian>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
+
 using namespace nymeaserver;
 
+// Gadgets sharing their class names with nymea types, used to test the JSON packers
+namespace packertest {
+
+class Param
+{
+    Q_GADGET
+    Q_PROPERTY(QString name READ name WRITE setName)
+    Q_PROPERTY(int weight READ weight WRITE setWeight)
+public:
+    QString name() const { return m_name; }
+    void setName(const QString &name) { m_name = name; }
+    int weight() const { return m_weight; }
+    void setWeight(int weight) { m_weight = weight; }
+private:
+    QString m_name;
+    int m_weight = 0;
+};
+
+class ParamList: public QList<Param>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    Q_INVOKABLE QVariant get(int index);
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+
+class Holder
+{
+    Q_GADGET
+    Q_PROPERTY(packertest::ParamList params READ params WRITE setParams)
+public:
+    ParamList params() const { return m_params; }
+    void setParams(const ParamList &params) { m_params = params; }
+private:
+    ParamList m_params;
+};
+
+}
+Q_DECLARE_METATYPE(packertest::Param)
+Q_DECLARE_METATYPE(packertest::ParamList)
+Q_DECLARE_METATYPE(packertest::Holder)
+
+QVariant packertest::ParamList::get(int index)
+{
+    return QVariant::fromValue(at(index));
+}
+
+void packertest::ParamList::put(const QVariant &variant)
+{
+    append(variant.value<Param>());
+}
+
+class PackerTestHandler: public JsonHandler
+{
+    Q_OBJECT
+public:
+    explicit PackerTestHandler(QObject *parent = nullptr): JsonHandler(parent) {
+        registerObject<packertest::Param, packertest::ParamList>();
+        registerObject<packertest::Holder>();
+    }
+    QString name() const override { return "PackerTest"; }
+};
+
 class TestJSONRPC: public NymeaTestBase
 {
     Q_OBJECT
@@ -58,6 +130,11 @@ private slots:
 
     void testHandshakeLocale();
 
+    void testHandshakeCompression();
+
+    void testHandshakeCborEncoding();
+    void testCachedReplyCborEncoding();
+
     void testInitialSetup();
 
     void testRevokeToken();
@@ -76,6 +153,11 @@ private slots:
 
     void stateChangeEmitsNotifications();
 
+    void stateChangeNotificationFilter();
+
+    void stateChangeNotificationRateLimit();
+    void heldBackStateChangesDroppedOnThingRemoval();
+
     void pluginConfigChangeEmitsNotification();
 
     /*
@@ -116,8 +198,21 @@ private slots:
     void testDataFragmentation_data();
     void testDataFragmentation();
 
+    void testPackerRoundTrip();
+
+    void testFramingNestedObjects();
+
+    void testLargeScriptUpload();
+
+    void testPacketSizeLimit();
+    void testPacketSizeLimitMethodLast();
+
     void testGarbageData();
 
+    void getMetrics();
+
+    void getMemoryUsage();
+
 private:
     QStringList extractRefs(const QVariant &variant);
 
@@ -234,6 +329,175 @@ void TestJSONRPC::testHandshakeLocale()
     QVERIFY(found);
 }
 
+void TestJSONRPC::testHandshakeCompression()
+{
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    // The Hello reply itself is sent uncompressed
+    QVariantMap params;
+    params.insert("compression", "CompressionDeflate");
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QString("success"));
+    QCOMPARE(handShake.value("params").toMap().value("compression").toString(), QString("CompressionDeflate"));
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    QCOMPARE(inflateInit(&stream), Z_OK);
+
+    // All following messages share one deflate stream, each one can be inflated as soon as it arrives
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    for (int i = 0; i < 2; i++) {
+        spy.clear();
+        QVariantMap call;
+        call.insert("id", i);
+        call.insert("method", "JSONRPC.Version");
+        call.insert("token", m_apiToken);
+        m_mockTcpServer->injectData(newClientId, QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact) + "\n");
+        if (spy.count() == 0) {
+            spy.wait();
+        }
+        QCOMPARE(spy.count(), 1);
+        QByteArray compressed = spy.first().at(1).toByteArray();
+        QVERIFY(!compressed.startsWith('{'));
+
+        QByteArray inflated(64 * 1024, 0);
+        stream.next_in = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        stream.next_out = reinterpret_cast<Bytef*>(inflated.data());
+        stream.avail_out = static_cast<uInt>(inflated.size());
+        QCOMPARE(inflate(&stream, Z_SYNC_FLUSH), Z_OK);
+        QCOMPARE(stream.avail_in, 0u);
+        inflated.resize(inflated.size() - static_cast<int>(stream.avail_out));
+        QVERIFY(inflated.endsWith('\n'));
+
+        QJsonParseError error;
+        QVariantMap response = QJsonDocument::fromJson(inflated, &error).toVariant().toMap();
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(response.value("id").toInt(), i);
+        QCOMPARE(response.value("status").toString(), QString("success"));
+        QCOMPARE(response.value("params").toMap().value("version").toString(), QString(NYMEA_VERSION_STRING));
+    }
+    inflateEnd(&stream);
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+}
+
+void TestJSONRPC::testHandshakeCborEncoding()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR requires Qt 5.12");
+#else
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QVariantMap params;
+    params.insert("encoding", "EncodingCbor");
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QString("success"));
+    QCOMPARE(handShake.value("params").toMap().value("encoding").toString(), QString("EncodingCbor"));
+
+    QCborMap call;
+    call.insert(QStringLiteral("id"), 42);
+    call.insert(QStringLiteral("method"), QStringLiteral("JSONRPC.Version"));
+    call.insert(QStringLiteral("token"), QString::fromUtf8(m_apiToken));
+    QByteArray payload = call.toCborValue().toCbor();
+    QByteArray frame(4, 0);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), reinterpret_cast<uchar*>(frame.data()));
+    frame.append(payload);
+
+    // Deliver the frame in two fragments, the reply must only be sent once it is complete
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    m_mockTcpServer->injectData(newClientId, frame.left(6));
+    qApp->processEvents();
+    QCOMPARE(spy.count(), 0);
+    m_mockTcpServer->injectData(newClientId, frame.mid(6));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+
+    QByteArray reply = spy.first().at(1).toByteArray();
+    QVERIFY(reply.size() > 4);
+    quint32 replySize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(reply.constData()));
+    QCOMPARE(static_cast<int>(replySize), reply.size() - 4);
+
+    QCborParserError error;
+    QCborValue response = QCborValue::fromCbor(reply.mid(4), &error);
+    QVERIFY(error.error == QCborError::NoError);
+    QCOMPARE(static_cast<int>(response.toMap().value(QStringLiteral("id")).toInteger()), 42);
+    QCOMPARE(response.toMap().value(QStringLiteral("status")).toString(), QString("success"));
+    QCOMPARE(response.toMap().value(QStringLiteral("params")).toMap().value(QStringLiteral("version")).toString(), QString(NYMEA_VERSION_STRING));
+
+    // Garbage must be reported as an error without dropping the framing
+    spy.clear();
+    QByteArray garbage = QByteArray::fromHex("00000002ffff");
+    m_mockTcpServer->injectData(newClientId, garbage);
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    response = QCborValue::fromCbor(spy.first().at(1).toByteArray().mid(4), &error);
+    QCOMPARE(response.toMap().value(QStringLiteral("status")).toString(), QString("error"));
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+#endif
+}
+
+void TestJSONRPC::testCachedReplyCborEncoding()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR requires Qt 5.12");
+#else
+    QVariantMap expected = injectAndWait("Integrations.GetVendors").toMap().value("params").toMap();
+    QVERIFY(!expected.value("vendors").toList().isEmpty());
+
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    qApp->processEvents();
+
+    QVariantMap params;
+    params.insert("encoding", "EncodingCbor");
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", params, newClientId).toMap();
+    QCOMPARE(handShake.value("params").toMap().value("encoding").toString(), QString("EncodingCbor"));
+
+    // The JSON call above filled the reply cache, both calls must be served from it in CBOR
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    for (int i = 0; i < 2; i++) {
+        QCborMap call;
+        call.insert(QStringLiteral("id"), 100 + i);
+        call.insert(QStringLiteral("method"), QStringLiteral("Integrations.GetVendors"));
+        call.insert(QStringLiteral("token"), QString::fromUtf8(m_apiToken));
+        QByteArray payload = call.toCborValue().toCbor();
+        QByteArray frame(4, 0);
+        qToBigEndian<quint32>(static_cast<quint32>(payload.size()), reinterpret_cast<uchar*>(frame.data()));
+        frame.append(payload);
+
+        spy.clear();
+        m_mockTcpServer->injectData(newClientId, frame);
+        if (spy.count() == 0) {
+            spy.wait();
+        }
+        QCOMPARE(spy.count(), 1);
+
+        QCborParserError error;
+        QCborValue response = QCborValue::fromCbor(spy.first().at(1).toByteArray().mid(4), &error);
+        QVERIFY(error.error == QCborError::NoError);
+        QCOMPARE(static_cast<int>(response.toMap().value(QStringLiteral("id")).toInteger()), 100 + i);
+        QCOMPARE(response.toMap().value(QStringLiteral("status")).toString(), QString("success"));
+        QCOMPARE(response.toMap().value(QStringLiteral("params")).toVariant().toMap(), expected);
+    }
+
+    emit m_mockTcpServer->clientDisconnected(newClientId);
+#endif
+}
+
 void TestJSONRPC::testInitialSetup()
 {
     foreach (const QString &user, NymeaCore::instance()->userManager()->users()) {
@@ -1018,6 +1282,183 @@ void TestJSONRPC::stateChangeEmitsNotifications()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newVal);
 }
 
+void TestJSONRPC::stateChangeNotificationFilter()
+{
+    enableNotifications({"Integrations"});
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    // Subscribe to some other thing only
+    QVariantMap filter;
+    filter.insert("thingIds", QVariantList() << QUuid::createUuid());
+    QVariantMap params;
+    params.insert("filter", filter);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationFilter", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    clientSpy.clear();
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(11)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QTest::qWait(500);
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Got a notification for a thing which is not subscribed.");
+
+    // Subscribe to the mock thing but another state
+    filter.insert("thingIds", QVariantList() << m_mockThingId);
+    filter.insert("stateTypeIds", QVariantList() << QUuid::createUuid());
+    params.insert("filter", filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilter", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(12)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QTest::qWait(500);
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Got a notification for a state which is not subscribed.");
+    // Thing related notifications which don't carry a state are still sent
+    QVERIFY2(!checkNotifications(clientSpy, "Integrations.EventTriggered").isEmpty(), "Did not get Integrations.EventTriggered notification.");
+
+    // Subscribe to the mock thing and the state
+    filter.insert("stateTypeIds", QVariantList() << stateTypeId);
+    params.insert("filter", filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilter", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    clientSpy.clear();
+    request.setUrl(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(13)));
+    reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    while (checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty() && clientSpy.wait()) { }
+    QVariantList stateChangedVariants = checkNotifications(clientSpy, "Integrations.StateChanged");
+    QCOMPARE(stateChangedVariants.count(), 1);
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("thingId").toUuid(), QUuid(m_mockThingId));
+    QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 13);
+
+    // Remove the filter again
+    response = injectAndWait("JSONRPC.SetNotificationFilter");
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QVERIFY(disableNotifications());
+}
+
+void TestJSONRPC::stateChangeNotificationRateLimit()
+{
+    // The same state change is sent in both namespaces, they must not replace each other
+    enableNotifications({"Devices", "Integrations"});
+
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+
+    QVariantMap params;
+    params.insert("minInterval", 1000);
+    QVariant response = injectAndWait("JSONRPC.SetNotificationRateLimit", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("minInterval").toUInt(), 1000u);
+
+    // The first change is sent right away, the following ones are coalesced into the last one
+    clientSpy.clear();
+    for (int i = 21; i <= 23; i++) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(i)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+    }
+    QTest::qWait(200);
+    foreach (const QString &notificationName, QStringList({"Devices.StateChanged", "Integrations.StateChanged"})) {
+        QVariantList stateChangedVariants = checkNotifications(clientSpy, notificationName);
+        QVERIFY2(stateChangedVariants.count() == 1, qUtf8Printable(notificationName));
+        QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 21);
+    }
+
+    clientSpy.clear();
+    while ((checkNotifications(clientSpy, "Devices.StateChanged").isEmpty() || checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty()) && clientSpy.wait()) { }
+    foreach (const QString &notificationName, QStringList({"Devices.StateChanged", "Integrations.StateChanged"})) {
+        QVariantList stateChangedVariants = checkNotifications(clientSpy, notificationName);
+        QVERIFY2(stateChangedVariants.count() == 1, qUtf8Printable(notificationName));
+        QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 23);
+        QCOMPARE(stateChangedVariants.first().toMap().value("coalesced").toInt(), 1);
+    }
+
+    params.insert("minInterval", 0);
+    response = injectAndWait("JSONRPC.SetNotificationRateLimit", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    // Pretend the client can't keep up, state changes are held back until it has caught up
+    m_mockTcpServer->setBytesToWrite(m_clientId, 1024 * 1024);
+    clientSpy.clear();
+    for (int i = 24; i <= 26; i++) {
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(stateTypeId.toString()).arg(i)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        QSignalSpy replySpy(reply, SIGNAL(finished()));
+        replySpy.wait();
+    }
+    QTest::qWait(200);
+    QVERIFY2(checkNotifications(clientSpy, "Devices.StateChanged").isEmpty(), "Got a state change notification for a congested client.");
+    QVERIFY2(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty(), "Got a state change notification for a congested client.");
+
+    m_mockTcpServer->setBytesToWrite(m_clientId, 0);
+    while ((checkNotifications(clientSpy, "Devices.StateChanged").isEmpty() || checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty()) && clientSpy.wait()) { }
+    foreach (const QString &notificationName, QStringList({"Devices.StateChanged", "Integrations.StateChanged"})) {
+        QVariantList stateChangedVariants = checkNotifications(clientSpy, notificationName);
+        QVERIFY2(stateChangedVariants.count() == 1, qUtf8Printable(notificationName));
+        QCOMPARE(stateChangedVariants.first().toMap().value("params").toMap().value("value").toInt(), 26);
+        QCOMPARE(stateChangedVariants.first().toMap().value("dropped").toInt(), 2);
+    }
+
+    QVERIFY(disableNotifications());
+}
+
+void TestJSONRPC::heldBackStateChangesDroppedOnThingRemoval()
+{
+    enableNotifications({"Integrations"});
+
+    QVariantList thingParams;
+    QVariantMap httpportParam;
+    httpportParam.insert("paramTypeId", mockThingHttpportParamTypeId);
+    httpportParam.insert("value", 5679);
+    thingParams.append(httpportParam);
+    QVariantMap params;
+    params.insert("thingClassId", mockThingClassId);
+    params.insert("name", "Removed mock");
+    params.insert("thingParams", thingParams);
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("thingError").toString(), QString("ThingErrorNoError"));
+    ThingId thingId = ThingId(response.toMap().value("params").toMap().value("thingId").toUuid());
+
+    // Hold back a state change of the new thing for the congested client
+    QNetworkAccessManager nam;
+    QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
+    QUuid stateTypeId("80baec19-54de-4948-ac46-31eabfaceb83");
+    m_mockTcpServer->setBytesToWrite(m_clientId, 1024 * 1024);
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(5679).arg(stateTypeId.toString()).arg(42)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+    QSignalSpy replySpy(reply, SIGNAL(finished()));
+    replySpy.wait();
+    QTest::qWait(200);
+    QVERIFY(checkNotifications(clientSpy, "Integrations.StateChanged").isEmpty());
+
+    params.clear();
+    params.insert("thingId", thingId);
+    response = injectAndWait("Integrations.RemoveThing", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("thingError").toString(), QString("ThingErrorNoError"));
+
+    // Once the client catches up, the state change of the removed thing must not show up anymore
+    clientSpy.clear();
+    m_mockTcpServer->setBytesToWrite(m_clientId, 0);
+    QTest::qWait(200);
+    foreach (const QVariant &notification, checkNotifications(clientSpy, "Integrations.StateChanged")) {
+        QVERIFY2(notification.toMap().value("params").toMap().value("thingId").toUuid() != thingId, "Got a state change notification for a removed thing.");
+    }
+
+    QVERIFY(disableNotifications());
+}
+
 void TestJSONRPC::pluginConfigChangeEmitsNotification()
 {
     QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
@@ -1374,6 +1815,153 @@ void TestJSONRPC::testDataFragmentation()
     QCOMPARE(jsonDoc.toVariant().toMap().value("status").toString(), QStringLiteral("success"));
 }
 
+void TestJSONRPC::testPackerRoundTrip()
+{
+    // The core handlers have registered nymea's Param and ParamList already
+    PackerTestHandler handler;
+
+    packertest::ParamList params;
+    packertest::Param first;
+    first.setName("first");
+    first.setWeight(1);
+    params.append(first);
+    packertest::Param second;
+    second.setName("second");
+    second.setWeight(2);
+    params.append(second);
+    packertest::Holder holder;
+    holder.setParams(params);
+
+    QVariantMap packed = handler.pack(holder).toMap();
+    QVariantList packedParams = packed.value("params").toList();
+    QCOMPARE(packedParams.count(), 2);
+    QCOMPARE(packedParams.at(0).toMap().value("name").toString(), QString("first"));
+    QCOMPARE(packedParams.at(1).toMap().value("weight").toInt(), 2);
+    QVERIFY(!packedParams.at(0).toMap().contains("paramTypeId"));
+
+    packertest::Holder unpacked = handler.unpack<packertest::Holder>(packed);
+    QCOMPARE(unpacked.params().count(), 2);
+    QCOMPARE(unpacked.params().at(0).name(), QString("first"));
+    QCOMPARE(unpacked.params().at(1).weight(), 2);
+
+    // The nymea types of the same name must still be packed with their own packers
+    ParamTypeId paramTypeId = ParamTypeId::createParamTypeId();
+    ParamList nymeaParams;
+    nymeaParams.append(Param(paramTypeId, 5));
+    QVariantList packedNymeaParams = handler.pack(nymeaParams).toList();
+    QCOMPARE(packedNymeaParams.count(), 1);
+    QCOMPARE(packedNymeaParams.first().toMap().value("paramTypeId").toUuid(), static_cast<QUuid>(paramTypeId));
+    QCOMPARE(packedNymeaParams.first().toMap().value("value").toInt(), 5);
+    QVERIFY(!packedNymeaParams.first().toMap().contains("name"));
+}
+
+void TestJSONRPC::testFramingNestedObjects()
+{
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+
+    // A fragment ending with a nested object or braces within strings must not end the packet,
+    // and packets following each other don't need a separator
+    m_mockTcpServer->injectData(m_clientId, "{\"id\": 555, \"method\": \"JSONRPC.Hello\", \"params\": {\"locale\": \"en_US\"}");
+    m_mockTcpServer->injectData(m_clientId, ", \"comment\": \"}\\n{ \\\"}\"}{\"id\": 556, \"method\": \"JSONRPC.Hello\"}");
+    while (spy.count() < 2 && spy.wait()) { }
+    QCOMPARE(spy.count(), 2);
+
+    for (int i = 0; i < spy.count(); i++) {
+        QVariantMap response = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant().toMap();
+        QCOMPARE(response.value("id").toInt(), 555 + i);
+        QCOMPARE(response.value("status").toString(), QStringLiteral("success"));
+    }
+}
+
+void TestJSONRPC::testLargeScriptUpload()
+{
+    // Scripts may exceed the default packet size limit by far
+    QString content = "import QtQuick 2.0\nItem {\n";
+    while (content.size() < 256 * 1024) {
+        content.append("    // Padding the script beyond the default packet size limit\n");
+    }
+    content.append("}\n");
+
+    QVariantMap params;
+    params.insert("name", "Large script");
+    params.insert("content", content);
+    QVariantMap response = injectAndWait("Scripts.AddScript", params).toMap();
+    QCOMPARE(response.value("status").toString(), QStringLiteral("success"));
+    QCOMPARE(response.value("params").toMap().value("scriptError").toString(), QStringLiteral("ScriptErrorNoError"));
+
+    params.clear();
+    params.insert("id", response.value("params").toMap().value("script").toMap().value("id"));
+    response = injectAndWait("Scripts.RemoveScript", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("scriptError").toString(), QStringLiteral("ScriptErrorNoError"));
+}
+
+void TestJSONRPC::testPacketSizeLimit()
+{
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", QVariantMap(), newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QStringLiteral("success"));
+
+    QSignalSpy dataSpy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    QSignalSpy terminatedSpy(m_mockTcpServer, &MockTcpServer::connectionTerminated);
+
+    // Methods without a limit of their own may not exceed the default limit, even if complete
+    QByteArray packet = "{\"id\": 555, \"method\": \"JSONRPC.Version\", \"comment\": \"" + QByteArray(128 * 1024, 'a') + "\"}\n";
+    m_mockTcpServer->injectData(newClientId, packet);
+    if (terminatedSpy.count() == 0) {
+        terminatedSpy.wait();
+    }
+    QCOMPARE(terminatedSpy.count(), 1);
+    QCOMPARE(dataSpy.count(), 1);
+    QVariantMap response = QJsonDocument::fromJson(dataSpy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("status").toString(), QStringLiteral("error"));
+}
+
+void TestJSONRPC::testPacketSizeLimitMethodLast()
+{
+    QSignalSpy dataSpy(m_mockTcpServer, &MockTcpServer::outgoingData);
+
+    // Members may come in any order, so a large script must pass even if its method comes last
+    QByteArray content = "import QtQuick 2.0\\nItem {\\n";
+    while (content.size() < 256 * 1024) {
+        content.append("    // Padding the script beyond the default packet size limit\\n");
+    }
+    content.append("}\\n");
+    QByteArray packet = "{\"id\": 555, \"params\": {\"name\": \"Large script\", \"content\": \"" + content + "\"}, \"method\": \"Scripts.AddScript\"}\n";
+    m_mockTcpServer->injectData(m_clientId, packet);
+    if (dataSpy.count() == 0) {
+        dataSpy.wait();
+    }
+    QCOMPARE(dataSpy.count(), 1);
+    QVariantMap response = QJsonDocument::fromJson(dataSpy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("id").toInt(), 555);
+    QCOMPARE(response.value("status").toString(), QStringLiteral("success"));
+    QCOMPARE(response.value("params").toMap().value("scriptError").toString(), QStringLiteral("ScriptErrorNoError"));
+
+    QVariantMap params;
+    params.insert("id", response.value("params").toMap().value("script").toMap().value("id"));
+    response = injectAndWait("Scripts.RemoveScript", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("scriptError").toString(), QStringLiteral("ScriptErrorNoError"));
+
+    // Once complete, the packet must still fit the limit of its method
+    QUuid newClientId = QUuid::createUuid();
+    m_mockTcpServer->clientConnected(newClientId);
+    QVariantMap handShake = injectAndWait("JSONRPC.Hello", QVariantMap(), newClientId).toMap();
+    QCOMPARE(handShake.value("status").toString(), QStringLiteral("success"));
+
+    dataSpy.clear();
+    QSignalSpy terminatedSpy(m_mockTcpServer, &MockTcpServer::connectionTerminated);
+    packet = "{\"id\": 556, \"comment\": \"" + QByteArray(128 * 1024, 'a') + "\", \"method\": \"JSONRPC.Version\"}\n";
+    m_mockTcpServer->injectData(newClientId, packet);
+    if (terminatedSpy.count() == 0) {
+        terminatedSpy.wait();
+    }
+    QCOMPARE(terminatedSpy.count(), 1);
+    QCOMPARE(dataSpy.count(), 1);
+    response = QJsonDocument::fromJson(dataSpy.first().at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(response.value("status").toString(), QStringLiteral("error"));
+}
+
 void TestJSONRPC::testGarbageData()
 {
     QSignalSpy spy(m_mockTcpServer, &MockTcpServer::connectionTerminated);
@@ -1388,6 +1976,118 @@ void TestJSONRPC::testGarbageData()
     QCOMPARE(spy.count(), 1);
 }
 
+void TestJSONRPC::getMetrics()
+{
+    QVariantMap metrics;
+    QVariant response = injectAndWait("System.GetMetrics");
+    foreach (const QVariant &metric, response.toMap().value("params").toMap().value("metrics").toList()) {
+        metrics.insert(metric.toMap().value("name").toString(), metric);
+    }
+    QVERIFY2(metrics.contains("nymea_jsonrpc_requests_total"), "Request counter missing");
+    QVERIFY2(metrics.contains("nymea_logengine_queue_depth"), "Log engine queue depth missing");
+    QVERIFY2(metrics.contains("nymea_event_loop_lag_seconds"), "Event loop lag missing");
+
+    QVariantMap requests = metrics.value("nymea_jsonrpc_requests_total").toMap();
+    QCOMPARE(requests.value("type").toString(), QString("counter"));
+    QCOMPARE(requests.value("labelName").toString(), QString("method"));
+    double versionCalls = 0;
+    foreach (const QVariant &sample, requests.value("samples").toList()) {
+        if (sample.toMap().value("labelValue").toString() == "JSONRPC.Version") {
+            versionCalls = sample.toMap().value("value").toDouble();
+        }
+    }
+
+    for (int i = 0; i < 5; i++) {
+        injectAndWait("JSONRPC.Version");
+    }
+
+    // Unknown methods must not show up as label values
+    injectAndWait("JSONRPC.NoSuchMethod");
+
+    metrics.clear();
+    response = injectAndWait("System.GetMetrics");
+    foreach (const QVariant &metric, response.toMap().value("params").toMap().value("metrics").toList()) {
+        metrics.insert(metric.toMap().value("name").toString(), metric);
+    }
+
+    QVariantMap versionSample;
+    foreach (const QVariant &sample, metrics.value("nymea_jsonrpc_requests_total").toMap().value("samples").toList()) {
+        QVERIFY(sample.toMap().value("labelValue").toString() != "JSONRPC.NoSuchMethod");
+        if (sample.toMap().value("labelValue").toString() == "JSONRPC.Version") {
+            versionSample = sample.toMap();
+        }
+    }
+    QCOMPARE(versionSample.value("value").toDouble(), versionCalls + 5);
+
+    // Every request ends up in exactly one latency bucket
+    QVariantMap latencySample;
+    QVariantMap latency = metrics.value("nymea_jsonrpc_request_duration_seconds").toMap();
+    QCOMPARE(latency.value("type").toString(), QString("histogram"));
+    foreach (const QVariant &sample, latency.value("samples").toList()) {
+        if (sample.toMap().value("labelValue").toString() == "JSONRPC.Version") {
+            latencySample = sample.toMap();
+        }
+    }
+    QCOMPARE(latencySample.value("count").toDouble(), versionCalls + 5);
+    QVariantList buckets = latencySample.value("buckets").toList();
+    QVERIFY(!buckets.isEmpty());
+    quint64 previous = 0;
+    foreach (const QVariant &bucket, buckets) {
+        QVERIFY(bucket.toMap().value("count").toULongLong() >= previous);
+        previous = bucket.toMap().value("count").toULongLong();
+    }
+    QVERIFY(previous <= latencySample.value("count").toULongLong());
+}
+
+void TestJSONRPC::getMemoryUsage()
+{
+    QVariant response = injectAndWait("System.GetMemoryUsage");
+    QVariantMap usage = response.toMap().value("params").toMap();
+    QVERIFY(usage.value("residentBytes").toLongLong() > 0);
+    QCOMPARE(usage.value("allocationSamplingInterval").toInt(), 0);
+    QVERIFY(!usage.value("snapshots").toList().isEmpty());
+
+    QVariantMap subsystems;
+    foreach (const QVariant &subsystem, usage.value("subsystems").toList()) {
+        subsystems.insert(subsystem.toMap().value("name").toString(), subsystem);
+    }
+    QVERIFY2(subsystems.contains("logengine.queue"), "Log engine queue missing");
+    QVERIFY2(subsystems.contains("jsonrpc.clientBuffers"), "Client buffers missing");
+    QVERIFY2(subsystems.contains("thingmanager.pendingActions"), "Pending actions missing");
+    QVERIFY(subsystems.value("jsonrpc.clients").toMap().value("objects").toInt() >= 1);
+    QVERIFY(subsystems.value("thingmanager.things").toMap().value("objects").toInt() >= 1);
+
+    // Sampling can be enabled at runtime
+    QVariantMap params;
+    params.insert("interval", 1024);
+    params.insert("reset", true);
+    response = injectAndWait("System.SetAllocationSampling", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    for (int i = 0; i < 10; i++) {
+        injectAndWait("Integrations.GetThings");
+    }
+
+    response = injectAndWait("System.GetMemoryUsage");
+    usage = response.toMap().value("params").toMap();
+    QCOMPARE(usage.value("allocationSamplingInterval").toInt(), 1024);
+    QVariantList sites = usage.value("allocationSites").toList();
+    QVERIFY(!sites.isEmpty());
+    QVERIFY(!sites.first().toMap().value("stack").toStringList().isEmpty());
+    QVERIFY(sites.first().toMap().value("samples").toULongLong() >= 1);
+
+    params.insert("interval", 0);
+    params.insert("reset", true);
+    response = injectAndWait("System.SetAllocationSampling", params);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    response = injectAndWait("System.GetMemoryUsage");
+    usage = response.toMap().value("params").toMap();
+    QCOMPARE(usage.value("allocationSamplingInterval").toInt(), 0);
+    QVERIFY(usage.value("allocationSites").toList().isEmpty());
+    QCOMPARE(usage.value("sampledLiveBytes").toULongLong(), static_cast<quint64>(0));
+}
+
 #include "testjsonrpc.moc"
 
 QTEST_MAIN(TestJSONRPC)
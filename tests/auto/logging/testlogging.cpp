@@ -83,6 +83,9 @@ private slots:
 
     void testLimits();
 
+    void stateLoggingPolicies();
+    void stateLoggingDeadbandHold();
+
     // this has to be the last test
     void removeThing();
 };
@@ -711,6 +714,127 @@ void TestLogging::testLimits()
     QCOMPARE(response.value("params").toMap().value("logEntries").toList().count(), 10);
 }
 
+void TestLogging::stateLoggingPolicies()
+{
+    auto setIntState = [this](int value) {
+        QNetworkAccessManager nam;
+        QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+        QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value))));
+        connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+        spy.wait();
+    };
+
+    QVariantMap policy;
+    policy.insert("thingId", m_mockThingId);
+    policy.insert("stateTypeId", mockIntStateTypeId);
+    policy.insert("mode", "StateLoggingModeAbsoluteDeadband");
+    policy.insert("deadband", 10);
+    QVariantMap params;
+    params.insert("policy", policy);
+    QVariant response = injectAndWait("Logging.SetStateLoggingPolicy", params);
+    verifyLoggingError(response);
+
+    response = injectAndWait("Logging.GetStateLoggingPolicies");
+    QVariantList policies = response.toMap().value("params").toMap().value("policies").toList();
+    QCOMPARE(policies.count(), 1);
+    QCOMPARE(policies.first().toMap().value("mode").toString(), QString("StateLoggingModeAbsoluteDeadband"));
+    QCOMPARE(policies.first().toMap().value("thingId").toUuid(), QUuid(m_mockThingId));
+
+    response = injectAndWait("Logging.GetStateLoggingStatistics");
+    QVariantMap statisticsBefore = response.toMap().value("params").toMap();
+
+    // A big change passes the deadband, a small one after it doesn't
+    int value = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId)->stateValue(mockIntStateTypeId).toInt();
+    setIntState(value + 100);
+    setIntState(value + 101);
+    waitForDBSync();
+
+    response = injectAndWait("Logging.GetStateLoggingStatistics");
+    QVariantMap statistics = response.toMap().value("params").toMap();
+    QCOMPARE(statistics.value("written").toUInt(), statisticsBefore.value("written").toUInt() + 1);
+    QCOMPARE(statistics.value("suppressedDeadband").toUInt(), statisticsBefore.value("suppressedDeadband").toUInt() + 1);
+
+    params.clear();
+    params.insert("typeIds", QVariantList() << mockIntStateTypeId);
+    params.insert("thingIds", QVariantList() << m_mockThingId);
+    params.insert("limit", 1);
+    response = injectAndWait("Logging.GetLogEntries", params);
+    QVariantList logEntries = response.toMap().value("params").toMap().value("logEntries").toList();
+    QCOMPARE(logEntries.count(), 1);
+    QCOMPARE(logEntries.first().toMap().value("value").toInt(), value + 100);
+
+    // Invalid policies are rejected
+    policy.insert("deadband", -1);
+    params.clear();
+    params.insert("policy", policy);
+    response = injectAndWait("Logging.SetStateLoggingPolicy", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidPolicy);
+
+    params.clear();
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    response = injectAndWait("Logging.RemoveStateLoggingPolicy", params);
+    verifyLoggingError(response);
+    response = injectAndWait("Logging.RemoveStateLoggingPolicy", params);
+    verifyLoggingError(response, Logging::LoggingErrorPolicyNotFound);
+
+    response = injectAndWait("Logging.GetStateLoggingPolicies");
+    QCOMPARE(response.toMap().value("params").toMap().value("policies").toList().count(), 0);
+}
+
+void TestLogging::stateLoggingDeadbandHold()
+{
+    auto setIntState = [this](int value) {
+        QNetworkAccessManager nam;
+        QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+        QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(value))));
+        connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+        spy.wait();
+    };
+
+    QVariantMap policy;
+    policy.insert("thingId", m_mockThingId);
+    policy.insert("stateTypeId", mockIntStateTypeId);
+    policy.insert("mode", "StateLoggingModeAbsoluteDeadband");
+    policy.insert("deadband", 10);
+    policy.insert("minimumInterval", 300);
+    policy.insert("sampleAndHold", true);
+    QVariantMap params;
+    params.insert("policy", policy);
+    QVariant response = injectAndWait("Logging.SetStateLoggingPolicy", params);
+    verifyLoggingError(response);
+
+    response = injectAndWait("Logging.GetStateLoggingStatistics");
+    QVariantMap statisticsBefore = response.toMap().value("params").toMap();
+
+    // The small change is held back by the deadband and written once the interval has passed, not only on shutdown
+    int value = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId)->stateValue(mockIntStateTypeId).toInt();
+    setIntState(value + 100);
+    setIntState(value + 101);
+    QTest::qWait(600);
+    waitForDBSync();
+
+    response = injectAndWait("Logging.GetStateLoggingStatistics");
+    QVariantMap statistics = response.toMap().value("params").toMap();
+    QCOMPARE(statistics.value("suppressedDeadband").toUInt(), statisticsBefore.value("suppressedDeadband").toUInt() + 1);
+    QCOMPARE(statistics.value("released").toUInt(), statisticsBefore.value("released").toUInt() + 1);
+
+    params.clear();
+    params.insert("typeIds", QVariantList() << mockIntStateTypeId);
+    params.insert("thingIds", QVariantList() << m_mockThingId);
+    params.insert("limit", 1);
+    response = injectAndWait("Logging.GetLogEntries", params);
+    QVariantList logEntries = response.toMap().value("params").toMap().value("logEntries").toList();
+    QCOMPARE(logEntries.count(), 1);
+    QCOMPARE(logEntries.first().toMap().value("value").toInt(), value + 101);
+
+    params.clear();
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    response = injectAndWait("Logging.RemoveStateLoggingPolicy", params);
+    verifyLoggingError(response);
+}
+
 void TestLogging::removeThing()
 {
     // enable notifications
@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "servers/mqttbroker.h"
+#include "servers/mqtttopicmatcher.h"
 #include "servers/mocktcpserver.h"
 
 #include "nymea-mqtt/mqttclient.h"
@@ -57,6 +58,8 @@ private slots:
 
     void testSubscribePolicy_data();
     void testSubscribePolicy();
+
+    void benchmarkTopicMatcher();
 };
 
 void TestMqttBroker::initTestCase()
@@ -448,6 +451,43 @@ void TestMqttBroker::testSubscribePolicy()
     QCOMPARE(clientSubscribedSpy.count(), (allowed ? 1 : 0));
 }
 
+void TestMqttBroker::benchmarkTopicMatcher()
+{
+    // A policy as created for a Tasmota device plus a few more generic filters
+    QStringList filters;
+    filters << "tasmota-4d2f/#" << "tele/tasmota-4d2f/+" << "stat/tasmota-4d2f/+" << "/+/shellies/#";
+    for (int i = 0; i < 20; i++) {
+        filters << QString("cmnd/device%1/POWER").arg(i);
+    }
+    MqttTopicMatcher matcher(filters);
+
+    QStringList topics;
+    topics << "tele/tasmota-4d2f/SENSOR" << "stat/tasmota-4d2f/POWER" << "tasmota-4d2f/a/b/c" << "/x/shellies/relay/0" << "cmnd/device19/POWER";
+    QStringList deniedTopics;
+    deniedTopics << "tele/tasmota-0000/SENSOR" << "stat/tasmota-4d2f/a/b" << "cmnd/device20/POWER" << "/shellies/relay/0";
+
+    foreach (const QString &topic, topics) {
+        QVERIFY2(matcher.matches(topic), topic.toUtf8());
+    }
+    foreach (const QString &topic, deniedTopics) {
+        QVERIFY2(!matcher.matches(topic), topic.toUtf8());
+    }
+
+    int authorizations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        foreach (const QString &topic, topics) {
+            authorizations += matcher.matches(topic) ? 1 : 0;
+        }
+        foreach (const QString &topic, deniedTopics) {
+            authorizations += matcher.matches(topic) ? 0 : 1;
+        }
+    }
+    qint64 elapsed = qMax(timer.nsecsElapsed(), Q_INT64_C(1));
+    qDebug() << "Authorizations per second:" << static_cast<qint64>(authorizations * 1000000000.0 / elapsed);
+}
+
 
 #include "testmqttbroker.moc"
 QTEST_MAIN(TestMqttBroker)
@@ -83,6 +83,12 @@ private slots:
     void executeRuleActions_data();
     void executeRuleActions();
 
+    void executeRuleActionsPerThingOrder();
+
+    void executeRuleActionsErrorsLogged();
+
+    void triggeredRulesLoggedPerRule();
+
     void findRule();
 
     void removeInvalidRule();
@@ -3014,6 +3020,155 @@ void TestRules::testInterfaceBasedStateRule()
     verifyRuleExecuted(mockPowerActionTypeId);
 }
 
+void TestRules::executeRuleActionsPerThingOrder()
+{
+    QVariantMap asyncAction;
+    asyncAction.insert("thingId", m_mockThingId);
+    asyncAction.insert("actionTypeId", mockAsyncActionTypeId);
+    QVariantMap noParamsAction;
+    noParamsAction.insert("thingId", m_mockThingId);
+    noParamsAction.insert("actionTypeId", mockWithoutParamsActionTypeId);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "Ordered actions");
+    addRuleParams.insert("actions", QVariantList() << asyncAction << noParamsAction);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QList<LogEntry> entries;
+    QMetaObject::Connection connection = connect(NymeaCore::instance()->logEngine(), &LogEngine::logEntryAdded, this, [&entries, ruleId](const LogEntry &entry){
+        if (entry.source() == Logging::LoggingSourceRules && entry.typeId() == ruleId) {
+            entries.append(entry);
+        }
+    });
+
+    cleanupMockHistory();
+
+    QVariantMap executeParams;
+    executeParams.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.ExecuteActions", executeParams);
+    verifyRuleError(response);
+
+    // The async action takes a second, the second action for the same thing has to wait for it
+    QTest::qWait(200);
+    verifyRuleNotExecuted();
+    QVERIFY(entries.isEmpty());
+
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+    QTRY_COMPARE(entries.count(), 1);
+    QCOMPARE(entries.first().eventType(), Logging::LoggingEventTypeActionsExecuted);
+    QCOMPARE(entries.first().level(), Logging::LoggingLevelInfo);
+
+    disconnect(connection);
+
+    QVariantMap removeParams;
+    removeParams.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+}
+
+void TestRules::executeRuleActionsErrorsLogged()
+{
+    QVariantMap failingAction;
+    failingAction.insert("thingId", m_mockThingId);
+    failingAction.insert("actionTypeId", mockFailingActionTypeId);
+    QVariantMap noParamsAction;
+    noParamsAction.insert("thingId", m_mockThingId);
+    noParamsAction.insert("actionTypeId", mockWithoutParamsActionTypeId);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "Failing actions");
+    addRuleParams.insert("actions", QVariantList() << failingAction << noParamsAction);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QList<LogEntry> entries;
+    QMetaObject::Connection connection = connect(NymeaCore::instance()->logEngine(), &LogEngine::logEntryAdded, this, [&entries, ruleId](const LogEntry &entry){
+        if (entry.source() == Logging::LoggingSourceRules && entry.typeId() == ruleId) {
+            entries.append(entry);
+        }
+    });
+
+    cleanupMockHistory();
+
+    QVariantMap executeParams;
+    executeParams.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.ExecuteActions", executeParams);
+    verifyRuleError(response);
+
+    // A failing action doesn't stop the following ones, the log entry lists the error
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+    QTRY_COMPARE(entries.count(), 1);
+    QCOMPARE(entries.first().eventType(), Logging::LoggingEventTypeActionsExecuted);
+    QCOMPARE(entries.first().level(), Logging::LoggingLevelAlert);
+    QCOMPARE(entries.first().errorCode(), static_cast<int>(Thing::ThingErrorSetupFailed));
+    QCOMPARE(entries.first().value().toList(), QVariantList() << "ThingErrorSetupFailed x1");
+
+    disconnect(connection);
+
+    QVariantMap removeParams;
+    removeParams.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+}
+
+void TestRules::triggeredRulesLoggedPerRule()
+{
+    QVariantMap eventDescriptor;
+    eventDescriptor.insert("eventTypeId", mockEvent1EventTypeId);
+    eventDescriptor.insert("thingId", m_mockThingId);
+
+    QVariantMap failingAction;
+    failingAction.insert("thingId", m_mockThingId);
+    failingAction.insert("actionTypeId", mockFailingActionTypeId);
+    QVariantMap noParamsAction;
+    noParamsAction.insert("thingId", m_mockThingId);
+    noParamsAction.insert("actionTypeId", mockWithoutParamsActionTypeId);
+
+    // Two rules triggered by the same event, only one of them failing
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "Failing on event");
+    addRuleParams.insert("eventDescriptors", QVariantList() << eventDescriptor);
+    addRuleParams.insert("actions", QVariantList() << failingAction);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId failingRuleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    addRuleParams.insert("name", "Succeeding on event");
+    addRuleParams.insert("actions", QVariantList() << noParamsAction);
+    response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId succeedingRuleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QHash<RuleId, LogEntry> entries;
+    QMetaObject::Connection connection = connect(NymeaCore::instance()->logEngine(), &LogEngine::logEntryAdded, this, [&entries](const LogEntry &entry){
+        if (entry.source() == Logging::LoggingSourceRules && entry.eventType() == Logging::LoggingEventTypeActionsExecuted) {
+            entries.insert(RuleId(entry.typeId()), entry);
+        }
+    });
+
+    cleanupMockHistory();
+    generateEvent(mockEvent1EventTypeId);
+
+    // Each rule logs the outcome of its own actions
+    QTRY_COMPARE(entries.count(), 2);
+    QCOMPARE(entries.value(failingRuleId).level(), Logging::LoggingLevelAlert);
+    QCOMPARE(entries.value(failingRuleId).errorCode(), static_cast<int>(Thing::ThingErrorSetupFailed));
+    QCOMPARE(entries.value(succeedingRuleId).level(), Logging::LoggingLevelInfo);
+
+    disconnect(connection);
+
+    QVariantMap removeParams;
+    removeParams.insert("ruleId", failingRuleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+    removeParams.insert("ruleId", succeedingRuleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+}
+
 void TestRules::testLoopingRules()
 {
     QVariantMap powerOnActionParam;
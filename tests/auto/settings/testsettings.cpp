@@ -0,0 +1,222 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeasettings.h"
+#include "settings/inisettingsbackend.h"
+#include "settings/logsettingsbackend.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QtTest>
+
+// No stream operators are registered for this type, so it cannot be written to a QDataStream
+class UnstreamableValue
+{
+public:
+    int value = 0;
+};
+Q_DECLARE_METATYPE(UnstreamableValue)
+
+class TestSettings: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void groupsAndArrays_data();
+    void groupsAndArrays();
+
+    void migrateFromIni();
+    void migrateToIniReplacesOutdatedIni();
+
+    void unstreamableValueIsRefused();
+
+private:
+    QString m_path;
+};
+
+void TestSettings::initTestCase()
+{
+    QCoreApplication::instance()->setOrganizationName("nymea-test");
+    m_path = "/tmp/nymea-test/settingstest/";
+    QDir(m_path).removeRecursively();
+    QDir().mkpath(m_path);
+}
+
+void TestSettings::groupsAndArrays_data()
+{
+    QTest::addColumn<QString>("format");
+
+    QTest::newRow("ini") << "ini";
+    QTest::newRow("log") << "log";
+}
+
+void TestSettings::groupsAndArrays()
+{
+    QFETCH(QString, format);
+
+    SettingsBackend *settings = nullptr;
+    if (format == "ini") {
+        settings = new IniSettingsBackend(m_path + "groups.conf");
+    } else {
+        settings = new LogSettingsBackend(m_path + "groups.store");
+    }
+
+    settings->beginGroup("RuleA");
+    settings->setValue("name", "Rule A");
+    settings->setValue("enabled", true);
+    settings->beginWriteArray("weekDays");
+    for (int i = 0; i < 3; i++) {
+        settings->setArrayIndex(i);
+        settings->setValue("weekDay", i + 1);
+    }
+    settings->endArray();
+    settings->beginGroup("events");
+    settings->setValue("eventTypeId", "ev1");
+    settings->endGroup();
+    settings->endGroup();
+
+    settings->beginGroup("RuleB");
+    settings->setValue("name", "Rule B");
+    settings->endGroup();
+
+    QCOMPARE(settings->childGroups(), QStringList() << "RuleA" << "RuleB");
+    QVERIFY(settings->childKeys().isEmpty());
+
+    settings->beginGroup("RuleA");
+    QCOMPARE(settings->group(), QString("RuleA"));
+    QCOMPARE(settings->childKeys(), QStringList() << "enabled" << "name");
+    QCOMPARE(settings->childGroups(), QStringList() << "events" << "weekDays");
+    QCOMPARE(settings->value("name").toString(), QString("Rule A"));
+    QCOMPARE(settings->value("enabled").toBool(), true);
+    QCOMPARE(settings->value("missing", "default").toString(), QString("default"));
+    int count = settings->beginReadArray("weekDays");
+    QCOMPARE(count, 3);
+    for (int i = 0; i < count; i++) {
+        settings->setArrayIndex(i);
+        QCOMPARE(settings->value("weekDay").toInt(), i + 1);
+    }
+    settings->endArray();
+    QVERIFY(settings->contains("events/eventTypeId"));
+    settings->remove("events");
+    QVERIFY(!settings->contains("events/eventTypeId"));
+    settings->endGroup();
+
+    settings->beginGroup("RuleB");
+    settings->remove("");
+    settings->endGroup();
+    QCOMPARE(settings->childGroups(), QStringList() << "RuleA");
+
+    settings->clear();
+    QVERIFY(settings->allKeys().isEmpty());
+    delete settings;
+}
+
+void TestSettings::migrateFromIni()
+{
+    QString iniFileName = m_path + "migration.conf";
+    QString logFileName = m_path + "migration.store";
+    {
+        QSettings ini(iniFileName, QSettings::IniFormat);
+        ini.beginGroup("Thing");
+        ini.setValue("name", "My thing");
+        ini.setValue("params", QVariantList() << 1 << 2);
+        ini.endGroup();
+    }
+
+    LogSettingsBackend *settings = new LogSettingsBackend(logFileName, iniFileName);
+    QVERIFY(!QFile::exists(iniFileName));
+    QVERIFY(QFile::exists(iniFileName + ".migrated"));
+    QCOMPARE(settings->value("Thing/name").toString(), QString("My thing"));
+    QCOMPARE(settings->value("Thing/params").toList().count(), 2);
+    settings->setValue("Thing/name", "Renamed thing");
+    delete settings;
+
+    // And back to INI
+    QVERIFY(LogSettingsBackend::migrateToIni(logFileName, iniFileName));
+    QVERIFY(!QFile::exists(logFileName));
+    QSettings ini(iniFileName, QSettings::IniFormat);
+    QCOMPARE(ini.value("Thing/name").toString(), QString("Renamed thing"));
+}
+
+void TestSettings::migrateToIniReplacesOutdatedIni()
+{
+    QString iniFileName = m_path + "outdated.conf";
+    QString logFileName = m_path + "outdated.store";
+    {
+        QSettings ini(iniFileName, QSettings::IniFormat);
+        ini.setValue("Thing/name", "My thing");
+    }
+
+    LogSettingsBackend *settings = new LogSettingsBackend(logFileName, iniFileName);
+    settings->setValue("Thing/name", "Renamed thing");
+    delete settings;
+
+    // An outdated INI file shows up again while the settings are in the log
+    {
+        QSettings ini(iniFileName, QSettings::IniFormat);
+        ini.setValue("Thing/name", "My thing");
+        ini.setValue("Removed/name", "Removed thing");
+    }
+
+    QVERIFY(LogSettingsBackend::migrateToIni(logFileName, iniFileName));
+    QSettings ini(iniFileName, QSettings::IniFormat);
+    QCOMPARE(ini.value("Thing/name").toString(), QString("Renamed thing"));
+    QVERIFY(!ini.contains("Removed/name"));
+}
+
+void TestSettings::unstreamableValueIsRefused()
+{
+    QString logFileName = m_path + "unstreamable.store";
+    QString iniFileName = m_path + "unstreamable.conf";
+
+    LogSettingsBackend *settings = new LogSettingsBackend(logFileName);
+    settings->setValue("before", "Before");
+    settings->setValue("broken", QVariant::fromValue(UnstreamableValue()));
+    QVERIFY(!settings->contains("broken"));
+    settings->setValue("after", "After");
+    delete settings;
+
+    // Closes the store, so it is loaded from disk again below
+    QVERIFY(LogSettingsBackend::migrateToIni(logFileName, iniFileName));
+    QVERIFY(QFile::rename(logFileName + ".migrated", logFileName));
+
+    settings = new LogSettingsBackend(logFileName);
+    QCOMPARE(settings->value("before").toString(), QString("Before"));
+    QCOMPARE(settings->value("after").toString(), QString("After"));
+    QVERIFY(!settings->contains("broken"));
+    delete settings;
+}
+
+#include "testsettings.moc"
+QTEST_MAIN(TestSettings)
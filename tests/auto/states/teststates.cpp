@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "jsonrpc/devicehandler.h"
+#include "integrations/thingmanagerimplementation.h"
 
 using namespace nymeaserver;
 
@@ -45,6 +46,8 @@ private slots:
     void getStateValue();
 
     void save_load_states();
+
+    void stateChangeBusStatistics();
 };
 
 void TestStates::getStateTypes()
@@ -140,5 +143,42 @@ void TestStates::save_load_states()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toBool(), mockDeviceClass.getStateType(mockBoolStateTypeId).defaultValue().toBool());
 }
 
+void TestStates::stateChangeBusStatistics()
+{
+    StateChangeBus *bus = qobject_cast<ThingManagerImplementation*>(NymeaCore::instance()->thingManager())->stateChangeBus();
+    QHash<QString, StateChangeBus::StageStatistics> before;
+    foreach (const StateChangeBus::StageStatistics &statistics, bus->statistics()) {
+        before.insert(statistics.stage, statistics);
+    }
+    QStringList stages = {"persistence", "signals", "io", "logging", "jsonrpc", "rules"};
+    foreach (const QString &stage, stages) {
+        QVERIFY2(before.contains(stage), QString("State change stage %1 not registered").arg(stage).toUtf8());
+    }
+    quint64 publishedBefore = bus->publishedChanges();
+
+    Thing* device = NymeaCore::instance()->thingManager()->findConfiguredThings(mockThingClassId).first();
+    int port = device->paramValue(mockThingHttpportParamTypeId).toInt();
+    int newIntValue = device->stateValue(mockIntStateTypeId).toInt() + 1;
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkReply *reply = nam.get(QNetworkRequest(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(newIntValue))));
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    spy.wait();
+    QCOMPARE(device->stateValue(mockIntStateTypeId).toInt(), newIntValue);
+
+    // The persistence stage is batched, everything else sees the change right away
+    bus->flush();
+
+    QVERIFY(bus->publishedChanges() > publishedBefore);
+    foreach (const StateChangeBus::StageStatistics &statistics, bus->statistics()) {
+        if (!stages.contains(statistics.stage)) {
+            continue;
+        }
+        QVERIFY2(statistics.changes > before.value(statistics.stage).changes, QString("Stage %1 did not receive the change").arg(statistics.stage).toUtf8());
+        QVERIFY(statistics.batches > 0);
+        QVERIFY(statistics.maxNsecs <= statistics.totalNsecs);
+    }
+}
+
 #include "teststates.moc"
 QTEST_MAIN(TestStates)
@@ -0,0 +1,243 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "hardware/network/upnp/upnpdiscoveryimplementation.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSignalSpy>
+#include <QtTest>
+
+using namespace nymeaserver;
+
+// Serves a minimal device description for every GET without touching the network
+class DescriptionReply: public QNetworkReply
+{
+    Q_OBJECT
+public:
+    DescriptionReply(const QNetworkRequest &request, QObject *parent):
+        QNetworkReply(parent)
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(QNetworkAccessManager::GetOperation);
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+
+        m_data = QByteArray("<?xml version=\"1.0\"?>"
+                            "<root><device>"
+                            "<deviceType>urn:schemas-upnp-org:device:Basic:1</deviceType>"
+                            "<friendlyName>Test device</friendlyName>"
+                            "<UDN>uuid:" + request.url().path().mid(1).toUtf8() + "</UDN>"
+                            "</device></root>");
+        open(QIODevice::ReadOnly);
+
+        QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+    }
+
+    void abort() override { }
+    qint64 bytesAvailable() const override { return m_data.size() - m_offset + QIODevice::bytesAvailable(); }
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 size = qMin(maxSize, qint64(m_data.size() - m_offset));
+        memcpy(data, m_data.constData() + m_offset, size);
+        m_offset += size;
+        return size;
+    }
+
+private slots:
+    void finish()
+    {
+        setFinished(true);
+        emit readyRead();
+        emit finished();
+    }
+
+private:
+    QByteArray m_data;
+    qint64 m_offset = 0;
+};
+
+class DescriptionServer: public QNetworkAccessManager
+{
+    Q_OBJECT
+public:
+    QList<QUrl> requests;
+
+protected:
+    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoingData = nullptr) override
+    {
+        Q_UNUSED(op)
+        Q_UNUSED(outgoingData)
+        requests.append(request.url());
+        return new DescriptionReply(request, this);
+    }
+};
+
+class TestUpnp: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void duplicateSearchResponses();
+    void descriptorCacheExpiry();
+    void byeByeEvictsDescriptor();
+
+private:
+    QByteArray searchResponse(const QString &uuid, int maxAge) const;
+    QByteArray notifyMessage(const QString &uuid, const QString &nts) const;
+    UpnpDiscoveryReply *startDiscovery(UpnpDiscoveryImplementation *upnp) const;
+    bool waitForRequests(DescriptionServer *server, int count) const;
+
+    QHostAddress m_device = QHostAddress("192.168.0.10");
+};
+
+QByteArray TestUpnp::searchResponse(const QString &uuid, int maxAge) const
+{
+    return QByteArray("HTTP/1.1 200 OK\r\n"
+                      "CACHE-CONTROL: max-age=" + QByteArray::number(maxAge) + "\r\n"
+                      "EXT:\r\n"
+                      "LOCATION: http://192.168.0.10:8080/" + uuid.toUtf8() + "\r\n"
+                      "SERVER: test UPnP/1.1\r\n"
+                      "ST: upnp:rootdevice\r\n"
+                      "USN: uuid:" + uuid.toUtf8() + "::upnp:rootdevice\r\n"
+                      "\r\n");
+}
+
+QByteArray TestUpnp::notifyMessage(const QString &uuid, const QString &nts) const
+{
+    return QByteArray("NOTIFY * HTTP/1.1\r\n"
+                      "HOST: 239.255.255.250:1900\r\n"
+                      "CACHE-CONTROL: max-age=1800\r\n"
+                      "LOCATION: http://192.168.0.10:8080/" + uuid.toUtf8() + "\r\n"
+                      "NT: upnp:rootdevice\r\n"
+                      "NTS: " + nts.toUtf8() + "\r\n"
+                      "USN: uuid:" + uuid.toUtf8() + "::upnp:rootdevice\r\n"
+                      "\r\n");
+}
+
+UpnpDiscoveryReply *TestUpnp::startDiscovery(UpnpDiscoveryImplementation *upnp) const
+{
+    // Enabled without binding the SSDP socket, datagrams are fed in directly
+    upnp->m_enabled = true;
+    return upnp->discoverDevices("ssdp:all", QString(), 3000);
+}
+
+bool TestUpnp::waitForRequests(DescriptionServer *server, int count) const
+{
+    // Let the queued replies finish, then check that nothing else was fetched
+    QTest::qWait(50);
+    return server->requests.count() == count;
+}
+
+void TestUpnp::duplicateSearchResponses()
+{
+    DescriptionServer server;
+    UpnpDiscoveryImplementation upnp(&server);
+    UpnpDiscoveryReply *reply = startDiscovery(&upnp);
+    QSignalSpy finishedSpy(reply, &UpnpDiscoveryReply::finished);
+    QSignalSpy notifySpy(&upnp, &UpnpDiscovery::upnpNotify);
+
+    // Responses for the same location while the description is being fetched
+    for (int i = 0; i < 3; i++)
+        upnp.processDatagram(searchResponse("device-a", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    // And after it has been cached
+    for (int i = 0; i < 3; i++)
+        upnp.processDatagram(searchResponse("device-a", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    // Alive notifications are passed on, but never fetch a description
+    upnp.processDatagram(notifyMessage("device-a", "ssdp:alive"), m_device, 1900);
+    upnp.processDatagram(notifyMessage("device-a", "ssdp:alive"), m_device, 1900);
+    QCOMPARE(notifySpy.count(), 2);
+    QVERIFY(waitForRequests(&server, 1));
+
+    upnp.processDatagram(searchResponse("device-b", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 2));
+
+    QVERIFY(finishedSpy.wait(10000));
+    QList<UpnpDeviceDescriptor> descriptors = reply->deviceDescriptors();
+    QCOMPARE(descriptors.count(), 2);
+    QCOMPARE(descriptors.at(0).uuid(), QString("uuid:device-a"));
+    QCOMPARE(descriptors.at(1).uuid(), QString("uuid:device-b"));
+}
+
+void TestUpnp::descriptorCacheExpiry()
+{
+    DescriptionServer server;
+    UpnpDiscoveryImplementation upnp(&server);
+    UpnpDiscoveryReply *reply = startDiscovery(&upnp);
+    QSignalSpy finishedSpy(reply, &UpnpDiscoveryReply::finished);
+
+    upnp.processDatagram(searchResponse("device-a", 1), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    upnp.processDatagram(searchResponse("device-a", 1), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    // Once max-age has passed the description is fetched again
+    QTest::qWait(1100);
+    upnp.processDatagram(searchResponse("device-a", 1), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 2));
+    QCOMPARE(server.requests.at(1), server.requests.at(0));
+
+    QVERIFY(finishedSpy.wait(10000));
+    QCOMPARE(reply->deviceDescriptors().count(), 1);
+}
+
+void TestUpnp::byeByeEvictsDescriptor()
+{
+    DescriptionServer server;
+    UpnpDiscoveryImplementation upnp(&server);
+    UpnpDiscoveryReply *reply = startDiscovery(&upnp);
+    QSignalSpy finishedSpy(reply, &UpnpDiscoveryReply::finished);
+
+    upnp.processDatagram(searchResponse("device-a", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    // A byebye for another device leaves the cache alone
+    upnp.processDatagram(notifyMessage("device-b", "ssdp:byebye"), m_device, 1900);
+    upnp.processDatagram(searchResponse("device-a", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 1));
+
+    upnp.processDatagram(notifyMessage("device-a", "ssdp:byebye"), m_device, 1900);
+    upnp.processDatagram(searchResponse("device-a", 1800), m_device, 1900);
+    QVERIFY(waitForRequests(&server, 2));
+
+    QVERIFY(finishedSpy.wait(10000));
+}
+
+#include "testupnp.moc"
+QTEST_MAIN(TestUpnp)
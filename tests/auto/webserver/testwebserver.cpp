@@ -65,6 +65,8 @@ private slots:
     void getDebugServer_data();
     void getDebugServer();
 
+    void getMetrics();
+
 public slots:
     void onSslErrors(const QList<QSslError> &) {
         qWarning() << "SSL error";
@@ -634,5 +636,47 @@ void TestWebserver::getDebugServer()
     QCOMPARE(statusCode, expectedStatusCode);
 }
 
+void TestWebserver::getMetrics()
+{
+    QVariantMap params; QVariant response;
+    params.insert("enabled", true);
+    response = injectAndWait("Configuration.SetDebugServerEnabled", params);
+    verifyError(response, "configurationError", "ConfigurationErrorNoError");
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request;
+    request.setUrl(QUrl("https://localhost:3333/metrics"));
+    QNetworkReply *reply = nam.get(request);
+
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("text/plain"));
+
+    QByteArray data = reply->readAll();
+    QVERIFY(data.contains("# TYPE nymea_jsonrpc_requests_total counter\n"));
+    QVERIFY(data.contains("nymea_jsonrpc_requests_total{method=\"Configuration.SetDebugServerEnabled\"} "));
+    QVERIFY(data.contains("# TYPE nymea_jsonrpc_request_duration_seconds histogram\n"));
+    QVERIFY(data.contains("nymea_jsonrpc_request_duration_seconds_bucket{method=\"Configuration.SetDebugServerEnabled\",le=\"+Inf\"} "));
+    reply->deleteLater();
+
+    // Not available without the debug server
+    params.insert("enabled", false);
+    response = injectAndWait("Configuration.SetDebugServerEnabled", params);
+    verifyError(response, "configurationError", "ConfigurationErrorNoError");
+
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+    reply->deleteLater();
+}
+
 #include "testwebserver.moc"
 QTEST_MAIN(TestWebserver)